@@ -0,0 +1,731 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : rpf -> [uds | lut] -> wpf, one pipeline per VSP
+ *  memory type : mmap
+ *
+ *  Every frame of every pipeline is handed to common/vsp2_async at once;
+ *  the call returns without waiting and the frame's done() runs on one of
+ *  a few executor threads when its wpf buffer is back. No thread blocks in
+ *  an ioctl, the executors sleep in epoll only.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_async.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#ifndef USE_M3
+/* for h3 */
+#define MEDIA_DEV_NAME		"/dev/media3"		/* fe9a0000.vsp */
+#else
+/* for m3 */
+#define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
+#endif
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* source parameter */
+#define SRC_FILENAME		"1280_720_ARGB32.argb"
+#define SRC_WIDTH		(1280)			/* src: width */
+#define SRC_HEIGHT		(720)			/* src: height */
+#define SRC_SIZE		(SRC_WIDTH*SRC_HEIGHT*4)
+
+/* lut parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+
+/* pipeline parameter */
+#define PIPE_MAX		(4)
+#define PIPE_BUF_NUM		(3)		/* buffer sets per pipeline */
+#define PIPE_FRAME_NUM		(200)
+#define ASYNC_THREAD_NUM	(2)
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct async_module {
+	const char	*pname;
+	const char	*pentity;	/* NULL : rpf.0 -> wpf.0 */
+	unsigned int	dst_width;
+	unsigned int	dst_height;
+};
+
+struct async_pipe;
+
+struct async_frame {
+	struct vsp2_async_frame	af;		/* first, done() casts back */
+	struct async_pipe	*ppipe;
+	int			frame;
+	unsigned long long	hash;
+	int			result;
+};
+
+struct async_pipe {
+	int				id;
+	const struct async_module	*pmod;
+	char				devnode[32];
+	unsigned int			dst_size;
+	unsigned char			*pimage;	/* input file */
+
+	struct vsp2_media		*pmedia;
+	int				src_fd;
+	int				dst_fd;
+	MMNGR_ID			lut_id;
+	unsigned long			lut_virt;
+	struct vsp2_async_pipe		*pasync_pipe;
+	struct async_frame		*pframe;	/* frame_num */
+
+	/* executor, one thread at a time per pipeline */
+	int				done;
+	int				failed;
+	long long			t_last;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct async_module async_module[] = {
+	{ "copy",	NULL,		SRC_WIDTH,	SRC_HEIGHT },
+	{ "uds",	"uds.0",	1920,		1080 },
+	{ "lut",	"lut",		SRC_WIDTH,	SRC_HEIGHT },
+};
+
+static struct async_pipe	async_pipe[PIPE_MAX];
+static int			async_pipe_num;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	add_pipe(const char *pspec);
+static int	test_async(int frame_num, int thread_num, int buf_num);
+static int	open_pipe(struct async_pipe *ppipe);
+static void	close_pipe(struct async_pipe *ppipe);
+static void	frame_fill(struct vsp2_async_frame *paf, unsigned char *psrc,
+			   unsigned int size);
+static void	frame_done(struct vsp2_async_frame *paf,
+			   const unsigned char *pdst, unsigned int size,
+			   int result);
+static int	read_file(unsigned char*, unsigned int, const char*);
+static int	call_media_ctl(struct async_pipe *ppipe);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity, int flags);
+static int	commit_lut(struct async_pipe *ppipe);
+static unsigned long long	calc_hash(unsigned long long hash,
+					  const void *pdata, size_t len);
+static long long	get_time_us(void);
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -p <module>[@<media>]: add a pipeline, module is\n");
+	printf("             copy, uds or lut [lut@%s]\n", MEDIA_DEV_NAME);
+	printf("             one pipeline per media device, up to %d\n",
+	       PIPE_MAX);
+	printf("        -n <num>: frames per pipeline, all submitted at once"
+	       " [%d]\n", PIPE_FRAME_NUM);
+	printf("        -t <num>: executor threads [%d]\n", ASYNC_THREAD_NUM);
+	printf("        -q <num>: buffer sets per pipeline [%d]\n",
+	       PIPE_BUF_NUM);
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int	frame_num = PIPE_FRAME_NUM;
+	int	thread_num = ASYNC_THREAD_NUM;
+	int	buf_num = PIPE_BUF_NUM;
+	int	opt;
+	int	i;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "p:n:t:q:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (add_pipe(optarg) < 0)
+				exit(1);
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 't':
+			thread_num = atoi(optarg);
+			break;
+		case 'q':
+			buf_num = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (frame_num < 1 || thread_num < 1 || buf_num < 1 ||
+	    buf_num > VSP2_ASYNC_BUF_MAX) {
+		print_usage(argv[0]);
+		exit(0);
+	}
+	if (async_pipe_num == 0)
+		add_pipe("lut");
+
+	printf("exec ASYNC %d pipeline(s), %d frames, %d thread(s)\n",
+	       async_pipe_num, frame_num, thread_num);
+	for (i = 0; i < async_pipe_num; i++)
+		printf("  pipe %d : %s on %s\n", i, async_pipe[i].pmod->pname,
+		       async_pipe[i].devnode);
+
+	test_async(frame_num, thread_num, buf_num);
+
+	exit(0);
+}
+
+/******************************************************************************
+ *  pipelines
+ ******************************************************************************/
+static int add_pipe(const char *pspec)
+{
+	struct async_pipe	*ppipe;
+	const char		*pdev = MEDIA_DEV_NAME;
+	const char		*pat;
+	size_t			len;
+	int			i;
+
+	if (async_pipe_num >= PIPE_MAX) {
+		printf("Error : too many pipelines (max %d)\n", PIPE_MAX);
+		return -1;
+	}
+
+	pat = strchr(pspec, '@');
+	len = pat ? (size_t)(pat - pspec) : strlen(pspec);
+	if (pat != NULL)
+		pdev = pat + 1;
+
+	ppipe = &async_pipe[async_pipe_num];
+	for (i = 0; i < (int)(sizeof(async_module) / sizeof(async_module[0]));
+	     i++) {
+		if (strlen(async_module[i].pname) == len &&
+		    strncmp(async_module[i].pname, pspec, len) == 0)
+			ppipe->pmod = &async_module[i];
+	}
+	if (ppipe->pmod == NULL) {
+		printf("Error : unknown module (%s)\n", pspec);
+		return -1;
+	}
+
+	/* the pipeline owns the whole device, wpf.0 included */
+	for (i = 0; i < async_pipe_num; i++) {
+		if (strcmp(async_pipe[i].devnode, pdev) == 0) {
+			printf("Error : %s used by two pipelines\n", pdev);
+			return -1;
+		}
+	}
+
+	ppipe->id	= async_pipe_num;
+	ppipe->dst_size	= ppipe->pmod->dst_width * ppipe->pmod->dst_height * 4;
+	ppipe->src_fd	= -1;
+	ppipe->dst_fd	= -1;
+	snprintf(ppipe->devnode, sizeof(ppipe->devnode), "%s", pdev);
+	async_pipe_num++;
+	return 0;
+}
+
+static int test_async(int frame_num, int thread_num, int buf_num)
+{
+	struct vsp2_async	*pasync;
+	struct vsp2_async_stat	stat;
+	struct async_pipe	*ppipe;
+	struct async_frame	*pf;
+	unsigned char		*pimage;
+	long long		t_start, t_submit, t_end;
+	char			name[16];
+	int			mismatch, failed = 0;
+	int			ercd = 0;
+	int			i, j;
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file (shared input, read only after this)                   */
+	/*-------------------------------------------------------------------*/
+	pimage = malloc(SRC_SIZE);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if (read_file(pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		free(pimage);
+		return -1;
+	}
+
+	pasync = vsp2_async_new(thread_num);
+	if (pasync == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		free(pimage);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Pipelines                                                        */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < async_pipe_num; i++) {
+		ppipe = &async_pipe[i];
+		ppipe->pimage = pimage;
+
+		ppipe->pframe = calloc(frame_num, sizeof(*ppipe->pframe));
+		if (ppipe->pframe == NULL || open_pipe(ppipe) < 0) {
+			printf("Error : pipe %d start failed.\n", i);
+			ercd = -1;
+			goto stop;
+		}
+
+		snprintf(name, sizeof(name), "vsp%d-%s", i, ppipe->pmod->pname);
+		ppipe->pasync_pipe = vsp2_async_pipe_new(pasync, name,
+							 ppipe->src_fd,
+							 ppipe->dst_fd,
+							 SRC_SIZE,
+							 ppipe->dst_size,
+							 buf_num);
+		if (ppipe->pasync_pipe == NULL) {
+			printf("Error : pipe %d start failed.\n", i);
+			ercd = -1;
+			goto stop;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Submit every frame, nothing waits here                           */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("submit");
+	t_start = get_time_us();
+	for (j = 0; j < frame_num; j++) {
+		for (i = 0; i < async_pipe_num; i++) {
+			ppipe		= &async_pipe[i];
+			pf		= &ppipe->pframe[j];
+			pf->af.fill	= frame_fill;
+			pf->af.done	= frame_done;
+			pf->ppipe	= ppipe;
+			pf->frame	= j;
+			pf->result	= -1;
+			if (vsp2_async_process(ppipe->pasync_pipe,
+					       &pf->af) < 0)
+				failed++;
+		}
+	}
+	t_submit = get_time_us() - t_start;
+	vsp2_trace_end();
+
+	vsp2_trace_begin("drain");
+	vsp2_async_drain(pasync);
+	t_end = get_time_us();
+	vsp2_trace_end();
+
+	/*-------------------------------------------------------------------*/
+	/*  Report                                                           */
+	/*-------------------------------------------------------------------*/
+	printf("\n----- ASYNC -----\n");
+	printf("submit        : %d frames in %.2f ms (%.2f us each)\n",
+	       frame_num * async_pipe_num, t_submit / 1000.0,
+	       (double)t_submit / (frame_num * async_pipe_num));
+	for (i = 0; i < async_pipe_num; i++) {
+		ppipe = &async_pipe[i];
+
+		/* the same input gives the same output, frame after frame */
+		mismatch = 0;
+		for (j = 1; j < frame_num; j++) {
+			if (ppipe->pframe[j].result == 0 &&
+			    ppipe->pframe[j].hash != ppipe->pframe[0].hash)
+				mismatch++;
+		}
+
+		printf("pipe %d %-6s : %d done, %d failed, %.1f fps, "
+		       "%d mismatch\n", i, ppipe->pmod->pname, ppipe->done,
+		       ppipe->failed, ppipe->t_last > t_start ?
+		       ppipe->done * 1e6 / (ppipe->t_last - t_start) : 0,
+		       mismatch);
+		failed += ppipe->failed + mismatch;
+	}
+	printf("total         : %.1f fps over %d pipeline(s)\n",
+	       t_end > t_start ? frame_num * async_pipe_num * 1e6 /
+	       (t_end - t_start) : 0, async_pipe_num);
+
+stop:
+	vsp2_async_free(pasync, &stat);
+	if (ercd == 0) {
+		printf("executor      : %d thread(s), %llu frames out at most, "
+		       "%llu wakeups (%.2f per frame), %llu on a busy pipe\n",
+		       thread_num, stat.max_out, stat.wakeups,
+		       stat.frames ? (double)stat.wakeups / stat.frames : 0,
+		       stat.busy);
+		printf("result        : %s\n", failed == 0 ? "OK" : "NG");
+		printf("-----------------\n");
+	}
+
+	for (i = 0; i < async_pipe_num; i++) {
+		close_pipe(&async_pipe[i]);
+		free(async_pipe[i].pframe);
+	}
+	free(pimage);
+	return ercd;
+}
+
+static int open_pipe(struct async_pipe *ppipe)
+{
+	struct v4l2_format	fmt;
+	char			name[32];
+	int			ret;
+
+	snprintf(name, sizeof(name), "async %s %d", ppipe->pmod->pname,
+		 ppipe->id);
+	vsp2_mem_pipeline(name);
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(ppipe);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	ppipe->src_fd = open_video_device(ppipe->pmedia, SRC_INPUT_DEV,
+					  O_RDWR);
+	if (ppipe->src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/* dst is in the executor's epoll set, DQBUF must not block */
+	ppipe->dst_fd = open_video_device(ppipe->pmedia, DST_OUTPUT_DEV,
+					  O_RDWR | O_NONBLOCK);
+	if (ppipe->dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Lookup table (negative) - VIDIOC_VSP2_LUT_CONFIG                 */
+	/*-------------------------------------------------------------------*/
+	if (strcmp(ppipe->pmod->pname, "lut") == 0) {
+		if (commit_lut(ppipe) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	if (ioctl(ppipe->src_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= ppipe->pmod->dst_width;
+	fmt.fmt.pix_mp.height		= ppipe->pmod->dst_height;
+
+	if (ioctl(ppipe->dst_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/* buffers : vsp2_async_pipe_new() */
+	return 0;
+}
+
+static void close_pipe(struct async_pipe *ppipe)
+{
+	/* the executor has released the buffers */
+	if (ppipe->src_fd != -1)
+		close(ppipe->src_fd);
+	if (ppipe->dst_fd != -1)
+		close(ppipe->dst_fd);
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for lookup table                                  */
+	/*-------------------------------------------------------------------*/
+	if (ppipe->lut_virt != 0)
+		mmngr_free_in_user(ppipe->lut_id);
+
+	if (ppipe->pmedia != NULL)
+		vsp2_media_close(ppipe->pmedia);
+}
+
+/******************************************************************************
+ *  executor callbacks
+ ******************************************************************************/
+static void frame_fill(struct vsp2_async_frame *paf, unsigned char *psrc,
+		       unsigned int size)
+{
+	struct async_frame *pf = (struct async_frame *)paf;
+
+	vsp2_trace_begin("fill");
+	memcpy(psrc, pf->ppipe->pimage, size);
+	vsp2_trace_end();
+}
+
+static void frame_done(struct vsp2_async_frame *paf,
+		       const unsigned char *pdst, unsigned int size,
+		       int result)
+{
+	struct async_frame	*pf = (struct async_frame *)paf;
+	struct async_pipe	*ppipe = pf->ppipe;
+
+	pf->result = result;
+	if (result < 0) {
+		ppipe->failed++;
+		return;
+	}
+
+	vsp2_trace_begin("check");
+	pf->hash = calc_hash(0xcbf29ce484222325ULL, pdst, size);
+	vsp2_trace_end();
+
+	ppipe->done++;
+	ppipe->t_last = get_time_us();
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	/* file input */
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int call_media_ctl(struct async_pipe *ppipe)
+{
+	struct vsp2_media		*pmedia;
+	struct v4l2_mbus_framefmt	format;
+	const char			*pentity = ppipe->pmod->pentity;
+
+	/* Initialize v4l2 media controller */
+	pmedia = vsp2_media_open(ppipe->devnode);
+	if (!pmedia) {
+		printf("Error : vsp2_media_open(%s)\n", ppipe->devnode);
+		return -1;
+	}
+
+	ppipe->pmedia = pmedia;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [module] -> wpf.0:0   */
+	/*----------------------------------*/
+	if (pentity == NULL) {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
+			return -1;
+		}
+	} else {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pentity, 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> %s)\n",
+			       pentity);
+			return -1;
+		}
+		if (vsp2_media_setup_link(pmedia, pentity, 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(%s -> wpf)\n",
+			       pentity);
+			return -1;
+		}
+	}
+	/*----------------------*/
+	/* wpf.0:1 -> output    */
+	/*----------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/*----------------------------------------------------- set format */
+	format.width	= SRC_WIDTH;
+	format.height	= SRC_HEIGHT;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf)\n");
+		return -1;
+	}
+	if (pentity != NULL) {
+		if (vsp2_media_set_format(pmedia, pentity, 0, &format) != 0) {
+			printf("Error : vsp2_media_set_format(%s pad 0)\n",
+			       pentity);
+			return -1;
+		}
+		format.width	= ppipe->pmod->dst_width;
+		format.height	= ppipe->pmod->dst_height;
+		if (vsp2_media_set_format(pmedia, pentity, 1, &format) != 0) {
+			printf("Error : vsp2_media_set_format(%s pad 1)\n",
+			       pentity);
+			return -1;
+		}
+	}
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf)\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity,
+			     int flags)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, flags);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
+
+static int commit_lut(struct async_pipe *ppipe)
+{
+	struct vsp2_lut_config	lut_par;
+	unsigned int		*ptbl;
+	unsigned long		phys, hard;
+	int			fd;
+	int			ret;
+	int			i;
+
+	ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &ppipe->lut_id, LUT_TBL_NUM*8,
+			     &phys, &hard, &ppipe->lut_virt, MMNGR_VA_SUPPORT);
+	if (ret != 0) {
+		printf("Error : mmngr_alloc_in_user()\n");
+		ppipe->lut_virt = 0;
+		return -1;
+	}
+
+	ptbl = (unsigned int *)ppipe->lut_virt;
+	for (i = 0; i < LUT_TBL_NUM; i++) {
+		ptbl[i*2]	= LUT_REG_ADDR + i*4;
+		ptbl[i*2+1]	= (255 - i) << 16
+				| (255 - i) << 8
+				| (255 - i);
+	}
+
+	fd = open_video_device(ppipe->pmedia, "lut", O_RDWR);
+	if (fd == -1)
+		return -1;
+
+	memset(&lut_par, 0, sizeof(lut_par));
+	lut_par.addr	= (void *)ppipe->lut_virt;
+	lut_par.tbl_num	= LUT_TBL_NUM;
+	lut_par.fxa	= 0x80;
+
+	ret = ioctl(fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+	close(fd);
+	return ret;
+}
+
+static unsigned long long calc_hash(unsigned long long hash,
+				    const void *pdata, size_t len)
+{
+	const unsigned char *p = pdata;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
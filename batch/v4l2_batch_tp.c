@@ -0,0 +1,1118 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : rpf -> [uds | lut | clu] -> wpf
+ *  memory type : mmap
+ *
+ *  Converts a directory or a list of images through one pipeline. Links,
+ *  tables and buffers are set up once; formats and buffers are set up
+ *  again only when the frame size changes. Three buffer sets per queue, so
+ *  that while the VSP processes image N the CPU reads image N+1 into the
+ *  next set and writes image N-1 out from the third.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#ifndef USE_M3
+/* for h3 */
+#define MEDIA_DEV_NAME		"/dev/media3"		/* fe9a0000.vsp */
+#else
+/* for m3 */
+#define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
+#endif
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* lut / clu parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+#define CLU_GRID		(17)
+#define CLU_TBL_NUM		(CLU_GRID*CLU_GRID*CLU_GRID)
+#define CLU_REG_DATA		(0x00007404)
+
+/* batch parameter */
+#define BATCH_BUF_NUM		(3)		/* vsp, read, write back */
+#define BATCH_IMAGE_MAX		(4096)
+#define BATCH_SIZE_MAX		(8190)		/* width and height */
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+#define VIDIOC_VSP2_CLU_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct vsp2_clu_config {
+	unsigned char	mode;
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned char	fxa;
+	unsigned short	tbl_num;	/* 1 to 9826 */
+};
+
+struct batch_module {
+	const char	*pname;
+	const char	*pentity;	/* NULL : rpf.0 -> wpf.0 */
+	const char	*ptag;		/* output file name */
+};
+
+struct batch_image {
+	char		input[256];
+	char		output[512];
+	unsigned int	width;
+	unsigned int	height;
+};
+
+struct batch_stat {
+	int			images;
+	int			configs;	/* frame size changes */
+	unsigned long long	pixels;
+	long long		total_us;
+	long long		config_us;	/* formats and buffers */
+	long long		read_us;
+	long long		write_us;
+	long long		wait_us;	/* blocked in VIDIOC_DQBUF */
+};
+
+struct batch {
+	const struct batch_module	*pmod;
+	unsigned int			out_width;	/* uds, 0 : as input */
+	unsigned int			out_height;
+
+	struct vsp2_media		*pmedia;
+	int				src_fd;
+	int				dst_fd;
+	MMNGR_ID			tbl_id;
+	unsigned long			tbl_virt;
+
+	/* current frame size, 0 : no buffers */
+	unsigned int			width;
+	unsigned int			height;
+	unsigned int			src_size;
+	unsigned int			dst_size;
+	unsigned char			*psrc_buf[BATCH_BUF_NUM];
+	unsigned char			*pdst_buf[BATCH_BUF_NUM];
+	struct batch_image		*pset[BATCH_BUF_NUM];	/* in the set */
+	bool				streaming;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct batch_module batch_module[] = {
+	{ "copy",	NULL,		"COPY" },
+	{ "uds",	"uds.0",	"UDS" },
+	{ "lut",	"lut",		"LUT" },
+	{ "clu",	"clu",		"CLU" },
+};
+
+static struct batch_image	batch_image[BATCH_IMAGE_MAX];
+static int			batch_image_num;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	set_module(struct batch *pb, const char *pspec);
+static int	add_image(struct batch *pb, const char *pinput,
+			  unsigned int width, unsigned int height,
+			  const char *poutput, const char *poutdir);
+static int	load_dir(struct batch *pb, const char *pdir,
+			 const char *poutdir);
+static int	load_list(struct batch *pb, const char *pfilename,
+			  const char *poutdir);
+static int	cmp_image(const void *pa, const void *pb);
+static int	test_batch(struct batch *pb, const char *pdevnode);
+static int	batch_table(struct batch *pb);
+static int	batch_config(struct batch *pb, unsigned int width,
+			     unsigned int height, struct batch_stat *pstat);
+static void	batch_release(struct batch *pb);
+static int	batch_run(struct batch *pb, struct batch_image *pimage,
+			  int num, struct batch_stat *pstat);
+static int	batch_queue(struct batch *pb, int idx);
+static int	batch_dequeue(struct batch *pb, int *pidx, long long *pwait_us);
+static void	print_batch_stat(struct batch *pb, struct batch_stat *pstat);
+static long long	get_time_us(void);
+
+static int	read_file(unsigned char*, unsigned int, const char*);
+static int	write_file(unsigned char*, unsigned int, const char*);
+
+static int	call_media_ctl(struct batch *pb, const char *pdevnode);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -p <module>: copy, uds:<w>x<h>, lut or clu [lut]\n");
+	printf("        -i <dir>: every <w>_<h>_*.argb (ARGB32) in <dir>\n");
+	printf("        -l <file>: list, one image per line :\n");
+	printf("             <input> <w>x<h> [<output>]\n");
+	printf("        -o <dir>: output directory [.]\n");
+	printf("        -d <media>: device [%s]\n", MEDIA_DEV_NAME);
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct batch	batch;
+	const char	*pdevnode = MEDIA_DEV_NAME;
+	const char	*poutdir = ".";
+	const char	*pindir = NULL;
+	const char	*plist = NULL;
+	int		opt;
+
+	vsp2_trace_begin("run");
+
+	memset(&batch, 0, sizeof(batch));
+	batch.pmod = &batch_module[2];		/* lut */
+	batch.src_fd = -1;
+	batch.dst_fd = -1;
+
+	while ((opt = getopt(argc, argv, "p:i:l:o:d:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (set_module(&batch, optarg) < 0)
+				exit(1);
+			break;
+		case 'i':
+			pindir = optarg;
+			break;
+		case 'l':
+			plist = optarg;
+			break;
+		case 'o':
+			poutdir = optarg;
+			break;
+		case 'd':
+			pdevnode = optarg;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (pindir == NULL && plist == NULL) {
+		print_usage(argv[0]);
+		exit(0);
+	}
+
+	/* output names depend on the module, so the inputs come last */
+	if (pindir != NULL && load_dir(&batch, pindir, poutdir) < 0)
+		exit(1);
+	if (plist != NULL && load_list(&batch, plist, poutdir) < 0)
+		exit(1);
+	if (batch_image_num == 0) {
+		printf("Error : no input image\n");
+		exit(1);
+	}
+
+	printf("exec BATCH %s, %d image(s) on %s\n", batch.pmod->pname,
+	       batch_image_num, pdevnode);
+
+	test_batch(&batch, pdevnode);
+
+	exit(0);
+}
+
+/******************************************************************************
+ *  inputs
+ ******************************************************************************/
+static int set_module(struct batch *pb, const char *pspec)
+{
+	const char	*p;
+	size_t		len;
+	int		i;
+
+	p = strchr(pspec, ':');
+	len = p ? (size_t)(p - pspec) : strlen(pspec);
+
+	pb->pmod = NULL;
+	for (i = 0; i < (int)(sizeof(batch_module) / sizeof(batch_module[0]));
+	     i++) {
+		if (strlen(batch_module[i].pname) == len &&
+		    strncmp(batch_module[i].pname, pspec, len) == 0)
+			pb->pmod = &batch_module[i];
+	}
+	if (pb->pmod == NULL) {
+		printf("Error : unknown module (%s)\n", pspec);
+		return -1;
+	}
+
+	/* uds scales every image to one size */
+	pb->out_width	= 0;
+	pb->out_height	= 0;
+	if (strcmp(pb->pmod->pname, "uds") == 0) {
+		if (p == NULL || sscanf(p + 1, "%ux%u", &pb->out_width,
+					&pb->out_height) != 2 ||
+		    pb->out_width < 16 || pb->out_width > BATCH_SIZE_MAX ||
+		    pb->out_height < 16 || pb->out_height > BATCH_SIZE_MAX) {
+			printf("Error : uds needs an output size (uds:<w>x<h>)"
+			       "\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int add_image(struct batch *pb, const char *pinput,
+		     unsigned int width, unsigned int height,
+		     const char *poutput, const char *poutdir)
+{
+	struct batch_image	*pimage;
+	struct stat		st;
+	const char		*pbase;
+	unsigned int		w, h;
+	int			skip = 0;
+	int			len;
+
+	if (batch_image_num >= BATCH_IMAGE_MAX) {
+		printf("Error : too many images (max %d)\n", BATCH_IMAGE_MAX);
+		return -1;
+	}
+	if (width < 16 || width > BATCH_SIZE_MAX ||
+	    height < 16 || height > BATCH_SIZE_MAX) {
+		printf("Error : %s bad size %ux%u\n", pinput, width, height);
+		return -1;
+	}
+	if (stat(pinput, &st) != 0 ||
+	    st.st_size < (off_t)width * height * 4) {
+		printf("Error : %s is not a %ux%u ARGB32 image\n", pinput,
+		       width, height);
+		return -1;
+	}
+
+	pimage = &batch_image[batch_image_num];
+	snprintf(pimage->input, sizeof(pimage->input), "%s", pinput);
+	pimage->width	= width;
+	pimage->height	= height;
+
+	if (poutput != NULL) {
+		snprintf(pimage->output, sizeof(pimage->output), "%s",
+			 poutput);
+		batch_image_num++;
+		return 0;
+	}
+
+	/* <w>_<h>_<name>.argb -> <dst w>_<dst h>_<name>_<TAG>.argb */
+	pbase = strrchr(pinput, '/');
+	pbase = pbase ? pbase + 1 : pinput;
+	len = strlen(pbase);
+	if (len > 5 && strcmp(pbase + len - 5, ".argb") == 0)
+		len -= 5;
+	if (sscanf(pbase, "%u_%u_%n", &w, &h, &skip) == 2 && skip > 0 &&
+	    w == width && h == height) {
+		snprintf(pimage->output, sizeof(pimage->output),
+			 "%s/%u_%u_%.*s_%s.argb", poutdir,
+			 pb->out_width ? pb->out_width : width,
+			 pb->out_height ? pb->out_height : height,
+			 len - skip, pbase + skip, pb->pmod->ptag);
+	} else {
+		snprintf(pimage->output, sizeof(pimage->output),
+			 "%s/%.*s_%s.argb", poutdir, len, pbase,
+			 pb->pmod->ptag);
+	}
+	batch_image_num++;
+	return 0;
+}
+
+static int load_dir(struct batch *pb, const char *pdir, const char *poutdir)
+{
+	DIR		*pdp;
+	struct dirent	*pent;
+	char		path[512];
+	unsigned int	w, h;
+	int		first = batch_image_num;
+	int		skip;
+	int		len;
+	int		ret = 0;
+
+	pdp = opendir(pdir);
+	if (pdp == NULL) {
+		printf("Error : opendir(%s) errno=(%d)\n", pdir, errno);
+		return -1;
+	}
+
+	while ((pent = readdir(pdp)) != NULL) {
+		/* the size comes from the name, as for the test images */
+		len = strlen(pent->d_name);
+		skip = 0;
+		if (len <= 5 || strcmp(pent->d_name + len - 5, ".argb") != 0 ||
+		    sscanf(pent->d_name, "%u_%u_%n", &w, &h, &skip) != 2 ||
+		    skip == 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", pdir, pent->d_name);
+		if (add_image(pb, path, w, h, NULL, poutdir) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	closedir(pdp);
+
+	/* one frame size after the other, so each is set up once */
+	qsort(&batch_image[first], batch_image_num - first,
+	      sizeof(batch_image[0]), cmp_image);
+	return ret;
+}
+
+static int load_list(struct batch *pb, const char *pfilename,
+		     const char *poutdir)
+{
+	FILE		*fp;
+	char		line[1024];
+	char		input[256], output[512];
+	unsigned int	w, h;
+	int		lineno = 0;
+	int		num;
+
+	fp = fopen(pfilename, "r");
+	if (fp == NULL) {
+		printf("Error : list open error (%s)\n", pfilename);
+		return -1;
+	}
+
+	/* kept in list order */
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		num = sscanf(line, "%255s %ux%u %511s", input, &w, &h, output);
+		if (num <= 0 || input[0] == '#')
+			continue;
+		if (num < 3 || add_image(pb, input, w, h,
+					 num == 4 ? output : NULL,
+					 poutdir) < 0) {
+			printf("Error : %s line %d\n", pfilename, lineno);
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int cmp_image(const void *pa, const void *pb)
+{
+	const struct batch_image *pia = pa;
+	const struct batch_image *pib = pb;
+
+	if (pia->width != pib->width)
+		return pia->width < pib->width ? -1 : 1;
+	if (pia->height != pib->height)
+		return pia->height < pib->height ? -1 : 1;
+	return strcmp(pia->input, pib->input);
+}
+
+/******************************************************************************
+ *  batch
+ ******************************************************************************/
+static int test_batch(struct batch *pb, const char *pdevnode)
+{
+	struct batch_stat	stat;
+	long long		t_start;
+	int			first, num;
+	int			ret;
+
+	memset(&stat, 0, sizeof(stat));
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl (links, once)                                     */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(pb, pdevnode);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		goto out;
+	}
+	ret = -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	pb->src_fd = open_video_device(pb->pmedia, SRC_INPUT_DEV);
+	if (pb->src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		goto out;
+	}
+
+	pb->dst_fd = open_video_device(pb->pmedia, DST_OUTPUT_DEV);
+	if (pb->dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		goto out;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Lookup table - VIDIOC_VSP2_LUT_CONFIG / VIDIOC_VSP2_CLU_CONFIG   */
+	/*-------------------------------------------------------------------*/
+	if (batch_table(pb) < 0)
+		goto out;
+
+	/*-------------------------------------------------------------------*/
+	/*  Images, one run per frame size                                   */
+	/*-------------------------------------------------------------------*/
+	ret = 0;
+	t_start = get_time_us();
+	for (first = 0; first < batch_image_num; first += num) {
+		for (num = 1; first + num < batch_image_num; num++) {
+			if (batch_image[first + num].width !=
+			    batch_image[first].width ||
+			    batch_image[first + num].height !=
+			    batch_image[first].height)
+				break;
+		}
+
+		if (batch_config(pb, batch_image[first].width,
+				 batch_image[first].height, &stat) < 0 ||
+		    batch_run(pb, &batch_image[first], num, &stat) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	stat.total_us = get_time_us() - t_start;
+
+	print_batch_stat(pb, &stat);
+
+out:
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF / Unmap buffer / VIDIOC_REQBUFS (release)       */
+	/*-------------------------------------------------------------------*/
+	batch_release(pb);
+
+	if (pb->src_fd != -1)
+		close(pb->src_fd);
+	if (pb->dst_fd != -1)
+		close(pb->dst_fd);
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for lookup table                                  */
+	/*-------------------------------------------------------------------*/
+	if (pb->tbl_virt != 0)
+		mmngr_free_in_user(pb->tbl_id);
+
+	vsp2_media_close(pb->pmedia);
+	return ret;
+}
+
+static int batch_table(struct batch *pb)
+{
+	struct vsp2_lut_config	lut_par;
+	struct vsp2_clu_config	clu_par;
+	unsigned int		*ptbl;
+	unsigned long		phys, hard;
+	bool			lut;
+	int			fd;
+	int			ret;
+	int			r, g, b;
+	int			i;
+
+	lut = (strcmp(pb->pmod->pname, "lut") == 0);
+	if (!lut && strcmp(pb->pmod->pname, "clu") != 0)
+		return 0;
+
+	ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &pb->tbl_id,
+			     (lut ? LUT_TBL_NUM : CLU_TBL_NUM) * 8, &phys,
+			     &hard, &pb->tbl_virt, MMNGR_VA_SUPPORT);
+	if (ret != 0) {
+		printf("Error : mmngr_alloc_in_user()\n");
+		pb->tbl_virt = 0;
+		return -1;
+	}
+
+	fd = open_video_device(pb->pmedia, pb->pmod->pentity);
+	if (fd == -1) {
+		printf("Error open %s device: %s (%d).\n", pb->pmod->pentity,
+			strerror(errno), errno);
+		return -1;
+	}
+
+	ptbl = (unsigned int *)pb->tbl_virt;
+	if (lut) {
+		/* negative */
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			ptbl[i*2]	= LUT_REG_ADDR + i*4;
+			ptbl[i*2+1]	= (255 - i) << 16
+					| (255 - i) << 8
+					| (255 - i);
+		}
+
+		memset(&lut_par, 0, sizeof(lut_par));
+		lut_par.addr	= (void *)pb->tbl_virt;
+		lut_par.tbl_num	= LUT_TBL_NUM;
+		lut_par.fxa	= 0x80;
+		ret = ioctl(fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+	} else {
+		/* sepia */
+		for (b = 0; b < CLU_GRID; b++) {
+			for (g = 0; g < CLU_GRID; g++) {
+				for (r = 0; r < CLU_GRID; r++) {
+					i = (r * 77 + g * 150 + b * 29) *
+					    255 / 16 / 256;
+					*ptbl++ = CLU_REG_DATA;
+					*ptbl++ = (i * 240 / 255 + 15) << 16
+						| (i * 200 / 255 + 10) << 8
+						| (i * 145 / 255);
+				}
+			}
+		}
+
+		memset(&clu_par, 0, sizeof(clu_par));
+		clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
+		clu_par.addr	= (void *)pb->tbl_virt;
+		clu_par.tbl_num	= CLU_TBL_NUM;
+		ret = ioctl(fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par);
+	}
+	close(fd);
+
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int batch_config(struct batch *pb, unsigned int width,
+			unsigned int height, struct batch_stat *pstat)
+{
+	struct v4l2_mbus_framefmt	format;
+	struct v4l2_format		fmt;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	const char			*pentity = pb->pmod->pentity;
+	unsigned int			out_width, out_height;
+	long long			t_start;
+	int				i;
+
+	if (pb->width == width && pb->height == height)
+		return 0;
+
+	vsp2_trace_begin("configure");
+	t_start = get_time_us();
+
+	/* the queues must be idle and empty to change the size */
+	batch_release(pb);
+
+	out_width	= pb->out_width ? pb->out_width : width;
+	out_height	= pb->out_height ? pb->out_height : height;
+
+	/*-------------------------------------------------------------------*/
+	/*  Pad formats                                                      */
+	/*-------------------------------------------------------------------*/
+	format.width	= width;
+	format.height	= height;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pb->pmedia, "rpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pb->pmedia, "rpf.0", 1, &format) != 0 ||
+	    (pentity != NULL &&
+	     vsp2_media_set_format(pb->pmedia, pentity, 0, &format) != 0)) {
+		printf("Error : vsp2_media_set_format(%ux%u)\n", width,
+		       height);
+		goto err;
+	}
+
+	format.width	= out_width;
+	format.height	= out_height;
+	if ((pentity != NULL &&
+	     vsp2_media_set_format(pb->pmedia, pentity, 1, &format) != 0) ||
+	    vsp2_media_set_format(pb->pmedia, "wpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pb->pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(%ux%u)\n", out_width,
+		       out_height);
+		goto err;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= width;
+	fmt.fmt.pix_mp.height		= height;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	if (ioctl(pb->src_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= out_width;
+	fmt.fmt.pix_mp.height		= out_height;
+	/* the source stride came back in it, a smaller output wants its own */
+	memset(fmt.fmt.pix_mp.plane_fmt, 0, sizeof(fmt.fmt.pix_mp.plane_fmt));
+
+	if (ioctl(pb->dst_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= BATCH_BUF_NUM;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	if (ioctl(pb->src_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+	    req_buf.count != BATCH_BUF_NUM) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	req_buf.count	= BATCH_BUF_NUM;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(pb->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+	    req_buf.count != BATCH_BUF_NUM) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	pb->width	= width;
+	pb->height	= height;
+	pb->src_size	= width * height * 4;
+	pb->dst_size	= out_width * out_height * 4;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                           */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < BATCH_BUF_NUM; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		if (ioctl(pb->src_fd, VIDIOC_QUERYBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto err;
+		}
+		pb->psrc_buf[i] = mmap(0, pb->src_size,
+				       PROT_READ | PROT_WRITE, MAP_SHARED,
+				       pb->src_fd, planes[0].m.mem_offset);
+		if (pb->psrc_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			pb->psrc_buf[i] = NULL;
+			goto err;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		if (ioctl(pb->dst_fd, VIDIOC_QUERYBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto err;
+		}
+		pb->pdst_buf[i] = mmap(0, pb->dst_size,
+				       PROT_READ | PROT_WRITE, MAP_SHARED,
+				       pb->dst_fd, planes[0].m.mem_offset);
+		if (pb->pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			pb->pdst_buf[i] = NULL;
+			goto err;
+		}
+	}
+
+	pstat->configs++;
+	pstat->config_us += get_time_us() - t_start;
+	vsp2_trace_end();
+	return 0;
+
+err:
+	vsp2_trace_end();
+	return -1;
+}
+
+static void batch_release(struct batch *pb)
+{
+	struct v4l2_requestbuffers	req_buf;
+	unsigned int			type;
+	int				i;
+
+	if (pb->width == 0)
+		return;
+
+	if (pb->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(pb->src_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pb->dst_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		pb->streaming = false;
+	}
+
+	for (i = 0; i < BATCH_BUF_NUM; i++) {
+		if (pb->psrc_buf[i] != NULL)
+			munmap(pb->psrc_buf[i], pb->src_size);
+		if (pb->pdst_buf[i] != NULL)
+			munmap(pb->pdst_buf[i], pb->dst_size);
+		pb->psrc_buf[i] = NULL;
+		pb->pdst_buf[i] = NULL;
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+	if (ioctl(pb->src_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(pb->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+
+	pb->width	= 0;
+	pb->height	= 0;
+}
+
+static int batch_run(struct batch *pb, struct batch_image *pimage, int num,
+		     struct batch_stat *pstat)
+{
+	long long	t;
+	int		done = -1;	/* set to write back, -1 : none */
+	int		idx;
+	int		n;
+
+	/*
+	 * image N is on the VSP in set N % 3; N+1 is read into the next set
+	 * and queued behind it at once, so the VSP does not idle between
+	 * the two, then N-1 is written out from the set left over.
+	 */
+	for (n = -1; n < num; n++) {
+		if (n + 1 < num) {
+			idx = (n + 1) % BATCH_BUF_NUM;
+
+			t = get_time_us();
+			if (read_file(pb->psrc_buf[idx], pb->src_size,
+				      pimage[n + 1].input) == 0) {
+				printf("error line=%d errno=(%d)\n", __LINE__,
+				       errno);
+				return -1;
+			}
+			pstat->read_us += get_time_us() - t;
+
+			pb->pset[idx] = &pimage[n + 1];
+			if (batch_queue(pb, idx) < 0)
+				return -1;
+		}
+		if (n < 0)
+			continue;
+
+		if (done >= 0) {
+			t = get_time_us();
+			if (write_file(pb->pdst_buf[done], pb->dst_size,
+				       pb->pset[done]->output) == 0)
+				return -1;
+			pstat->write_us += get_time_us() - t;
+		}
+
+		if (batch_dequeue(pb, &done, &pstat->wait_us) < 0)
+			return -1;
+		if (done != n % BATCH_BUF_NUM) {
+			printf("Error : image %d came back in set %d\n", n,
+			       done);
+			return -1;
+		}
+		pstat->images++;
+		pstat->pixels += (unsigned long long)pimage[n].width *
+				 pimage[n].height;
+	}
+
+	/* the last image has nothing left to overlap with */
+	t = get_time_us();
+	if (write_file(pb->pdst_buf[done], pb->dst_size,
+		       pb->pset[done]->output) == 0)
+		return -1;
+	pstat->write_us += get_time_us() - t;
+
+	return 0;
+}
+
+static int batch_queue(struct batch *pb, int idx)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	unsigned int		type;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= pb->dst_size;
+
+	if (ioctl(pb->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.m.planes[0].bytesused	= pb->src_size;
+	buf.bytesused			= pb->src_size;
+
+	if (ioctl(pb->src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	if (pb->streaming)
+		return 0;
+
+	/* the queues start on their first buffers */
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (ioctl(pb->src_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(pb->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	pb->streaming = true;
+
+	return 0;
+}
+
+static int batch_dequeue(struct batch *pb, int *pidx, long long *pwait_us)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	long long		t;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	t = get_time_us();
+	if (ioctl(pb->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	*pwait_us += get_time_us() - t;
+	*pidx = buf.index;
+
+	/* the source of a finished image is done as well */
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	if (ioctl(pb->src_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void print_batch_stat(struct batch *pb, struct batch_stat *pstat)
+{
+	double n = pstat->images ? pstat->images : 1;
+
+	printf("\n----- BATCH %s -----\n", pb->pmod->ptag);
+	printf("images        : %d of %d, %d frame size(s), %d buffer sets\n",
+	       pstat->images, batch_image_num, pstat->configs, BATCH_BUF_NUM);
+	printf("total         : %.1f ms, %.1f images/s, %.1f Mpixel/s\n",
+	       pstat->total_us / 1000.0,
+	       pstat->total_us ? pstat->images * 1e6 / pstat->total_us : 0,
+	       pstat->total_us ? (double)pstat->pixels / pstat->total_us : 0);
+	printf("per image     : read %.2f ms, write %.2f ms, wait %.2f ms\n",
+	       pstat->read_us / n / 1000, pstat->write_us / n / 1000,
+	       pstat->wait_us / n / 1000);
+	printf("configure     : %.2f ms in %d change(s)\n",
+	       pstat->config_us / 1000.0, pstat->configs);
+	printf("result        : %s\n",
+	       pstat->images == batch_image_num ? "OK" : "NG");
+	printf("----------------------\n");
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	/* file input */
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int write_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("write file");
+
+	/* file output */
+	fp = fopen(pfilename, "wb");
+	if (!fp) {
+		printf("output file open error..\n");
+		ret = 0;
+	} else {
+		ret = fwrite(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer write error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int call_media_ctl(struct batch *pb, const char *pdevnode)
+{
+	struct vsp2_media	*pmedia;
+	const char		*pentity = pb->pmod->pentity;
+
+	/* Initialize v4l2 media controller */
+	pmedia = vsp2_media_open(pdevnode);
+	if (!pmedia) {
+		printf("Error : vsp2_media_open(%s)\n", pdevnode);
+		return -1;
+	}
+
+	pb->pmedia = pmedia;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [module] -> wpf.0:0   */
+	/*----------------------------------*/
+	if (pentity == NULL) {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
+			return -1;
+		}
+	} else {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pentity, 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> %s)\n",
+			       pentity);
+			return -1;
+		}
+		if (vsp2_media_setup_link(pmedia, pentity, 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(%s -> wpf)\n",
+			       pentity);
+			return -1;
+		}
+	}
+
+	/*----------------------------------*/
+	/* wpf.0:1 -> wpf.0 output          */
+	/*----------------------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/* pad formats follow the frame size, see batch_config() */
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
@@ -10,6 +10,7 @@
  ******************************************************************************/
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdbool.h>
@@ -24,6 +25,11 @@
 #include "mmngr_user_public.h"
 #include "mmngr_buf_user_public.h"
 
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+
 /******************************************************************************
  *  macros
  ******************************************************************************/
@@ -36,9 +42,9 @@
 #define MEDIA_DEV_NAME		"/dev/media1"	/* fe960000.vsp */
 #endif
 
-#define SRC1_INPUT_DEV		"%s rpf.0 input"
-#define SRC2_INPUT_DEV		"%s rpf.1 input"
-#define DST_OUTPUT_DEV		"%s wpf.0 output"
+#define SRC1_INPUT_DEV		"rpf.0 input"
+#define SRC2_INPUT_DEV		"rpf.1 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
 
 /* source parameter */
 #define SRC1_FILENAME		"1280_720_ARGB32.argb"
@@ -54,24 +60,36 @@
 #define DST_FILENAME_MMAP	"1280_720_ARGB32_BRU_MMAP.argb"
 #define DST_FILENAME_USERPTR	"1280_720_ARGB32_BRU_USERPTR.argb"
 #define DST_FILENAME_DMABUF	"1280_720_ARGB32_BRU_DMABUF.argb"
+#define DST_FILENAME_STREAM	"1280_720_ARGB32_BRU_STREAM.argb"
 #define DST_WIDTH		(1280)		/* dst: width  */
 #define DST_HEIGHT		(720)		/* dst: height */
 #define DST_SIZE		(DST_WIDTH*DST_HEIGHT*4)
 
+/* stream parameter */
+#define STREAM_BUF_NUM		(3)		/* vsp, prepare, write back */
+
 /******************************************************************************
  *  structure
  ******************************************************************************/
-struct dev_pads {
-	struct media_pad	*ppad0;
-	struct media_pad	*ppad1;
+/* one pass over the stream */
+struct stream_pass {
+	const char		*pname;
+	int			frames;
+	long long		total_us;
+	long long		prep_us;	/* read file, image, premultiply */
+	long long		write_us;	/* write back */
+	long long		wait_us;	/* blocked in VIDIOC_DQBUF */
+	unsigned long long	sum;		/* checksum of the last frame */
 };
-struct dev_brupads {
-	struct media_pad	*ppad0;
-	struct media_pad	*ppad1;
-	struct media_pad	*ppad2;
-	struct media_pad	*ppad3;
-	struct media_pad	*ppad4;
-	struct media_pad	*ppad5;
+
+struct bru_stream {
+	int			src1_fd;
+	int			src2_fd;
+	int			dst_fd;
+	unsigned char		*psrc1_buf[STREAM_BUF_NUM];
+	unsigned char		*psrc2_buf[STREAM_BUF_NUM];
+	unsigned char		*pdst_buf[STREAM_BUF_NUM];
+	bool			streaming;
 };
 
 /******************************************************************************
@@ -80,18 +98,31 @@ struct dev_brupads {
 static int	test_bru_mmap(void);
 static int	test_bru_userptr(void);
 static int	test_bru_dmabuf(void);
+static int	test_bru_stream(int frame_num);
+
+static int	stream_pass_hw(struct bru_stream *ps, struct stream_pass *pp);
+static int	stream_pass_seq(struct bru_stream *ps, struct stream_pass *pp);
+static int	stream_pass_pipe(struct bru_stream *ps, struct stream_pass *pp);
+static int	stream_prepare(struct bru_stream *ps, int idx);
+static int	stream_queue(struct bru_stream *ps, int idx);
+static int	stream_dequeue(struct bru_stream *ps, int *pidx,
+			       long long *pwait_us);
+static unsigned long long	stream_sum(const unsigned char *pbuf,
+					   unsigned int size);
+static void	print_stream_stat(struct stream_pass *ppass, int num);
+static long long	get_time_us(void);
 
 static int	read_file(unsigned char*, unsigned int, const char*);
 static int	write_file(unsigned char*, unsigned int, const char*);
 
-static int	call_media_ctl(struct media_device **, const char **);
+static int	call_media_ctl(struct vsp2_media **);
 
 static void	make_stripe_image(void *pbuf, int width, int height);
 static void	make_color(unsigned int *ptr, unsigned int color, int count);
 static void	calc_img_premultiplied_alpha(void *pbuf, int width, int height);
 
-static int	open_video_device(struct media_device *pmedia,
-				  char *pentity_base, const char *pmedia_name);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
 
 /******************************************************************************
  *  main
@@ -110,6 +141,9 @@ void print_usage(const char *pname)
 	printf("        -m: use MMAP [default]\n");
 	printf("        -u: use USERPTR\n");
 	printf("        -d: use DMABUF\n");
+	printf("        -n: stream <n> frames (MMAP) with %d buffer sets and\n",
+		STREAM_BUF_NUM);
+	printf("            compare sequential and pipelined to the hardware\n");
 	printf("        -h: print usage\n");
 	printf("----------------------------------\n");
 }
@@ -117,28 +151,58 @@ void print_usage(const char *pname)
 int main(int argc, char *argv[])
 {
 	int opt;
+	int mem_type = 0;
+	int frame_num = 0;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "mudn:h")) != -1) {
+		switch (opt) {
+		case 'm':
+		case 'u':
+		case 'd':
+			mem_type = opt;
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			/* unknown : usage, then MMAP as without an option */
+			mem_type = 0;
+			break;
+		}
+	}
 
-	opt = getopt(argc, argv, "mudh");
+	if (frame_num > 0) {
+		printf("exec STREAM (%d frames)\n", frame_num);
+		vsp2_mem_pipeline("bru stream");
+		test_bru_stream(frame_num);
+		exit(0);
+	}
 
-	switch (opt) {
+	switch (mem_type) {
 	case 'm':
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("bru mmap");
 		test_bru_mmap();
 		break;
 	case 'u':
 		printf("exec USERPTR\n");
+		vsp2_mem_pipeline("bru userptr");
 		test_bru_userptr();
 		break;
 	case 'd':
 		printf("exec DMABUF\n");
+		vsp2_mem_pipeline("bru dmabuf");
 		test_bru_dmabuf();
 		break;
-	case 'h':
-		print_usage(argv[0]);
-		break;
 	default:
 		print_usage(argv[0]);
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("bru mmap");
 		test_bru_mmap();
 		break;
 	}
@@ -151,7 +215,7 @@ int main(int argc, char *argv[])
  ******************************************************************************/
 static int test_bru_mmap(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc1_buf;
 	unsigned char  *psrc2_buf;
@@ -173,12 +237,12 @@ static int test_bru_mmap(void)
 	unsigned int        caps;
 	struct v4l2_format  gfmt;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -188,7 +252,7 @@ static int test_bru_mmap(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV, pmedia_name);
+	src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV);
 	if (src1_fd == -1) {
 		printf("Error open src1 device: %s (%d).\n",
 			strerror(errno), errno);
@@ -196,7 +260,7 @@ static int test_bru_mmap(void)
 	}
 
 	/* src device(rpf.1) */
-	src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV, pmedia_name);
+	src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV);
 	if (src2_fd == -1) {
 		printf("Error open src2 device: %s (%d).\n",
 			strerror(errno), errno);
@@ -204,7 +268,7 @@ static int test_bru_mmap(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -476,9 +540,13 @@ static int test_bru_mmap(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make image                                                       */
 	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("make image");
 	make_stripe_image((void *)psrc2_buf, SRC2_WIDTH, SRC2_HEIGHT);
+	vsp2_trace_end();
+	vsp2_trace_begin("premultiply");
 	calc_img_premultiplied_alpha((void *)psrc2_buf, SRC2_WIDTH,
 					SRC2_HEIGHT);
+	vsp2_trace_end();
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -782,7 +850,7 @@ static int test_bru_mmap(void)
 	close(src2_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -792,7 +860,7 @@ static int test_bru_mmap(void)
  ******************************************************************************/
 static int test_bru_userptr(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc1_buf;
 	unsigned char  *psrc2_buf;
@@ -829,12 +897,12 @@ static int test_bru_userptr(void)
 	unsigned long	dst_hard;
 	unsigned long	dst_virt;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -844,7 +912,7 @@ static int test_bru_userptr(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV, pmedia_name);
+	src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV);
 	if (src1_fd == -1) {
 		printf("Error opening device: %s (%d).\n",
 			strerror(errno), errno);
@@ -852,7 +920,7 @@ static int test_bru_userptr(void)
 	}
 
 	/* src device(rpf.1) */
-	src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV, pmedia_name);
+	src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV);
 	if (src2_fd == -1) {
 		printf("Error open src2 device: %s (%d).\n",
 			strerror(errno), errno);
@@ -860,7 +928,7 @@ static int test_bru_userptr(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error opening device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1102,9 +1170,13 @@ static int test_bru_userptr(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make image                                                       */
 	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("make image");
 	make_stripe_image((void *)psrc2_buf, SRC2_WIDTH, SRC2_HEIGHT);
+	vsp2_trace_end();
+	vsp2_trace_begin("premultiply");
 	calc_img_premultiplied_alpha((void *)psrc2_buf, SRC2_WIDTH,
 		SRC2_HEIGHT);
+	vsp2_trace_end();
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -1408,7 +1480,7 @@ static int test_bru_userptr(void)
 	close(src2_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -1418,7 +1490,7 @@ static int test_bru_userptr(void)
  ******************************************************************************/
 static int test_bru_dmabuf(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc1_buf;
 	unsigned char  *psrc2_buf;
@@ -1461,12 +1533,12 @@ static int test_bru_dmabuf(void)
 	int		dst_mbid;
 	int		dst_dmafd;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -1476,7 +1548,7 @@ static int test_bru_dmabuf(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV, pmedia_name);
+	src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV);
 	if (src1_fd == -1) {
 		printf("Error opening device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1484,7 +1556,7 @@ static int test_bru_dmabuf(void)
 	}
 
 	/* src device(rpf.1) */
-	src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV, pmedia_name);
+	src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV);
 	if (src2_fd == -1) {
 		printf("Error open src2 device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1492,7 +1564,7 @@ static int test_bru_dmabuf(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error opening device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1631,11 +1703,21 @@ static int test_bru_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Read file                                                        */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(src1_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = read_file(psrc1_buf, SRC1_SIZE, SRC1_FILENAME);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(src1_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -1754,9 +1836,23 @@ static int test_bru_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make image                                                       */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(src2_dmafd, VSP2_SYNC_RW);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	vsp2_trace_begin("make image");
 	make_stripe_image((void *)psrc2_buf, SRC2_WIDTH, SRC2_HEIGHT);
+	vsp2_trace_end();
+	vsp2_trace_begin("premultiply");
 	calc_img_premultiplied_alpha((void *)psrc2_buf, SRC2_WIDTH,
 		SRC2_HEIGHT);
+	vsp2_trace_end();
+	ret = vsp2_sync_end(src2_dmafd, VSP2_SYNC_RW);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -1922,11 +2018,21 @@ static int test_bru_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Write file                                                       */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = write_file(pdst_buf, DST_SIZE, DST_FILENAME_DMABUF);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*********************************************************************
 	 *  src1
@@ -2098,11 +2204,607 @@ static int test_bru_dmabuf(void)
 	close(src2_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
 
+/******************************************************************************
+ *  stream (triple buffered)
+ *  Three buffer sets per queue, so that while the VSP processes frame N the
+ *  CPU prepares frame N+1 in another set and writes frame N-1 back from the
+ *  third. The same frames are run three ways :
+ *    hardware   : prepared once and requeued, no CPU work per frame
+ *    sequential : prepare, process, write back, one frame at a time
+ *    pipelined  : prepare and write back overlapped with the VSP
+ ******************************************************************************/
+static int test_bru_stream(int frame_num)
+{
+	struct vsp2_media  *pmedia;
+	struct bru_stream  stream;
+	struct stream_pass pass[3];
+
+	unsigned int  type;
+	int           ret = -1;
+
+	struct v4l2_format          fmt;
+	struct v4l2_requestbuffers  req_buf;
+	struct v4l2_buffer          buf;
+	struct v4l2_plane           planes[VIDEO_MAX_PLANES];
+
+	int	i;
+
+	memset(&stream, 0, sizeof(stream));
+	memset(pass, 0, sizeof(pass));
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	stream.src1_fd = open_video_device(pmedia, SRC1_INPUT_DEV);
+	if (stream.src1_fd == -1) {
+		printf("Error open src1 device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	stream.src2_fd = open_video_device(pmedia, SRC2_INPUT_DEV);
+	if (stream.src2_fd == -1) {
+		printf("Error open src2 device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	stream.dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
+	if (stream.dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC1_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC1_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(stream.src1_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC2_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC2_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+	fmt.fmt.pix_mp.flags		= V4L2_PIX_FMT_FLAG_PREMUL_ALPHA;
+
+	ret = ioctl(stream.src2_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= DST_WIDTH;
+	fmt.fmt.pix_mp.height		= DST_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(stream.dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= STREAM_BUF_NUM;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(stream.src1_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != STREAM_BUF_NUM) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.count	= STREAM_BUF_NUM;
+	ret = ioctl(stream.src2_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != STREAM_BUF_NUM) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.count	= STREAM_BUF_NUM;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(stream.dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != STREAM_BUF_NUM) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                           */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < STREAM_BUF_NUM; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		ret = ioctl(stream.src1_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		stream.psrc1_buf[i] = mmap(0, SRC1_SIZE,
+					   PROT_READ | PROT_WRITE, MAP_SHARED,
+					   stream.src1_fd,
+					   planes[0].m.mem_offset);
+		if (stream.psrc1_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(stream.src2_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		stream.psrc2_buf[i] = mmap(0, SRC2_SIZE,
+					   PROT_READ | PROT_WRITE, MAP_SHARED,
+					   stream.src2_fd,
+					   planes[0].m.mem_offset);
+		if (stream.psrc2_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(stream.dst_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		stream.pdst_buf[i] = mmap(0, DST_SIZE,
+					  PROT_READ | PROT_WRITE, MAP_SHARED,
+					  stream.dst_fd, planes[0].m.mem_offset);
+		if (stream.pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Passes                                                           */
+	/*-------------------------------------------------------------------*/
+	pass[0].pname	= "hardware";
+	pass[0].frames	= frame_num;
+	pass[1].pname	= "sequential";
+	pass[1].frames	= frame_num;
+	pass[2].pname	= "pipelined";
+	pass[2].frames	= frame_num;
+
+	vsp2_trace_begin("stream hardware");
+	ret = stream_pass_hw(&stream, &pass[0]);
+	vsp2_trace_end();
+	if (ret < 0)
+		return -1;
+
+	vsp2_trace_begin("stream sequential");
+	ret = stream_pass_seq(&stream, &pass[1]);
+	vsp2_trace_end();
+	if (ret < 0)
+		return -1;
+
+	vsp2_trace_begin("stream pipelined");
+	ret = stream_pass_pipe(&stream, &pass[2]);
+	vsp2_trace_end();
+	if (ret < 0)
+		return -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(stream.src1_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	ret = ioctl(stream.src2_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(stream.dst_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < STREAM_BUF_NUM; i++) {
+		munmap(stream.psrc1_buf[i], SRC1_SIZE);
+		munmap(stream.psrc2_buf[i], SRC2_SIZE);
+		munmap(stream.pdst_buf[i], DST_SIZE);
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(stream.src1_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	ret = ioctl(stream.src2_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(stream.dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	print_stream_stat(pass, 3);
+
+	close(stream.src1_fd);
+	close(stream.src2_fd);
+	close(stream.dst_fd);
+
+	vsp2_media_close(pmedia);
+
+	return 0;
+}
+
+static int stream_pass_hw(struct bru_stream *ps, struct stream_pass *pp)
+{
+	long long	t_start;
+	int		depth;
+	int		idx = 0;
+	int		frame;
+	int		i;
+
+	/* prepare every set once, outside the timing */
+	depth = (pp->frames < STREAM_BUF_NUM) ? pp->frames : STREAM_BUF_NUM;
+	for (i = 0; i < depth; i++) {
+		if (stream_prepare(ps, i) < 0)
+			return -1;
+	}
+
+	t_start = get_time_us();
+	for (i = 0; i < depth; i++) {
+		if (stream_queue(ps, i) < 0)
+			return -1;
+	}
+
+	for (frame = 0; frame < pp->frames; frame++) {
+		if (stream_dequeue(ps, &idx, &pp->wait_us) < 0)
+			return -1;
+		if (frame + depth < pp->frames) {
+			if (stream_queue(ps, idx) < 0)
+				return -1;
+		}
+	}
+	pp->total_us = get_time_us() - t_start;
+
+	pp->sum = stream_sum(ps->pdst_buf[idx], DST_SIZE);
+	return 0;
+}
+
+static int stream_pass_seq(struct bru_stream *ps, struct stream_pass *pp)
+{
+	long long	t_start, t;
+	int		idx = 0;
+	int		frame;
+
+	t_start = get_time_us();
+	for (frame = 0; frame < pp->frames; frame++) {
+		t = get_time_us();
+		if (stream_prepare(ps, 0) < 0)
+			return -1;
+		pp->prep_us += get_time_us() - t;
+
+		if (stream_queue(ps, 0) < 0)
+			return -1;
+		if (stream_dequeue(ps, &idx, &pp->wait_us) < 0)
+			return -1;
+
+		t = get_time_us();
+		if (write_file(ps->pdst_buf[idx], DST_SIZE,
+			       DST_FILENAME_STREAM) == 0)
+			return -1;
+		pp->write_us += get_time_us() - t;
+	}
+	pp->total_us = get_time_us() - t_start;
+
+	pp->sum = stream_sum(ps->pdst_buf[idx], DST_SIZE);
+	return 0;
+}
+
+static int stream_pass_pipe(struct bru_stream *ps, struct stream_pass *pp)
+{
+	long long	t_start, t;
+	int		done = -1;	/* set to write back, -1 : none */
+	int		idx;
+	int		frame;
+
+	t_start = get_time_us();
+
+	/* frame 0 goes in before anything can overlap with it */
+	t = get_time_us();
+	if (stream_prepare(ps, 0) < 0)
+		return -1;
+	pp->prep_us += get_time_us() - t;
+	if (stream_queue(ps, 0) < 0)
+		return -1;
+
+	/*
+	 * frame N is on the VSP in set N % 3; N+1 is prepared into the next
+	 * set and queued behind it at once, so the VSP does not idle between
+	 * the two, then N-1 is written back from the set left over.
+	 */
+	for (frame = 0; frame < pp->frames; frame++) {
+		if (frame + 1 < pp->frames) {
+			idx = (frame + 1) % STREAM_BUF_NUM;
+
+			t = get_time_us();
+			if (stream_prepare(ps, idx) < 0)
+				return -1;
+			pp->prep_us += get_time_us() - t;
+			if (stream_queue(ps, idx) < 0)
+				return -1;
+		}
+
+		if (done >= 0) {
+			t = get_time_us();
+			if (write_file(ps->pdst_buf[done], DST_SIZE,
+				       DST_FILENAME_STREAM) == 0)
+				return -1;
+			pp->write_us += get_time_us() - t;
+		}
+
+		if (stream_dequeue(ps, &done, &pp->wait_us) < 0)
+			return -1;
+		if (done != frame % STREAM_BUF_NUM) {
+			printf("Error : frame %d came back in set %d\n",
+				frame, done);
+			return -1;
+		}
+	}
+
+	/* the last frame has nothing left to overlap with */
+	t = get_time_us();
+	if (write_file(ps->pdst_buf[done], DST_SIZE,
+		       DST_FILENAME_STREAM) == 0)
+		return -1;
+	pp->write_us += get_time_us() - t;
+	pp->total_us = get_time_us() - t_start;
+
+	pp->sum = stream_sum(ps->pdst_buf[done], DST_SIZE);
+	return 0;
+}
+
+static int stream_prepare(struct bru_stream *ps, int idx)
+{
+	if (read_file(ps->psrc1_buf[idx], SRC1_SIZE, SRC1_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	vsp2_trace_begin("make image");
+	make_stripe_image(ps->psrc2_buf[idx], SRC2_WIDTH, SRC2_HEIGHT);
+	vsp2_trace_end();
+
+	vsp2_trace_begin("premultiply");
+	calc_img_premultiplied_alpha(ps->psrc2_buf[idx], SRC2_WIDTH,
+				     SRC2_HEIGHT);
+	vsp2_trace_end();
+
+	return 0;
+}
+
+static int stream_queue(struct bru_stream *ps, int idx)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	unsigned int		type;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= DST_SIZE;
+
+	if (ioctl(ps->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.m.planes[0].bytesused	= SRC1_SIZE;
+	buf.bytesused			= SRC1_SIZE;
+
+	if (ioctl(ps->src1_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	buf.m.planes[0].bytesused	= SRC2_SIZE;
+	buf.bytesused			= SRC2_SIZE;
+
+	if (ioctl(ps->src2_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	if (ps->streaming)
+		return 0;
+
+	/* the queues start on their first buffers */
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (ioctl(ps->src1_fd, VIDIOC_STREAMON, &type) < 0 ||
+	    ioctl(ps->src2_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(ps->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	ps->streaming = true;
+
+	return 0;
+}
+
+static int stream_dequeue(struct bru_stream *ps, int *pidx,
+			  long long *pwait_us)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	long long		t;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	t = get_time_us();
+	if (ioctl(ps->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	*pwait_us += get_time_us() - t;
+	*pidx = buf.index;
+
+	/* the sources of a finished frame are done as well */
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	if (ioctl(ps->src1_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	buf.length	= VIDEO_MAX_PLANES;
+	if (ioctl(ps->src2_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+static unsigned long long stream_sum(const unsigned char *pbuf,
+				     unsigned int size)
+{
+	const unsigned int	*p = (const unsigned int *)pbuf;
+	unsigned long long	sum = 0;
+	unsigned int		i;
+
+	for (i = 0; i < size / 4; i++)
+		sum = sum * 31 + p[i];
+
+	return sum;
+}
+
+static void print_stream_stat(struct stream_pass *ppass, int num)
+{
+	struct stream_pass	*phw = &ppass[0];
+	struct stream_pass	*pseq = &ppass[1];
+	struct stream_pass	*ppipe = &ppass[2];
+	double			hw_ms, cpu_ms;
+	bool			match = true;
+	int			i;
+
+	printf("\n----- BRU STREAM -----\n");
+	printf("frames        : %d, %d buffer sets\n", phw->frames,
+		STREAM_BUF_NUM);
+	printf("pass          :     fps  ms/frame   prep ms  write ms"
+	       "   wait ms\n");
+	for (i = 0; i < num; i++) {
+		struct stream_pass	*pp = &ppass[i];
+		double			n = pp->frames;
+
+		printf("  %-12s: %7.1f  %8.2f  %8.2f  %8.2f  %8.2f\n",
+			pp->pname, pp->total_us ? n * 1e6 / pp->total_us : 0,
+			pp->total_us / n / 1000, pp->prep_us / n / 1000,
+			pp->write_us / n / 1000, pp->wait_us / n / 1000);
+		if (pp->sum != phw->sum)
+			match = false;
+	}
+
+	/* hardware time over the time the passes took */
+	if (pseq->total_us && ppipe->total_us)
+		printf("throughput    : pipelined %.1f %% of hardware "
+		       "(sequential %.1f %%)\n",
+			100.0 * phw->total_us / ppipe->total_us,
+			100.0 * phw->total_us / pseq->total_us);
+
+	/* one CPU thread can overlap with the VSP but not with itself */
+	hw_ms	= phw->total_us / (double)phw->frames / 1000;
+	cpu_ms	= (ppipe->prep_us + ppipe->write_us) /
+		  (double)ppipe->frames / 1000;
+	printf("bound         : %s (prepare + write back %.2f ms, "
+	       "hardware %.2f ms)\n", cpu_ms > hw_ms ? "cpu" : "hardware",
+		cpu_ms, hw_ms);
+	printf("result        : %s\n", match ? "OK" : "NG");
+	printf("----------------------\n");
+}
+
 /******************************************************************************
  *  internal function
  ******************************************************************************/
@@ -2115,6 +2817,8 @@ static int read_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("read file");
+
 	fp = fopen(pfilename, "rb");
 	if (fp == NULL) {
 		printf("file open error...\n");
@@ -2125,6 +2829,7 @@ static int read_file(
 			printf("buffer read error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
@@ -2137,6 +2842,8 @@ static int write_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("write file");
+
 	/* file output */
 	fp = fopen(pfilename, "wb");
 	if (!fp) {
@@ -2148,183 +2855,57 @@ static int write_file(
 			printf("buffer write error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
-static int call_media_ctl(struct media_device **ppmedia,
-			  const char **ppmedia_name)
+static int call_media_ctl(struct vsp2_media **ppmedia)
 {
-	struct media_device		*pmedia;
-	struct media_link		*plink;
-	char				*endp;
-	struct dev_pads			rpf0pad;
-	struct dev_pads			rpf1pad;
-	struct dev_brupads		brupad;
-	struct dev_pads			wpfpad;
+	struct vsp2_media		*pmedia;
 	struct v4l2_mbus_framefmt	format;
 	struct v4l2_rect		rect;
 
-	const struct media_device_info	*pinfo;
-	char		*p;
-	const char	*pname;
-	char		buf[128];
-
 	/* Initialize v4l2 media controller */
-	pmedia = media_device_new(MEDIA_DEV_NAME);
+	pmedia = vsp2_media_open(MEDIA_DEV_NAME);
 	if (!pmedia) {
-		printf("Error : media_device_new()\n");
+		printf("Error : vsp2_media_open()\n");
 		return -1;
 	}
 
 	*ppmedia = pmedia;
 
-	if (media_device_enumerate(pmedia) != 0) {
-		printf("Error : media_device_enumerate()\n");
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
 		return -1;
 	}
 
-	if (media_reset_links(pmedia) != 0) {
-		printf("Error : media_reset_links()\n");
-		return -1;
-	}
-
-	/* get media device name */
-	pinfo = media_get_info(pmedia);
-	p = strchr(pinfo->bus_info, ':');
-	if (p)
-		pname = p + 1;
-	else
-		pname = pinfo->bus_info;
-
-	*ppmedia_name = pname;
-
 	/*----------------------*/
 	/* rpf.0:1 -> bru:0     */
 	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1 -> '%s bru':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(rpf.0 -> bru)\n");
-		return -1;
-	}
-	/*------------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(rpf.0 -> bru)\n");
+	if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "bru", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf.0 -> bru)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.1:1 -> bru:1     */
 	/*----------------------*/
-	sprintf(buf, "'%s rpf.1':1 -> '%s bru':1", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(rpf.1 -> bru)\n");
-		return -1;
-	}
-	/*------------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(rpf.1 -> bru)\n");
+	if (vsp2_media_setup_link(pmedia, "rpf.1", 1, "bru", 1, true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf.1 -> bru)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* bru:5 -> wpf.0:0     */
 	/*----------------------*/
-	sprintf(buf, "'%s bru':5 -> '%s wpf.0':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(bru -> wpf)\n");
-		return -1;
-	}
-	/*------------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(bru -> wpf)\n");
+	if (vsp2_media_setup_link(pmedia, "bru", 5, "wpf.0", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(bru -> wpf)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1 -> output    */
 	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1 -> '%s wpf.0 output':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(wpf -> output)\n");
-		return -1;
-	}
-	/*------------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(wpf -> output)\n");
-		return -1;
-	}
-
-	/*---------------------------------------------------- get pads */
-	/*----------------------*/
-	/* rpf0 pad             */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':0", pname);
-	rpf0pad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (rpf0pad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf.0 pad 0)\n");
-		return -1;
-	}
-	/*------------------------*/
-	sprintf(buf, "'%s rpf.0':1", pname);
-	rpf0pad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (rpf0pad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf.0 pad 1)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* rpf1 pad             */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.1':0", pname);
-	rpf1pad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (rpf1pad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf.1 pad 0)\n");
-		return -1;
-	}
-	/*------------------------*/
-	sprintf(buf, "'%s rpf.1':1", pname);
-	rpf1pad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (rpf1pad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf.1 pad 1)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* bru pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s bru':0", pname);
-	brupad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (brupad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(bru pad 0)\n");
-		return -1;
-	}
-	/*------------------------*/
-	sprintf(buf, "'%s bru':1", pname);
-	brupad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (brupad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(bru pad 1)\n");
-		return -1;
-	}
-	/*------------------------*/
-	sprintf(buf, "'%s bru':5", pname);
-	brupad.ppad5 = media_parse_pad(pmedia, buf, NULL);
-	if (brupad.ppad5 == NULL) {
-		printf("Error : media_parse_pad(bru pad 5)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* wpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':0", pname);
-	wpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
-		return -1;
-	}
-	/*------------------------*/
-	sprintf(buf, "'%s wpf.0':1", pname);
-	wpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 1)\n");
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
 		return -1;
 	}
 
@@ -2336,17 +2917,15 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC1_WIDTH;
 	format.height	= SRC1_HEIGHT;
 	format.code		= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(rpf0pad.ppad0->entity, &format,
-		rpf0pad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf.0 pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf.0 pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(rpf0pad.ppad1->entity, &format,
-		rpf0pad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf.0 pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf.0 pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2355,17 +2934,15 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC2_WIDTH;
 	format.height	= SRC2_HEIGHT;
 	format.code		= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(rpf1pad.ppad0->entity, &format,
-		rpf1pad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf.1 pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.1", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf.1 pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.1:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(rpf1pad.ppad1->entity, &format,
-		rpf1pad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf.1 pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.1", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf.1 pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2374,9 +2951,8 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC1_WIDTH;
 	format.height	= SRC1_HEIGHT;
 	format.code		= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(brupad.ppad0->entity, &format,
-		brupad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(bru pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "bru", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(bru pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2385,9 +2961,8 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC2_WIDTH;
 	format.height	= SRC2_HEIGHT;
 	format.code		= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(brupad.ppad1->entity, &format,
-		brupad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(bru pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "bru", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(bru pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2396,25 +2971,22 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= DST_WIDTH;
 	format.height	= DST_HEIGHT;
 	format.code		= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(brupad.ppad5->entity, &format,
-		brupad.ppad5->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(bru pad 5)\n");
+	if (vsp2_media_set_format(pmedia, "bru", 5, &format) != 0) {
+		printf("Error : vsp2_media_set_format(bru pad 5)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:0              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad0->entity, &format,
-		wpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad1->entity, &format,
-		wpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2424,10 +2996,9 @@ static int call_media_ctl(struct media_device **ppmedia,
 	rect.top    = 0;
 	rect.width  = SRC1_WIDTH;
 	rect.height = SRC1_HEIGHT;
-	if (v4l2_subdev_set_selection(rpf0pad.ppad0->entity, &rect,
-		rpf0pad.ppad0->index, V4L2_SEL_TGT_CROP,
-		V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_selection(rpf.0 pad 0)\n");
+	if (vsp2_media_set_selection(pmedia, "rpf.0", 0,
+		V4L2_SEL_TGT_CROP, &rect) != 0) {
+		printf("Error : vsp2_media_set_selection(rpf.0 pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2437,10 +3008,9 @@ static int call_media_ctl(struct media_device **ppmedia,
 	rect.top    = 0;
 	rect.width  = SRC2_WIDTH;
 	rect.height = SRC2_HEIGHT;
-	if (v4l2_subdev_set_selection(rpf1pad.ppad0->entity, &rect,
-		rpf1pad.ppad0->index, V4L2_SEL_TGT_CROP,
-		V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_selection(rpf.1 pad 0)\n");
+	if (vsp2_media_set_selection(pmedia, "rpf.1", 0,
+		V4L2_SEL_TGT_CROP, &rect) != 0) {
+		printf("Error : vsp2_media_set_selection(rpf.1 pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2450,10 +3020,9 @@ static int call_media_ctl(struct media_device **ppmedia,
 	rect.top    = 0;
 	rect.width  = SRC1_WIDTH;
 	rect.height = SRC1_HEIGHT;
-	if (v4l2_subdev_set_selection(brupad.ppad0->entity, &rect,
-		brupad.ppad0->index, V4L2_SEL_TGT_COMPOSE,
-		V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_selection(bru pad 0)\n");
+	if (vsp2_media_set_selection(pmedia, "bru", 0,
+		V4L2_SEL_TGT_COMPOSE, &rect) != 0) {
+		printf("Error : vsp2_media_set_selection(bru pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -2463,10 +3032,9 @@ static int call_media_ctl(struct media_device **ppmedia,
 	rect.top    = 50;
 	rect.width  = SRC2_WIDTH;
 	rect.height = SRC2_HEIGHT;
-	if (v4l2_subdev_set_selection(brupad.ppad1->entity, &rect,
-		brupad.ppad1->index, V4L2_SEL_TGT_COMPOSE,
-		V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_selection(bru pad 1)\n");
+	if (vsp2_media_set_selection(pmedia, "bru", 1,
+		V4L2_SEL_TGT_COMPOSE, &rect) != 0) {
+		printf("Error : vsp2_media_set_selection(bru pad 1)\n");
 		return -1;
 	}
 	return 0;
@@ -2540,21 +3108,21 @@ static void calc_img_premultiplied_alpha(void *pbuf, int width, int height)
 	}
 }
 
-static int open_video_device(struct media_device *pmedia, char *pentity_base,
-			     const char *pmedia_name)
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
 {
-	char entity_name[32];
-	const char *pdevname;
-	struct media_entity *pentity;
+	int fd;
 
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-					   strlen(entity_name));
-	if (!pentity) {
-		printf("Error media_get_entity(%s)\n", entity_name);
-		return -1;
-	}
-	pdevname = media_entity_get_devname(pentity);
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
 
-	return open(pdevname, O_RDWR);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
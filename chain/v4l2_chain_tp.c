@@ -0,0 +1,1071 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : stage 1 rpf -> uds -> wpf, stage 2 rpf -> lut -> wpf,
+ *                each stage on its own VSP
+ *  memory type : stage 1 mmap, exported (VIDIOC_EXPBUF);
+ *                stage 2 source dmabuf (the stage 1 buffers), output mmap
+ *
+ *  The wpf capture buffers of stage 1 are queued as they are into the rpf
+ *  of stage 2, so the intermediate frame goes from one VSP to the other
+ *  without a CPU copy and without even being mapped. Every intermediate
+ *  buffer has one owner at a time:
+ *
+ *    FREE -> WPF (queued on stage 1) -> RPF (queued on stage 2) -> FREE
+ *
+ *  and every hand-over checks the owner it takes the buffer from. Slot k
+ *  is stage 1 source k, intermediate k and stage 2 output k, so stage 2
+ *  source index k always gets the same dmabuf and keeps its attachment.
+ *  -c runs the same frames again with the intermediate copied by the CPU
+ *  into a mmap source of stage 2, and compares.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#ifndef USE_M3
+/* for h3 */
+#define UDS_DEV_NAME		"/dev/media2"
+#define LUT_DEV_NAME		"/dev/media3"		/* fe9a0000.vsp */
+#else
+/* for m3 */
+#define UDS_DEV_NAME		"/dev/media1"
+#define LUT_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
+#endif
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* source parameter */
+#define SRC_FILENAME		"1280_720_ARGB32.argb"
+#define SRC_WIDTH		(1280)			/* src: width */
+#define SRC_HEIGHT		(720)			/* src: height */
+#define SRC_SIZE		(SRC_WIDTH*SRC_HEIGHT*4)
+
+/* intermediate and destination parameter */
+#define DST_WIDTH		(1920)
+#define DST_HEIGHT		(1080)
+#define DST_SIZE		(DST_WIDTH*DST_HEIGHT*4)
+
+/* lut parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+
+/* chain parameter */
+#define CHAIN_STAGE_NUM		(2)
+#define CHAIN_BUF_MAX		(8)
+#define CHAIN_BUF_NUM		(3)		/* frames in flight */
+#define CHAIN_FRAME_NUM		(100)
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct chain_stage {
+	const char		*pname;
+	const char		*pentity;
+	char			devnode[32];
+	unsigned int		src_width;
+	unsigned int		src_height;
+	unsigned int		dst_width;
+	unsigned int		dst_height;
+	unsigned int		src_memory;	/* MMAP, or DMABUF */
+
+	struct vsp2_media	*pmedia;
+	int			src_fd;
+	int			dst_fd;
+	int			lut_fd;
+	MMNGR_ID		lut_id;
+	unsigned long		lut_virt;
+	unsigned char		*psrc_buf[CHAIN_BUF_MAX];	/* mmap only */
+	unsigned char		*pdst_buf[CHAIN_BUF_MAX];	/* NULL : not
+								 * mapped */
+	int			queued;		/* frames on the VSP */
+	bool			streaming;
+};
+
+enum chain_owner {
+	OWN_FREE,		/* on no queue, the chain may queue it */
+	OWN_WPF,		/* stage 1 writes it */
+	OWN_RPF,		/* stage 2 reads it */
+};
+
+struct chain_buf {
+	int			dmafd;		/* exported, -1 : copy mode */
+	enum chain_owner	owner;
+	int			frame;
+	long long		t_start;
+};
+
+struct chain_stat {
+	int			done;
+	long long		elapsed;
+	long long		lat_sum;
+	long long		lat_max;
+	unsigned long long	cpu_bytes;	/* intermediate read + written */
+	int			violations;	/* owner checks failed */
+	unsigned long long	hash;		/* last frame */
+	int			mismatch;	/* frames unlike the first */
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct chain_stage	chain_stage[CHAIN_STAGE_NUM] = {
+	{ "uds", "uds.0", UDS_DEV_NAME, SRC_WIDTH, SRC_HEIGHT,
+	  DST_WIDTH, DST_HEIGHT, V4L2_MEMORY_MMAP },
+	{ "lut", "lut", LUT_DEV_NAME, DST_WIDTH, DST_HEIGHT,
+	  DST_WIDTH, DST_HEIGHT, V4L2_MEMORY_DMABUF },
+};
+
+static struct chain_buf		chain_buf[CHAIN_BUF_MAX];
+static const char * const	chain_owner_name[] = { "free", "wpf", "rpf" };
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	run_chain(unsigned char *pimage, int frame_num, int buf_num,
+			  bool copy, struct chain_stat *pstat);
+static void	print_chain_stat(const char *pname,
+				 const struct chain_stat *pstat);
+static int	start_stage(struct chain_stage *pst, int buf_num,
+			    unsigned char *pimage, bool export);
+static void	stop_stage(struct chain_stage *pst, int buf_num);
+static int	queue_frame(struct chain_stage *pst, int slot);
+static int	dequeue_frame(struct chain_stage *pst);
+static int	set_owner(struct chain_buf *pbuf, int slot,
+			  enum chain_owner from, enum chain_owner to,
+			  struct chain_stat *pstat);
+static int	write_file(unsigned char*, unsigned int, const char*);
+static int	read_file(unsigned char*, unsigned int, const char*);
+static int	call_media_ctl(struct chain_stage *pst);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity, int flags);
+static int	commit_lut(int lut_fd, void *plut_table);
+static unsigned long long	calc_hash(const void *pdata, size_t len);
+static long long	get_time_us(void);
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -u <media>: VSP of the uds stage [%s]\n",
+	       UDS_DEV_NAME);
+	printf("        -l <media>: VSP of the lut stage [%s]\n",
+	       LUT_DEV_NAME);
+	printf("        -n <num>: frames [%d]\n", CHAIN_FRAME_NUM);
+	printf("        -q <num>: frames in flight, 2 - %d [%d]\n",
+	       CHAIN_BUF_MAX, CHAIN_BUF_NUM);
+	printf("        -c: run again copying the intermediate by the CPU\n");
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct chain_stat	zero_stat;
+	struct chain_stat	copy_stat;
+	unsigned char		*pimage;
+	int			frame_num = CHAIN_FRAME_NUM;
+	int			buf_num = CHAIN_BUF_NUM;
+	bool			copy = false;
+	int			ercd = 0;
+	int			opt;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "u:l:n:q:ch")) != -1) {
+		switch (opt) {
+		case 'u':
+			snprintf(chain_stage[0].devnode,
+				 sizeof(chain_stage[0].devnode), "%s", optarg);
+			break;
+		case 'l':
+			snprintf(chain_stage[1].devnode,
+				 sizeof(chain_stage[1].devnode), "%s", optarg);
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 'q':
+			buf_num = atoi(optarg);
+			break;
+		case 'c':
+			copy = true;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (frame_num < 1 || buf_num < 2 || buf_num > CHAIN_BUF_MAX) {
+		print_usage(argv[0]);
+		exit(0);
+	}
+
+	/* each stage owns its whole device, wpf.0 included */
+	if (strcmp(chain_stage[0].devnode, chain_stage[1].devnode) == 0) {
+		printf("Error : %s used by both stages\n",
+		       chain_stage[0].devnode);
+		exit(1);
+	}
+
+	printf("exec CHAIN %s on %s -> %s on %s, %d frames, %d in flight\n",
+	       chain_stage[0].pname, chain_stage[0].devnode,
+	       chain_stage[1].pname, chain_stage[1].devnode, frame_num,
+	       buf_num);
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file                                                        */
+	/*-------------------------------------------------------------------*/
+	pimage = malloc(SRC_SIZE);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		exit(1);
+	}
+	if (read_file(pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		free(pimage);
+		exit(1);
+	}
+
+	if (run_chain(pimage, frame_num, buf_num, false, &zero_stat) < 0) {
+		ercd = 1;
+		goto end;
+	}
+	print_chain_stat("zero copy", &zero_stat);
+
+	if (copy) {
+		if (run_chain(pimage, frame_num, buf_num, true,
+			      &copy_stat) < 0) {
+			ercd = 1;
+			goto end;
+		}
+		print_chain_stat("cpu copy", &copy_stat);
+		printf("  output : %s\n", zero_stat.hash == copy_stat.hash ?
+		       "same" : "DIFFER");
+	}
+
+end:
+
+	free(pimage);
+	exit(ercd);
+}
+
+/******************************************************************************
+ *  chain
+ ******************************************************************************/
+static int run_chain(unsigned char *pimage, int frame_num, int buf_num,
+		     bool copy, struct chain_stat *pstat)
+{
+	struct chain_stage	*pst1 = &chain_stage[0];
+	struct chain_stage	*pst2 = &chain_stage[1];
+	struct chain_buf	*pbuf;
+	struct pollfd		pfd[CHAIN_STAGE_NUM];
+	struct chain_stage	*ppoll[CHAIN_STAGE_NUM];
+	unsigned long long	ref_hash = 0;
+	unsigned long long	hash;
+	long long		t_first;
+	long long		lat;
+	int			next_frame = 0;
+	int			last_slot = -1;
+	int			poll_num;
+	int			ercd = 0;
+	int			slot;
+	int			i;
+
+	memset(pstat, 0, sizeof(*pstat));
+	for (i = 0; i < CHAIN_BUF_MAX; i++) {
+		chain_buf[i].dmafd	= -1;
+		chain_buf[i].owner	= OWN_FREE;
+	}
+	for (i = 0; i < CHAIN_STAGE_NUM; i++) {
+		chain_stage[i].pmedia		= NULL;
+		chain_stage[i].src_fd		= -1;
+		chain_stage[i].dst_fd		= -1;
+		chain_stage[i].lut_fd		= -1;
+		chain_stage[i].lut_virt		= 0;
+		chain_stage[i].queued		= 0;
+		chain_stage[i].streaming	= false;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Set up both stages                                               */
+	/*-------------------------------------------------------------------*/
+	vsp2_mem_pipeline(copy ? "chain cpu copy" : "chain zero copy");
+	pst2->src_memory = copy ? V4L2_MEMORY_MMAP : V4L2_MEMORY_DMABUF;
+
+	if (start_stage(pst1, buf_num, pimage, !copy) < 0 ||
+	    start_stage(pst2, buf_num, NULL, false) < 0) {
+		ercd = -1;
+		goto stop;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Stream frames through the chain                                  */
+	/*-------------------------------------------------------------------*/
+	t_first = get_time_us();
+	while (pstat->done < frame_num) {
+		/* a free slot starts the next frame on stage 1 */
+		for (slot = 0; slot < buf_num && next_frame < frame_num;
+		     slot++) {
+			pbuf = &chain_buf[slot];
+			if (pbuf->owner != OWN_FREE)
+				continue;
+			if (set_owner(pbuf, slot, OWN_FREE, OWN_WPF,
+				      pstat) < 0 ||
+			    queue_frame(pst1, slot) < 0) {
+				ercd = -1;
+				goto stop;
+			}
+			pbuf->frame	= next_frame++;
+			pbuf->t_start	= get_time_us();
+		}
+
+		/* a stage with nothing queued would poll as an error */
+		poll_num = 0;
+		for (i = 0; i < CHAIN_STAGE_NUM; i++) {
+			if (chain_stage[i].queued == 0)
+				continue;
+			pfd[poll_num].fd	= chain_stage[i].dst_fd;
+			pfd[poll_num].events	= POLLIN;
+			pfd[poll_num].revents	= 0;
+			ppoll[poll_num++]	= &chain_stage[i];
+		}
+		if (poll(pfd, poll_num, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			ercd = -1;
+			goto stop;
+		}
+
+		for (i = 0; i < poll_num; i++) {
+			if (pfd[i].revents == 0)
+				continue;
+
+			slot = dequeue_frame(ppoll[i]);
+			if (slot == -EAGAIN)
+				continue;
+			if (slot < 0) {
+				ercd = -1;
+				goto stop;
+			}
+			pbuf = &chain_buf[slot];
+
+			if (ppoll[i] == pst1) {
+				/*---------------------------------------------*/
+				/*  Stage 1 done : hand the output to stage 2  */
+				/*---------------------------------------------*/
+				if (copy) {
+					memcpy(pst2->psrc_buf[slot],
+					       pst1->pdst_buf[slot], DST_SIZE);
+					pstat->cpu_bytes += DST_SIZE * 2ULL;
+				}
+				if (set_owner(pbuf, slot, OWN_WPF, OWN_RPF,
+					      pstat) < 0 ||
+				    queue_frame(pst2, slot) < 0) {
+					ercd = -1;
+					goto stop;
+				}
+				continue;
+			}
+
+			/*-----------------------------------------------------*/
+			/*  Stage 2 done : the intermediate is free again      */
+			/*-----------------------------------------------------*/
+			if (set_owner(pbuf, slot, OWN_RPF, OWN_FREE,
+				      pstat) < 0) {
+				ercd = -1;
+				goto stop;
+			}
+			lat = get_time_us() - pbuf->t_start;
+			pstat->lat_sum += lat;
+			if (lat > pstat->lat_max)
+				pstat->lat_max = lat;
+
+			/* the first and the last frame are checked */
+			if (pbuf->frame == 0 || pbuf->frame == frame_num - 1) {
+				hash = calc_hash(pst2->pdst_buf[slot],
+						 DST_SIZE);
+				if (pbuf->frame == 0)
+					ref_hash = hash;
+				else if (hash != ref_hash)
+					pstat->mismatch++;
+				pstat->hash = hash;
+			}
+			if (pbuf->frame == frame_num - 1)
+				last_slot = slot;
+			pstat->done++;
+		}
+	}
+	pstat->elapsed = get_time_us() - t_first;
+
+	/*-------------------------------------------------------------------*/
+	/*  Write file (last frame)                                          */
+	/*-------------------------------------------------------------------*/
+	if (last_slot >= 0 && !copy)
+		write_file(pst2->pdst_buf[last_slot], DST_SIZE,
+			   "1920_1080_ARGB32_CHAIN.argb");
+
+stop:
+	/* stage 2 lets go of its attachments before stage 1 frees */
+	stop_stage(pst2, buf_num);
+	stop_stage(pst1, buf_num);
+	for (i = 0; i < CHAIN_BUF_MAX; i++) {
+		if (chain_buf[i].dmafd >= 0)
+			close(chain_buf[i].dmafd);
+		chain_buf[i].dmafd = -1;
+	}
+	return ercd;
+}
+
+static void print_chain_stat(const char *pname,
+			     const struct chain_stat *pstat)
+{
+	double	fps = 0.0;
+
+	if (pstat->elapsed > 0)
+		fps = (double)pstat->done * 1000000.0 / pstat->elapsed;
+
+	printf("  %-9s : %d frames, %.1f fps, latency avg %.2f ms max "
+	       "%.2f ms\n", pname, pstat->done, fps,
+	       pstat->done ? pstat->lat_sum / 1000.0 / pstat->done : 0.0,
+	       pstat->lat_max / 1000.0);
+	printf("              cpu %.2f MB per frame, owner checks %s (%d "
+	       "failed), frames %s\n",
+	       pstat->done ? (double)pstat->cpu_bytes / pstat->done /
+			     (1024.0 * 1024.0) : 0.0,
+	       pstat->violations ? "NG" : "OK", pstat->violations,
+	       pstat->mismatch ? "DIFFER" : "same");
+}
+
+static int set_owner(struct chain_buf *pbuf, int slot,
+		     enum chain_owner from, enum chain_owner to,
+		     struct chain_stat *pstat)
+{
+	if (pbuf->owner != from) {
+		printf("Error : buffer %d owned by %s, not %s\n", slot,
+		       chain_owner_name[pbuf->owner], chain_owner_name[from]);
+		pstat->violations++;
+		return -1;
+	}
+	pbuf->owner = to;
+	return 0;
+}
+
+/******************************************************************************
+ *  stage
+ ******************************************************************************/
+static int start_stage(struct chain_stage *pst, int buf_num,
+		       unsigned char *pimage, bool export)
+{
+	struct v4l2_format		fmt;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	struct v4l2_exportbuffer	exp;
+	unsigned int			*ptbl;
+	unsigned long			phys, hard;
+	unsigned int			src_size;
+	unsigned int			dst_size;
+	int				ret;
+	int				i;
+
+	src_size	= pst->src_width * pst->src_height * 4;
+	dst_size	= pst->dst_width * pst->dst_height * 4;
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(pst);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	pst->src_fd = open_video_device(pst->pmedia, SRC_INPUT_DEV, O_RDWR);
+	if (pst->src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/* dst is polled, done buffers are drained without blocking */
+	pst->dst_fd = open_video_device(pst->pmedia, DST_OUTPUT_DEV,
+					O_RDWR | O_NONBLOCK);
+	if (pst->dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Lookup table (negative) - VIDIOC_VSP2_LUT_CONFIG                 */
+	/*-------------------------------------------------------------------*/
+	if (strcmp(pst->pname, "lut") == 0) {
+		pst->lut_fd = open_video_device(pst->pmedia, "lut", O_RDWR);
+		if (pst->lut_fd == -1) {
+			printf("Error open lut device: %s (%d).\n",
+				strerror(errno), errno);
+			return -1;
+		}
+
+		ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &pst->lut_id,
+				     LUT_TBL_NUM*8, &phys, &hard,
+				     &pst->lut_virt, MMNGR_VA_SUPPORT);
+		if (ret != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			pst->lut_virt = 0;
+			return -1;
+		}
+
+		ptbl = (unsigned int *)pst->lut_virt;
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			ptbl[i*2]	= LUT_REG_ADDR + i*4;
+			ptbl[i*2+1]	= (255 - i) << 16
+					| (255 - i) << 8
+					| (255 - i);
+		}
+
+		ret = commit_lut(pst->lut_fd, (void *)pst->lut_virt);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= pst->src_width;
+	fmt.fmt.pix_mp.height		= pst->src_height;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(pst->src_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= pst->dst_width;
+	fmt.fmt.pix_mp.height		= pst->dst_height;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.num_planes	= 1;		/* argb32 */
+
+	ret = ioctl(pst->dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= pst->src_memory;
+
+	ret = ioctl(pst->src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || (int)req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(pst->dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || (int)req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap / VIDIOC_EXPBUF                           */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		if (pst->src_memory == V4L2_MEMORY_MMAP) {
+			ret = ioctl(pst->src_fd, VIDIOC_QUERYBUF, &buf);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n", __LINE__,
+				       errno);
+				return -1;
+			}
+			pst->psrc_buf[i] = mmap(0, src_size,
+						PROT_READ | PROT_WRITE,
+						MAP_SHARED, pst->src_fd,
+						planes[0].m.mem_offset);
+			if (pst->psrc_buf[i] == MAP_FAILED) {
+				printf("Error(%d) : mmap\n", __LINE__);
+				pst->psrc_buf[i] = NULL;
+				return -1;
+			}
+
+			/* the first stage reads the same image every frame */
+			if (pimage != NULL)
+				memcpy(pst->psrc_buf[i], pimage, src_size);
+		}
+
+		/* an exported buffer stays unmapped : only the VSPs use it */
+		if (export) {
+			memset(&exp, 0, sizeof(exp));
+			exp.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+			exp.index	= i;
+			exp.plane	= 0;
+			exp.flags	= O_CLOEXEC | O_RDWR;
+
+			ret = ioctl(pst->dst_fd, VIDIOC_EXPBUF, &exp);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n", __LINE__,
+				       errno);
+				return -1;
+			}
+			chain_buf[i].dmafd = exp.fd;
+			continue;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(pst->dst_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pst->pdst_buf[i] = mmap(0, dst_size, PROT_READ | PROT_WRITE,
+					MAP_SHARED, pst->dst_fd,
+					planes[0].m.mem_offset);
+		if (pst->pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			pst->pdst_buf[i] = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void stop_stage(struct chain_stage *pst, int buf_num)
+{
+	struct v4l2_requestbuffers	req_buf;
+	unsigned int			type;
+	int				i;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+	if (pst->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(pst->src_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pst->dst_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		pst->streaming = false;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		if (pst->psrc_buf[i] != NULL)
+			munmap(pst->psrc_buf[i],
+			       pst->src_width * pst->src_height * 4);
+		if (pst->pdst_buf[i] != NULL)
+			munmap(pst->pdst_buf[i],
+			       pst->dst_width * pst->dst_height * 4);
+		pst->psrc_buf[i] = NULL;
+		pst->pdst_buf[i] = NULL;
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	if (pst->src_fd != -1) {
+		req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		req_buf.memory	= pst->src_memory;
+		if (ioctl(pst->src_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		close(pst->src_fd);
+		pst->src_fd = -1;
+	}
+	if (pst->dst_fd != -1) {
+		req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		req_buf.memory	= V4L2_MEMORY_MMAP;
+		if (ioctl(pst->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		close(pst->dst_fd);
+		pst->dst_fd = -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for lookup table                                  */
+	/*-------------------------------------------------------------------*/
+	if (pst->lut_virt != 0)
+		vsp2_mem_free(pst->lut_id);
+	pst->lut_virt = 0;
+	if (pst->lut_fd != -1)
+		close(pst->lut_fd);
+	pst->lut_fd = -1;
+
+	vsp2_media_close(pst->pmedia);
+	pst->pmedia = NULL;
+}
+
+static int queue_frame(struct chain_stage *pst, int slot)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	unsigned int		src_size = pst->src_width * pst->src_height * 4;
+	unsigned int		type;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= slot;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused = pst->dst_width * pst->dst_height * 4;
+
+	if (ioctl(pst->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= slot;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= pst->src_memory;
+	buf.length	= 1;
+	buf.bytesused	= src_size;
+	buf.m.planes[0].bytesused	= src_size;
+	if (pst->src_memory == V4L2_MEMORY_DMABUF) {
+		/* the slot's own buffer, so the attachment is kept */
+		buf.m.planes[0].m.fd	= chain_buf[slot].dmafd;
+		buf.m.planes[0].length	= src_size;
+	}
+
+	if (ioctl(pst->src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	pst->queued++;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMON (with the first frame)                           */
+	/*-------------------------------------------------------------------*/
+	if (!pst->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(pst->src_fd, VIDIOC_STREAMON, &type) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pst->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pst->streaming = true;
+	}
+	return 0;
+}
+
+/* slot of a finished frame, -EAGAIN when none is done, or -1 */
+static int dequeue_frame(struct chain_stage *pst)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	int			slot;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	if (ioctl(pst->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+		if (errno == EAGAIN)
+			return -EAGAIN;
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	slot = buf.index;
+
+	/* the source of a finished frame is done as well */
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= pst->src_memory;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	if (ioctl(pst->src_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if ((int)buf.index != slot) {
+		printf("error line=%d index=%d/%d\n", __LINE__, buf.index,
+		       slot);
+		return -1;
+	}
+	pst->queued--;
+	return slot;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int write_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("write file");
+
+	/* file output */
+	fp = fopen(pfilename, "wb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fwrite(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer write error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	/* file input */
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int call_media_ctl(struct chain_stage *pst)
+{
+	struct vsp2_media		*pmedia;
+	struct v4l2_mbus_framefmt	format;
+
+	/* Initialize v4l2 media controller */
+	pmedia = vsp2_media_open(pst->devnode);
+	if (!pmedia) {
+		printf("Error : vsp2_media_open(%s)\n", pst->devnode);
+		return -1;
+	}
+
+	pst->pmedia = pmedia;
+
+	if (!vsp2_media_has_entity(pmedia, pst->pentity)) {
+		printf("Error : %s has no %s\n", pst->devnode, pst->pentity);
+		return -1;
+	}
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [module] -> wpf.0:0   */
+	/*----------------------------------*/
+	if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pst->pentity, 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf -> %s)\n",
+		       pst->pentity);
+		return -1;
+	}
+	if (vsp2_media_setup_link(pmedia, pst->pentity, 1, "wpf.0", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(%s -> wpf)\n",
+		       pst->pentity);
+		return -1;
+	}
+	/*----------------------*/
+	/* wpf.0:1 -> output    */
+	/*----------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/*----------------------------------------------------- set format */
+	format.width	= pst->src_width;
+	format.height	= pst->src_height;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 0)\n");
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 1)\n");
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, pst->pentity, 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(%s pad 0)\n",
+		       pst->pentity);
+		return -1;
+	}
+	format.width	= pst->dst_width;
+	format.height	= pst->dst_height;
+	if (vsp2_media_set_format(pmedia, pst->pentity, 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(%s pad 1)\n",
+		       pst->pentity);
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity,
+			     int flags)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, flags);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
+
+static int commit_lut(int lut_fd, void *plut_table)
+{
+	struct vsp2_lut_config	lut_par;
+
+	memset(&lut_par, 0, sizeof(lut_par));
+	lut_par.addr	= plut_table;
+	lut_par.tbl_num	= LUT_TBL_NUM;
+	lut_par.fxa	= 0x80;
+
+	return ioctl(lut_fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+}
+
+static unsigned long long calc_hash(const void *pdata, size_t len)
+{
+	const unsigned long long	*p = pdata;
+	unsigned long long		hash = 0xcbf29ce484222325ULL;
+
+	/* FNV-1a on 64-bit words, frames are a multiple of 8 bytes */
+	for (len /= sizeof(*p); len > 0; len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
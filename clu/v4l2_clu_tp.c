@@ -15,6 +15,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
@@ -24,6 +26,12 @@
 #include "mmngr_user_public.h"
 #include "mmngr_buf_user_public.h"
 
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_profile.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+
 /******************************************************************************
  *  macros
  ******************************************************************************/
@@ -36,9 +44,9 @@
 #define MEDIA_DEV_NAME		"/dev/media2"     /* fe9a0000.vsp */
 #endif
 
-#define SRC_INPUT_DEV		"%s rpf.0 input"
-#define DST_OUTPUT_DEV		"%s wpf.0 output"
-#define CLU_DEV			"%s clu"
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+#define CLU_DEV			"clu"
 
 /* source parameter */
 #define SRC_FILENAME		"1280_720_ARGB32.argb"
@@ -59,19 +67,23 @@
 #define G_MAX			(17)
 #define B_MAX			(17)
 #define CLU_MAX_ELEMENT		(R_MAX*G_MAX*B_MAX)
+#define CLU_REG_DATA		(0x00007404)
+#define CUBE_3D_MAX		(256)		/* max LUT_3D_SIZE */
+#define CLU_THREAD_MAX		(B_MAX)
+#define CLU_BLOB_MAGIC		"VSPCLU17"
+#define CLU_BLOB_VERSION	(2)		/* resampler, part of the key */
+#define CLU_BLOB_NAME		"clu_%016llx.bin"
+#define CLU_LOOK_MAX		(4)
+
+/* stream parameter */
+#define STREAM_BUF_NUM		(3)
+#define STREAM_BANDS		(8)		/* checksum bands per frame */
+#define STREAM_SWAP_PERIOD	(10)		/* frames between swaps */
 
 /* ioctl */
 #define VIDIOC_VSP2_CLU_CONFIG \
 	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
 
-/******************************************************************************
- *  structure
- ******************************************************************************/
-struct dev_pads {
-	struct media_pad	*ppad0;
-	struct media_pad	*ppad1;
-};
-
 struct vsp2_clu_config {
 	unsigned char	mode;
 	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
@@ -79,20 +91,96 @@ struct vsp2_clu_config {
 	unsigned short	tbl_num;	/* 1 to 9826 */
 };
 
+struct cube_3d {
+	int	size;		/* LUT_3D_SIZE */
+	float	(*pdata)[3];	/* size^3 entries, red changes fastest */
+	float	dmin[3];	/* DOMAIN_MIN / MAX : input range of the grid */
+	float	dmax[3];
+};
+
+struct clu_resample_arg {
+	const struct cube_3d	*pcube;
+	unsigned int		*ptbl;
+	int			b_start;
+	int			b_end;
+};
+
+struct clu_blob_header {
+	char			magic[8];
+	unsigned long long	key;	/* hash of the version and .cube file */
+	unsigned int		tbl_num;
+	unsigned int		version;	/* CLU_BLOB_VERSION */
+};
+
+struct min_max {
+	long long	sum;
+	long long	max;
+	long long	num;
+};
+
+struct swap_stat {
+	int		cur;		/* table in effect */
+	int		pend;		/* committed table, -1 : none */
+	long long	commit_us;
+	int		wait_frames;	/* frames output since the commit */
+	unsigned int	last_seq;
+
+	/* band checksums of each look, rendered on the cpu */
+	unsigned long long	ref[CLU_LOOK_MAX][STREAM_BANDS];
+
+	int		swaps;
+	int		applied;
+	int		dropped;
+	int		torn;
+	struct min_max	ioctl_us;
+	struct min_max	apply_us;
+	struct min_max	apply_frames;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+/* addr / data pairs, set_clu() uploads the first one */
+static unsigned int	clu_table[CLU_LOOK_MAX][CLU_MAX_ELEMENT*2];
+static int		clu_look_num;
+
+static const unsigned char clu_grid[17] = {0, 16, 32, 48, 64, 80, 96, 112,
+					    128, 144, 160, 176, 192, 208,
+					    224, 240, 255};
+
 /******************************************************************************
  *  internal function
  ******************************************************************************/
 static int	test_clu_mmap(void);
 static int	test_clu_userptr(void);
 static int	test_clu_dmabuf(void);
+static int	test_clu_stream(int frame_num, int swap_period);
 static int	read_file(unsigned char*, unsigned int, const char*);
 static int	write_file(unsigned char*, unsigned int, const char*);
-static int	call_media_ctl(struct media_device **, const char **);
-static int	set_clu(struct media_device *pmedia, unsigned long virt_addr,
-			char *pentity_base, const char *pmedia_name);
-static int	open_video_device(struct media_device *pmedia,
-				  char *pentity_base, const char *pmedia_name);
-
+static int	call_media_ctl(struct vsp2_media **);
+static int	set_clu(struct vsp2_media *pmedia, unsigned long virt_addr,
+			const char *pentity);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
+static void	make_clu_default(unsigned int *ptbl);
+static void	make_clu_identity(unsigned int *ptbl);
+static int	make_clu_from_cube(const char *pfilename, unsigned int *ptbl);
+static int	read_cube_3d(FILE *fp, struct cube_3d *pcube);
+static void	*resample_cube_thread(void *parg);
+static int	commit_clu(int clu_fd, void *pclu_table);
+static int	queue_stream_buf(int src_fd, int dst_fd,
+				 int src_idx, int dst_idx);
+static int	profile_mem_type(void);
+static long long	get_time_us(void);
+static void	stat_add(struct min_max *pmm, long long val);
+static void	calc_bands(const unsigned char *pframe,
+			   unsigned long long *pband);
+static int	calc_swap_ref(const unsigned char *psrc,
+			      const unsigned int *ptbl,
+			      unsigned long long *pband);
+static void	check_swap_frame(struct swap_stat *pstat,
+				 unsigned char *pframe);
+static int	print_swap_stat(struct swap_stat *pstat, int frame_num);
 
 /******************************************************************************
  *  main
@@ -108,38 +196,103 @@ void print_usage(const char *pname)
 	printf("----------------------------------\n");
 	printf(" Usage : %s [option]\n", pname);
 	printf("    option\n");
-	printf("        -m: use MMAP [default]\n");
+	printf("        -m: use MMAP [default, unless tuned]\n");
 	printf("        -u: use USERPTR\n");
 	printf("        -d: use DMABUF\n");
+	printf("        -c: 3D .cube file resampled into the table\n");
+	printf("            (repeatable up to %d, 1st is used)\n",
+		CLU_LOOK_MAX);
+	printf("        -n: stream <n> frames (MMAP) and swap tables live\n");
+	printf("        -s: frames between table swaps [%d]\n",
+		STREAM_SWAP_PERIOD);
 	printf("        -h: print usage\n");
 	printf("----------------------------------\n");
 }
 
 int main(int argc, char *argv[])
 {
-	int opt;
+	int		opt;
+	int		mem_type = 0;
+	int		frame_num = 0;
+	int		swap_period = STREAM_SWAP_PERIOD;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "mudc:n:s:h")) != -1) {
+		switch (opt) {
+		case 'm':
+		case 'u':
+		case 'd':
+			mem_type = opt;
+			break;
+		case 'c':
+			if (clu_look_num >= CLU_LOOK_MAX) {
+				printf("Error : too many tables\n");
+				exit(1);
+			}
+			vsp2_trace_begin("clu from cube");
+			if (make_clu_from_cube(optarg,
+					       clu_table[clu_look_num]) < 0) {
+				printf("Error : cannot make table from %s\n",
+					optarg);
+				exit(1);
+			}
+			vsp2_trace_end();
+			clu_look_num++;
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 's':
+			swap_period = atoi(optarg);
+			if (swap_period < 1)
+				swap_period = 1;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
 
-	opt = getopt(argc, argv, "mudh");
+	if (frame_num > 0) {
+		printf("exec STREAM (%d frames)\n", frame_num);
+		vsp2_mem_pipeline("clu stream");
+		if (test_clu_stream(frame_num, swap_period) < 0)
+			exit(1);
+		exit(0);
+	}
 
-	switch (opt) {
+	if (clu_look_num == 0) {
+		vsp2_trace_begin("clu table");
+		make_clu_default(clu_table[clu_look_num++]);
+		vsp2_trace_end();
+	}
+
+	/* none given : the one tune found fastest on this VSP, if any */
+	if (mem_type == 0)
+		mem_type = profile_mem_type();
+
+	switch (mem_type) {
 	case 'm':
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("clu mmap");
 		test_clu_mmap();
 		break;
 	case 'u':
 		printf("exec USERPTR\n");
+		vsp2_mem_pipeline("clu userptr");
 		test_clu_userptr();
 		break;
 	case 'd':
 		printf("exec DMABUF\n");
+		vsp2_mem_pipeline("clu dmabuf");
 		test_clu_dmabuf();
 		break;
-	case 'h':
-		print_usage(argv[0]);
-		break;
 	default:
 		print_usage(argv[0]);
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("clu mmap");
 		test_clu_mmap();
 		break;
 	}
@@ -152,7 +305,7 @@ int main(int argc, char *argv[])
  ******************************************************************************/
 static int test_clu_mmap(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -178,12 +331,11 @@ static int test_clu_mmap(void)
 	unsigned long	mmngr_clu_hard;
 	unsigned long	mmngr_clu_virt;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/*  Allocate memory by mmngr for cubic lookup table                  */
 	/*-------------------------------------------------------------------*/
-	ercd = mmngr_alloc_in_user(&mmngr_clu_fd, (CLU_MAX_ELEMENT*8),
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_clu_fd,
+		(CLU_MAX_ELEMENT*8),
 		&mmngr_clu_phys, &mmngr_clu_hard, &mmngr_clu_virt,
 		MMNGR_VA_SUPPORT);
 	if (ercd != 0) {
@@ -194,7 +346,9 @@ static int test_clu_mmap(void)
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -204,7 +358,7 @@ static int test_clu_mmap(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -212,7 +366,7 @@ static int test_clu_mmap(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -256,7 +410,7 @@ static int test_clu_mmap(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make cubic lookup table - VIDIOC_VSP2_CLU_CONFIG                 */
 	/*-------------------------------------------------------------------*/
-	ret = set_clu(pmedia, mmngr_clu_virt, CLU_DEV, pmedia_name);
+	ret = set_clu(pmedia, mmngr_clu_virt, CLU_DEV);
 	if (ret != 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -618,7 +772,7 @@ static int test_clu_mmap(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -628,7 +782,7 @@ static int test_clu_mmap(void)
  ******************************************************************************/
 static int test_clu_userptr(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -664,12 +818,11 @@ static int test_clu_userptr(void)
 	unsigned long	dst_hard;
 	unsigned long	dst_virt;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/*  Allocate memory for cubic lookup table by mmngr                  */
 	/*-------------------------------------------------------------------*/
-	ercd = mmngr_alloc_in_user(&mmngr_clu_fd, (CLU_MAX_ELEMENT*8),
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_clu_fd,
+		(CLU_MAX_ELEMENT*8),
 		&mmngr_clu_phys, &mmngr_clu_hard, &mmngr_clu_virt,
 		MMNGR_VA_SUPPORT);
 	if (ercd != 0) {
@@ -680,7 +833,9 @@ static int test_clu_userptr(void)
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -690,7 +845,7 @@ static int test_clu_userptr(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -698,7 +853,7 @@ static int test_clu_userptr(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -742,7 +897,7 @@ static int test_clu_userptr(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make cubic lookup table - VIDIOC_VSP2_CLU_CONFIG                 */
 	/*-------------------------------------------------------------------*/
-	ret = set_clu(pmedia, mmngr_clu_virt, CLU_DEV, pmedia_name);
+	ret = set_clu(pmedia, mmngr_clu_virt, CLU_DEV);
 	if (ret != 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -1084,7 +1239,7 @@ static int test_clu_userptr(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -1094,7 +1249,7 @@ static int test_clu_userptr(void)
  ******************************************************************************/
 static int test_clu_dmabuf(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -1134,13 +1289,12 @@ static int test_clu_dmabuf(void)
 	int		dst_mbid;
 	int		dst_dmafd;
 
-	const char *pmedia_name;
-
 
 	/*-------------------------------------------------------------------*/
 	/*  Allocate memory for cubic lookup table by mmngr                  */
 	/*-------------------------------------------------------------------*/
-	ercd = mmngr_alloc_in_user(&mmngr_clu_fd, (CLU_MAX_ELEMENT*8),
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_clu_fd,
+		(CLU_MAX_ELEMENT*8),
 		&mmngr_clu_phys, &mmngr_clu_hard, &mmngr_clu_virt,
 		MMNGR_VA_SUPPORT);
 	if (ercd != 0) {
@@ -1151,7 +1305,9 @@ static int test_clu_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -1161,7 +1317,7 @@ static int test_clu_dmabuf(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1169,7 +1325,7 @@ static int test_clu_dmabuf(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1213,7 +1369,7 @@ static int test_clu_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make cubic lookup table - VIDIOC_VSP2_CLU_CONFIG                 */
 	/*-------------------------------------------------------------------*/
-	ret = set_clu(pmedia, mmngr_clu_virt, CLU_DEV, pmedia_name);
+	ret = set_clu(pmedia, mmngr_clu_virt, CLU_DEV);
 	if (ret != 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -1301,11 +1457,21 @@ static int test_clu_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Read file                                                        */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = read_file(psrc_buf, SRC_SIZE, SRC_FILENAME);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -1471,11 +1637,21 @@ static int test_clu_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Write file                                                       */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = write_file(pdst_buf, DST_SIZE, DST_FILENAME_DMABUF);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*********************************************************************
 	 *  src
@@ -1594,11 +1770,397 @@ static int test_clu_dmabuf(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
 
+/******************************************************************************
+ *  stream (live table swap)
+ ******************************************************************************/
+static int test_clu_stream(int frame_num, int swap_period)
+{
+	struct vsp2_media  *pmedia;
+
+	unsigned char  *psrc_buf[STREAM_BUF_NUM];
+	unsigned char  *pdst_buf[STREAM_BUF_NUM];
+
+	int src_fd = -1;	/* src file descriptor */
+	int dst_fd = -1;	/* dst file descriptor */
+	int clu_fd = -1;	/* clu subdev file descriptor */
+
+	unsigned int  type;
+	int           ret = -1;
+	int           ercd = 0;
+
+	struct v4l2_format          fmt;
+	struct v4l2_requestbuffers  req_buf;
+	struct v4l2_buffer          buf;
+	struct v4l2_plane           planes[VIDEO_MAX_PLANES];
+
+	MMNGR_ID	mmngr_clu_fd[2];
+	unsigned long	mmngr_clu_phys[2];
+	unsigned long	mmngr_clu_hard[2];
+	unsigned long	mmngr_clu_virt[2];
+	int		tbl_side = 0;	/* table buffer in use by hardware */
+
+	struct swap_stat	stat;
+	long long		t_start;
+	int			buf_num;
+	int			frame;
+	int			i;
+
+	/* need two different tables to swap between */
+	if (clu_look_num < 2) {
+		vsp2_trace_begin("clu table");
+		if (clu_look_num == 0)
+			make_clu_default(clu_table[clu_look_num++]);
+		make_clu_identity(clu_table[clu_look_num++]);
+		vsp2_trace_end();
+	}
+
+	buf_num = (frame_num < STREAM_BUF_NUM) ? frame_num : STREAM_BUF_NUM;
+
+	memset(&stat, 0, sizeof(stat));
+	stat.pend = -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Allocate memory by mmngr for double buffered cubic lookup table        */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < 2; i++) {
+		ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_clu_fd[i],
+			CLU_MAX_ELEMENT*8,
+			&mmngr_clu_phys[i], &mmngr_clu_hard[i],
+			&mmngr_clu_virt[i], MMNGR_VA_SUPPORT);
+		if (ercd != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
+	if (src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
+	if (dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/* clu subdev stays open for the commits while streaming */
+	clu_fd = open_video_device(pmedia, CLU_DEV);
+	if (clu_fd == -1) {
+		printf("Error open clu device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Initial cubic lookup table - VIDIOC_VSP2_CLU_CONFIG                 */
+	/*-------------------------------------------------------------------*/
+	memcpy((void *)mmngr_clu_virt[tbl_side], clu_table[0],
+	       sizeof(clu_table[0]));
+	ret = commit_clu(clu_fd, (void *)mmngr_clu_virt[tbl_side]);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(src_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= DST_WIDTH;
+	fmt.fmt.pix_mp.height		= DST_HEIGHT;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.num_planes	= 1;		/* argb32 */
+
+	ret = ioctl(dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	req_buf.count	= buf_num;
+
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                           */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		ret = ioctl(src_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		psrc_buf[i] = mmap(0, SRC_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, src_fd, planes[0].m.mem_offset);
+		if (psrc_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(dst_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pdst_buf[i] = mmap(0, DST_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, dst_fd, planes[0].m.mem_offset);
+		if (pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file (same input for every frame)                           */
+	/*-------------------------------------------------------------------*/
+	ret = read_file(psrc_buf[0], SRC_SIZE, SRC_FILENAME);
+	if (ret == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	for (i = 1; i < buf_num; i++)
+		memcpy(psrc_buf[i], psrc_buf[0], SRC_SIZE);
+
+	/* what each table must give, to tell an applied swap from a late one */
+	for (i = 0; i < clu_look_num; i++) {
+		if (calc_swap_ref(psrc_buf[0], clu_table[i], stat.ref[i]) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QBUF / VIDIOC_STREAMON                                    */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		if (queue_stream_buf(src_fd, dst_fd, i, i) < 0)
+			return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Streaming loop                                                   */
+	/*-------------------------------------------------------------------*/
+	for (frame = 0; frame < frame_num; frame++) {
+		int src_idx, dst_idx;
+
+		/* dst */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		ret = ioctl(dst_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		dst_idx = buf.index;
+
+		if (frame > 0 && buf.sequence != stat.last_seq + 1)
+			stat.dropped += buf.sequence - stat.last_seq - 1;
+		stat.last_seq = buf.sequence;
+
+		vsp2_trace_begin("check frame");
+		check_swap_frame(&stat, pdst_buf[dst_idx]);
+		vsp2_trace_end();
+
+		/* src */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= 1;
+
+		ret = ioctl(src_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		src_idx = buf.index;
+
+		/* commit the next table while the hardware keeps running,
+		 * only while the frame queued below is there to latch it */
+		if ((frame + 1) % swap_period == 0 && stat.pend < 0 &&
+		    frame + buf_num < frame_num) {
+			int next = (stat.cur + 1) % clu_look_num;
+
+			tbl_side ^= 1;
+			memcpy((void *)mmngr_clu_virt[tbl_side],
+			       clu_table[next], sizeof(clu_table[next]));
+
+			t_start = get_time_us();
+			ret = commit_clu(clu_fd, (void *)mmngr_clu_virt[tbl_side]);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n",
+					__LINE__, errno);
+				return -1;
+			}
+			stat.commit_us = get_time_us();
+			stat_add(&stat.ioctl_us, stat.commit_us - t_start);
+			stat.pend = next;
+			stat.wait_frames = 0;
+			stat.swaps++;
+		}
+
+		if (frame + buf_num < frame_num) {
+			if (queue_stream_buf(src_fd, dst_fd, src_idx,
+					     dst_idx) < 0)
+				return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		munmap(psrc_buf[i], SRC_SIZE);
+		munmap(pdst_buf[i], DST_SIZE);
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for cubic lookup table                            */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < 2; i++) {
+		ret = mmngr_free_in_user(mmngr_clu_fd[i]);
+		if (ret < 0) {
+			printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+			return -1;
+		}
+	}
+
+	ret = print_swap_stat(&stat, frame_num);
+
+	close(clu_fd);
+	close(src_fd);
+	close(dst_fd);
+
+	vsp2_media_close(pmedia);
+
+	return ret;
+}
+
 /******************************************************************************
  *  internal function
  ******************************************************************************/
@@ -1611,6 +2173,8 @@ static int read_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("read file");
+
 	fp = fopen(pfilename, "rb");
 	if (fp == NULL) {
 		printf("file open error...\n");
@@ -1621,6 +2185,7 @@ static int read_file(
 			printf("buffer read error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
@@ -1633,6 +2198,8 @@ static int write_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("write file");
+
 	/* file output */
 	fp = fopen(pfilename, "wb");
 	if (!fp) {
@@ -1644,144 +2211,49 @@ static int write_file(
 			printf("buffer write error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
-static int call_media_ctl(struct media_device **ppmedia,
-			  const char **ppmedia_name)
+static int call_media_ctl(struct vsp2_media **ppmedia)
 {
-	struct media_device		*pmedia;
-	struct media_link		*plink;
-	char				*endp;
-	struct dev_pads			rpfpad;
-	struct dev_pads			clupad;
-	struct dev_pads			wpfpad;
+	struct vsp2_media		*pmedia;
 	struct v4l2_mbus_framefmt	format;
 
-	const struct media_device_info	*pinfo;
-	char		*p;
-	const char	*pname;
-	char		buf[128];
-
 	/* Initialize v4l2 media controller */
-	pmedia = media_device_new(MEDIA_DEV_NAME);
+	pmedia = vsp2_media_open(MEDIA_DEV_NAME);
 	if (!pmedia) {
-		printf("Error : media_device_new()\n");
+		printf("Error : vsp2_media_open()\n");
 		return -1;
 	}
 
 	*ppmedia = pmedia;
 
-	if (media_device_enumerate(pmedia) != 0) {
-		printf("Error : media_device_enumerate()\n");
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
 		return -1;
 	}
 
-	if (media_reset_links(pmedia) != 0) {
-		printf("Error : media_reset_links()\n");
-		return -1;
-	}
-
-	/* get media device name */
-	pinfo = media_get_info(pmedia);
-	p = strchr(pinfo->bus_info, ':');
-	if (p)
-		pname = p + 1;
-	else
-		pname = pinfo->bus_info;
-
-	*ppmedia_name = pname;
-
 	/*----------------------*/
 	/* rpf.0:1 -> clu:0     */
 	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1 -> '%s clu':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(rpf -> clu)\n");
-		return -1;
-	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(rpf -> clu)\n");
+	if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "clu", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf -> clu)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* clu:1 -> wpf.0:0     */
 	/*----------------------*/
-	sprintf(buf, "'%s clu':1 -> '%s wpf.0':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(clu -> wpf)\n");
-		return -1;
-	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(clu -> wpf)\n");
+	if (vsp2_media_setup_link(pmedia, "clu", 1, "wpf.0", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(clu -> wpf)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1 -> output    */
 	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1 -> '%s wpf.0 output':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(wpf -> output)\n");
-		return -1;
-	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(wpf -> output)\n");
-		return -1;
-	}
-
-	/*-------------------------------------------------- get pads */
-	/*----------------------*/
-	/* rpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':0", pname);
-	rpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 0)\n");
-		return -1;
-	}
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1", pname);
-	rpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 1)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* clu pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s clu':0", pname);
-	clupad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (clupad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 0)\n");
-		return -1;
-	}
-	/*----------------------*/
-	sprintf(buf, "'%s clu':1", pname);
-	clupad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (clupad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 1)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* wpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':0", pname);
-	wpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
-		return -1;
-	}
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1", pname);
-	wpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
 		return -1;
 	}
 
@@ -1792,144 +2264,636 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC_WIDTH;
 	format.height	= SRC_HEIGHT;
 	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(rpfpad.ppad0->entity, &format,
-		rpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(rpfpad.ppad1->entity, &format,
-		rpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 1)\n");
 		return -1;
 	}
 
 	/*----------------------*/
 	/* clu:0                */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(clupad.ppad0->entity, &format,
-		clupad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(clu pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "clu", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(clu pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* clu:1                */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(clupad.ppad1->entity, &format,
-		clupad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(clu pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "clu", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(clu pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:0              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad0->entity, &format,
-		wpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad1->entity, &format,
-		wpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
 		return -1;
 	}
 	return 0;
 }
 
-static int set_clu(struct media_device *pmedia, unsigned long virt_addr,
-		    char *pentity_base, const char *pmedia_name)
+static int set_clu(struct vsp2_media *pmedia, unsigned long virt_addr,
+		    const char *pentity)
 {
 	struct vsp2_clu_config	clu_par;
-	char			entity_name[32];
-	const char		*psubdevname;
-	struct media_entity	*pentity;
-	unsigned int		data;
-	unsigned int		*pclu_addr;
 	int			clu_fd = -1;
+	int			ret = -1;
+
+	/* Set config */
+	clu_fd = open_video_device(pmedia, pentity);
+
+	/* setting config & exec */
+	if (clu_fd != -1) {
+		/* Create config param */
+		memset(&clu_par, 0, sizeof(clu_par));
+
+		clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
+		clu_par.addr	= (void *)virt_addr;
+		clu_par.tbl_num	= CLU_MAX_ELEMENT;
 
+		/* Set clu table (prebuilt in main) */
+		memcpy((void *)virt_addr, clu_table[0], sizeof(clu_table[0]));
+
+		if (ioctl(clu_fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par) == 0)
+			ret = 0; /* success !! */
+		close(clu_fd);
+	}
+
+
+	return ret;
+}
+
+static void make_clu_default(unsigned int *ptbl)
+{
 	int		ir, ig, ib;
 	unsigned char	r, g, b;
-	int		ret = -1;
 
-	unsigned char tbl[17] = {0, 16, 32, 48, 64, 80, 96, 112, 128,
-				 144, 160, 176, 192, 208, 224, 240, 255};
+	/* inverted grid */
+	for (ib = 0; ib < B_MAX; ib++) {
+		b = clu_grid[16-ib];
 
-	pclu_addr = (unsigned int *)virt_addr;
+		for (ig = 0; ig < G_MAX; ig++) {
+			g = clu_grid[16-ig];
 
-	/* Set config */
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-		                           strlen(entity_name));
-	if (pentity == NULL) {
-		printf("Error media_get_entity_by_name(%s)\n", entity_name);
-		return -1;
+			for (ir = 0; ir < R_MAX; ir++) {
+				r = clu_grid[16-ir];
+
+				*ptbl++ = CLU_REG_DATA;
+				*ptbl++ = r << 16 | g << 8 | b;
+			}
+		}
+	}
+}
+
+static void make_clu_identity(unsigned int *ptbl)
+{
+	int	ir, ig, ib;
+
+	for (ib = 0; ib < B_MAX; ib++) {
+		for (ig = 0; ig < G_MAX; ig++) {
+			for (ir = 0; ir < R_MAX; ir++) {
+				*ptbl++ = CLU_REG_DATA;
+				*ptbl++ = clu_grid[ir] << 16
+					| clu_grid[ig] << 8
+					| clu_grid[ib];
+			}
+		}
 	}
-	psubdevname = media_entity_get_devname(pentity);
+}
+
+static int make_clu_from_cube(const char *pfilename, unsigned int *ptbl)
+{
+	struct clu_blob_header	hdr;
+	struct clu_resample_arg	arg[CLU_THREAD_MAX];
+	pthread_t		thread[CLU_THREAD_MAX];
+	struct cube_3d		cube;
+	unsigned long long	key = 0xcbf29ce484222325ULL;
+	unsigned int		version = CLU_BLOB_VERSION;
+	unsigned char		fbuf[4096];
+	char			blob_name[64];
+	FILE			*fp;
+	size_t			len, i;
+	long			nthread;
+	int			n;
+	int			ret = -1;
 
-	if (psubdevname == NULL) {
-		printf("Error media_entity_get_devname(%s)\n", entity_name);
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("Error : cannot open %s\n", pfilename);
 		return -1;
 	}
-	clu_fd = open(psubdevname, O_RDWR);
 
-	/* setting config & exec */
-	if (clu_fd != -1) {
-		/* Create config param */
-		memset(&clu_par, 0, sizeof(clu_par));
+	/* content key (FNV-1a), hashing is far cheaper than parsing; the
+	 * resampler version goes first so a new one never takes an old blob */
+	for (i = 0; i < sizeof(version); i++) {
+		key ^= ((unsigned char *)&version)[i];
+		key *= 0x100000001b3ULL;
+	}
+	while ((len = fread(fbuf, 1, sizeof(fbuf), fp)) > 0) {
+		for (i = 0; i < len; i++) {
+			key ^= fbuf[i];
+			key *= 0x100000001b3ULL;
+		}
+	}
 
-		clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
-		clu_par.addr	= (void *)virt_addr;
-		clu_par.tbl_num	= CLU_MAX_ELEMENT;
+	/* cached blob ? */
+	snprintf(blob_name, sizeof(blob_name), CLU_BLOB_NAME, key);
+	fp = freopen(blob_name, "rb", fp);
+	if (fp != NULL) {
+		if (fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+		    memcmp(hdr.magic, CLU_BLOB_MAGIC, sizeof(hdr.magic)) == 0 &&
+		    hdr.key == key && hdr.tbl_num == CLU_MAX_ELEMENT &&
+		    hdr.version == CLU_BLOB_VERSION &&
+		    fread(ptbl, sizeof(clu_table[0]), 1, fp) == 1) {
+			printf("clu table loaded from %s\n", blob_name);
+			fclose(fp);
+			return 0;
+		}
+		fclose(fp);
+	}
 
-		/* Set clu table */
-		for (ib = 0; ib < B_MAX; ib++) {
-			b = tbl[16-ib];
+	/* parse and resample */
+	fp = fopen(pfilename, "r");
+	if (fp == NULL) {
+		printf("Error : cannot open %s\n", pfilename);
+		return -1;
+	}
+	ret = read_cube_3d(fp, &cube);
+	fclose(fp);
+	if (ret < 0)
+		return -1;
+
+	nthread = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthread < 1)
+		nthread = 1;
+	if (nthread > CLU_THREAD_MAX)
+		nthread = CLU_THREAD_MAX;
+
+	/* split blue slices between the threads */
+	for (n = 0; n < nthread; n++) {
+		arg[n].pcube	= &cube;
+		arg[n].ptbl	= ptbl;
+		arg[n].b_start	= B_MAX * n / nthread;
+		arg[n].b_end	= B_MAX * (n + 1) / nthread;
+		if (pthread_create(&thread[n], NULL, resample_cube_thread,
+				   &arg[n]) != 0) {
+			/* run the remaining slices on this thread */
+			arg[n].b_end = B_MAX;
+			resample_cube_thread(&arg[n]);
+			break;
+		}
+	}
+	while (n-- > 0)
+		pthread_join(thread[n], NULL);
 
-			for (ig = 0; ig < G_MAX; ig++) {
-				g = tbl[16-ig];
+	free(cube.pdata);
 
-				for (ir = 0; ir < R_MAX; ir++) {
-					r = tbl[16-ir];
+	/* save blob for the next run */
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CLU_BLOB_MAGIC, sizeof(hdr.magic));
+	hdr.key		= key;
+	hdr.tbl_num	= CLU_MAX_ELEMENT;
+	hdr.version	= CLU_BLOB_VERSION;
 
-					*pclu_addr = 0x00007404;
-					pclu_addr++;
+	fp = fopen(blob_name, "wb");
+	if (fp == NULL) {
+		printf("Warning : cannot create %s\n", blob_name);
+		return 0;
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    fwrite(ptbl, sizeof(clu_table[0]), 1, fp) != 1) {
+		printf("Warning : cannot write %s\n", blob_name);
+		fclose(fp);
+		remove(blob_name);
+		return 0;
+	}
+	fclose(fp);
 
-					data = r << 16 | g << 8 | b;
-					*pclu_addr = data;
-					pclu_addr++;
-				}
+	return 0;
+}
+
+static int read_cube_3d(FILE *fp, struct cube_3d *pcube)
+{
+	char	line[256];
+	char	*p, *endp;
+	float	v[3];
+	int	total = 0;
+	int	num = 0;
+	int	ch;
+
+	pcube->size  = 0;
+	pcube->pdata = NULL;
+	for (ch = 0; ch < 3; ch++) {
+		pcube->dmin[ch] = 0.0f;
+		pcube->dmax[ch] = 1.0f;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		p = line;
+		while (*p == ' ' || *p == '\t')
+			p++;
+
+		if ((*p >= '0' && *p <= '9') || *p == '-' || *p == '.') {
+			/* data line, strtof is much faster than sscanf */
+			for (ch = 0; ch < 3; ch++) {
+				v[ch] = strtof(p, &endp);
+				if (endp == p)
+					break;
+				p = endp;
+			}
+			if (ch != 3 || pcube->pdata == NULL || num >= total) {
+				printf("Error : unexpected data in cube\n");
+				goto err;
+			}
+			for (ch = 0; ch < 3; ch++)
+				pcube->pdata[num][ch] = v[ch];
+			num++;
+		} else if (sscanf(p, "LUT_3D_SIZE %d", &pcube->size) == 1) {
+			if (pcube->size < 2 || pcube->size > CUBE_3D_MAX ||
+			    pcube->pdata != NULL) {
+				printf("Error : bad LUT_3D_SIZE\n");
+				goto err;
+			}
+			total = pcube->size * pcube->size * pcube->size;
+			pcube->pdata = malloc(sizeof(*pcube->pdata) * total);
+			if (pcube->pdata == NULL) {
+				printf("Error : malloc()\n");
+				goto err;
+			}
+		} else if (strncmp(p, "LUT_1D_SIZE", 11) == 0) {
+			printf("Error : 1D LUT, use the lut tool\n");
+			goto err;
+		} else if (strncmp(p, "DOMAIN_MIN", 10) == 0) {
+			if (sscanf(p, "DOMAIN_MIN %f %f %f", &pcube->dmin[0],
+				   &pcube->dmin[1], &pcube->dmin[2]) != 3) {
+				printf("Error : bad DOMAIN_MIN\n");
+				goto err;
+			}
+		} else if (strncmp(p, "DOMAIN_MAX", 10) == 0) {
+			if (sscanf(p, "DOMAIN_MAX %f %f %f", &pcube->dmax[0],
+				   &pcube->dmax[1], &pcube->dmax[2]) != 3) {
+				printf("Error : bad DOMAIN_MAX\n");
+				goto err;
 			}
 		}
+		/* TITLE and comments are skipped */
+	}
 
-		if (ioctl(clu_fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par) == 0)
-			ret = 0; /* success !! */
-		close(clu_fd);
+	if (pcube->pdata == NULL || num != total) {
+		printf("Error : cube has %d of %d entries\n", num, total);
+		goto err;
 	}
+	for (ch = 0; ch < 3; ch++) {
+		if (!(pcube->dmax[ch] > pcube->dmin[ch])) {
+			printf("Error : DOMAIN_MAX is not above DOMAIN_MIN\n");
+			goto err;
+		}
+	}
+	return 0;
 
+err:
+	free(pcube->pdata);
+	pcube->pdata = NULL;
+	return -1;
+}
 
-	return ret;
+static void *resample_cube_thread(void *parg)
+{
+	struct clu_resample_arg	*parg_s = parg;
+	const struct cube_3d	*pcube = parg_s->pcube;
+	unsigned int		*ptbl;
+	const float		*c000, *c100, *c010, *c001;
+	const float		*c110, *c101, *c011, *c111;
+	float			pos[3], f[3];
+	float			out[3];
+	int			idx[3];
+	int			n = pcube->size;
+	int			ir, ig, ib, ch;
+	unsigned int		val[3];
+
+#define CUBE_AT(r, g, b)	(pcube->pdata[(r) + ((g) + (b) * n) * n])
+
+	for (ib = parg_s->b_start; ib < parg_s->b_end; ib++) {
+		ptbl = parg_s->ptbl + ib * G_MAX * R_MAX * 2;
+
+		for (ig = 0; ig < G_MAX; ig++) {
+			for (ir = 0; ir < R_MAX; ir++) {
+				/* grid point placed in the domain, points
+				 * outside it take the edge of the cube */
+				pos[0] = clu_grid[ir] / 255.0f;
+				pos[1] = clu_grid[ig] / 255.0f;
+				pos[2] = clu_grid[ib] / 255.0f;
+
+				for (ch = 0; ch < 3; ch++) {
+					pos[ch] = (pos[ch] - pcube->dmin[ch]) /
+						  (pcube->dmax[ch] -
+						   pcube->dmin[ch]) * (n - 1);
+					if (pos[ch] < 0.0f)
+						pos[ch] = 0.0f;
+					if (pos[ch] > n - 1)
+						pos[ch] = n - 1;
+					idx[ch] = (int)pos[ch];
+					if (idx[ch] > n - 2)
+						idx[ch] = n - 2;
+					f[ch] = pos[ch] - idx[ch];
+				}
+
+				c000 = CUBE_AT(idx[0],   idx[1],   idx[2]);
+				c100 = CUBE_AT(idx[0]+1, idx[1],   idx[2]);
+				c010 = CUBE_AT(idx[0],   idx[1]+1, idx[2]);
+				c001 = CUBE_AT(idx[0],   idx[1],   idx[2]+1);
+				c110 = CUBE_AT(idx[0]+1, idx[1]+1, idx[2]);
+				c101 = CUBE_AT(idx[0]+1, idx[1],   idx[2]+1);
+				c011 = CUBE_AT(idx[0],   idx[1]+1, idx[2]+1);
+				c111 = CUBE_AT(idx[0]+1, idx[1]+1, idx[2]+1);
+
+				/* tetrahedral interpolation */
+				for (ch = 0; ch < 3; ch++) {
+					if (f[0] >= f[1] && f[1] >= f[2])
+						out[ch] = c000[ch]
+						+ f[0] * (c100[ch] - c000[ch])
+						+ f[1] * (c110[ch] - c100[ch])
+						+ f[2] * (c111[ch] - c110[ch]);
+					else if (f[0] >= f[2] && f[2] >= f[1])
+						out[ch] = c000[ch]
+						+ f[0] * (c100[ch] - c000[ch])
+						+ f[2] * (c101[ch] - c100[ch])
+						+ f[1] * (c111[ch] - c101[ch]);
+					else if (f[2] >= f[0] && f[0] >= f[1])
+						out[ch] = c000[ch]
+						+ f[2] * (c001[ch] - c000[ch])
+						+ f[0] * (c101[ch] - c001[ch])
+						+ f[1] * (c111[ch] - c101[ch]);
+					else if (f[1] >= f[0] && f[0] >= f[2])
+						out[ch] = c000[ch]
+						+ f[1] * (c010[ch] - c000[ch])
+						+ f[0] * (c110[ch] - c010[ch])
+						+ f[2] * (c111[ch] - c110[ch]);
+					else if (f[1] >= f[2] && f[2] >= f[0])
+						out[ch] = c000[ch]
+						+ f[1] * (c010[ch] - c000[ch])
+						+ f[2] * (c011[ch] - c010[ch])
+						+ f[0] * (c111[ch] - c011[ch]);
+					else
+						out[ch] = c000[ch]
+						+ f[2] * (c001[ch] - c000[ch])
+						+ f[1] * (c011[ch] - c001[ch])
+						+ f[0] * (c111[ch] - c011[ch]);
+
+					if (out[ch] <= 0.0f)
+						val[ch] = 0;
+					else if (out[ch] >= 1.0f)
+						val[ch] = 255;
+					else
+						val[ch] = (unsigned int)
+							(out[ch] * 255.0f + 0.5f);
+				}
+
+				*ptbl++ = CLU_REG_DATA;
+				*ptbl++ = val[0] << 16 | val[1] << 8 | val[2];
+			}
+		}
+	}
+
+#undef CUBE_AT
+
+	return NULL;
+}
+
+static int commit_clu(int clu_fd, void *pclu_table)
+{
+	struct vsp2_clu_config	clu_par;
+
+	memset(&clu_par, 0, sizeof(clu_par));
+	clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
+	clu_par.addr	= pclu_table;
+	clu_par.tbl_num	= CLU_MAX_ELEMENT;
+
+	return ioctl(clu_fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par);
 }
 
-static int open_video_device(struct media_device *pmedia, char *pentity_base,
-			     const char *pmedia_name)
+static int queue_stream_buf(int src_fd, int dst_fd, int src_idx, int dst_idx)
 {
-	char entity_name[32];
-	const char *pdevname;
-	struct media_entity *pentity;
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= dst_idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= DST_SIZE;
 
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-					   strlen(entity_name));
-	if (!pentity) {
-		printf("Error media_get_entity(%s)\n", entity_name);
+	if (ioctl(dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	pdevname = media_entity_get_devname(pentity);
 
-	return open(pdevname, O_RDWR);
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= src_idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= SRC_SIZE;
+	buf.bytesused			= SRC_SIZE;
+
+	if (ioctl(src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int profile_mem_type(void)
+{
+	struct vsp2_profile	prof;
+
+	if (vsp2_profile_load(MEDIA_DEV_NAME, "clu", SRC_WIDTH, SRC_HEIGHT,
+			      &prof) < 0)
+		return 0;
+
+	printf("profile : %s, %.1f fps when tuned\n",
+	       vsp2_profile_memory_name(prof.memory), prof.fps);
+	switch (prof.memory) {
+	case V4L2_MEMORY_USERPTR:
+		return 'u';
+	case V4L2_MEMORY_DMABUF:
+		return 'd';
+	default:
+		return 'm';
+	}
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void stat_add(struct min_max *pmm, long long val)
+{
+	if (pmm->num == 0 || val > pmm->max)
+		pmm->max = val;
+	pmm->sum += val;
+	pmm->num++;
+}
+
+static void calc_bands(const unsigned char *pframe, unsigned long long *pband)
+{
+	const unsigned int	*p = (const unsigned int *)pframe;
+	int			words = DST_SIZE / 4 / STREAM_BANDS;
+	int			i, j;
+
+	/* checksum per horizontal band, a torn frame mixes two tables */
+	for (i = 0; i < STREAM_BANDS; i++) {
+		pband[i] = 0xcbf29ce484222325ULL;
+		for (j = 0; j < words; j++) {
+			pband[i] ^= *p++;
+			pband[i] *= 0x100000001b3ULL;
+		}
+	}
+}
+
+static int calc_swap_ref(const unsigned char *psrc, const unsigned int *ptbl,
+			 unsigned long long *pband)
+{
+	unsigned char	*pdst;
+	unsigned int	c[8];
+	int		idx[3], frac[3], e[4];
+	int		i, k, ch, shift, v, v0, v1;
+
+	pdst = malloc(DST_SIZE);
+	if (pdst == NULL)
+		return -1;
+
+	/* trilinear over the 17 point grid, 16 levels a step and 255 on
+	 * the last point; argb32 is a:r:g:b in byte order */
+	for (i = 0; i < DST_SIZE; i += 4) {
+		for (k = 0; k < 3; k++) {
+			v = psrc[i + 1 + k] == 255 ? 256 : psrc[i + 1 + k];
+			idx[k]	= v >> 4;
+			frac[k]	= v & 15;
+			if (idx[k] == R_MAX - 1) {
+				idx[k]--;
+				frac[k] = 16;
+			}
+		}
+		for (k = 0; k < 8; k++)
+			c[k] = ptbl[(((idx[2] + ((k >> 2) & 1)) * G_MAX +
+				      idx[1] + ((k >> 1) & 1)) * R_MAX +
+				     idx[0] + (k & 1)) * 2 + 1];
+
+		pdst[i] = psrc[i];
+		for (ch = 0; ch < 3; ch++) {
+			shift = 16 - ch * 8;
+			for (k = 0; k < 4; k++)
+				e[k] = ((c[k * 2] >> shift) & 0xff)
+				       * (16 - frac[0])
+				     + ((c[k * 2 + 1] >> shift) & 0xff)
+				       * frac[0];
+			v0 = e[0] * (16 - frac[1]) + e[1] * frac[1];
+			v1 = e[2] * (16 - frac[1]) + e[3] * frac[1];
+			v = (v0 * (16 - frac[2]) + v1 * frac[2] + 2048) >> 12;
+			pdst[i + 1 + ch] = v > 255 ? 255 : v;
+		}
+	}
+	calc_bands(pdst, pband);
+
+	free(pdst);
+	return 0;
+}
+
+static void check_swap_frame(struct swap_stat *pstat, unsigned char *pframe)
+{
+	unsigned long long	band[STREAM_BANDS];
+	int			nold = 0, nnew = 0;
+	int			i;
+
+	calc_bands(pframe, band);
+	for (i = 0; i < STREAM_BANDS; i++) {
+		if (band[i] == pstat->ref[pstat->cur][i])
+			nold++;
+		if (pstat->pend >= 0 && band[i] == pstat->ref[pstat->pend][i])
+			nnew++;
+	}
+
+	if (pstat->pend < 0) {
+		if (nold != STREAM_BANDS)
+			pstat->torn++;
+		return;
+	}
+
+	/* applied only once the output is the new look as rendered on the
+	 * cpu; a frame that is neither look is torn */
+	if (nnew != STREAM_BANDS) {
+		if (nold != STREAM_BANDS)
+			pstat->torn++;
+		pstat->wait_frames++;
+		return;
+	}
+
+	stat_add(&pstat->apply_us, get_time_us() - pstat->commit_us);
+	stat_add(&pstat->apply_frames, pstat->wait_frames);
+	pstat->cur  = pstat->pend;
+	pstat->pend = -1;
+	pstat->applied++;
+}
+
+static int print_swap_stat(struct swap_stat *pstat, int frame_num)
+{
+	bool	ok = pstat->dropped == 0 && pstat->torn == 0 &&
+		     pstat->applied == pstat->swaps;
+
+	printf("\n----- LIVE TABLE SWAP -----\n");
+	printf("frames        : %d\n", frame_num);
+	printf("swaps         : %d committed, %d applied\n",
+		pstat->swaps, pstat->applied);
+	printf("dropped frame : %d\n", pstat->dropped);
+	printf("torn frame    : %d\n", pstat->torn);
+	if (pstat->ioctl_us.num)
+		printf("commit ioctl  : avg %lld us, max %lld us\n",
+			pstat->ioctl_us.sum / pstat->ioctl_us.num,
+			pstat->ioctl_us.max);
+	if (pstat->apply_us.num)
+		printf("update latency: avg %lld us (%lld frames), "
+		       "max %lld us (%lld frames)\n",
+			pstat->apply_us.sum / pstat->apply_us.num,
+			pstat->apply_frames.sum / pstat->apply_frames.num,
+			pstat->apply_us.max, pstat->apply_frames.max);
+	printf("result        : %s\n", ok ? "OK" : "NG");
+	printf("---------------------------\n");
+	return ok ? 0 : -1;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
 }
@@ -0,0 +1,705 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  async pipeline
+ *  Every pipeline has two fds in the epoll set, its dst fd and a kick
+ *  eventfd written on submit, both EPOLLONESHOT. The pipeline is served by
+ *  one thread at a time - busy - and a thread that finds it busy only sets
+ *  again, so the one serving it goes round once more. That keeps fill()
+ *  and done() in order without holding the lock around them. The thread
+ *  that served rearms the fds; dst only while buffers are queued, as
+ *  polling an idle queue reports an error at once.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/videodev2.h>
+
+#include "vsp2_async.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define ASYNC_THREAD_MAX	(16)
+#define ASYNC_EVENT_MAX		(16)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_async_pipe {
+	struct vsp2_async		*pasync;
+	struct vsp2_async_pipe		*pnext;		/* in the executor */
+	char				name[16];
+	int				src_fd;
+	int				dst_fd;
+	int				kick_fd;
+	unsigned int			src_size;
+	unsigned int			dst_size;
+	int				buf_num;
+	unsigned char			*psrc_buf[VSP2_ASYNC_BUF_MAX];
+	unsigned char			*pdst_buf[VSP2_ASYNC_BUF_MAX];
+
+	/* under lock */
+	pthread_mutex_t			lock;
+	struct vsp2_async_frame		*phead;		/* pending */
+	struct vsp2_async_frame		*ptail;
+	bool				busy;
+	bool				again;
+	bool				failed;
+
+	/* the thread that set busy only */
+	struct vsp2_async_frame		*pslot[VSP2_ASYNC_BUF_MAX];
+	int				next;		/* set to queue */
+	int				inflight;
+	bool				streaming;
+};
+
+struct vsp2_async {
+	int				epfd;
+	int				quit_fd;
+	pthread_t			thread[ASYNC_THREAD_MAX];
+	int				thread_num;
+	struct vsp2_async_pipe		*ppipe;		/* owner only */
+
+	/* frames out, for vsp2_async_drain() */
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+	unsigned long long		out;
+
+	struct vsp2_async_stat		stat;		/* under lock */
+	_Atomic unsigned long long	wakeups;
+	_Atomic unsigned long long	busy;
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void	*async_main(void *parg);
+static bool	async_serve(struct vsp2_async_pipe *ppipe, int *pinflight);
+static int	async_queue(struct vsp2_async_pipe *ppipe,
+			    struct vsp2_async_frame *pframe);
+static int	async_dequeue(struct vsp2_async_pipe *ppipe, int *presult);
+static void	async_fail(struct vsp2_async_pipe *ppipe);
+static void	async_finish(struct vsp2_async_pipe *ppipe,
+			     struct vsp2_async_frame *pframe,
+			     const unsigned char *pdst, int result);
+static void	async_arm(struct vsp2_async_pipe *ppipe, int fd);
+
+/******************************************************************************
+ *  owner
+ ******************************************************************************/
+struct vsp2_async *vsp2_async_new(int threads)
+{
+	struct vsp2_async	*pasync;
+	struct epoll_event	ev;
+	int			ret;
+	int			i;
+
+	if (threads < 1 || threads > ASYNC_THREAD_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	pasync = calloc(1, sizeof(*pasync));
+	if (pasync == NULL)
+		return NULL;
+
+	pthread_mutex_init(&pasync->lock, NULL);
+	pthread_cond_init(&pasync->cond, NULL);
+
+	pasync->epfd	= epoll_create1(EPOLL_CLOEXEC);
+	pasync->quit_fd	= eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (pasync->epfd < 0 || pasync->quit_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	/* level triggered and never read : wakes every thread to leave */
+	memset(&ev, 0, sizeof(ev));
+	ev.events	= EPOLLIN;
+	ev.data.ptr	= NULL;
+	if (epoll_ctl(pasync->epfd, EPOLL_CTL_ADD, pasync->quit_fd,
+		      &ev) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	for (i = 0; i < threads; i++) {
+		ret = pthread_create(&pasync->thread[i], NULL, async_main,
+				     pasync);
+		if (ret != 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, ret);
+			break;
+		}
+		pthread_setname_np(pasync->thread[i], "vsp2 async");
+		pasync->thread_num++;
+	}
+	if (pasync->thread_num == 0)
+		goto err;
+	return pasync;
+
+err:
+	if (pasync->epfd >= 0)
+		close(pasync->epfd);
+	if (pasync->quit_fd >= 0)
+		close(pasync->quit_fd);
+	pthread_mutex_destroy(&pasync->lock);
+	pthread_cond_destroy(&pasync->cond);
+	free(pasync);
+	return NULL;
+}
+
+void vsp2_async_free(struct vsp2_async *pasync, struct vsp2_async_stat *pstat)
+{
+	unsigned long long	val = 1;
+	ssize_t			ret;
+	int			i;
+
+	if (pasync == NULL)
+		return;
+
+	vsp2_async_drain(pasync);
+
+	ret = write(pasync->quit_fd, &val, sizeof(val));
+	(void)ret;
+	for (i = 0; i < pasync->thread_num; i++)
+		pthread_join(pasync->thread[i], NULL);
+
+	while (pasync->ppipe != NULL)
+		vsp2_async_pipe_free(pasync->ppipe);
+
+	if (pstat != NULL) {
+		*pstat		= pasync->stat;
+		pstat->wakeups	= atomic_load(&pasync->wakeups);
+		pstat->busy	= atomic_load(&pasync->busy);
+	}
+
+	close(pasync->epfd);
+	close(pasync->quit_fd);
+	pthread_mutex_destroy(&pasync->lock);
+	pthread_cond_destroy(&pasync->cond);
+	free(pasync);
+}
+
+struct vsp2_async_pipe *vsp2_async_pipe_new(struct vsp2_async *pasync,
+					    const char *pname, int src_fd,
+					    int dst_fd, unsigned int src_size,
+					    unsigned int dst_size, int buf_num)
+{
+	struct vsp2_async_pipe		*ppipe;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	struct epoll_event		ev;
+	int				i;
+
+	if (buf_num < 1 || buf_num > VSP2_ASYNC_BUF_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	ppipe = calloc(1, sizeof(*ppipe));
+	if (ppipe == NULL)
+		return NULL;
+
+	snprintf(ppipe->name, sizeof(ppipe->name), "%s", pname);
+	ppipe->pasync	= pasync;
+	ppipe->src_fd	= src_fd;
+	ppipe->dst_fd	= dst_fd;
+	ppipe->src_size	= src_size;
+	ppipe->dst_size	= dst_size;
+	ppipe->buf_num	= buf_num;
+	pthread_mutex_init(&ppipe->lock, NULL);
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS / VIDIOC_QUERYBUF / Mmap                          */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+	if (ioctl(src_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+	    (int)req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+	    (int)req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	for (i = 0; i < buf_num; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		if (ioctl(src_fd, VIDIOC_QUERYBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto err;
+		}
+		ppipe->psrc_buf[i] = mmap(0, src_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED, src_fd,
+					  planes[0].m.mem_offset);
+		if (ppipe->psrc_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			ppipe->psrc_buf[i] = NULL;
+			goto err;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		if (ioctl(dst_fd, VIDIOC_QUERYBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto err;
+		}
+		ppipe->pdst_buf[i] = mmap(0, dst_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED, dst_fd,
+					  planes[0].m.mem_offset);
+		if (ppipe->pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			ppipe->pdst_buf[i] = NULL;
+			goto err;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Into the epoll set                                               */
+	/*-------------------------------------------------------------------*/
+	ppipe->kick_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (ppipe->kick_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events	= EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr	= ppipe;
+	if (epoll_ctl(pasync->epfd, EPOLL_CTL_ADD, ppipe->kick_fd, &ev) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		close(ppipe->kick_fd);
+		goto err;
+	}
+
+	/* dst is armed once a buffer is queued */
+	ev.events	= EPOLLONESHOT;
+	if (epoll_ctl(pasync->epfd, EPOLL_CTL_ADD, dst_fd, &ev) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		epoll_ctl(pasync->epfd, EPOLL_CTL_DEL, ppipe->kick_fd, NULL);
+		close(ppipe->kick_fd);
+		goto err;
+	}
+
+	ppipe->pnext	= pasync->ppipe;
+	pasync->ppipe	= ppipe;
+	return ppipe;
+
+err:
+	for (i = 0; i < buf_num; i++) {
+		if (ppipe->psrc_buf[i] != NULL)
+			munmap(ppipe->psrc_buf[i], src_size);
+		if (ppipe->pdst_buf[i] != NULL)
+			munmap(ppipe->pdst_buf[i], dst_size);
+	}
+	pthread_mutex_destroy(&ppipe->lock);
+	free(ppipe);
+	return NULL;
+}
+
+void vsp2_async_pipe_free(struct vsp2_async_pipe *ppipe)
+{
+	struct vsp2_async		*pasync;
+	struct vsp2_async_pipe		**pp;
+	struct v4l2_requestbuffers	req_buf;
+	unsigned int			type;
+	int				i;
+
+	if (ppipe == NULL)
+		return;
+	pasync = ppipe->pasync;
+
+	for (pp = &pasync->ppipe; *pp != NULL; pp = &(*pp)->pnext) {
+		if (*pp == ppipe) {
+			*pp = ppipe->pnext;
+			break;
+		}
+	}
+
+	epoll_ctl(pasync->epfd, EPOLL_CTL_DEL, ppipe->dst_fd, NULL);
+	epoll_ctl(pasync->epfd, EPOLL_CTL_DEL, ppipe->kick_fd, NULL);
+	close(ppipe->kick_fd);
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF / Unmap buffer / VIDIOC_REQBUFS (release)       */
+	/*-------------------------------------------------------------------*/
+	if (ppipe->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(ppipe->src_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(ppipe->dst_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+	}
+
+	for (i = 0; i < ppipe->buf_num; i++) {
+		munmap(ppipe->psrc_buf[i], ppipe->src_size);
+		munmap(ppipe->pdst_buf[i], ppipe->dst_size);
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+	if (ioctl(ppipe->src_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(ppipe->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+
+	pthread_mutex_destroy(&ppipe->lock);
+	free(ppipe);
+}
+
+/******************************************************************************
+ *  any thread
+ ******************************************************************************/
+int vsp2_async_process(struct vsp2_async_pipe *ppipe,
+		       struct vsp2_async_frame *pframe)
+{
+	struct vsp2_async	*pasync = ppipe->pasync;
+	unsigned long long	val = 1;
+	bool			kick = false;
+	ssize_t			ret;
+
+	pthread_mutex_lock(&pasync->lock);
+	pasync->out++;
+	if (pasync->out > pasync->stat.max_out)
+		pasync->stat.max_out = pasync->out;
+	pthread_mutex_unlock(&pasync->lock);
+
+	pthread_mutex_lock(&ppipe->lock);
+	if (ppipe->failed) {
+		pthread_mutex_unlock(&ppipe->lock);
+		async_finish(ppipe, NULL, NULL, -1);
+		errno = EIO;
+		return -1;
+	}
+
+	pframe->pnext = NULL;
+	if (ppipe->ptail != NULL)
+		ppipe->ptail->pnext = pframe;
+	else
+		ppipe->phead = pframe;
+	ppipe->ptail = pframe;
+
+	/* a thread serving the pipeline picks it up on its next round */
+	if (ppipe->busy)
+		ppipe->again = true;
+	else
+		kick = true;
+	pthread_mutex_unlock(&ppipe->lock);
+
+	if (kick) {
+		ret = write(ppipe->kick_fd, &val, sizeof(val));
+		(void)ret;
+	}
+	return 0;
+}
+
+void vsp2_async_drain(struct vsp2_async *pasync)
+{
+	pthread_mutex_lock(&pasync->lock);
+	while (pasync->out != 0)
+		pthread_cond_wait(&pasync->cond, &pasync->lock);
+	pthread_mutex_unlock(&pasync->lock);
+}
+
+/******************************************************************************
+ *  executor thread
+ ******************************************************************************/
+static void *async_main(void *parg)
+{
+	struct vsp2_async	*pasync = parg;
+	struct vsp2_async_pipe	*ppipe;
+	struct epoll_event	ev[ASYNC_EVENT_MAX];
+	unsigned long long	val;
+	ssize_t			rd;
+	int			inflight;
+	int			num;
+	int			i;
+
+	for (;;) {
+		num = epoll_wait(pasync->epfd, ev, ASYNC_EVENT_MAX, -1);
+		if (num < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return NULL;
+		}
+
+		for (i = 0; i < num; i++) {
+			ppipe = ev[i].data.ptr;
+			if (ppipe == NULL)
+				return NULL;		/* quit */
+
+			atomic_fetch_add_explicit(&pasync->wakeups, 1,
+						  memory_order_relaxed);
+
+			/* the kick and dst fds share the pipeline pointer;
+			 * a kick is consumed, dst is drained by DQBUF */
+			rd = read(ppipe->kick_fd, &val, sizeof(val));
+			(void)rd;
+
+			if (!async_serve(ppipe, &inflight))
+				continue;
+
+			async_arm(ppipe, ppipe->kick_fd);
+			if (inflight > 0)
+				async_arm(ppipe, ppipe->dst_fd);
+		}
+	}
+}
+
+static bool async_serve(struct vsp2_async_pipe *ppipe, int *pinflight)
+{
+	struct vsp2_async_frame	*pframe;
+	int			idx;
+	int			result;
+	int			ret;
+
+	pthread_mutex_lock(&ppipe->lock);
+	if (ppipe->busy) {
+		ppipe->again = true;
+		pthread_mutex_unlock(&ppipe->lock);
+		atomic_fetch_add_explicit(&ppipe->pasync->busy, 1,
+					  memory_order_relaxed);
+		return false;
+	}
+	ppipe->busy = true;
+
+	for (;;) {
+		ppipe->again = false;
+		pthread_mutex_unlock(&ppipe->lock);
+
+		/* done buffers first, they free the sets for what waits */
+		while (ppipe->inflight > 0) {
+			ret = async_dequeue(ppipe, &result);
+			if (ret == -EAGAIN)
+				break;
+			if (ret < 0) {
+				async_fail(ppipe);
+				break;
+			}
+			idx = ret;
+			pframe = ppipe->pslot[idx];
+			ppipe->pslot[idx] = NULL;
+			ppipe->inflight--;
+			async_finish(ppipe, pframe, ppipe->pdst_buf[idx],
+				     result);
+		}
+
+		pthread_mutex_lock(&ppipe->lock);
+		if (ppipe->failed || ppipe->inflight >= ppipe->buf_num ||
+		    ppipe->phead == NULL) {
+			if (!ppipe->again)
+				break;
+			continue;
+		}
+
+		pframe = ppipe->phead;
+		ppipe->phead = pframe->pnext;
+		if (ppipe->phead == NULL)
+			ppipe->ptail = NULL;
+		pthread_mutex_unlock(&ppipe->lock);
+
+		if (async_queue(ppipe, pframe) < 0) {
+			async_finish(ppipe, pframe, NULL, -1);
+			async_fail(ppipe);
+		}
+		pthread_mutex_lock(&ppipe->lock);
+		ppipe->again = true;	/* more may wait, or be done */
+	}
+
+	*pinflight = ppipe->inflight;
+	ppipe->busy = false;
+	pthread_mutex_unlock(&ppipe->lock);
+	return true;
+}
+
+static int async_queue(struct vsp2_async_pipe *ppipe,
+		       struct vsp2_async_frame *pframe)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	unsigned int		type;
+	int			idx = ppipe->next;
+
+	/* the sets come back in the order they went in */
+	pframe->fill(pframe, ppipe->psrc_buf[idx], ppipe->src_size);
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= ppipe->dst_size;
+
+	if (ioctl(ppipe->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.m.planes[0].bytesused	= ppipe->src_size;
+	buf.bytesused			= ppipe->src_size;
+
+	if (ioctl(ppipe->src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	ppipe->pslot[idx] = pframe;
+	ppipe->next = (idx + 1) % ppipe->buf_num;
+	ppipe->inflight++;
+
+	if (ppipe->streaming)
+		return 0;
+
+	/* the queues start on their first buffers */
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (ioctl(ppipe->src_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(ppipe->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	ppipe->streaming = true;
+	return 0;
+}
+
+static int async_dequeue(struct vsp2_async_pipe *ppipe, int *presult)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	int			idx;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	/* dst is O_NONBLOCK */
+	if (ioctl(ppipe->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+		if (errno == EAGAIN)
+			return -EAGAIN;
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	*presult = (buf.flags & V4L2_BUF_FLAG_ERROR) ? -1 : 0;
+	idx = buf.index;
+
+	/* the source of a done frame is done as well */
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.length	= VIDEO_MAX_PLANES;
+	if (ioctl(ppipe->src_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if ((int)buf.index != idx || idx >= ppipe->buf_num) {
+		printf("error line=%d set %d / %d\n", __LINE__, idx,
+		       buf.index);
+		return -1;
+	}
+	return idx;
+}
+
+static void async_fail(struct vsp2_async_pipe *ppipe)
+{
+	struct vsp2_async_frame	*pframe;
+	struct vsp2_async_frame	*plist;
+	int			i;
+
+	printf("Error : async pipeline %s failed\n", ppipe->name);
+
+	pthread_mutex_lock(&ppipe->lock);
+	ppipe->failed	= true;
+	plist		= ppipe->phead;
+	ppipe->phead	= NULL;
+	ppipe->ptail	= NULL;
+	pthread_mutex_unlock(&ppipe->lock);
+
+	/* what is on the device will not come back in order any more */
+	for (i = 0; i < ppipe->buf_num; i++) {
+		if (ppipe->pslot[i] != NULL)
+			async_finish(ppipe, ppipe->pslot[i], NULL, -1);
+		ppipe->pslot[i] = NULL;
+	}
+	ppipe->inflight = 0;
+
+	while (plist != NULL) {
+		pframe = plist;
+		plist = pframe->pnext;
+		async_finish(ppipe, pframe, NULL, -1);
+	}
+}
+
+static void async_finish(struct vsp2_async_pipe *ppipe,
+			 struct vsp2_async_frame *pframe,
+			 const unsigned char *pdst, int result)
+{
+	struct vsp2_async *pasync = ppipe->pasync;
+
+	/* the frame may be gone once done() returns */
+	if (pframe != NULL)
+		pframe->done(pframe, pdst, pdst ? ppipe->dst_size : 0, result);
+
+	pthread_mutex_lock(&pasync->lock);
+	if (pframe != NULL)
+		pasync->stat.frames++;
+	if (result < 0)
+		pasync->stat.failed++;
+	if (--pasync->out == 0)
+		pthread_cond_broadcast(&pasync->cond);
+	pthread_mutex_unlock(&pasync->lock);
+}
+
+static void async_arm(struct vsp2_async_pipe *ppipe, int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events	= EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr	= ppipe;
+	if (epoll_ctl(ppipe->pasync->epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+}
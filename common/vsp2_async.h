@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  async pipeline : vsp2_async_process() hands a frame to a pipeline and
+ *  returns at once; the frame's done() is called when its wpf buffer is
+ *  back. No ioctl blocks: a few executor threads sleep in one epoll on
+ *  every pipeline's dst fd, dequeue what is done and queue what waits.
+ *
+ *  A pipeline owns buf_num buffer sets. Frames beyond that wait in a list
+ *  in the pipeline, so any number may be out at once; each frame is
+ *  filled into a free source buffer by fill() just before it is queued.
+ *  fill() and done() run on an executor thread, one at a time per
+ *  pipeline and in submit order; done() may submit the next frame.
+ *
+ *    any thread  : vsp2_async_process(), vsp2_async_drain()
+ *    owner       : vsp2_async_new(), vsp2_async_pipe_new(),
+ *                  vsp2_async_pipe_free(), vsp2_async_free()
+ ******************************************************************************/
+#ifndef VSP2_ASYNC_H
+#define VSP2_ASYNC_H
+
+#define VSP2_ASYNC_BUF_MAX	(8)
+
+struct vsp2_async;
+struct vsp2_async_pipe;
+
+struct vsp2_async_frame {
+	/* set by the caller */
+	void	(*fill)(struct vsp2_async_frame *pframe, unsigned char *psrc,
+			unsigned int size);
+	void	(*done)(struct vsp2_async_frame *pframe,
+			const unsigned char *pdst, unsigned int size,
+			int result);		/* 0 : ok, -1 : error */
+	void	*parg;
+
+	/* pending list */
+	struct vsp2_async_frame	*pnext;
+};
+
+struct vsp2_async_stat {
+	unsigned long long	frames;		/* done() calls */
+	unsigned long long	failed;
+	unsigned long long	wakeups;	/* epoll events handled */
+	unsigned long long	busy;		/* events for a pipeline that
+						 * another thread was serving */
+	unsigned long long	max_out;	/* frames out at once */
+};
+
+/* threads : executor threads, 1 - 16 */
+struct vsp2_async	*vsp2_async_new(int threads);
+/* waits for every frame, stops the threads */
+void	vsp2_async_free(struct vsp2_async *pasync,
+			struct vsp2_async_stat *pstat);
+
+/* formats set, dst opened with O_NONBLOCK; the buffers are requested and
+ * mapped here (MMAP), and released by vsp2_async_pipe_free() after a
+ * vsp2_async_drain(); the fds stay the caller's */
+struct vsp2_async_pipe	*vsp2_async_pipe_new(struct vsp2_async *pasync,
+					     const char *pname, int src_fd,
+					     int dst_fd, unsigned int src_size,
+					     unsigned int dst_size,
+					     int buf_num);
+void	vsp2_async_pipe_free(struct vsp2_async_pipe *ppipe);
+
+/* 0, or -1 when the pipeline has failed (done() is not called) */
+int	vsp2_async_process(struct vsp2_async_pipe *ppipe,
+			   struct vsp2_async_frame *pframe);
+/* until every frame submitted so far is done */
+void	vsp2_async_drain(struct vsp2_async *pasync);
+
+#endif /* VSP2_ASYNC_H */
@@ -0,0 +1,955 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  media controller layer
+ *  The model holds every VSP entity, pad and possible link, and shadows
+ *  what the backend has been told. Requests that match the shadow are
+ *  answered from it. media_reset_links() becomes a mark on the enabled
+ *  links, they are only disabled when the next setup does not want them
+ *  again, at the latest when a node is opened for streaming.
+ *
+ *  A device stays open for the life of the process once opened, so
+ *  every test in one run shares the shadow state. Several devices may be
+ *  open at once, each used by one thread at a time.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "vsp2_media.h"
+#include "vsp2_result.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define MEDIA_MODEL_BUS		"fe9a0000.vsp"
+#define MEDIA_RPF_NUM		(5)
+#define MEDIA_ENTITY_MAX	(24)
+#define MEDIA_PAD_MAX		(6)
+#define MEDIA_LINK_MAX		(96)
+#define MEDIA_SEL_CROP		(0)
+#define MEDIA_SEL_COMPOSE	(1)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct media_model_entity {
+	char				name[24];	/* without bus prefix */
+	unsigned int			pad_num;
+	unsigned int			source_pads;	/* bit per pad */
+	bool				video;		/* video node */
+	bool				present;	/* on this device */
+	struct v4l2_mbus_framefmt	fmt[MEDIA_PAD_MAX];
+	bool				fmt_valid[MEDIA_PAD_MAX];
+	struct v4l2_rect		sel[MEDIA_PAD_MAX][2];
+	bool				sel_valid[MEDIA_PAD_MAX][2];
+	struct media_entity		*phandle;	/* libmediactl entity */
+};
+
+struct media_model_link {
+	struct media_model_entity	*psrc;
+	unsigned int			src_pad;
+	struct media_model_entity	*psink;
+	unsigned int			sink_pad;
+	bool				immutable;
+	bool				enabled;
+	bool				stale;		/* reset, not yet applied */
+};
+
+struct media_backend {
+	const char	*pname;
+	int	(*open_dev)(struct vsp2_media *pmedia, const char *pdevnode);
+	void	(*close_dev)(struct vsp2_media *pmedia);
+	int	(*reset_links)(struct vsp2_media *pmedia);
+	int	(*setup_link)(struct vsp2_media *pmedia,
+			      struct media_model_link *plink, bool enable);
+	int	(*set_format)(struct vsp2_media *pmedia,
+			      struct media_model_entity *pent,
+			      unsigned int pad,
+			      struct v4l2_mbus_framefmt *pformat);
+	int	(*set_selection)(struct vsp2_media *pmedia,
+				 struct media_model_entity *pent,
+				 unsigned int pad, unsigned int target,
+				 struct v4l2_rect *prect);
+	int	(*open_node)(struct vsp2_media *pmedia,
+			     struct media_model_entity *pent, int flags);
+};
+
+struct vsp2_media {
+	struct vsp2_media		*pnext;
+	const struct media_backend	*pbackend;
+	char				devnode[64];
+	char				bus_name[32];
+	int				ref;
+	bool				links_known;	/* shadow is valid */
+	struct media_device		*pdev;
+
+	struct media_model_entity	entity[MEDIA_ENTITY_MAX];
+	int				entity_num;
+	struct media_model_link		link[MEDIA_LINK_MAX];
+	int				link_num;
+
+	/* statistics */
+	int				calls;
+	int				skipped;
+	long long			time_us;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct vsp2_media	*pmedia_list;
+static pthread_mutex_t		media_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static long long	media_now_us(void);
+static void	media_model_build(struct vsp2_media *pmedia);
+static struct media_model_entity	*media_model_add(
+						struct vsp2_media *pmedia,
+						const char *pname,
+						unsigned int pad_num,
+						unsigned int source_pads,
+						bool video);
+static void	media_model_link(struct vsp2_media *pmedia,
+				 struct media_model_entity *psrc,
+				 unsigned int src_pad,
+				 struct media_model_entity *psink,
+				 unsigned int sink_pad, bool immutable);
+static struct media_model_entity	*media_find_entity(
+						struct vsp2_media *pmedia,
+						const char *pname);
+static struct media_model_link	*media_find_link(struct vsp2_media *pmedia,
+						 struct media_model_entity *psrc,
+						 unsigned int src_pad,
+						 struct media_model_entity *psink,
+						 unsigned int sink_pad);
+static bool	media_is_histogram(const struct media_model_entity *pent);
+static int	media_apply_link(struct vsp2_media *pmedia,
+				 struct media_model_link *plink, bool enable);
+static int	media_flush(struct vsp2_media *pmedia);
+static int	media_check_pipeline(struct vsp2_media *pmedia);
+static void	media_describe(struct vsp2_media *pmedia, char *pbuf,
+			       size_t size);
+static void	media_exit(void);
+
+static int	mediactl_open(struct vsp2_media *pmedia, const char *pdevnode);
+static void	mediactl_close(struct vsp2_media *pmedia);
+static int	mediactl_reset_links(struct vsp2_media *pmedia);
+static int	mediactl_setup_link(struct vsp2_media *pmedia,
+				    struct media_model_link *plink,
+				    bool enable);
+static int	mediactl_set_format(struct vsp2_media *pmedia,
+				    struct media_model_entity *pent,
+				    unsigned int pad,
+				    struct v4l2_mbus_framefmt *pformat);
+static int	mediactl_set_selection(struct vsp2_media *pmedia,
+				       struct media_model_entity *pent,
+				       unsigned int pad, unsigned int target,
+				       struct v4l2_rect *prect);
+static int	mediactl_open_node(struct vsp2_media *pmedia,
+				   struct media_model_entity *pent, int flags);
+
+static int	model_open(struct vsp2_media *pmedia, const char *pdevnode);
+static void	model_close(struct vsp2_media *pmedia);
+static int	model_reset_links(struct vsp2_media *pmedia);
+static int	model_setup_link(struct vsp2_media *pmedia,
+				 struct media_model_link *plink, bool enable);
+static int	model_set_format(struct vsp2_media *pmedia,
+				 struct media_model_entity *pent,
+				 unsigned int pad,
+				 struct v4l2_mbus_framefmt *pformat);
+static int	model_set_selection(struct vsp2_media *pmedia,
+				    struct media_model_entity *pent,
+				    unsigned int pad, unsigned int target,
+				    struct v4l2_rect *prect);
+static int	model_open_node(struct vsp2_media *pmedia,
+				struct media_model_entity *pent, int flags);
+
+/******************************************************************************
+ *  backend
+ ******************************************************************************/
+static const struct media_backend media_backend_mediactl = {
+	.pname		= "mediactl",
+	.open_dev	= mediactl_open,
+	.close_dev	= mediactl_close,
+	.reset_links	= mediactl_reset_links,
+	.setup_link	= mediactl_setup_link,
+	.set_format	= mediactl_set_format,
+	.set_selection	= mediactl_set_selection,
+	.open_node	= mediactl_open_node,
+};
+
+static const struct media_backend media_backend_model = {
+	.pname		= "model",
+	.open_dev	= model_open,
+	.close_dev	= model_close,
+	.reset_links	= model_reset_links,
+	.setup_link	= model_setup_link,
+	.set_format	= model_set_format,
+	.set_selection	= model_set_selection,
+	.open_node	= model_open_node,
+};
+
+/******************************************************************************
+ *  interface
+ ******************************************************************************/
+struct vsp2_media *vsp2_media_open(const char *pdevnode)
+{
+	struct vsp2_media	*pmedia;
+	const char		*p;
+	long long		t_start;
+
+	pthread_mutex_lock(&media_lock);
+	for (pmedia = pmedia_list; pmedia != NULL; pmedia = pmedia->pnext) {
+		if (strcmp(pmedia->devnode, pdevnode) == 0) {
+			pmedia->ref++;
+			pthread_mutex_unlock(&media_lock);
+			return pmedia;
+		}
+	}
+
+	pmedia = calloc(1, sizeof(*pmedia));
+	if (pmedia == NULL) {
+		pthread_mutex_unlock(&media_lock);
+		return NULL;
+	}
+
+	p = getenv("VSP2_MEDIA");
+	if (p != NULL && strcmp(p, "model") == 0)
+		pmedia->pbackend = &media_backend_model;
+	else
+		pmedia->pbackend = &media_backend_mediactl;
+	snprintf(pmedia->devnode, sizeof(pmedia->devnode), "%s", pdevnode);
+	media_model_build(pmedia);
+
+	t_start = media_now_us();
+	if (pmedia->pbackend->open_dev(pmedia, pdevnode) < 0) {
+		pthread_mutex_unlock(&media_lock);
+		free(pmedia);
+		return NULL;
+	}
+	pmedia->time_us += media_now_us() - t_start;
+
+	if (pmedia_list == NULL)
+		atexit(media_exit);
+	pmedia->pnext	= pmedia_list;
+	pmedia->ref	= 1;
+	pmedia_list	= pmedia;
+	pthread_mutex_unlock(&media_lock);
+
+	return pmedia;
+}
+
+void vsp2_media_close(struct vsp2_media *pmedia)
+{
+	/* the device and its shadow state stay until exit */
+	pthread_mutex_lock(&media_lock);
+	if (pmedia != NULL && pmedia->ref > 0)
+		pmedia->ref--;
+	pthread_mutex_unlock(&media_lock);
+}
+
+const char *vsp2_media_bus_name(struct vsp2_media *pmedia)
+{
+	return pmedia->bus_name;
+}
+
+bool vsp2_media_has_entity(struct vsp2_media *pmedia, const char *pentity)
+{
+	struct media_model_entity *pent;
+
+	pent = media_find_entity(pmedia, pentity);
+	return pent != NULL && pent->present;
+}
+
+int vsp2_media_reset_links(struct vsp2_media *pmedia)
+{
+	long long	t_start;
+	int		ret;
+	int		i;
+
+	if (!pmedia->links_known) {
+		t_start = media_now_us();
+		ret = pmedia->pbackend->reset_links(pmedia);
+		pmedia->time_us += media_now_us() - t_start;
+		pmedia->calls++;
+		if (ret < 0)
+			return -1;
+
+		for (i = 0; i < pmedia->link_num; i++) {
+			pmedia->link[i].enabled	= pmedia->link[i].immutable;
+			pmedia->link[i].stale	= false;
+		}
+		pmedia->links_known = true;
+		return 0;
+	}
+
+	/* mark only, the links go when a setup does not want them again */
+	for (i = 0; i < pmedia->link_num; i++) {
+		if (pmedia->link[i].enabled && !pmedia->link[i].immutable)
+			pmedia->link[i].stale = true;
+	}
+	pmedia->skipped++;
+	return 0;
+}
+
+int vsp2_media_setup_link(struct vsp2_media *pmedia,
+			  const char *psource, unsigned int source_pad,
+			  const char *psink, unsigned int sink_pad, bool enable)
+{
+	struct media_model_entity	*psrc, *pdst;
+	struct media_model_link		*plink, *pother;
+	int				i;
+
+	psrc = media_find_entity(pmedia, psource);
+	pdst = media_find_entity(pmedia, psink);
+	if (psrc == NULL || pdst == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	plink = media_find_link(pmedia, psrc, source_pad, pdst, sink_pad);
+	if (plink == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pmedia->links_known && plink->enabled == enable) {
+		plink->stale = false;
+		pmedia->skipped++;
+		return 0;
+	}
+
+	/* a sink takes one link : a reset link into it goes first; a source
+	 * pad feeds one link but the histograms : the old one goes first */
+	for (i = 0; enable && i < pmedia->link_num; i++) {
+		pother = &pmedia->link[i];
+		if (pother == plink || !pother->enabled || pother->immutable)
+			continue;
+		if ((pother->stale && pother->psink == pdst &&
+		     pother->sink_pad == sink_pad) ||
+		    (pother->psrc == psrc && pother->src_pad == source_pad &&
+		     !media_is_histogram(pother->psink))) {
+			if (media_apply_link(pmedia, pother, false) < 0)
+				return -1;
+		}
+	}
+
+	return media_apply_link(pmedia, plink, enable);
+}
+
+int vsp2_media_set_format(struct vsp2_media *pmedia, const char *pentity,
+			  unsigned int pad, struct v4l2_mbus_framefmt *pformat)
+{
+	struct media_model_entity	*pent;
+	long long			t_start;
+	unsigned int			i;
+	int				ret;
+
+	pent = media_find_entity(pmedia, pentity);
+	if (pent == NULL || pad >= pent->pad_num) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pent->fmt_valid[pad] &&
+	    pent->fmt[pad].width == pformat->width &&
+	    pent->fmt[pad].height == pformat->height &&
+	    pent->fmt[pad].code == pformat->code) {
+		*pformat = pent->fmt[pad];
+		pmedia->skipped++;
+		return 0;
+	}
+
+	t_start = media_now_us();
+	ret = pmedia->pbackend->set_format(pmedia, pent, pad, pformat);
+	pmedia->time_us += media_now_us() - t_start;
+	pmedia->calls++;
+	if (ret < 0)
+		return -1;
+
+	/* a sink format propagates to the source pads, rectangles reset */
+	for (i = 0; i < pent->pad_num; i++) {
+		if (!(pent->source_pads & (1 << pad)) &&
+		    (pent->source_pads & (1 << i)))
+			pent->fmt_valid[i] = false;
+	}
+	pent->sel_valid[pad][MEDIA_SEL_CROP]	= false;
+	pent->sel_valid[pad][MEDIA_SEL_COMPOSE]	= false;
+	pent->fmt[pad]		= *pformat;
+	pent->fmt_valid[pad]	= true;
+	return 0;
+}
+
+int vsp2_media_set_selection(struct vsp2_media *pmedia, const char *pentity,
+			     unsigned int pad, unsigned int target,
+			     struct v4l2_rect *prect)
+{
+	struct media_model_entity	*pent;
+	long long			t_start;
+	unsigned int			i;
+	int				sel = -1;
+	int				ret;
+
+	pent = media_find_entity(pmedia, pentity);
+	if (pent == NULL || pad >= pent->pad_num) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (target == V4L2_SEL_TGT_CROP)
+		sel = MEDIA_SEL_CROP;
+	else if (target == V4L2_SEL_TGT_COMPOSE)
+		sel = MEDIA_SEL_COMPOSE;
+
+	if (sel >= 0 && pent->sel_valid[pad][sel] &&
+	    memcmp(&pent->sel[pad][sel], prect, sizeof(*prect)) == 0) {
+		pmedia->skipped++;
+		return 0;
+	}
+
+	t_start = media_now_us();
+	ret = pmedia->pbackend->set_selection(pmedia, pent, pad, target,
+					      prect);
+	pmedia->time_us += media_now_us() - t_start;
+	pmedia->calls++;
+	if (ret < 0)
+		return -1;
+
+	/* a crop sizes the source pad */
+	for (i = 0; i < pent->pad_num; i++) {
+		if (pent->source_pads & (1 << i))
+			pent->fmt_valid[i] = false;
+	}
+	if (sel >= 0) {
+		pent->sel[pad][sel]		= *prect;
+		pent->sel_valid[pad][sel]	= true;
+	}
+	return 0;
+}
+
+int vsp2_media_open_node(struct vsp2_media *pmedia, const char *pentity,
+			 int flags)
+{
+	struct media_model_entity	*pent;
+	char				links[512];
+	int				fd;
+
+	pent = media_find_entity(pmedia, pentity);
+	if (pent == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	/* streaming follows, the deferred reset must be in place */
+	if (media_flush(pmedia) < 0)
+		return -1;
+
+	fd = pmedia->pbackend->open_node(pmedia, pent, flags);
+	if (fd >= 0 && vsp2_result_active()) {
+		media_describe(pmedia, links, sizeof(links));
+		vsp2_result_media(pmedia->devnode, pmedia->bus_name, links);
+		vsp2_result_node(fd, pmedia->devnode, pent->name);
+	}
+	return fd;
+}
+
+/******************************************************************************
+ *  model
+ ******************************************************************************/
+static long long media_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void media_model_build(struct vsp2_media *pmedia)
+{
+	struct media_model_entity	*psrc[MEDIA_RPF_NUM + 4];
+	struct media_model_entity	*psink[4];
+	struct media_model_entity	*prpf, *pvideo, *pwpf;
+	char				name[24];
+	int				src_num = 0;
+	int				i, j, k, s;
+
+	/* rpf.N with its input video node */
+	for (i = 0; i < MEDIA_RPF_NUM; i++) {
+		snprintf(name, sizeof(name), "rpf.%d", i);
+		prpf = media_model_add(pmedia, name, 2, 1 << 1, false);
+		snprintf(name, sizeof(name), "rpf.%d input", i);
+		pvideo = media_model_add(pmedia, name, 1, 1 << 0, true);
+		media_model_link(pmedia, pvideo, 0, prpf, 0, true);
+		psrc[src_num++] = prpf;
+	}
+
+	pwpf = media_model_add(pmedia, "wpf.0", 2, 1 << 1, false);
+	pvideo = media_model_add(pmedia, "wpf.0 output", 1, 0, true);
+	media_model_link(pmedia, pwpf, 1, pvideo, 0, true);
+
+	psink[0] = media_model_add(pmedia, "uds.0", 2, 1 << 1, false);
+	psink[1] = media_model_add(pmedia, "lut", 2, 1 << 1, false);
+	psink[2] = media_model_add(pmedia, "clu", 2, 1 << 1, false);
+	psink[3] = media_model_add(pmedia, "bru", 6, 1 << 5, false);
+	media_model_add(pmedia, "hgo", 1, 0, false);
+	for (i = 0; i < 4; i++)
+		psrc[src_num++] = psink[i];
+
+	/* every processing source may feed every processing sink */
+	for (i = 0; i < src_num; i++) {
+		s = psrc[i]->pad_num - 1;
+		for (j = 0; j < 4; j++) {
+			if (psink[j] == psrc[i])
+				continue;
+			for (k = 0; k < psink[j]->pad_num - 1; k++)
+				media_model_link(pmedia, psrc[i], s,
+						 psink[j], k, false);
+		}
+		media_model_link(pmedia, psrc[i], s, pwpf, 0, false);
+	}
+}
+
+static struct media_model_entity *media_model_add(struct vsp2_media *pmedia,
+						  const char *pname,
+						  unsigned int pad_num,
+						  unsigned int source_pads,
+						  bool video)
+{
+	struct media_model_entity *pent = &pmedia->entity[pmedia->entity_num++];
+
+	snprintf(pent->name, sizeof(pent->name), "%s", pname);
+	pent->pad_num		= pad_num;
+	pent->source_pads	= source_pads;
+	pent->video		= video;
+	return pent;
+}
+
+static void media_model_link(struct vsp2_media *pmedia,
+			     struct media_model_entity *psrc,
+			     unsigned int src_pad,
+			     struct media_model_entity *psink,
+			     unsigned int sink_pad, bool immutable)
+{
+	struct media_model_link *plink = &pmedia->link[pmedia->link_num++];
+
+	plink->psrc		= psrc;
+	plink->src_pad		= src_pad;
+	plink->psink		= psink;
+	plink->sink_pad		= sink_pad;
+	plink->immutable	= immutable;
+	plink->enabled		= immutable;
+}
+
+static struct media_model_entity *media_find_entity(struct vsp2_media *pmedia,
+						    const char *pname)
+{
+	int i;
+
+	for (i = 0; i < pmedia->entity_num; i++) {
+		if (strcmp(pmedia->entity[i].name, pname) == 0)
+			return &pmedia->entity[i];
+	}
+	return NULL;
+}
+
+static struct media_model_link *media_find_link(struct vsp2_media *pmedia,
+						struct media_model_entity *psrc,
+						unsigned int src_pad,
+						struct media_model_entity *psink,
+						unsigned int sink_pad)
+{
+	struct media_model_link	*plink;
+	int			i;
+
+	for (i = 0; i < pmedia->link_num; i++) {
+		plink = &pmedia->link[i];
+		if (plink->psrc == psrc && plink->src_pad == src_pad &&
+		    plink->psink == psink && plink->sink_pad == sink_pad)
+			return plink;
+	}
+	return NULL;
+}
+
+/* hgo and hgt tap a source pad next to the link it feeds */
+static bool media_is_histogram(const struct media_model_entity *pent)
+{
+	return strcmp(pent->name, "hgo") == 0 || strcmp(pent->name, "hgt") == 0;
+}
+
+static int media_apply_link(struct vsp2_media *pmedia,
+			    struct media_model_link *plink, bool enable)
+{
+	long long	t_start;
+	int		ret;
+
+	t_start = media_now_us();
+	ret = pmedia->pbackend->setup_link(pmedia, plink, enable);
+	pmedia->time_us += media_now_us() - t_start;
+	pmedia->calls++;
+	if (ret < 0) {
+		/* the device state is unknown now, reset it next time */
+		pmedia->links_known = false;
+		return -1;
+	}
+
+	plink->enabled	= enable;
+	plink->stale	= false;
+	return 0;
+}
+
+static int media_flush(struct vsp2_media *pmedia)
+{
+	int i;
+
+	for (i = 0; i < pmedia->link_num; i++) {
+		if (pmedia->link[i].stale &&
+		    media_apply_link(pmedia, &pmedia->link[i], false) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int media_check_pipeline(struct vsp2_media *pmedia)
+{
+	struct media_model_link		*plink;
+	struct v4l2_mbus_framefmt	*psrc, *psink;
+	int				err = 0;
+	int				i;
+
+	/* what link validation at STREAMON looks at */
+	for (i = 0; i < pmedia->link_num; i++) {
+		plink = &pmedia->link[i];
+		if (!plink->enabled || plink->psrc->video ||
+		    plink->psink->video)
+			continue;
+
+		if (!plink->psrc->fmt_valid[plink->src_pad] ||
+		    !plink->psink->fmt_valid[plink->sink_pad]) {
+			printf("media model : '%s':%u -> '%s':%u format "
+			       "not set\n", plink->psrc->name, plink->src_pad,
+			       plink->psink->name, plink->sink_pad);
+			err++;
+			continue;
+		}
+
+		psrc	= &plink->psrc->fmt[plink->src_pad];
+		psink	= &plink->psink->fmt[plink->sink_pad];
+		if (psrc->width != psink->width ||
+		    psrc->height != psink->height ||
+		    psrc->code != psink->code) {
+			printf("media model : '%s':%u -> '%s':%u format "
+			       "mismatch %ux%u/0x%04x -> %ux%u/0x%04x\n",
+			       plink->psrc->name, plink->src_pad,
+			       plink->psink->name, plink->sink_pad,
+			       psrc->width, psrc->height, psrc->code,
+			       psink->width, psink->height, psink->code);
+			err++;
+		}
+	}
+	return err ? -1 : 0;
+}
+
+/* enabled links between processing entities, "rpf.0:1->uds.0:0,..." */
+static void media_describe(struct vsp2_media *pmedia, char *pbuf,
+			   size_t size)
+{
+	struct media_model_link	*plink;
+	size_t			len = 0;
+	int			i;
+
+	pbuf[0] = '\0';
+	for (i = 0; i < pmedia->link_num && len < size; i++) {
+		plink = &pmedia->link[i];
+		if (!plink->enabled || plink->immutable)
+			continue;
+		len += snprintf(pbuf + len, size - len, "%s%s:%u->%s:%u",
+				len ? "," : "", plink->psrc->name,
+				plink->src_pad, plink->psink->name,
+				plink->sink_pad);
+		/* truncated : snprintf counts what did not fit */
+		if (len >= size) {
+			len = size - 1;
+			break;
+		}
+	}
+}
+
+static void media_exit(void)
+{
+	struct vsp2_media	*pmedia;
+	const char		*p = getenv("VSP2_MEDIA_STAT");
+
+	pthread_mutex_lock(&media_lock);
+	while (pmedia_list != NULL) {
+		pmedia = pmedia_list;
+		if (p != NULL && p[0] != '\0' && p[0] != '0')
+			printf("media : %s %s backend, %d calls, %d answered "
+			       "by the model, %lld us\n", pmedia->devnode,
+			       pmedia->pbackend->pname, pmedia->calls,
+			       pmedia->skipped, pmedia->time_us);
+
+		pmedia->pbackend->close_dev(pmedia);
+		pmedia_list = pmedia->pnext;
+		free(pmedia);
+	}
+	pthread_mutex_unlock(&media_lock);
+}
+
+/******************************************************************************
+ *  backend : libmediactl
+ ******************************************************************************/
+static int mediactl_open(struct vsp2_media *pmedia, const char *pdevnode)
+{
+	const struct media_device_info	*pinfo;
+	const char			*p;
+	char				name[64];
+	int				i;
+
+	pmedia->pdev = media_device_new(pdevnode);
+	if (pmedia->pdev == NULL) {
+		errno = ENODEV;
+		return -1;
+	}
+	if (media_device_enumerate(pmedia->pdev) != 0) {
+		media_device_unref(pmedia->pdev);
+		errno = ENODEV;
+		return -1;
+	}
+
+	pinfo = media_get_info(pmedia->pdev);
+	p = strchr(pinfo->bus_info, ':');
+	snprintf(pmedia->bus_name, sizeof(pmedia->bus_name), "%s",
+		 p ? p + 1 : pinfo->bus_info);
+
+	/* the full names are built once, lookups use the handles */
+	for (i = 0; i < pmedia->entity_num; i++) {
+		snprintf(name, sizeof(name), "%s %s", pmedia->bus_name,
+			 pmedia->entity[i].name);
+		pmedia->entity[i].phandle =
+			media_get_entity_by_name(pmedia->pdev, name,
+						 strlen(name));
+		pmedia->entity[i].present = pmedia->entity[i].phandle != NULL;
+	}
+	return 0;
+}
+
+static void mediactl_close(struct vsp2_media *pmedia)
+{
+	media_device_unref(pmedia->pdev);
+}
+
+static int mediactl_reset_links(struct vsp2_media *pmedia)
+{
+	int ret;
+
+	ret = media_reset_links(pmedia->pdev);
+	if (ret != 0) {
+		errno = ret < 0 ? -ret : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+static int mediactl_setup_link(struct vsp2_media *pmedia,
+			       struct media_model_link *plink, bool enable)
+{
+	const struct media_pad	*psrc, *psink;
+	int			ret;
+
+	if (plink->psrc->phandle == NULL || plink->psink->phandle == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	psrc	= media_entity_get_pad(plink->psrc->phandle, plink->src_pad);
+	psink	= media_entity_get_pad(plink->psink->phandle, plink->sink_pad);
+	if (psrc == NULL || psink == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = media_setup_link(pmedia->pdev, (struct media_pad *)psrc,
+			       (struct media_pad *)psink,
+			       enable ? MEDIA_LNK_FL_ENABLED : 0);
+	if (ret != 0) {
+		errno = ret < 0 ? -ret : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+static int mediactl_set_format(struct vsp2_media *pmedia,
+			       struct media_model_entity *pent,
+			       unsigned int pad,
+			       struct v4l2_mbus_framefmt *pformat)
+{
+	int ret;
+
+	if (pent->phandle == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	ret = v4l2_subdev_set_format(pent->phandle, pformat, pad,
+				     V4L2_SUBDEV_FORMAT_ACTIVE);
+	if (ret != 0) {
+		errno = ret < 0 ? -ret : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+static int mediactl_set_selection(struct vsp2_media *pmedia,
+				  struct media_model_entity *pent,
+				  unsigned int pad, unsigned int target,
+				  struct v4l2_rect *prect)
+{
+	int ret;
+
+	if (pent->phandle == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	ret = v4l2_subdev_set_selection(pent->phandle, prect, pad, target,
+					V4L2_SUBDEV_FORMAT_ACTIVE);
+	if (ret != 0) {
+		errno = ret < 0 ? -ret : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+static int mediactl_open_node(struct vsp2_media *pmedia,
+			      struct media_model_entity *pent, int flags)
+{
+	const char *pdevname;
+
+	if (pent->phandle == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	pdevname = media_entity_get_devname(pent->phandle);
+	if (pdevname == NULL) {
+		errno = ENODEV;
+		return -1;
+	}
+	return open(pdevname, flags);
+}
+
+/******************************************************************************
+ *  backend : model only
+ ******************************************************************************/
+static int model_open(struct vsp2_media *pmedia, const char *pdevnode)
+{
+	int i;
+
+	snprintf(pmedia->bus_name, sizeof(pmedia->bus_name), "%s",
+		 MEDIA_MODEL_BUS);
+	for (i = 0; i < pmedia->entity_num; i++)
+		pmedia->entity[i].present = true;
+	return 0;
+}
+
+static void model_close(struct vsp2_media *pmedia)
+{
+}
+
+static int model_reset_links(struct vsp2_media *pmedia)
+{
+	return 0;
+}
+
+static int model_setup_link(struct vsp2_media *pmedia,
+			    struct media_model_link *plink, bool enable)
+{
+	struct media_model_link	*pother;
+	int			i;
+
+	if (plink->immutable) {
+		if (!enable) {
+			errno = EINVAL;
+			return -1;
+		}
+		return 0;
+	}
+
+	/* as the kernel : one enabled link per sink pad, and per source
+	 * pad but for the links into the histograms */
+	for (i = 0; enable && i < pmedia->link_num; i++) {
+		pother = &pmedia->link[i];
+		if (pother == plink || !pother->enabled)
+			continue;
+		if ((pother->psink == plink->psink &&
+		     pother->sink_pad == plink->sink_pad) ||
+		    (pother->psrc == plink->psrc &&
+		     pother->src_pad == plink->src_pad &&
+		     !media_is_histogram(pother->psink) &&
+		     !media_is_histogram(plink->psink))) {
+			errno = EBUSY;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int model_set_format(struct vsp2_media *pmedia,
+			    struct media_model_entity *pent,
+			    unsigned int pad,
+			    struct v4l2_mbus_framefmt *pformat)
+{
+	if (pent->video || pformat->width < 1 || pformat->width > 8190 ||
+	    pformat->height < 1 || pformat->height > 8190) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+static int model_set_selection(struct vsp2_media *pmedia,
+			       struct media_model_entity *pent,
+			       unsigned int pad, unsigned int target,
+			       struct v4l2_rect *prect)
+{
+	struct v4l2_mbus_framefmt *pfmt = &pent->fmt[pad];
+
+	if (pent->video ||
+	    (target != V4L2_SEL_TGT_CROP && target != V4L2_SEL_TGT_COMPOSE)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* a crop lies inside the pad format */
+	if (target == V4L2_SEL_TGT_CROP && pent->fmt_valid[pad] &&
+	    (prect->left < 0 || prect->top < 0 ||
+	     prect->left + prect->width > pfmt->width ||
+	     prect->top + prect->height > pfmt->height)) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+static int model_open_node(struct vsp2_media *pmedia,
+			   struct media_model_entity *pent, int flags)
+{
+	if (media_check_pipeline(pmedia) == 0)
+		printf("media model : pipeline ok, no device for '%s'\n",
+		       pent->name);
+
+	errno = ENODEV;
+	return -1;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  media controller layer : links, pad formats, selections and node open
+ *  by entity name without the bus prefix ("rpf.0", "wpf.0 output").
+ *
+ *  An in-process model of the VSP topology sits in front of the backend.
+ *  It keeps the link and pad state, so a setup that is already in place
+ *  costs no call, and a reset is deferred until a link really changes.
+ *
+ *    VSP2_MEDIA=model   : dry run on the model only, no device needed;
+ *                         the pipeline is checked when a node is opened
+ *    VSP2_MEDIA_STAT=1  : print backend calls and setup time at exit
+ ******************************************************************************/
+#ifndef VSP2_MEDIA_H
+#define VSP2_MEDIA_H
+
+#include <stdbool.h>
+#include <linux/videodev2.h>
+#include <linux/v4l2-mediabus.h>
+
+struct vsp2_media;
+
+/* NULL : error with errno set; one per device node, counted */
+struct vsp2_media	*vsp2_media_open(const char *pdevnode);
+void	vsp2_media_close(struct vsp2_media *pmedia);
+const char	*vsp2_media_bus_name(struct vsp2_media *pmedia);
+bool	vsp2_media_has_entity(struct vsp2_media *pmedia, const char *pentity);
+
+/* 0 : success, -1 : error with errno set */
+int	vsp2_media_reset_links(struct vsp2_media *pmedia);
+/* an enable first takes down the other link of its source pad, as the
+ * driver allows one per pad (links into hgo and hgt aside) */
+int	vsp2_media_setup_link(struct vsp2_media *pmedia,
+			      const char *psource, unsigned int source_pad,
+			      const char *psink, unsigned int sink_pad,
+			      bool enable);
+int	vsp2_media_set_format(struct vsp2_media *pmedia, const char *pentity,
+			      unsigned int pad,
+			      struct v4l2_mbus_framefmt *pformat);
+int	vsp2_media_set_selection(struct vsp2_media *pmedia,
+				 const char *pentity, unsigned int pad,
+				 unsigned int target, struct v4l2_rect *prect);
+int	vsp2_media_open_node(struct vsp2_media *pmedia, const char *pentity,
+			     int flags);
+
+#endif /* VSP2_MEDIA_H */
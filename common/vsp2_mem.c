@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  memory accounting
+ *  Every live allocation is one record keyed by its mmngr id or mapped
+ *  address, tagged with its type and the pipeline that was current on the
+ *  allocating thread. Totals are updated under one lock; the report
+ *  reads a copy.
+ *  Cached frames are checked once against the exporter before the first
+ *  is given out; the check is only as strong as the fresh dmabuf mapping
+ *  is uncached, which is how mmngr and the emulator map it.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+
+#include "mmngr_buf_user_public.h"
+
+#define VSP2_MEM_NO_WRAP
+#include "vsp2_mem.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define MEM_PIPE_MAX		(32)
+#define MEM_PIPE_NAME_LEN	(32)
+#define MEM_REC_GROW		(64)
+#define MEM_PROBE_SIZE		(64 * 1024)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct mem_usage {
+	unsigned long long	live;
+	unsigned long long	peak;
+};
+
+struct mem_type_stat {
+	struct mem_usage	use;
+	unsigned int		allocs;
+	unsigned int		fails;
+	unsigned int		denied;		/* over the limit */
+	long long		time_us;
+	long long		max_us;
+};
+
+struct mem_pipe {
+	char			name[MEM_PIPE_NAME_LEN];
+	struct mem_usage	use;
+	struct mem_usage	type_use[VSP2_MEM_TYPE_NUM];
+};
+
+struct mem_rec {
+	enum vsp2_mem_type	type;
+	int			pipe;
+	MMNGR_ID		id;		/* -1 : mapping */
+	void			*paddr;
+	unsigned long		size;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const char	*mem_type_name[VSP2_MEM_TYPE_NUM] = {
+	"v4l2 mmap", "mmngr", "table", "hugepage",
+};
+
+static pthread_mutex_t		mem_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mem_usage		mem_total;
+static struct mem_type_stat	mem_type[VSP2_MEM_TYPE_NUM];
+static struct mem_pipe		mem_pipe[MEM_PIPE_MAX];
+static int			mem_pipe_num = 1;	/* 0 : "-" */
+static struct mem_rec		*pmem_rec;
+static int			mem_rec_num;
+static int			mem_rec_cap;
+static unsigned long long	mem_limit;		/* 0 : no limit */
+static unsigned int		mem_period;		/* seconds */
+static bool			mem_cached;
+static bool			mem_cached_ok;
+static pthread_once_t		mem_probe_once = PTHREAD_ONCE_INIT;
+static __thread int		mem_pipe_self;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static long long	mem_now_us(void);
+static int	mem_reserve(enum vsp2_mem_type type, unsigned long size);
+static void	mem_add(enum vsp2_mem_type type, bool ok, MMNGR_ID id,
+			void *paddr, unsigned long size, long long us);
+static void	mem_remove(MMNGR_ID id, void *paddr);
+static void	mem_use_add(struct mem_usage *puse, unsigned long size);
+static void	*mem_period_thread(void *parg);
+static void	mem_probe_cached(void);
+static int	mem_probe_sync(int dmafd, unsigned long long flags);
+
+/******************************************************************************
+ *  setup
+ ******************************************************************************/
+__attribute__((constructor))
+static void mem_init(void)
+{
+	pthread_t	thread;
+	const char	*p;
+
+	snprintf(mem_pipe[0].name, MEM_PIPE_NAME_LEN, "-");
+
+	p = getenv("VSP2_MEM_LIMIT");
+	if (p != NULL)
+		mem_limit = strtoull(p, NULL, 0) * 1024;
+
+	p = getenv("VSP2_MEM_STAT");
+	if (p != NULL && p[0] != '\0' && p[0] != '0')
+		atexit(vsp2_mem_report);
+
+	p = getenv("VSP2_MEM_CACHED");
+	mem_cached = p != NULL && p[0] != '\0' && p[0] != '0';
+
+	p = getenv("VSP2_MEM_PERIOD");
+	if (p != NULL)
+		mem_period = strtoul(p, NULL, 0);
+	if (mem_period > 0 &&
+	    pthread_create(&thread, NULL, mem_period_thread, NULL) == 0)
+		pthread_detach(thread);
+}
+
+static void *mem_period_thread(void *parg)
+{
+	for (;;) {
+		sleep(mem_period);
+		vsp2_mem_report();
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ *  pipeline
+ ******************************************************************************/
+void vsp2_mem_pipeline(const char *pname)
+{
+	int i;
+
+	pthread_mutex_lock(&mem_lock);
+	for (i = 1; i < mem_pipe_num; i++) {
+		if (strncmp(mem_pipe[i].name, pname, MEM_PIPE_NAME_LEN - 1) == 0)
+			break;
+	}
+	if (i == mem_pipe_num && mem_pipe_num < MEM_PIPE_MAX) {
+		snprintf(mem_pipe[i].name, MEM_PIPE_NAME_LEN, "%s", pname);
+		mem_pipe_num++;
+	}
+	/* out of slots : charged to "-" */
+	mem_pipe_self = i < mem_pipe_num ? i : 0;
+	pthread_mutex_unlock(&mem_lock);
+}
+
+/******************************************************************************
+ *  allocation
+ ******************************************************************************/
+int vsp2_mem_alloc(enum vsp2_mem_type type, MMNGR_ID *pid,
+		   unsigned long size, unsigned long *pphy_addr,
+		   unsigned long *phard_addr, unsigned long *puser_virt_addr,
+		   unsigned long flag)
+{
+	long long	t_start;
+	int		ret;
+
+	if (mem_reserve(type, size) < 0)
+		return R_MM_NOMEM;
+
+	/* frames only : tables are read by the VSP without a sync */
+	if (mem_cached && type == VSP2_MEM_MMNGR && flag == MMNGR_VA_SUPPORT)
+		flag = MMNGR_VA_SUPPORT_CACHED;
+	if (flag == MMNGR_VA_SUPPORT_CACHED && !vsp2_mem_cached_ok())
+		flag = MMNGR_VA_SUPPORT;
+
+	t_start = mem_now_us();
+	ret = mmngr_alloc_in_user(pid, size, pphy_addr, phard_addr,
+				  puser_virt_addr, flag);
+	mem_add(type, ret == R_MM_OK, ret == R_MM_OK ? *pid : -1, NULL, size,
+		mem_now_us() - t_start);
+	return ret;
+}
+
+int vsp2_mem_free(MMNGR_ID id)
+{
+	int ret;
+
+	ret = mmngr_free_in_user(id);
+	if (ret == R_MM_OK)
+		mem_remove(id, NULL);
+	return ret;
+}
+
+void *vsp2_mem_mmap(void *paddr, size_t length, int prot, int flags,
+		    int fd, off_t offset)
+{
+	long long	t_start;
+	void		*p;
+
+	if (mem_reserve(VSP2_MEM_MMAP, length) < 0) {
+		errno = ENOMEM;
+		return MAP_FAILED;
+	}
+
+	t_start = mem_now_us();
+	p = mmap(paddr, length, prot, flags, fd, offset);
+	mem_add(VSP2_MEM_MMAP, p != MAP_FAILED, -1, p, length,
+		mem_now_us() - t_start);
+	return p;
+}
+
+int vsp2_mem_munmap(void *paddr, size_t length)
+{
+	int ret;
+
+	ret = munmap(paddr, length);
+	if (ret == 0)
+		mem_remove(-1, paddr);
+	return ret;
+}
+
+void *vsp2_mem_huge_alloc(unsigned long size, enum vsp2_mem_huge_kind *pkind)
+{
+	unsigned long	len = (size + VSP2_MEM_HUGE_SIZE - 1) &
+			      ~(VSP2_MEM_HUGE_SIZE - 1);
+	unsigned long	head;
+	long long	t_start;
+	char		*p;
+
+	*pkind = VSP2_MEM_HUGE_NONE;
+	if (mem_reserve(VSP2_MEM_HUGE, len) < 0)
+		return NULL;
+
+	t_start = mem_now_us();
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED) {
+		*pkind = VSP2_MEM_HUGE_TLB;
+		goto out;
+	}
+
+	/* no hugetlbfs pool : over-map, trim to 2 MiB, ask for THP */
+	p = mmap(NULL, len + VSP2_MEM_HUGE_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		goto out;
+	head = ((unsigned long)p + VSP2_MEM_HUGE_SIZE - 1) &
+	       ~(VSP2_MEM_HUGE_SIZE - 1);
+	head -= (unsigned long)p;
+	if (head > 0)
+		munmap(p, head);
+	if (VSP2_MEM_HUGE_SIZE - head > 0)
+		munmap(p + head + len, VSP2_MEM_HUGE_SIZE - head);
+	p += head;
+	madvise(p, len, MADV_HUGEPAGE);
+	*pkind = VSP2_MEM_HUGE_THP;
+
+out:
+	mem_add(VSP2_MEM_HUGE, p != MAP_FAILED, -1,
+		p != MAP_FAILED ? p : NULL, len, mem_now_us() - t_start);
+	return p != MAP_FAILED ? p : NULL;
+}
+
+int vsp2_mem_huge_free(void *paddr, unsigned long size)
+{
+	unsigned long	len = (size + VSP2_MEM_HUGE_SIZE - 1) &
+			      ~(VSP2_MEM_HUGE_SIZE - 1);
+	int		ret;
+
+	ret = munmap(paddr, len);
+	if (ret == 0)
+		mem_remove(-1, paddr);
+	return ret;
+}
+
+long vsp2_mem_huge_backed(void *paddr, unsigned long size)
+{
+	unsigned long	start = (unsigned long)paddr;
+	unsigned long	lo, hi;
+	char		line[256];
+	long		kib = -1;
+	long		val;
+	bool		in = false;
+	FILE		*fp;
+
+	/* AnonHugePages of the mapping that holds the range */
+	fp = fopen("/proc/self/smaps", "r");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2 &&
+		    strchr(line, '-') < strchr(line, ' ')) {
+			in = lo <= start && start + size <= hi;
+			continue;
+		}
+		if (!in)
+			continue;
+		if (sscanf(line, "AnonHugePages: %ld kB", &val) == 1 ||
+		    sscanf(line, "Private_Hugetlb: %ld kB", &val) == 1)
+			kib = (kib < 0 ? 0 : kib) + val;
+	}
+	fclose(fp);
+
+	/* the mapping may have merged with a neighbour */
+	if (kib > (long)(size / 1024))
+		kib = size / 1024;
+	return kib;
+}
+
+/******************************************************************************
+ *  cached frames
+ ******************************************************************************/
+bool vsp2_mem_cached_ok(void)
+{
+	pthread_once(&mem_probe_once, mem_probe_cached);
+	return mem_cached_ok;
+}
+
+static void mem_probe_cached(void)
+{
+	unsigned long	phy_addr, hard_addr, virt_addr;
+	unsigned int	*puser;
+	unsigned int	*pmap = MAP_FAILED;
+	MMNGR_ID	id = -1;
+	int		mbid = -1;
+	int		dmafd = -1;
+	int		line = 0;
+	unsigned int	i;
+
+	if (mmngr_alloc_in_user(&id, MEM_PROBE_SIZE, &phy_addr, &hard_addr,
+				&virt_addr, MMNGR_VA_SUPPORT_CACHED) != R_MM_OK) {
+		id = -1;
+		line = __LINE__;
+		goto out;
+	}
+	if (mmngr_export_start_in_user(&mbid, MEM_PROBE_SIZE, hard_addr,
+				       &dmafd) != R_MM_OK) {
+		mbid = -1;
+		line = __LINE__;
+		goto out;
+	}
+
+	/* the pattern stays in the CPU cache unless the sync writes it back */
+	puser = (unsigned int *)virt_addr;
+	if (mem_probe_sync(dmafd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE) < 0) {
+		line = __LINE__;
+		goto out;
+	}
+	for (i = 0; i < MEM_PROBE_SIZE / sizeof(*puser); i++)
+		puser[i] = 0x5a000000 ^ (i * 2654435761U);
+	if (mem_probe_sync(dmafd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE) < 0) {
+		line = __LINE__;
+		goto out;
+	}
+
+	pmap = mmap(NULL, MEM_PROBE_SIZE, PROT_READ, MAP_SHARED, dmafd, 0);
+	if (pmap == MAP_FAILED) {
+		line = __LINE__;
+		goto out;
+	}
+	if (memcmp(pmap, puser, MEM_PROBE_SIZE) != 0) {
+		errno = 0;
+		line = __LINE__;
+		goto out;
+	}
+	mem_cached_ok = true;
+
+out:
+	if (line != 0 && mem_cached)
+		fprintf(stderr, "memory : VSP2_MEM_CACHED refused, the dmabuf "
+			"sync is not seen to write the cache back "
+			"(line=%d errno=(%d)); frames are mapped uncached\n",
+			line, errno);
+	if (pmap != MAP_FAILED)
+		munmap(pmap, MEM_PROBE_SIZE);
+	if (mbid >= 0)
+		mmngr_export_end_in_user(mbid);
+	if (id >= 0)
+		mmngr_free_in_user(id);
+}
+
+static int mem_probe_sync(int dmafd, unsigned long long flags)
+{
+	struct dma_buf_sync	sync;
+	int			ret;
+
+	sync.flags = flags;
+	do {
+		ret = ioctl(dmafd, DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+	return ret;
+}
+
+/******************************************************************************
+ *  report
+ ******************************************************************************/
+void vsp2_mem_report(void)
+{
+	struct mem_type_stat	type[VSP2_MEM_TYPE_NUM];
+	struct mem_pipe		pipe[MEM_PIPE_MAX];
+	struct mem_usage	total;
+	int			pipe_num;
+	int			i, t;
+
+	pthread_mutex_lock(&mem_lock);
+	memcpy(type, mem_type, sizeof(type));
+	memcpy(pipe, mem_pipe, sizeof(pipe));
+	total		= mem_total;
+	pipe_num	= mem_pipe_num;
+	pthread_mutex_unlock(&mem_lock);
+
+	fflush(stdout);
+
+	fprintf(stderr, "memory : %-16s %10s %10s %7s %5s %7s %7s\n",
+		"type", "live KiB", "peak KiB", "allocs", "fail",
+		"avg us", "max us");
+	for (t = 0; t < VSP2_MEM_TYPE_NUM; t++) {
+		fprintf(stderr, "         %-16s %10llu %10llu %7u %5u %7lld %7lld\n",
+			mem_type_name[t], type[t].use.live / 1024,
+			type[t].use.peak / 1024, type[t].allocs,
+			type[t].fails + type[t].denied,
+			type[t].allocs ? type[t].time_us / type[t].allocs : 0,
+			type[t].max_us);
+	}
+	fprintf(stderr, "         %-16s %10llu %10llu", "total",
+		total.live / 1024, total.peak / 1024);
+	if (mem_limit > 0)
+		fprintf(stderr, "   limit %llu KiB", mem_limit / 1024);
+	if (mem_cached)
+		fprintf(stderr, vsp2_mem_cached_ok() ? "   mmngr cached" :
+			"   mmngr cached refused");
+	fprintf(stderr, "\n");
+
+	fprintf(stderr, "memory : %-16s %10s %10s   peak KiB by type\n",
+		"pipeline", "live KiB", "peak KiB");
+	for (i = 0; i < pipe_num; i++) {
+		if (pipe[i].use.peak == 0)
+			continue;
+		fprintf(stderr, "         %-16s %10llu %10llu  ",
+			pipe[i].name, pipe[i].use.live / 1024,
+			pipe[i].use.peak / 1024);
+		for (t = 0; t < VSP2_MEM_TYPE_NUM; t++)
+			fprintf(stderr, " %s %llu", mem_type_name[t],
+				pipe[i].type_use[t].peak / 1024);
+		fprintf(stderr, "\n");
+	}
+}
+
+/******************************************************************************
+ *  record
+ ******************************************************************************/
+static long long mem_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* the size is charged to the total up front, so a limit holds across threads */
+static int mem_reserve(enum vsp2_mem_type type, unsigned long size)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&mem_lock);
+	if (mem_limit > 0 && mem_total.live + size > mem_limit) {
+		mem_type[type].denied++;
+		fprintf(stderr, "memory : %s %lu KiB denied, %llu of %llu KiB in use\n",
+			mem_type_name[type], size / 1024,
+			mem_total.live / 1024, mem_limit / 1024);
+		ret = -1;
+	} else {
+		mem_use_add(&mem_total, size);
+	}
+	pthread_mutex_unlock(&mem_lock);
+	return ret;
+}
+
+static void mem_use_add(struct mem_usage *puse, unsigned long size)
+{
+	puse->live += size;
+	if (puse->live > puse->peak)
+		puse->peak = puse->live;
+}
+
+static void mem_add(enum vsp2_mem_type type, bool ok, MMNGR_ID id,
+		    void *paddr, unsigned long size, long long us)
+{
+	struct mem_type_stat	*pstat = &mem_type[type];
+	struct mem_rec		*prec;
+	int			pipe = mem_pipe_self;
+
+	pthread_mutex_lock(&mem_lock);
+	if (!ok) {
+		pstat->fails++;
+		mem_total.live -= size;
+		goto out;
+	}
+
+	pstat->allocs++;
+	pstat->time_us += us;
+	if (us > pstat->max_us)
+		pstat->max_us = us;
+
+	if (mem_rec_num == mem_rec_cap) {
+		prec = realloc(pmem_rec, (mem_rec_cap + MEM_REC_GROW) *
+				sizeof(*prec));
+		if (prec == NULL) {
+			/* counted, not tracked */
+			mem_total.live -= size;
+			goto out;
+		}
+		pmem_rec	= prec;
+		mem_rec_cap	+= MEM_REC_GROW;
+	}
+	prec		= &pmem_rec[mem_rec_num++];
+	prec->type	= type;
+	prec->pipe	= pipe;
+	prec->id	= id;
+	prec->paddr	= paddr;
+	prec->size	= size;
+
+	mem_use_add(&pstat->use, size);
+	mem_use_add(&mem_pipe[pipe].use, size);
+	mem_use_add(&mem_pipe[pipe].type_use[type], size);
+out:
+	pthread_mutex_unlock(&mem_lock);
+}
+
+static void mem_remove(MMNGR_ID id, void *paddr)
+{
+	struct mem_rec	*prec;
+	int		i;
+
+	pthread_mutex_lock(&mem_lock);
+	for (i = 0; i < mem_rec_num; i++) {
+		prec = &pmem_rec[i];
+		if (prec->id != id || prec->paddr != paddr)
+			continue;
+
+		mem_total.live				-= prec->size;
+		mem_type[prec->type].use.live		-= prec->size;
+		mem_pipe[prec->pipe].use.live		-= prec->size;
+		mem_pipe[prec->pipe].type_use[prec->type].live -= prec->size;
+		pmem_rec[i] = pmem_rec[--mem_rec_num];
+		break;
+	}
+	pthread_mutex_unlock(&mem_lock);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  memory accounting : live, peak and per pipeline usage of device visible
+ *  memory by type, with allocation latency and failures.
+ *
+ *    VSP2_MEM_STAT=1        print the report at exit
+ *    VSP2_MEM_PERIOD=<sec>  print it every <sec> seconds as well
+ *    VSP2_MEM_LIMIT=<KiB>   cap the total, allocations above it fail
+ *    VSP2_MEM_CACHED=1      map mmngr frame buffers cacheable; the CPU
+ *                           access must then be synced (vsp2_sync.h)
+ *
+ *  A cached frame buffer is only given where the dmabuf sync is seen to
+ *  write the CPU cache back: once, a pattern written through a cached
+ *  mmngr mapping is synced and read back through a fresh mapping of its
+ *  exported dmabuf fd. Where it does not come back, frames stay uncached.
+ *
+ *  Include after the mmngr and system headers: mmngr_alloc_in_user(),
+ *  mmngr_free_in_user(), mmap() and munmap() of the including file are
+ *  routed through the accounting. Table buffers are allocated with
+ *  vsp2_mem_alloc(VSP2_MEM_TABLE, ...) to be told apart from frames.
+ *
+ *  vsp2_mem_huge_alloc() gives USERPTR frame buffers backed by 2 MiB pages:
+ *  hugetlbfs pages when the pool has them, else a 2 MiB aligned region
+ *  with transparent hugepages requested.
+ ******************************************************************************/
+#ifndef VSP2_MEM_H
+#define VSP2_MEM_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "mmngr_user_public.h"
+
+enum vsp2_mem_type {
+	VSP2_MEM_MMAP = 0,	/* v4l2 MMAP buffer, mapped from the driver */
+	VSP2_MEM_MMNGR,		/* mmngr frame buffer for USERPTR / DMABUF */
+	VSP2_MEM_TABLE,		/* mmngr LUT / CLU / HGO buffer */
+	VSP2_MEM_HUGE,		/* hugepage frame buffer for USERPTR */
+	VSP2_MEM_TYPE_NUM,
+};
+
+void	vsp2_mem_pipeline(const char *pname);
+void	vsp2_mem_report(void);
+/* true : cached frame buffers are synced by the dmabuf exporter */
+bool	vsp2_mem_cached_ok(void);
+int	vsp2_mem_alloc(enum vsp2_mem_type type, MMNGR_ID *pid,
+		       unsigned long size, unsigned long *pphy_addr,
+		       unsigned long *phard_addr, unsigned long *puser_virt_addr,
+		       unsigned long flag);
+int	vsp2_mem_free(MMNGR_ID id);
+void	*vsp2_mem_mmap(void *paddr, size_t length, int prot, int flags,
+		       int fd, off_t offset);
+int	vsp2_mem_munmap(void *paddr, size_t length);
+
+#define VSP2_MEM_HUGE_SIZE	(2UL * 1024 * 1024)
+
+enum vsp2_mem_huge_kind {
+	VSP2_MEM_HUGE_NONE = 0,	/* failed */
+	VSP2_MEM_HUGE_TLB,	/* MAP_HUGETLB, pages reserved up front */
+	VSP2_MEM_HUGE_THP,	/* aligned, MADV_HUGEPAGE; the kernel may not */
+};
+
+/* size is rounded up to VSP2_MEM_HUGE_SIZE; NULL on failure */
+void	*vsp2_mem_huge_alloc(unsigned long size,
+			     enum vsp2_mem_huge_kind *pkind);
+int	vsp2_mem_huge_free(void *paddr, unsigned long size);
+/* KiB of the range backed by huge pages, -1 : not known */
+long	vsp2_mem_huge_backed(void *paddr, unsigned long size);
+
+#ifndef VSP2_MEM_NO_WRAP
+#define mmngr_alloc_in_user(pid, size, pphy, phard, pvirt, flag) \
+	vsp2_mem_alloc(VSP2_MEM_MMNGR, (pid), (size), (pphy), (phard), \
+		       (pvirt), (flag))
+#define mmngr_free_in_user(id) \
+	vsp2_mem_free((id))
+#define mmap(paddr, length, prot, flags, fd, offset) \
+	vsp2_mem_mmap((paddr), (length), (prot), (flags), (fd), (offset))
+#define munmap(paddr, length) \
+	vsp2_mem_munmap((paddr), (length))
+#endif
+
+#endif /* VSP2_MEM_H */
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  cpu counters
+ *  Each thread opens its own counters on its first stage; they count the
+ *  calling thread only, user and kernel, and run free from then on. A
+ *  stage costs two reads of every counter. Counters the cpu or the
+ *  kernel do not offer are left out and shown as '-'.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "vsp2_pmu.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define PMU_RAW_MAX		(4)
+#define PMU_EVENT_MAX		(PMU_FIXED_NUM + PMU_RAW_MAX)
+#define PMU_STAGE_MAX		(32)
+#define PMU_DEPTH_MAX		(16)
+#define PMU_LINE_SIZE		(64)		/* bytes per LL miss */
+
+#define PMU_LL(op)	(PERF_COUNT_HW_CACHE_LL | \
+			 ((op) << 8) | \
+			 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+enum pmu_fixed {
+	PMU_CYCLES = 0,
+	PMU_INSTR,
+	PMU_CACHE_REF,
+	PMU_CACHE_MISS,
+	PMU_LL_READ_MISS,
+	PMU_LL_WRITE_MISS,
+	PMU_FAULTS,
+	PMU_FIXED_NUM,
+};
+
+struct pmu_event {
+	char		name[16];
+	uint32_t	type;
+	uint64_t	config;
+};
+
+struct pmu_frame {
+	const char	*pname;
+	long long	ts;
+	double		start[PMU_EVENT_MAX];
+};
+
+struct pmu_thread {
+	int			fd[PMU_EVENT_MAX];
+	int			depth;
+	struct pmu_frame	stack[PMU_DEPTH_MAX];
+};
+
+struct pmu_stage {
+	const char	*pname;
+	unsigned int	calls;
+	long long	time_us;
+	double		sum[PMU_EVENT_MAX];
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct pmu_event	pmu_event[PMU_EVENT_MAX] = {
+	{ "cycles",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES },
+	{ "instr",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS },
+	{ "cache ref",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_REFERENCES },
+	{ "cache miss",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES },
+	{ "LL rd miss",	PERF_TYPE_HW_CACHE,
+			PMU_LL(PERF_COUNT_HW_CACHE_OP_READ) },
+	{ "LL wr miss",	PERF_TYPE_HW_CACHE,
+			PMU_LL(PERF_COUNT_HW_CACHE_OP_WRITE) },
+	{ "faults",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_PAGE_FAULTS },
+};
+static int			pmu_event_num = PMU_FIXED_NUM;
+static bool			pmu_enabled;
+static bool			pmu_available[PMU_EVENT_MAX];
+static pthread_mutex_t		pmu_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pmu_stage		pmu_stage[PMU_STAGE_MAX];
+static int			pmu_stage_num;
+static __thread struct pmu_thread	*ppmu_self;
+static pthread_key_t		pmu_key;	/* frees ppmu_self */
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static long long	pmu_now(void);
+static int	pmu_open(const struct pmu_event *pev);
+static double	pmu_read(int fd);
+static struct pmu_thread	*pmu_thread_get(void);
+static void	pmu_thread_free(void *parg);
+static void	pmu_add(const struct pmu_frame *pframe,
+			const double *pend, long long now);
+static void	pmu_report(void);
+static void	pmu_field(const struct pmu_stage *pst, int ev, double div,
+			  int width);
+
+/******************************************************************************
+ *  setup
+ ******************************************************************************/
+__attribute__((constructor))
+static void pmu_init(void)
+{
+	const char	*p;
+	char		*pend;
+	unsigned long	raw;
+
+	p = getenv("VSP2_PMU");
+	if (p == NULL || p[0] == '\0' || p[0] == '0')
+		return;
+
+	/* VSP2_PMU_RAW=0x19,0x60 */
+	p = getenv("VSP2_PMU_RAW");
+	while (p != NULL && *p != '\0' && pmu_event_num < PMU_EVENT_MAX) {
+		raw = strtoul(p, &pend, 0);
+		if (pend == p)
+			break;
+		snprintf(pmu_event[pmu_event_num].name,
+			 sizeof(pmu_event[0].name), "raw 0x%lx", raw);
+		pmu_event[pmu_event_num].type	= PERF_TYPE_RAW;
+		pmu_event[pmu_event_num].config	= raw;
+		pmu_event_num++;
+		p = (*pend == ',') ? pend + 1 : pend;
+	}
+
+	pthread_key_create(&pmu_key, pmu_thread_free);
+	pmu_enabled = true;
+	atexit(pmu_report);
+}
+
+static int pmu_open(const struct pmu_event *pev)
+{
+	struct perf_event_attr	attr;
+	int			fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size		= sizeof(attr);
+	attr.type		= pev->type;
+	attr.config		= pev->config;
+	attr.exclude_hv		= 1;
+	attr.read_format	= PERF_FORMAT_TOTAL_TIME_ENABLED |
+				  PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+		/* perf_event_paranoid keeps the kernel part out */
+		attr.exclude_kernel = 1;
+		fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+	return fd;
+}
+
+static struct pmu_thread *pmu_thread_get(void)
+{
+	struct pmu_thread	*pthr = ppmu_self;
+	static bool		warned;
+	bool			any = false;
+	int			i;
+
+	if (pthr != NULL)
+		return pthr;
+
+	pthr = calloc(1, sizeof(*pthr));
+	if (pthr == NULL)
+		return NULL;
+	for (i = 0; i < pmu_event_num; i++) {
+		pthr->fd[i] = pmu_open(&pmu_event[i]);
+		if (pthr->fd[i] >= 0) {
+			pmu_available[i] = true;
+			any = true;
+		}
+	}
+	if (!any && !warned) {
+		warned = true;
+		fprintf(stderr, "pmu : perf_event_open failed: %s\n",
+			strerror(errno));
+	}
+	ppmu_self = pthr;
+	pthread_setspecific(pmu_key, pthr);
+	return pthr;
+}
+
+static void pmu_thread_free(void *parg)
+{
+	struct pmu_thread	*pthr = parg;
+	int			i;
+
+	/* a worker thread exits, its finished stages are summed already */
+	for (i = 0; i < pmu_event_num; i++) {
+		if (pthr->fd[i] >= 0)
+			close(pthr->fd[i]);
+	}
+	ppmu_self = NULL;
+	free(pthr);
+}
+
+/******************************************************************************
+ *  stage
+ ******************************************************************************/
+void vsp2_pmu_begin(const char *pname)
+{
+	struct pmu_thread	*pthr;
+	struct pmu_frame	*pframe;
+	int			i;
+
+	if (!pmu_enabled)
+		return;
+	pthr = pmu_thread_get();
+	if (pthr == NULL)
+		return;
+
+	if (pthr->depth < PMU_DEPTH_MAX) {
+		pframe		= &pthr->stack[pthr->depth];
+		pframe->pname	= pname;
+		for (i = 0; i < pmu_event_num; i++)
+			pframe->start[i] = pmu_read(pthr->fd[i]);
+		/* last, so the reads are not part of the stage time */
+		pframe->ts	= pmu_now();
+	}
+	pthr->depth++;
+}
+
+void vsp2_pmu_end(void)
+{
+	struct pmu_thread	*pthr = ppmu_self;
+	double			end[PMU_EVENT_MAX];
+	long long		now;
+	int			i;
+
+	if (!pmu_enabled || pthr == NULL || pthr->depth == 0)
+		return;
+
+	now = pmu_now();
+	pthr->depth--;
+	if (pthr->depth >= PMU_DEPTH_MAX)
+		return;
+
+	for (i = 0; i < pmu_event_num; i++)
+		end[i] = pmu_read(pthr->fd[i]);
+	pmu_add(&pthr->stack[pthr->depth], end, now);
+}
+
+static double pmu_read(int fd)
+{
+	uint64_t	val[3];	/* value, time enabled, time running */
+
+	if (fd < 0 || read(fd, val, sizeof(val)) != sizeof(val) ||
+	    val[2] == 0)
+		return 0;
+	/* scaled up when the pmu was multiplexed between counters */
+	return (double)val[0] * val[1] / val[2];
+}
+
+static long long pmu_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void pmu_add(const struct pmu_frame *pframe,
+		    const double *pend, long long now)
+{
+	struct pmu_stage	*pst = NULL;
+	int			i;
+
+	pthread_mutex_lock(&pmu_lock);
+	for (i = 0; i < pmu_stage_num; i++) {
+		if (strcmp(pmu_stage[i].pname, pframe->pname) == 0) {
+			pst = &pmu_stage[i];
+			break;
+		}
+	}
+	if (pst == NULL && pmu_stage_num < PMU_STAGE_MAX) {
+		pst = &pmu_stage[pmu_stage_num++];
+		pst->pname = pframe->pname;
+	}
+	if (pst != NULL) {
+		pst->calls++;
+		pst->time_us += now - pframe->ts;
+		for (i = 0; i < pmu_event_num; i++)
+			pst->sum[i] += pend[i] - pframe->start[i];
+	}
+	pthread_mutex_unlock(&pmu_lock);
+}
+
+/******************************************************************************
+ *  report
+ ******************************************************************************/
+static void pmu_field(const struct pmu_stage *pst, int ev, double div,
+		      int width)
+{
+	if (pmu_available[ev])
+		fprintf(stderr, " %*.1f", width, pst->sum[ev] / div);
+	else
+		fprintf(stderr, " %*s", width, "-");
+}
+
+static void pmu_report(void)
+{
+	const struct pmu_stage	*pst;
+	double			bytes;
+	int			i, ev;
+
+	/* stages still open at exit end here, as in the trace */
+	while (ppmu_self != NULL && ppmu_self->depth > 0)
+		vsp2_pmu_end();
+
+	fflush(stdout);
+	pthread_mutex_lock(&pmu_lock);
+
+	fprintf(stderr, "pmu : %-16s %6s %9s %8s %8s %5s %6s %8s %8s %7s",
+		"stage", "calls", "ms", "Mcycles", "Minstr", "IPC",
+		"miss%", "LL MB", "MB/s", "faults");
+	for (ev = PMU_FIXED_NUM; ev < pmu_event_num; ev++)
+		fprintf(stderr, " %10s", pmu_event[ev].name);
+	fprintf(stderr, "\n");
+
+	for (i = 0; i < pmu_stage_num; i++) {
+		pst = &pmu_stage[i];
+		fprintf(stderr, "      %-16s %6u %9.2f", pst->pname, pst->calls,
+			pst->time_us / 1000.0);
+		pmu_field(pst, PMU_CYCLES, 1e6, 8);
+		pmu_field(pst, PMU_INSTR, 1e6, 8);
+
+		if (pmu_available[PMU_CYCLES] && pmu_available[PMU_INSTR] &&
+		    pst->sum[PMU_CYCLES] > 0)
+			fprintf(stderr, " %5.2f",
+				pst->sum[PMU_INSTR] / pst->sum[PMU_CYCLES]);
+		else
+			fprintf(stderr, " %5s", "-");
+
+		if (pmu_available[PMU_CACHE_REF] &&
+		    pmu_available[PMU_CACHE_MISS] &&
+		    pst->sum[PMU_CACHE_REF] > 0)
+			fprintf(stderr, " %6.1f", 100.0 *
+				pst->sum[PMU_CACHE_MISS] /
+				pst->sum[PMU_CACHE_REF]);
+		else
+			fprintf(stderr, " %6s", "-");
+
+		/* every last level miss is one line of DRAM traffic */
+		if (pmu_available[PMU_LL_READ_MISS] ||
+		    pmu_available[PMU_LL_WRITE_MISS]) {
+			bytes = (pst->sum[PMU_LL_READ_MISS] +
+				 pst->sum[PMU_LL_WRITE_MISS]) * PMU_LINE_SIZE;
+			fprintf(stderr, " %8.1f %8.1f", bytes / 1e6,
+				pst->time_us > 0 ? bytes / pst->time_us : 0);
+		} else {
+			fprintf(stderr, " %8s %8s", "-", "-");
+		}
+
+		pmu_field(pst, PMU_FAULTS, 1, 7);
+		for (ev = PMU_FIXED_NUM; ev < pmu_event_num; ev++)
+			pmu_field(pst, ev, 1, 10);
+		fprintf(stderr, "\n");
+	}
+
+	pthread_mutex_unlock(&pmu_lock);
+}
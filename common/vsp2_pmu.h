@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  cpu counters : perf_event_open counters read at the start and end of
+ *  each stage, summed per stage name and printed at exit. The stages are
+ *  the vsp2_trace_begin() / vsp2_trace_end() spans.
+ *
+ *    VSP2_PMU=1                 count cycles, instructions, cache and
+ *                               last level cache misses, page faults
+ *    VSP2_PMU_RAW=<ev>[,<ev>]   add raw pmu events, e.g. 0x19 BUS_ACCESS
+ *                               on Cortex-A57
+ ******************************************************************************/
+#ifndef VSP2_PMU_H
+#define VSP2_PMU_H
+
+void	vsp2_pmu_begin(const char *pname);
+void	vsp2_pmu_end(void);
+
+#endif /* VSP2_PMU_H */
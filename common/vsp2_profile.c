@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  tuning profile
+ *  A text file, one entry per line:
+ *
+ *    <module> <w>x<h> <mmap|userptr|dmabuf> <depth> <fps> <kernel>
+ *
+ *  A save reads the file, drops the entry it replaces and writes the file
+ *  again through a rename, so a reader never sees half of it.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/utsname.h>
+#include <linux/videodev2.h>
+
+#include "vsp2_media.h"
+#include "vsp2_profile.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define PROFILE_LINE_LEN	(256)
+#define PROFILE_LINE_MAX	(64)
+#define PROFILE_PATH_LEN	(256)
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	profile_path(const char *pdevnode, char *ppath, size_t len,
+			     char *pbus, size_t bus_len);
+static int	parse_line(const char *pline, struct vsp2_profile *pprof);
+static unsigned int	parse_memory(const char *pname);
+static void	get_kernel(char *pkernel, size_t len);
+
+/******************************************************************************
+ *  interface
+ ******************************************************************************/
+int vsp2_profile_load(const char *pdevnode, const char *pmodule,
+		      unsigned int width, unsigned int height,
+		      struct vsp2_profile *pprof)
+{
+	struct vsp2_profile	prof;
+	char			path[PROFILE_PATH_LEN];
+	char			line[PROFILE_LINE_LEN];
+	char			kernel[VSP2_PROFILE_KERNEL_LEN];
+	FILE			*fp;
+	int			ret = -1;
+
+	if (profile_path(pdevnode, path, sizeof(path), NULL, 0) < 0)
+		return -1;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	errno = ENOENT;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (parse_line(line, &prof) < 0)
+			continue;
+		if (strcmp(prof.module, pmodule) != 0 ||
+		    prof.width != width || prof.height != height)
+			continue;
+
+		/* the best choice moves with the kernel */
+		*pprof = prof;
+		get_kernel(kernel, sizeof(kernel));
+		if (strcmp(prof.kernel, kernel) != 0) {
+			printf("profile : %s %ux%u tuned on kernel %s, not %s;"
+			       " not used\n", pmodule, width, height,
+			       prof.kernel, kernel);
+			errno = ESTALE;
+		} else {
+			ret = 0;
+		}
+		break;
+	}
+	fclose(fp);
+	return ret;
+}
+
+int vsp2_profile_save(const char *pdevnode, struct vsp2_profile *pprof)
+{
+	struct vsp2_profile	prof;
+	char			path[PROFILE_PATH_LEN];
+	char			tmp[PROFILE_PATH_LEN + 8];
+	char			bus[32];
+	char			(*plines)[PROFILE_LINE_LEN];
+	FILE			*fp;
+	int			line_num = 0;
+	int			ret = -1;
+	int			i;
+
+	if (profile_path(pdevnode, path, sizeof(path), bus, sizeof(bus)) < 0)
+		return -1;
+	get_kernel(pprof->kernel, sizeof(pprof->kernel));
+
+	plines = calloc(PROFILE_LINE_MAX, PROFILE_LINE_LEN);
+	if (plines == NULL)
+		return -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Entries kept : every other module and size                       */
+	/*-------------------------------------------------------------------*/
+	fp = fopen(path, "r");
+	if (fp != NULL) {
+		while (line_num < PROFILE_LINE_MAX - 1 &&
+		       fgets(plines[line_num], PROFILE_LINE_LEN, fp) != NULL) {
+			if (parse_line(plines[line_num], &prof) < 0)
+				continue;
+			if (strcmp(prof.module, pprof->module) == 0 &&
+			    prof.width == pprof->width &&
+			    prof.height == pprof->height)
+				continue;
+			line_num++;
+		}
+		fclose(fp);
+	}
+
+	snprintf(plines[line_num++], PROFILE_LINE_LEN,
+		 "%s %ux%u %s %u %.1f %s\n", pprof->module, pprof->width,
+		 pprof->height, vsp2_profile_memory_name(pprof->memory),
+		 pprof->depth, pprof->fps, pprof->kernel);
+
+	/*-------------------------------------------------------------------*/
+	/*  Written aside, then put in place                                 */
+	/*-------------------------------------------------------------------*/
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		printf("Error : fopen(%s) errno=(%d)\n", tmp, errno);
+		goto out;
+	}
+	fprintf(fp, "# vsp2 profile : %s\n", bus);
+	fprintf(fp, "# module size memory depth fps kernel\n");
+	for (i = 0; i < line_num; i++)
+		fputs(plines[i], fp);
+	if (fclose(fp) != 0 || rename(tmp, path) < 0) {
+		printf("Error : write %s errno=(%d)\n", path, errno);
+		remove(tmp);
+		goto out;
+	}
+	ret = 0;
+
+out:
+	free(plines);
+	return ret;
+}
+
+const char *vsp2_profile_memory_name(unsigned int memory)
+{
+	switch (memory) {
+	case V4L2_MEMORY_MMAP:
+		return "mmap";
+	case V4L2_MEMORY_USERPTR:
+		return "userptr";
+	case V4L2_MEMORY_DMABUF:
+		return "dmabuf";
+	default:
+		return "-";
+	}
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int profile_path(const char *pdevnode, char *ppath, size_t len,
+			char *pbus, size_t bus_len)
+{
+	struct vsp2_media	*pmedia;
+	const char		*pdir;
+	const char		*p;
+	char			bus[32];
+
+	/* the bus name stays with the VSP, the node number may not */
+	pmedia = vsp2_media_open(pdevnode);
+	if (pmedia != NULL && vsp2_media_bus_name(pmedia)[0] != '\0') {
+		snprintf(bus, sizeof(bus), "%s", vsp2_media_bus_name(pmedia));
+	} else {
+		p = strrchr(pdevnode, '/');
+		snprintf(bus, sizeof(bus), "%s", p ? p + 1 : pdevnode);
+	}
+	vsp2_media_close(pmedia);
+
+	pdir = getenv("VSP2_PROFILE_DIR");
+	if (pdir == NULL || pdir[0] == '\0')
+		pdir = ".";
+	if (snprintf(ppath, len, "%s/vsp2_%s.profile", pdir, bus) >=
+	    (int)len) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if (pbus != NULL)
+		snprintf(pbus, bus_len, "%s", bus);
+	return 0;
+}
+
+static int parse_line(const char *pline, struct vsp2_profile *pprof)
+{
+	char	memory[16];
+
+	if (pline[0] == '#')
+		return -1;
+
+	memset(pprof, 0, sizeof(*pprof));
+	if (sscanf(pline, "%31s %ux%u %15s %u %lf %64s", pprof->module,
+		   &pprof->width, &pprof->height, memory, &pprof->depth,
+		   &pprof->fps, pprof->kernel) != 7)
+		return -1;
+
+	pprof->memory = parse_memory(memory);
+	if (pprof->memory == 0 || pprof->depth == 0)
+		return -1;
+	return 0;
+}
+
+static unsigned int parse_memory(const char *pname)
+{
+	if (strcmp(pname, "mmap") == 0)
+		return V4L2_MEMORY_MMAP;
+	if (strcmp(pname, "userptr") == 0)
+		return V4L2_MEMORY_USERPTR;
+	if (strcmp(pname, "dmabuf") == 0)
+		return V4L2_MEMORY_DMABUF;
+	return 0;
+}
+
+static void get_kernel(char *pkernel, size_t len)
+{
+	struct utsname	uts;
+
+	if (uname(&uts) != 0)
+		snprintf(pkernel, len, "unknown");
+	else
+		snprintf(pkernel, len, "%s", uts.release);
+}
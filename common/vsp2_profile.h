@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  tuning profile : the memory type and queue depth that ran a pipeline
+ *  fastest on one VSP, as found by tune/v4l2_tune_tp. There is one file
+ *  per VSP, named after its bus name so that a renumbered /dev/media
+ *  keeps its profile, with one line per module and source size.
+ *
+ *    VSP2_PROFILE_DIR=<dir>  where the profiles are [current directory]
+ *
+ *  An entry holds the kernel it was measured on; loaded on another, it is
+ *  not used.
+ ******************************************************************************/
+#ifndef VSP2_PROFILE_H
+#define VSP2_PROFILE_H
+
+#define VSP2_PROFILE_MODULE_LEN	(32)
+#define VSP2_PROFILE_KERNEL_LEN	(65)
+
+struct vsp2_profile {
+	char		module[VSP2_PROFILE_MODULE_LEN];  /* "lut",
+							   * "uds:1920x1080" */
+	unsigned int	width;		/* source */
+	unsigned int	height;
+	unsigned int	memory;		/* V4L2_MEMORY_MMAP, USERPTR, DMABUF */
+	unsigned int	depth;		/* frames in flight */
+	double		fps;
+	char		kernel[VSP2_PROFILE_KERNEL_LEN];
+};
+
+/* 0 : found; -1 with errno ENOENT (no entry) or ESTALE (other kernel,
+ * *pprof filled all the same) */
+int	vsp2_profile_load(const char *pdevnode, const char *pmodule,
+			  unsigned int width, unsigned int height,
+			  struct vsp2_profile *pprof);
+/* replaces the entry of the same module and size; the kernel is filled in */
+int	vsp2_profile_save(const char *pdevnode, struct vsp2_profile *pprof);
+
+/* "mmap", "userptr", "dmabuf" */
+const char	*vsp2_profile_memory_name(unsigned int memory);
+
+#endif /* VSP2_PROFILE_H */
@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  run record
+ *  Nodes are known by fd: their format, memory type, queue depth and
+ *  bytes come from S_FMT, REQBUFS, QBUF and DQBUF. A frame's latency
+ *  runs from the QBUF of its oldest input buffer to the DQBUF of its
+ *  output; the device completes in order, so each input node keeps a
+ *  FIFO of queue times. Nodes belong to the pipeline of their media
+ *  device, and an output only takes from the FIFOs of its own pipeline;
+ *  nodes not opened through the media layer share pipeline 0. Every span
+ *  and ioctl name is a phase with its durations kept for the percentiles.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/utsname.h>
+#include <linux/videodev2.h>
+
+#include "vsp2_result.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define RESULT_FD_MAX		(256)
+#define RESULT_PHASE_MAX	(64)
+#define RESULT_SAMPLE_MAX	(1 << 16)	/* per phase */
+#define RESULT_SAMPLE_GROW	(256)
+#define RESULT_FIFO_NUM		(64)		/* queued input buffers */
+#define RESULT_DEPTH_MAX	(16)
+#define RESULT_LINKS_LEN	(512)
+#define RESULT_PIPE_MAX		(16)		/* 0 : not a media node */
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct result_pipe {
+	char			devnode[64];
+	char			bus[32];
+	char			links[RESULT_LINKS_LEN];
+	unsigned int		frames;
+};
+
+struct result_node {
+	bool			used;
+	int			pipe;
+	char			entity[24];
+	unsigned int		type;		/* 0 : format not set */
+	unsigned int		pixelformat;
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		planes;
+	unsigned long		sizeimage;
+	unsigned int		memory;
+	unsigned int		count;
+	unsigned int		qbuf;
+	unsigned int		dqbuf;
+	unsigned long long	bytes;
+	long long		fifo[RESULT_FIFO_NUM];	/* QBUF time */
+	int			fifo_head;
+	int			fifo_num;
+};
+
+struct result_phase {
+	char		name[40];
+	unsigned int	calls;
+	long long	sum;
+	long long	*psample;	/* first RESULT_SAMPLE_MAX calls */
+	int		num;
+	int		cap;
+};
+
+struct result_span {
+	const char	*pname;
+	long long	ts;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static bool			result_enabled;
+static const char		*presult_file;
+static pthread_mutex_t		result_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct result_node	result_node[RESULT_FD_MAX];
+static struct result_phase	result_phase[RESULT_PHASE_MAX];
+static int			result_phase_num;
+static struct v4l2_capability	result_cap;
+static struct result_pipe	result_pipe[RESULT_PIPE_MAX];
+static int			result_pipe_num = 1;
+static long long		result_first_qbuf;
+static long long		result_last_dqbuf;
+static unsigned int		result_frames;
+static __thread struct result_span	result_stack[RESULT_DEPTH_MAX];
+static __thread int			result_depth;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static long long	result_now(void);
+static struct result_node	*result_node_get(int fd);
+static int	result_pipe_get(const char *pdevnode);
+static void	result_phase_add(const char *pname, long long us);
+static unsigned long long	result_buf_bytes(const struct v4l2_buffer *pbuf);
+static void	result_qbuf(struct result_node *pnode,
+			    const struct v4l2_buffer *pbuf, long long now);
+static void	result_dqbuf(struct result_node *pnode,
+			     const struct v4l2_buffer *pbuf, long long now);
+static void	result_write(void);
+static void	write_str(FILE *fp, const char *pstr);
+static void	write_node(FILE *fp, const struct result_node *pnode);
+static void	write_phase(FILE *fp, struct result_phase *pphase);
+static int	cmp_sample(const void *pa, const void *pb);
+
+/******************************************************************************
+ *  setup
+ ******************************************************************************/
+__attribute__((constructor))
+static void result_init(void)
+{
+	presult_file = getenv("VSP2_RESULT");
+	if (presult_file == NULL || presult_file[0] == '\0')
+		return;
+
+	result_enabled = true;
+	atexit(result_write);
+}
+
+bool vsp2_result_active(void)
+{
+	return result_enabled;
+}
+
+/******************************************************************************
+ *  collect
+ ******************************************************************************/
+void vsp2_result_ioctl(int fd, unsigned long request, void *parg, int ret,
+		       const char *pname, long long dur_us)
+{
+	struct v4l2_format		*pfmt = parg;
+	struct v4l2_requestbuffers	*preq = parg;
+	struct result_node		*pnode;
+	long long			now;
+	unsigned int			i;
+
+	if (!result_enabled)
+		return;
+	now = result_now();
+
+	pthread_mutex_lock(&result_lock);
+	result_phase_add(pname, dur_us);
+	pnode = result_node_get(fd);
+	if (ret != 0 || pnode == NULL)
+		goto out;
+
+	switch (request) {
+	case VIDIOC_QUERYCAP:
+		if (result_cap.driver[0] == '\0')
+			result_cap = *(struct v4l2_capability *)parg;
+		break;
+	case VIDIOC_S_FMT:
+		pnode->type = pfmt->type;
+		if (V4L2_TYPE_IS_MULTIPLANAR(pfmt->type)) {
+			pnode->pixelformat	= pfmt->fmt.pix_mp.pixelformat;
+			pnode->width		= pfmt->fmt.pix_mp.width;
+			pnode->height		= pfmt->fmt.pix_mp.height;
+			pnode->planes		= pfmt->fmt.pix_mp.num_planes;
+			pnode->sizeimage	= 0;
+			for (i = 0; i < pnode->planes &&
+				    i < VIDEO_MAX_PLANES; i++)
+				pnode->sizeimage +=
+				    pfmt->fmt.pix_mp.plane_fmt[i].sizeimage;
+		} else {
+			pnode->pixelformat	= pfmt->fmt.pix.pixelformat;
+			pnode->width		= pfmt->fmt.pix.width;
+			pnode->height		= pfmt->fmt.pix.height;
+			pnode->planes		= 1;
+			pnode->sizeimage	= pfmt->fmt.pix.sizeimage;
+		}
+		break;
+	case VIDIOC_REQBUFS:
+		/* count 0 frees the queue at the end of the run */
+		if (preq->count == 0)
+			break;
+		pnode->memory	= preq->memory;
+		pnode->count	= preq->count;
+		break;
+	case VIDIOC_QBUF:
+		result_qbuf(pnode, parg, now);
+		break;
+	case VIDIOC_DQBUF:
+		result_dqbuf(pnode, parg, now);
+		break;
+	default:
+		break;
+	}
+out:
+	pthread_mutex_unlock(&result_lock);
+}
+
+void vsp2_result_span_begin(const char *pname)
+{
+	if (!result_enabled)
+		return;
+	if (result_depth < RESULT_DEPTH_MAX) {
+		result_stack[result_depth].pname	= pname;
+		result_stack[result_depth].ts		= result_now();
+	}
+	result_depth++;
+}
+
+void vsp2_result_span_end(void)
+{
+	long long now;
+
+	if (!result_enabled || result_depth == 0)
+		return;
+
+	now = result_now();
+	result_depth--;
+	if (result_depth >= RESULT_DEPTH_MAX)
+		return;
+
+	pthread_mutex_lock(&result_lock);
+	result_phase_add(result_stack[result_depth].pname,
+			 now - result_stack[result_depth].ts);
+	pthread_mutex_unlock(&result_lock);
+}
+
+void vsp2_result_media(const char *pdevnode, const char *pbus,
+		       const char *plinks)
+{
+	struct result_pipe *ppipe;
+
+	if (!result_enabled)
+		return;
+
+	pthread_mutex_lock(&result_lock);
+	ppipe = &result_pipe[result_pipe_get(pdevnode)];
+	if (ppipe != &result_pipe[0]) {
+		snprintf(ppipe->bus, sizeof(ppipe->bus), "%s", pbus);
+		snprintf(ppipe->links, sizeof(ppipe->links), "%s", plinks);
+	}
+	pthread_mutex_unlock(&result_lock);
+}
+
+void vsp2_result_node(int fd, const char *pdevnode, const char *pentity)
+{
+	if (!result_enabled || fd < 0 || fd >= RESULT_FD_MAX)
+		return;
+
+	/* a new open of a reused fd number starts over */
+	pthread_mutex_lock(&result_lock);
+	memset(&result_node[fd], 0, sizeof(result_node[fd]));
+	result_node[fd].used = true;
+	result_node[fd].pipe = result_pipe_get(pdevnode);
+	snprintf(result_node[fd].entity, sizeof(result_node[fd].entity),
+		 "%s", pentity);
+	pthread_mutex_unlock(&result_lock);
+}
+
+static void result_qbuf(struct result_node *pnode,
+			const struct v4l2_buffer *pbuf, long long now)
+{
+	pnode->qbuf++;
+	if (result_first_qbuf == 0)
+		result_first_qbuf = now;
+	if (!V4L2_TYPE_IS_OUTPUT(pbuf->type))
+		return;
+
+	pnode->bytes += result_buf_bytes(pbuf);
+	if (pnode->fifo_num < RESULT_FIFO_NUM) {
+		pnode->fifo[(pnode->fifo_head + pnode->fifo_num) %
+			    RESULT_FIFO_NUM] = now;
+		pnode->fifo_num++;
+	}
+}
+
+static void result_dqbuf(struct result_node *pnode,
+			 const struct v4l2_buffer *pbuf, long long now)
+{
+	struct result_node	*pin;
+	long long		oldest = 0;
+	int			fd;
+
+	pnode->dqbuf++;
+	if (V4L2_TYPE_IS_OUTPUT(pbuf->type))
+		return;
+
+	pnode->bytes += result_buf_bytes(pbuf);
+	result_pipe[pnode->pipe].frames++;
+	result_frames++;
+	result_last_dqbuf = now;
+
+	/* one buffer of every input of this pipeline went into this frame */
+	for (fd = 0; fd < RESULT_FD_MAX; fd++) {
+		pin = &result_node[fd];
+		if (!pin->used || pin->pipe != pnode->pipe ||
+		    pin->fifo_num == 0)
+			continue;
+		if (oldest == 0 || pin->fifo[pin->fifo_head] < oldest)
+			oldest = pin->fifo[pin->fifo_head];
+		pin->fifo_head = (pin->fifo_head + 1) % RESULT_FIFO_NUM;
+		pin->fifo_num--;
+	}
+	if (oldest != 0)
+		result_phase_add("frame", now - oldest);
+}
+
+/******************************************************************************
+ *  helpers
+ ******************************************************************************/
+static long long result_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct result_node *result_node_get(int fd)
+{
+	if (fd < 0 || fd >= RESULT_FD_MAX)
+		return NULL;
+	/* nodes not opened through the media layer are counted as well */
+	result_node[fd].used = true;
+	return &result_node[fd];
+}
+
+/* the pipeline of a media device node, 0 when out of slots */
+static int result_pipe_get(const char *pdevnode)
+{
+	int i;
+
+	for (i = 1; i < result_pipe_num; i++) {
+		if (strcmp(result_pipe[i].devnode, pdevnode) == 0)
+			return i;
+	}
+	if (result_pipe_num == RESULT_PIPE_MAX)
+		return 0;
+	snprintf(result_pipe[i].devnode, sizeof(result_pipe[i].devnode),
+		 "%s", pdevnode);
+	return result_pipe_num++;
+}
+
+static void result_phase_add(const char *pname, long long us)
+{
+	struct result_phase	*pphase = NULL;
+	long long		*p;
+	int			i;
+
+	for (i = 0; i < result_phase_num; i++) {
+		if (strcmp(result_phase[i].name, pname) == 0) {
+			pphase = &result_phase[i];
+			break;
+		}
+	}
+	if (pphase == NULL) {
+		if (result_phase_num == RESULT_PHASE_MAX)
+			return;
+		pphase = &result_phase[result_phase_num++];
+		snprintf(pphase->name, sizeof(pphase->name), "%s", pname);
+	}
+
+	pphase->calls++;
+	pphase->sum += us;
+	if (pphase->num == RESULT_SAMPLE_MAX)
+		return;
+	if (pphase->num == pphase->cap) {
+		p = realloc(pphase->psample, (pphase->cap + RESULT_SAMPLE_GROW) *
+			    sizeof(*p));
+		if (p == NULL)
+			return;
+		pphase->psample	= p;
+		pphase->cap	+= RESULT_SAMPLE_GROW;
+	}
+	pphase->psample[pphase->num++] = us;
+}
+
+static unsigned long long result_buf_bytes(const struct v4l2_buffer *pbuf)
+{
+	unsigned long long	bytes = 0;
+	unsigned int		i;
+
+	if (!V4L2_TYPE_IS_MULTIPLANAR(pbuf->type))
+		return pbuf->bytesused ? pbuf->bytesused : pbuf->length;
+
+	for (i = 0; i < pbuf->length && i < VIDEO_MAX_PLANES; i++)
+		bytes += pbuf->m.planes[i].bytesused ?
+			 pbuf->m.planes[i].bytesused :
+			 pbuf->m.planes[i].length;
+	return bytes;
+}
+
+/******************************************************************************
+ *  output
+ ******************************************************************************/
+static void result_write(void)
+{
+	static const char	*pmemory[] = {
+		"", "mmap", "userptr", "overlay", "dmabuf",
+	};
+	struct result_node	*pnode;
+	struct utsname		uts;
+	struct tm		tm;
+	time_t			t;
+	char			stamp[32];
+	char			args[256];
+	unsigned long long	bytes = 0;
+	unsigned long long	pixels = 0;
+	double			elapsed_s = 0;
+	FILE			*fp;
+	bool			first;
+	ssize_t			len;
+	int			fd, i;
+
+	/* spans still open at exit end here, as in the trace */
+	while (result_depth > 0)
+		vsp2_result_span_end();
+
+	fp = fopen(presult_file, "a");
+	if (fp == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return;
+	}
+
+	t = time(NULL);
+	gmtime_r(&t, &tm);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &tm);
+	if (uname(&uts) != 0)
+		memset(&uts, 0, sizeof(uts));
+
+	/* arguments without argv[0], NULs to spaces */
+	args[0] = '\0';
+	fd = open("/proc/self/cmdline", O_RDONLY);
+	if (fd >= 0) {
+		len = read(fd, args, sizeof(args) - 1);
+		close(fd);
+		args[len > 0 ? len : 0] = '\0';
+		for (i = 0; i < len - 1; i++) {
+			if (args[i] == '\0')
+				args[i] = ' ';
+		}
+	}
+
+	pthread_mutex_lock(&result_lock);
+
+	fprintf(fp, "{\"tool\":");
+	write_str(fp, program_invocation_short_name);
+	fprintf(fp, ",\"args\":");
+	write_str(fp, strchr(args, ' ') ? strchr(args, ' ') + 1 : "");
+	fprintf(fp, ",\"time\":\"%s\",\"kernel\":", stamp);
+	write_str(fp, uts.release);
+	fprintf(fp, ",\"machine\":");
+	write_str(fp, uts.machine);
+
+	fprintf(fp, ",\"driver\":{\"name\":");
+	write_str(fp, (const char *)result_cap.driver);
+	fprintf(fp, ",\"card\":");
+	write_str(fp, (const char *)result_cap.card);
+	fprintf(fp, ",\"version\":\"%u.%u.%u\"}",
+		(result_cap.version >> 16) & 0xff,
+		(result_cap.version >> 8) & 0xff, result_cap.version & 0xff);
+
+	fprintf(fp, ",\"vsp\":[");
+	for (i = 1; i < result_pipe_num; i++) {
+		fprintf(fp, "%s{\"media\":", i > 1 ? "," : "");
+		write_str(fp, result_pipe[i].devnode);
+		fprintf(fp, ",\"bus\":");
+		write_str(fp, result_pipe[i].bus);
+		fprintf(fp, ",\"pipeline\":");
+		write_str(fp, result_pipe[i].links);
+		fprintf(fp, ",\"frames\":%u}", result_pipe[i].frames);
+	}
+	fprintf(fp, "]");
+
+	fprintf(fp, ",\"nodes\":[");
+	first = true;
+	for (fd = 0; fd < RESULT_FD_MAX; fd++) {
+		pnode = &result_node[fd];
+		if (!pnode->used || pnode->type == 0)
+			continue;
+		if (!first)
+			fprintf(fp, ",");
+		first = false;
+		write_node(fp, pnode);
+		fprintf(fp, ",\"media\":");
+		write_str(fp, result_pipe[pnode->pipe].devnode);
+		fprintf(fp, ",\"memory\":\"%s\"}",
+			pnode->memory < 5 ? pmemory[pnode->memory] : "");
+
+		bytes += pnode->bytes;
+		if (!V4L2_TYPE_IS_OUTPUT(pnode->type))
+			pixels += (unsigned long long)pnode->width *
+				  pnode->height * pnode->dqbuf;
+	}
+	fprintf(fp, "]");
+
+	if (result_last_dqbuf > result_first_qbuf)
+		elapsed_s = (result_last_dqbuf - result_first_qbuf) / 1e6;
+	fprintf(fp, ",\"frames\":%u,\"elapsed_ms\":%.3f,\"bytes_moved\":%llu",
+		result_frames, elapsed_s * 1000, bytes);
+	fprintf(fp, ",\"fps\":%.2f,\"mpix_s\":%.2f,\"mb_s\":%.2f",
+		elapsed_s > 0 ? result_frames / elapsed_s : 0,
+		elapsed_s > 0 ? pixels / elapsed_s / 1e6 : 0,
+		elapsed_s > 0 ? bytes / elapsed_s / 1e6 : 0);
+
+	fprintf(fp, ",\"phases\":{");
+	for (i = 0; i < result_phase_num; i++) {
+		if (i > 0)
+			fprintf(fp, ",");
+		write_phase(fp, &result_phase[i]);
+	}
+	fprintf(fp, "}}\n");
+
+	pthread_mutex_unlock(&result_lock);
+	fclose(fp);
+}
+
+static void write_str(FILE *fp, const char *pstr)
+{
+	fputc('"', fp);
+	for (; *pstr != '\0'; pstr++) {
+		if (*pstr == '"' || *pstr == '\\')
+			fprintf(fp, "\\%c", *pstr);
+		else if ((unsigned char)*pstr < 0x20)
+			fprintf(fp, "\\u%04x", *pstr);
+		else
+			fputc(*pstr, fp);
+	}
+	fputc('"', fp);
+}
+
+/* left open for the caller to add fields */
+static void write_node(FILE *fp, const struct result_node *pnode)
+{
+	fprintf(fp, "{\"node\":");
+	write_str(fp, pnode->entity);
+	fprintf(fp, ",\"type\":\"%s\",\"format\":\"%c%c%c%c\"",
+		V4L2_TYPE_IS_OUTPUT(pnode->type) ? "output" : "capture",
+		pnode->pixelformat & 0xff, (pnode->pixelformat >> 8) & 0xff,
+		(pnode->pixelformat >> 16) & 0xff,
+		(pnode->pixelformat >> 24) & 0xff);
+	fprintf(fp, ",\"width\":%u,\"height\":%u,\"planes\":%u"
+		",\"sizeimage\":%lu,\"queue_depth\":%u,\"qbuf\":%u"
+		",\"dqbuf\":%u,\"bytes\":%llu",
+		pnode->width, pnode->height, pnode->planes, pnode->sizeimage,
+		pnode->count, pnode->qbuf, pnode->dqbuf, pnode->bytes);
+}
+
+static void write_phase(FILE *fp, struct result_phase *pphase)
+{
+	long long	*ps = pphase->psample;
+	int		n = pphase->num;
+
+	/* nearest rank on the kept samples */
+	if (n > 0)
+		qsort(ps, n, sizeof(*ps), cmp_sample);
+	write_str(fp, pphase->name);
+	fprintf(fp, ":{\"n\":%u,\"mean_us\":%.1f", pphase->calls,
+		pphase->calls ? (double)pphase->sum / pphase->calls : 0);
+	if (n > 0)
+		fprintf(fp, ",\"p50_us\":%lld,\"p90_us\":%lld,\"p99_us\":%lld"
+			",\"max_us\":%lld",
+			ps[(n * 50 + 99) / 100 - 1], ps[(n * 90 + 99) / 100 - 1],
+			ps[(n * 99 + 99) / 100 - 1], ps[n - 1]);
+	fprintf(fp, "}");
+}
+
+static int cmp_sample(const void *pa, const void *pb)
+{
+	long long a = *(const long long *)pa;
+	long long b = *(const long long *)pb;
+
+	return (a > b) - (a < b);
+}
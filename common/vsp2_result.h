@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  run record : one JSON object per run, appended as one line to the file
+ *  named by VSP2_RESULT=<file>, for diffing runs across kernel and driver
+ *  versions.
+ *
+ *  The record is collected from the trace wrappers (ioctls and spans) and
+ *  the media layer (instance, links, nodes); the tools make no calls.
+ ******************************************************************************/
+#ifndef VSP2_RESULT_H
+#define VSP2_RESULT_H
+
+#include <stdbool.h>
+
+bool	vsp2_result_active(void);
+void	vsp2_result_ioctl(int fd, unsigned long request, void *parg, int ret,
+			  const char *pname, long long dur_us);
+void	vsp2_result_span_begin(const char *pname);
+void	vsp2_result_span_end(void);
+/* one pipeline per media device node */
+void	vsp2_result_media(const char *pdevnode, const char *pbus,
+			  const char *plinks);
+void	vsp2_result_node(int fd, const char *pdevnode, const char *pentity);
+
+#endif /* VSP2_RESULT_H */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  spsc ring
+ *  head is written by the consumer only, tail by the producer only; each
+ *  side keeps a cached copy of the other index and reloads it only when
+ *  the ring looks full or empty. Both indexes run freely and are masked
+ *  on access.
+ *
+ *  armed is the sleep handshake : the consumer sets it and rechecks tail,
+ *  the producer publishes tail and checks armed, with a full fence on
+ *  both sides, so one of them always sees the other.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "vsp2_ring.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define RING_LINE		(64)		/* cache line */
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_ring {
+	/* producer */
+	_Atomic unsigned int	tail __attribute__((aligned(RING_LINE)));
+	unsigned int		head_cache;
+	unsigned long long	pushed;
+	unsigned long long	signals;
+
+	/* consumer */
+	_Atomic unsigned int	head __attribute__((aligned(RING_LINE)));
+	unsigned int		tail_cache;
+
+	/* shared, read mostly */
+	_Atomic int		armed __attribute__((aligned(RING_LINE)));
+	unsigned int		mask;
+	int			evfd;
+	void			**pslot;
+};
+
+/******************************************************************************
+ *  interface
+ ******************************************************************************/
+struct vsp2_ring *vsp2_ring_new(unsigned int size)
+{
+	struct vsp2_ring	*pring;
+	unsigned int		num = 1;
+
+	while (num < size)
+		num <<= 1;
+
+	if (posix_memalign((void **)&pring, RING_LINE, sizeof(*pring)) != 0)
+		return NULL;
+	memset(pring, 0, sizeof(*pring));
+
+	pring->mask	= num - 1;
+	pring->pslot	= calloc(num, sizeof(*pring->pslot));
+	pring->evfd	= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (pring->pslot == NULL || pring->evfd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		vsp2_ring_free(pring);
+		return NULL;
+	}
+	return pring;
+}
+
+void vsp2_ring_free(struct vsp2_ring *pring)
+{
+	if (pring == NULL)
+		return;
+	if (pring->evfd >= 0)
+		close(pring->evfd);
+	free(pring->pslot);
+	free(pring);
+}
+
+bool vsp2_ring_push(struct vsp2_ring *pring, void *pitem)
+{
+	unsigned int	tail;
+	uint64_t	val = 1;
+	ssize_t		ret;
+
+	tail = atomic_load_explicit(&pring->tail, memory_order_relaxed);
+	if (tail - pring->head_cache > pring->mask) {
+		pring->head_cache = atomic_load_explicit(&pring->head,
+							 memory_order_acquire);
+		if (tail - pring->head_cache > pring->mask)
+			return false;
+	}
+
+	pring->pslot[tail & pring->mask] = pitem;
+	atomic_store_explicit(&pring->tail, tail + 1, memory_order_release);
+	pring->pushed++;
+
+	/* wake the consumer only when it went to sleep */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&pring->armed, memory_order_relaxed) &&
+	    atomic_exchange_explicit(&pring->armed, 0,
+				     memory_order_relaxed)) {
+		ret = write(pring->evfd, &val, sizeof(val));
+		(void)ret;
+		pring->signals++;
+	}
+	return true;
+}
+
+void vsp2_ring_kick(struct vsp2_ring *pring)
+{
+	uint64_t	val = 1;
+	ssize_t		ret;
+
+	ret = write(pring->evfd, &val, sizeof(val));
+	(void)ret;
+}
+
+void *vsp2_ring_pop(struct vsp2_ring *pring)
+{
+	unsigned int	head;
+	void		*pitem;
+
+	head = atomic_load_explicit(&pring->head, memory_order_relaxed);
+	if (head == pring->tail_cache) {
+		pring->tail_cache = atomic_load_explicit(&pring->tail,
+							 memory_order_acquire);
+		if (head == pring->tail_cache)
+			return NULL;
+	}
+
+	pitem = pring->pslot[head & pring->mask];
+	atomic_store_explicit(&pring->head, head + 1, memory_order_release);
+	return pitem;
+}
+
+int vsp2_ring_fd(struct vsp2_ring *pring)
+{
+	return pring->evfd;
+}
+
+bool vsp2_ring_arm(struct vsp2_ring *pring)
+{
+	unsigned int head;
+
+	head = atomic_load_explicit(&pring->head, memory_order_relaxed);
+	atomic_store_explicit(&pring->armed, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* an item that raced with arming is taken instead of sleeping */
+	if (atomic_load_explicit(&pring->tail, memory_order_acquire) != head) {
+		atomic_store_explicit(&pring->armed, 0, memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+void vsp2_ring_disarm(struct vsp2_ring *pring)
+{
+	uint64_t	val;
+	ssize_t		ret;
+
+	atomic_store_explicit(&pring->armed, 0, memory_order_relaxed);
+	ret = read(pring->evfd, &val, sizeof(val));
+	(void)ret;
+}
+
+void vsp2_ring_stat(struct vsp2_ring *pring, unsigned long long *ppushed,
+		    unsigned long long *psignals)
+{
+	*ppushed	= pring->pushed;
+	*psignals	= pring->signals;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  spsc ring : lock-free queue of pointers from exactly one producer
+ *  thread to exactly one consumer thread.
+ *
+ *  A consumer with nothing to do arms the ring and sleeps in poll() on
+ *  vsp2_ring_fd(). The producer writes the eventfd only when it finds the
+ *  consumer armed, so a busy pipeline makes no system call per item.
+ *
+ *    consumer : while ((p = vsp2_ring_pop(r)) != NULL) ...;
+ *               if (vsp2_ring_arm(r)) { poll(); vsp2_ring_disarm(r); }
+ ******************************************************************************/
+#ifndef VSP2_RING_H
+#define VSP2_RING_H
+
+#include <stdbool.h>
+
+struct vsp2_ring;
+
+/* size is rounded up to a power of two */
+struct vsp2_ring	*vsp2_ring_new(unsigned int size);
+void	vsp2_ring_free(struct vsp2_ring *pring);
+
+/* producer side */
+bool	vsp2_ring_push(struct vsp2_ring *pring, void *pitem);
+void	vsp2_ring_kick(struct vsp2_ring *pring);
+
+/* consumer side */
+void	*vsp2_ring_pop(struct vsp2_ring *pring);
+int	vsp2_ring_fd(struct vsp2_ring *pring);
+bool	vsp2_ring_arm(struct vsp2_ring *pring);
+void	vsp2_ring_disarm(struct vsp2_ring *pring);
+
+/* items pushed, eventfd writes they cost */
+void	vsp2_ring_stat(struct vsp2_ring *pring, unsigned long long *ppushed,
+		       unsigned long long *psignals);
+
+#endif /* VSP2_RING_H */
@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  batch scheduler
+ *  A deque is an array filled before the run and only shrinks after it:
+ *  the owner moves head forward, a thief cuts one entry out at or near the
+ *  tail. Jobs take milliseconds, so a mutex per deque is cheap; thieves
+ *  pick their victim from the queued cost, read without the lock.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "vsp2_sched.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define SCHED_PLACE_MAX		(32)		/* distinct need masks */
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct sched_entry {
+	void			*pjob;
+	unsigned int		need;
+	unsigned long long	cost;
+};
+
+struct sched_dev {
+	struct vsp2_sched		*psched;
+	int				index;
+	char				name[16];
+	unsigned int			caps;
+	void				*pctx;
+	pthread_t			thread;
+	bool				joinable;
+
+	/* the deque */
+	pthread_mutex_t			lock;
+	struct sched_entry		*pentry;
+	int				head;
+	int				tail;
+	int				size;
+	_Atomic unsigned long long	queued;		/* cost in the deque */
+
+	/* given is counted by thieves with the lock held, the rest by
+	 * the device thread; all is read after the join */
+	struct vsp2_sched_stat		stat;
+};
+
+struct sched_place {
+	unsigned int	need;
+	unsigned int	count;
+};
+
+struct vsp2_sched {
+	const struct vsp2_sched_ops	*pops;
+	bool				steal;
+	struct sched_dev		dev[VSP2_SCHED_DEV_MAX];
+	int				dev_num;
+	struct sched_place		place[SCHED_PLACE_MAX];
+	int				place_num;
+	long long			t_start;
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void	*sched_main(void *parg);
+static bool	sched_take(struct sched_dev *pdev, struct sched_entry *pent);
+static bool	sched_steal(struct sched_dev *pdev, struct sched_entry *pent);
+static long long	sched_now_us(void);
+
+/******************************************************************************
+ *  owner
+ ******************************************************************************/
+struct vsp2_sched *vsp2_sched_new(const struct vsp2_sched_ops *pops,
+				  bool steal)
+{
+	struct vsp2_sched *psched;
+
+	psched = calloc(1, sizeof(*psched));
+	if (psched == NULL)
+		return NULL;
+
+	psched->pops	= pops;
+	psched->steal	= steal;
+	return psched;
+}
+
+void vsp2_sched_free(struct vsp2_sched *psched)
+{
+	int i;
+
+	if (psched == NULL)
+		return;
+
+	for (i = 0; i < psched->dev_num; i++) {
+		pthread_mutex_destroy(&psched->dev[i].lock);
+		free(psched->dev[i].pentry);
+	}
+	free(psched);
+}
+
+int vsp2_sched_add_device(struct vsp2_sched *psched, const char *pname,
+			  unsigned int caps, void *pctx)
+{
+	struct sched_dev *pdev;
+
+	if (psched->dev_num >= VSP2_SCHED_DEV_MAX) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	pdev = &psched->dev[psched->dev_num];
+	pdev->psched	= psched;
+	pdev->index	= psched->dev_num;
+	pdev->caps	= caps;
+	pdev->pctx	= pctx;
+	snprintf(pdev->name, sizeof(pdev->name), "%s", pname);
+	pthread_mutex_init(&pdev->lock, NULL);
+
+	return psched->dev_num++;
+}
+
+int vsp2_sched_push(struct vsp2_sched *psched, void *pjob, unsigned int need,
+		    unsigned long long cost)
+{
+	struct sched_place	*pplace = NULL;
+	struct sched_entry	*pentry;
+	struct sched_dev	*pdev = NULL;
+	unsigned int		able = 0;
+	unsigned int		nth;
+	int			i;
+
+	for (i = 0; i < psched->dev_num; i++) {
+		if ((need & ~psched->dev[i].caps) == 0)
+			able++;
+	}
+	if (able == 0) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	/* round robin per kind of job over the devices that can run it */
+	for (i = 0; i < psched->place_num; i++) {
+		if (psched->place[i].need == need)
+			pplace = &psched->place[i];
+	}
+	if (pplace == NULL) {
+		if (psched->place_num >= SCHED_PLACE_MAX) {
+			errno = ENOSPC;
+			return -1;
+		}
+		pplace = &psched->place[psched->place_num++];
+		pplace->need = need;
+	}
+
+	nth = pplace->count++ % able;
+	for (i = 0; i < psched->dev_num; i++) {
+		if ((need & ~psched->dev[i].caps) == 0 && nth-- == 0) {
+			pdev = &psched->dev[i];
+			break;
+		}
+	}
+
+	if (pdev->tail == pdev->size) {
+		pentry = realloc(pdev->pentry, (pdev->size * 2 + 16) *
+				 sizeof(*pentry));
+		if (pentry == NULL)
+			return -1;
+		pdev->pentry	= pentry;
+		pdev->size	= pdev->size * 2 + 16;
+	}
+	pdev->pentry[pdev->tail].pjob	= pjob;
+	pdev->pentry[pdev->tail].need	= need;
+	pdev->pentry[pdev->tail].cost	= cost;
+	pdev->tail++;
+	atomic_fetch_add(&pdev->queued, cost);
+
+	return pdev->index;
+}
+
+int vsp2_sched_run(struct vsp2_sched *psched)
+{
+	struct sched_dev	*pdev;
+	int			left = 0;
+	int			ret;
+	int			i;
+
+	psched->t_start = sched_now_us();
+
+	for (i = 0; i < psched->dev_num; i++) {
+		pdev = &psched->dev[i];
+		ret = pthread_create(&pdev->thread, NULL, sched_main, pdev);
+		if (ret != 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, ret);
+			continue;
+		}
+		pthread_setname_np(pdev->thread, pdev->name);
+		pdev->joinable = true;
+	}
+
+	for (i = 0; i < psched->dev_num; i++) {
+		pdev = &psched->dev[i];
+		if (pdev->joinable)
+			pthread_join(pdev->thread, NULL);
+		left += pdev->stat.failed + pdev->tail - pdev->head;
+	}
+	return left;
+}
+
+void vsp2_sched_stat(struct vsp2_sched *psched, int dev,
+		     struct vsp2_sched_stat *pstat)
+{
+	*pstat = psched->dev[dev].stat;
+}
+
+/******************************************************************************
+ *  device thread
+ ******************************************************************************/
+static void *sched_main(void *parg)
+{
+	struct sched_dev		*pdev = parg;
+	struct vsp2_sched		*psched = pdev->psched;
+	const struct vsp2_sched_ops	*pops = psched->pops;
+	struct sched_entry		ent;
+	long long			t_start;
+
+	if (pops->start(pdev->index, pdev->pctx) < 0) {
+		pops->stop(pdev->index, pdev->pctx);
+		return NULL;
+	}
+	pdev->stat.started = true;
+
+	while (sched_take(pdev, &ent) ||
+	       (psched->steal && sched_steal(pdev, &ent))) {
+		t_start = sched_now_us();
+		if (pops->run(pdev->index, pdev->pctx, ent.pjob) < 0)
+			pdev->stat.failed++;
+		pdev->stat.busy_us += sched_now_us() - t_start;
+		pdev->stat.jobs++;
+		pdev->stat.cost += ent.cost;
+		pdev->stat.wall_us = sched_now_us() - psched->t_start;
+	}
+
+	pops->stop(pdev->index, pdev->pctx);
+	return NULL;
+}
+
+static bool sched_take(struct sched_dev *pdev, struct sched_entry *pent)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&pdev->lock);
+	if (pdev->head < pdev->tail) {
+		*pent = pdev->pentry[pdev->head++];
+		atomic_fetch_sub(&pdev->queued, pent->cost);
+		found = true;
+	}
+	pthread_mutex_unlock(&pdev->lock);
+	return found;
+}
+
+static bool sched_steal(struct sched_dev *pdev, struct sched_entry *pent)
+{
+	struct vsp2_sched	*psched = pdev->psched;
+	struct sched_dev	*pvictim;
+	unsigned long long	queued, best;
+	unsigned int		tried = 1 << pdev->index;
+	int			i, v;
+
+	for (;;) {
+		/* the one with the most work left that is not tried yet */
+		v = -1;
+		best = 0;
+		for (i = 0; i < psched->dev_num; i++) {
+			queued = atomic_load(&psched->dev[i].queued);
+			if ((tried & (1 << i)) == 0 && queued > best) {
+				best = queued;
+				v = i;
+			}
+		}
+		if (v < 0)
+			return false;
+		tried |= 1 << v;
+
+		/* from the back, the jobs the owner reaches last */
+		pvictim = &psched->dev[v];
+		pthread_mutex_lock(&pvictim->lock);
+		for (i = pvictim->tail - 1; i >= pvictim->head; i--) {
+			if ((pvictim->pentry[i].need & ~pdev->caps) != 0)
+				continue;
+
+			*pent = pvictim->pentry[i];
+			memmove(&pvictim->pentry[i], &pvictim->pentry[i + 1],
+				(pvictim->tail - i - 1) * sizeof(*pent));
+			pvictim->tail--;
+			atomic_fetch_sub(&pvictim->queued, pent->cost);
+			pvictim->stat.given++;
+			pthread_mutex_unlock(&pvictim->lock);
+
+			pdev->stat.stolen++;
+			return true;
+		}
+		pthread_mutex_unlock(&pvictim->lock);
+	}
+}
+
+static long long sched_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
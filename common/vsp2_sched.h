@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  batch scheduler : runs a fixed list of jobs on a set of devices, one
+ *  thread per device, with work stealing between them.
+ *
+ *  Every device has a capability mask and every job a mask of what it
+ *  needs; a job runs only on a device that has all of it. Jobs are placed
+ *  round robin on the devices able to run them, into one deque per device.
+ *  A device takes from the front of its own deque; once that is empty it
+ *  steals one job from the back of the device with the most queued cost
+ *  that has a job it can run. A device leaves when nothing it can run is
+ *  queued anywhere - jobs never create jobs, so no more can come.
+ *
+ *    owner : vsp2_sched_new(), vsp2_sched_add_device(), vsp2_sched_push(),
+ *            vsp2_sched_run(), vsp2_sched_stat(), vsp2_sched_free()
+ ******************************************************************************/
+#ifndef VSP2_SCHED_H
+#define VSP2_SCHED_H
+
+#include <stdbool.h>
+
+#define VSP2_SCHED_DEV_MAX	(8)
+
+struct vsp2_sched;
+
+struct vsp2_sched_ops {
+	/* device thread; a device whose start() fails runs no job, what it
+	 * was given is left to the others to steal */
+	int	(*start)(int dev, void *pctx);
+	/* 0 : success, -1 : the job failed, the device goes on */
+	int	(*run)(int dev, void *pctx, void *pjob);
+	void	(*stop)(int dev, void *pctx);
+};
+
+struct vsp2_sched_stat {
+	unsigned int		jobs;		/* run here */
+	unsigned int		failed;
+	unsigned int		stolen;		/* taken from other devices */
+	unsigned int		given;		/* taken by other devices */
+	unsigned long long	cost;		/* sum of the jobs run here */
+	long long		busy_us;	/* inside run() */
+	long long		wall_us;	/* run start to the last job */
+	bool			started;
+};
+
+struct vsp2_sched	*vsp2_sched_new(const struct vsp2_sched_ops *pops,
+					bool steal);
+void	vsp2_sched_free(struct vsp2_sched *psched);
+
+/* before vsp2_sched_run(); device index or -1 */
+int	vsp2_sched_add_device(struct vsp2_sched *psched, const char *pname,
+			      unsigned int caps, void *pctx);
+/* device the job was placed on, -1 when no device has the caps */
+int	vsp2_sched_push(struct vsp2_sched *psched, void *pjob,
+			unsigned int need, unsigned long long cost);
+
+/* returns when every device has left; the number of jobs that failed or
+ * were never run, -1 on error */
+int	vsp2_sched_run(struct vsp2_sched *psched);
+void	vsp2_sched_stat(struct vsp2_sched *psched, int dev,
+			struct vsp2_sched_stat *pstat);
+
+#endif /* VSP2_SCHED_H */
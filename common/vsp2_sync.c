@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  dmabuf cpu access
+ *  The exporter may fail the sync with EINTR or EAGAIN while it waits for
+ *  the device's fences; the call is simply made again.
+ ******************************************************************************/
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#include "vsp2_sync.h"
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	sync_ioctl(int dmafd, unsigned long long flags);
+
+/******************************************************************************
+ *  interface
+ ******************************************************************************/
+int vsp2_sync_begin(int dmafd, unsigned int access)
+{
+	return sync_ioctl(dmafd, DMA_BUF_SYNC_START | (access & VSP2_SYNC_RW));
+}
+
+int vsp2_sync_end(int dmafd, unsigned int access)
+{
+	return sync_ioctl(dmafd, DMA_BUF_SYNC_END | (access & VSP2_SYNC_RW));
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int sync_ioctl(int dmafd, unsigned long long flags)
+{
+	struct dma_buf_sync	sync;
+	int			ret;
+
+	if ((flags & VSP2_SYNC_RW) == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	sync.flags = flags;
+	do {
+		ret = ioctl(dmafd, DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+	return ret;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  dmabuf cpu access : DMA_BUF_IOCTL_SYNC around every CPU read or write of
+ *  a buffer the VSP also uses. begin makes what the device wrote visible
+ *  to the CPU, end writes the CPU's lines back before the device reads,
+ *  so the buffer may be mapped cacheable (VSP2_MEM_CACHED=1, vsp2_mem.h).
+ *
+ *    vsp2_sync_begin(src_dmafd, VSP2_SYNC_WRITE);
+ *    read_file(psrc_buf, SRC_SIZE, SRC_FILENAME);
+ *    vsp2_sync_end(src_dmafd, VSP2_SYNC_WRITE);
+ *
+ *  begin and end take the same access; nothing may be queued to the VSP
+ *  in between.
+ ******************************************************************************/
+#ifndef VSP2_SYNC_H
+#define VSP2_SYNC_H
+
+#include <linux/dma-buf.h>
+
+#define VSP2_SYNC_READ		DMA_BUF_SYNC_READ
+#define VSP2_SYNC_WRITE		DMA_BUF_SYNC_WRITE
+#define VSP2_SYNC_RW		DMA_BUF_SYNC_RW
+
+/* 0, or -1 with errno */
+int	vsp2_sync_begin(int dmafd, unsigned int access);
+int	vsp2_sync_end(int dmafd, unsigned int access);
+
+#endif /* VSP2_SYNC_H */
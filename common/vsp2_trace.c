@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  timeline trace
+ *  Each thread records into its own buffer, so recording takes no lock.
+ *  Buffers are chained once into a list with a compare-and-swap. An event
+ *  is published by a release store of the count; the exit handler stops
+ *  the trace first and reads each buffer only up to its published count,
+ *  so a thread still running cannot hand it a half-written event.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/videodev2.h>
+
+#define VSP2_TRACE_NO_WRAP
+#include "vsp2_trace.h"
+#include "vsp2_pmu.h"
+#include "vsp2_result.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define TRACE_EVENT_MAX		(65536)		/* per thread */
+#define TRACE_DEPTH_MAX		(16)		/* nested spans */
+#define TRACE_FD_MAX		(256)
+#define TRACE_FD_NAME_LEN	(64)
+
+/* open() flags that take a mode argument */
+#ifdef O_TMPFILE
+#define TRACE_OPEN_MODE		(O_CREAT | O_TMPFILE)
+#else
+#define TRACE_OPEN_MODE		(O_CREAT)
+#endif
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct trace_event {
+	const char	*pname;
+	const char	*pcat;
+	long long	ts;		/* us from trace start */
+	long long	dur;
+	int		fd;		/* -1 : not an fd event */
+	int		index;		/* v4l2 buffer index, -1 : none */
+	unsigned int	sequence;
+	long long	buf_ts;		/* v4l2 buffer timestamp, us */
+};
+
+struct trace_span {
+	const char	*pname;
+	long long	ts;
+};
+
+struct trace_thread {
+	struct trace_thread	*pnext;
+	int			tid;
+	int			num;		/* published events */
+	int			lost;
+	int			depth;
+	struct trace_span	stack[TRACE_DEPTH_MAX];
+	struct trace_event	event[TRACE_EVENT_MAX];
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static bool			trace_enabled;
+static const char		*ptrace_file;
+static long long		trace_start;
+static struct trace_thread	*ptrace_list;
+static __thread struct trace_thread	*ptrace_self;
+static char	trace_fd_name[TRACE_FD_MAX][TRACE_FD_NAME_LEN];
+static pthread_mutex_t	trace_fd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static long long	trace_now(void);
+static struct trace_thread	*trace_thread_get(void);
+static bool	trace_on(void);
+static struct trace_event	*trace_event_new(struct trace_thread *pthr);
+static void	trace_event_publish(struct trace_thread *pthr);
+static void	trace_write(void);
+static void	write_string(FILE *fp, const char *ps);
+static void	write_event(FILE *fp, const struct trace_event *pev,
+			    int pid, int tid, bool *pfirst);
+
+/******************************************************************************
+ *  setup
+ ******************************************************************************/
+__attribute__((constructor))
+static void trace_init(void)
+{
+	ptrace_file = getenv("VSP2_TRACE");
+	if (ptrace_file == NULL || ptrace_file[0] == '\0')
+		return;
+
+	trace_start	= trace_now();
+	trace_enabled	= true;
+	atexit(trace_write);
+}
+
+/******************************************************************************
+ *  record
+ ******************************************************************************/
+void vsp2_trace_begin(const char *pname)
+{
+	struct trace_thread *pthr;
+
+	vsp2_pmu_begin(pname);
+	vsp2_result_span_begin(pname);
+	if (!trace_on())
+		return;
+	pthr = trace_thread_get();
+	if (pthr == NULL)
+		return;
+
+	if (pthr->depth < TRACE_DEPTH_MAX) {
+		pthr->stack[pthr->depth].pname	= pname;
+		pthr->stack[pthr->depth].ts	= trace_now();
+	}
+	pthr->depth++;
+}
+
+void vsp2_trace_end(void)
+{
+	struct trace_thread	*pthr;
+	struct trace_event	*pev;
+
+	vsp2_pmu_end();
+	vsp2_result_span_end();
+	if (!trace_on())
+		return;
+	pthr = trace_thread_get();
+	if (pthr == NULL || pthr->depth == 0)
+		return;
+
+	pthr->depth--;
+	if (pthr->depth >= TRACE_DEPTH_MAX)
+		return;
+
+	pev = trace_event_new(pthr);
+	if (pev == NULL)
+		return;
+	pev->pname	= pthr->stack[pthr->depth].pname;
+	pev->pcat	= "span";
+	pev->ts		= pthr->stack[pthr->depth].ts;
+	pev->dur	= trace_now() - pev->ts;
+	trace_event_publish(pthr);
+}
+
+int vsp2_trace_ioctl(int fd, unsigned long request, void *parg,
+		     const char *pname)
+{
+	struct trace_thread	*pthr;
+	struct trace_event	*pev;
+	struct v4l2_buffer	*pbuf = parg;
+	long long		ts;
+	int			ret;
+
+	if (!trace_on() && !vsp2_result_active())
+		return ioctl(fd, request, parg);
+
+	ts  = trace_now();
+	ret = ioctl(fd, request, parg);
+	vsp2_result_ioctl(fd, request, parg, ret, pname, trace_now() - ts);
+	if (!trace_on())
+		return ret;
+
+	pthr = trace_thread_get();
+	if (pthr == NULL)
+		return ret;
+	pev = trace_event_new(pthr);
+	if (pev == NULL)
+		return ret;
+
+	pev->pname	= pname;
+	pev->pcat	= "ioctl";
+	pev->ts		= ts;
+	pev->dur	= trace_now() - ts;
+	pev->fd		= fd;
+
+	/* buffer identity, and the driver timestamp once it is filled in */
+	if (ret == 0 &&
+	    (request == VIDIOC_QBUF || request == VIDIOC_DQBUF)) {
+		pev->index	= pbuf->index;
+		pev->sequence	= pbuf->sequence;
+		if (request == VIDIOC_DQBUF)
+			pev->buf_ts = (long long)pbuf->timestamp.tv_sec *
+				      1000000 + pbuf->timestamp.tv_usec;
+	}
+	trace_event_publish(pthr);
+
+	return ret;
+}
+
+int vsp2_trace_open(const char *ppath, int flags, ...)
+{
+	struct trace_thread	*pthr;
+	struct trace_event	*pev;
+	mode_t			mode = 0;
+	va_list			ap;
+	long long		ts;
+	int			fd;
+
+	/* the mode is there only for a file that may be created */
+	if (flags & TRACE_OPEN_MODE) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+
+	if (!trace_on())
+		return open(ppath, flags, mode);
+
+	ts = trace_now();
+	fd = open(ppath, flags, mode);
+
+	if (fd >= 0 && fd < TRACE_FD_MAX) {
+		pthread_mutex_lock(&trace_fd_lock);
+		snprintf(trace_fd_name[fd], TRACE_FD_NAME_LEN, "fd %d %s",
+			 fd, ppath);
+		pthread_mutex_unlock(&trace_fd_lock);
+	}
+
+	pthr = trace_thread_get();
+	if (pthr == NULL)
+		return fd;
+	pev = trace_event_new(pthr);
+	if (pev == NULL)
+		return fd;
+
+	pev->pname	= "open";
+	pev->pcat	= "open";
+	pev->ts		= ts;
+	pev->dur	= trace_now() - ts;
+	pev->fd		= fd;
+	trace_event_publish(pthr);
+
+	return fd;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static long long trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 -
+	       trace_start;
+}
+
+static struct trace_thread *trace_thread_get(void)
+{
+	struct trace_thread *pthr = ptrace_self;
+
+	if (pthr != NULL)
+		return pthr;
+
+	pthr = calloc(1, sizeof(*pthr));
+	if (pthr == NULL)
+		return NULL;
+	pthr->tid = syscall(SYS_gettid);
+
+	/* push onto the list, the only shared write */
+	pthr->pnext = __atomic_load_n(&ptrace_list, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&ptrace_list, &pthr->pnext, pthr,
+					    true, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED))
+		;
+
+	ptrace_self = pthr;
+	return pthr;
+}
+
+static bool trace_on(void)
+{
+	return __atomic_load_n(&trace_enabled, __ATOMIC_ACQUIRE);
+}
+
+/* the next free event, counted only once trace_event_publish() is called */
+static struct trace_event *trace_event_new(struct trace_thread *pthr)
+{
+	struct trace_event *pev;
+
+	if (pthr->num >= TRACE_EVENT_MAX) {
+		__atomic_store_n(&pthr->lost, pthr->lost + 1,
+				 __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	pev = &pthr->event[pthr->num];
+	memset(pev, 0, sizeof(*pev));
+	pev->fd		= -1;
+	pev->index	= -1;
+	pev->buf_ts	= -1;
+	return pev;
+}
+
+static void trace_event_publish(struct trace_thread *pthr)
+{
+	__atomic_store_n(&pthr->num, pthr->num + 1, __ATOMIC_RELEASE);
+}
+
+/* a JSON string : quotes, backslashes and control characters escaped */
+static void write_string(FILE *fp, const char *ps)
+{
+	const unsigned char *p = (const unsigned char *)ps;
+
+	fputc('"', fp);
+	for (; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+static void write_event(FILE *fp, const struct trace_event *pev,
+			int pid, int tid, bool *pfirst)
+{
+	fprintf(fp, "%s\n{\"name\":", *pfirst ? "" : ",");
+	write_string(fp, pev->pname);
+	fprintf(fp, ",\"cat\":");
+	write_string(fp, pev->pcat);
+	fprintf(fp, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,"
+		"\"tid\":%d,\"args\":{", pev->ts, pev->dur, pid, tid);
+	*pfirst = false;
+
+	if (pev->fd >= 0)
+		fprintf(fp, "\"fd\":%d", pev->fd);
+	if (pev->index >= 0)
+		fprintf(fp, ",\"index\":%d,\"sequence\":%u",
+			pev->index, pev->sequence);
+	if (pev->buf_ts >= 0)
+		fprintf(fp, ",\"buf_ts_us\":%lld", pev->buf_ts);
+	fprintf(fp, "}}");
+}
+
+static void trace_write(void)
+{
+	struct trace_thread	*pthr;
+	struct trace_event	*pev;
+	bool			first = true;
+	bool			used[TRACE_FD_MAX];
+	FILE			*fp;
+	int			lost = 0;
+	int			num = 0;
+	int			count;
+	int			i;
+
+	/* spans still open at exit end here */
+	pthr = ptrace_self;
+	while (pthr != NULL && pthr->depth > 0)
+		vsp2_trace_end();
+
+	/* other threads may still run : no new events from here on */
+	__atomic_store_n(&trace_enabled, false, __ATOMIC_SEQ_CST);
+
+	fp = fopen(ptrace_file, "w");
+	if (fp == NULL) {
+		printf("Error : cannot open trace file %s\n", ptrace_file);
+		return;
+	}
+
+	memset(used, 0, sizeof(used));
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	/* pid 1 : one track per thread, pid 2 : one track per fd */
+	for (pthr = __atomic_load_n(&ptrace_list, __ATOMIC_ACQUIRE);
+	     pthr != NULL; pthr = pthr->pnext) {
+		count = __atomic_load_n(&pthr->num, __ATOMIC_ACQUIRE);
+		for (i = 0; i < count; i++) {
+			pev = &pthr->event[i];
+			write_event(fp, pev, 1, pthr->tid, &first);
+			if (pev->fd >= 0 && pev->fd < TRACE_FD_MAX) {
+				write_event(fp, pev, 2, pev->fd, &first);
+				used[pev->fd] = true;
+			}
+		}
+		num  += count;
+		lost += __atomic_load_n(&pthr->lost, __ATOMIC_RELAXED);
+	}
+
+	fprintf(fp, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+		"\"args\":{\"name\":\"threads\"}}", first ? "" : ",");
+	fprintf(fp, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,"
+		"\"args\":{\"name\":\"fds\"}}");
+	pthread_mutex_lock(&trace_fd_lock);
+	for (i = 0; i < TRACE_FD_MAX; i++) {
+		if (!used[i])
+			continue;
+		fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+			"\"pid\":2,\"tid\":%d,\"args\":{\"name\":", i);
+		write_string(fp, trace_fd_name[i][0] ? trace_fd_name[i] : "fd");
+		fprintf(fp, "}}");
+	}
+	pthread_mutex_unlock(&trace_fd_lock);
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	printf("trace : %d events written to %s", num, ptrace_file);
+	if (lost)
+		printf(" (%d lost, buffer full)", lost);
+	printf("\n");
+}
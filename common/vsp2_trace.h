@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  timeline trace : begin / end spans and every ioctl, written as Chrome
+ *  trace JSON at exit. Enabled by VSP2_TRACE=<output file>.
+ *
+ *  Include after the system headers: ioctl() and open() of the including
+ *  file are routed through the trace.
+ ******************************************************************************/
+#ifndef VSP2_TRACE_H
+#define VSP2_TRACE_H
+
+void	vsp2_trace_begin(const char *pname);
+void	vsp2_trace_end(void);
+int	vsp2_trace_ioctl(int fd, unsigned long request, void *parg,
+			 const char *pname);
+int	vsp2_trace_open(const char *ppath, int flags, ...);
+
+#ifndef VSP2_TRACE_NO_WRAP
+#define ioctl(fd, request, parg) \
+	vsp2_trace_ioctl((fd), (request), (parg), #request)
+#define open(...) \
+	vsp2_trace_open(__VA_ARGS__)
+#endif
+
+#endif /* VSP2_TRACE_H */
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  userptr registration
+ *  One slot per v4l2 index remembers the address and length it was last
+ *  queued with, which is what the driver still has pinned there. A QBUF
+ *  looks for its buffer among the slots, then for a slot never used, then
+ *  takes the idle slot queued longest ago. Pools are a few buffers, so
+ *  the lookup is a plain scan.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#include "vsp2_userptr.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct userptr_slot {
+	unsigned long		addr;		/* 0 : never used */
+	unsigned long		length;
+	bool			queued;
+	unsigned long long	last;		/* QBUF count when queued */
+};
+
+struct vsp2_userptr {
+	int			fd;
+	unsigned int		type;
+	unsigned int		num;
+	struct userptr_slot	slot[VIDEO_MAX_FRAME];
+	struct vsp2_userptr_stat stat;
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	find_slot(struct vsp2_userptr *pu, unsigned long addr,
+			  unsigned long length);
+static long long	get_time_us(void);
+
+/******************************************************************************
+ *  interface
+ ******************************************************************************/
+struct vsp2_userptr *vsp2_userptr_new(int fd, unsigned int type,
+				      unsigned int num)
+{
+	struct vsp2_userptr		*pu;
+	struct v4l2_requestbuffers	req_buf;
+
+	if (num == 0 || num > VIDEO_MAX_FRAME) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= num;
+	req_buf.type	= type;
+	req_buf.memory	= V4L2_MEMORY_USERPTR;
+	if (ioctl(fd, VIDIOC_REQBUFS, &req_buf) < 0)
+		return NULL;
+	if (req_buf.count == 0) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	pu = calloc(1, sizeof(*pu));
+	if (pu == NULL)
+		return NULL;
+	pu->fd		= fd;
+	pu->type	= type;
+	pu->num		= req_buf.count;	/* the driver may give fewer */
+	return pu;
+}
+
+void vsp2_userptr_free(struct vsp2_userptr *pu)
+{
+	struct v4l2_requestbuffers req_buf;
+
+	if (pu == NULL)
+		return;
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;
+	req_buf.type	= pu->type;
+	req_buf.memory	= V4L2_MEMORY_USERPTR;
+	if (ioctl(pu->fd, VIDIOC_REQBUFS, &req_buf) < 0)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+	free(pu);
+}
+
+int vsp2_userptr_qbuf(struct vsp2_userptr *pu, void *paddr,
+		      unsigned long length, unsigned int bytesused)
+{
+	struct userptr_slot	*pslot;
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	long long		t;
+	bool			hit;
+	int			idx;
+
+	idx = find_slot(pu, (unsigned long)paddr, length);
+	if (idx < 0)
+		return -1;
+	pslot	= &pu->slot[idx];
+	hit	= pslot->addr == (unsigned long)paddr &&
+		  pslot->length == length;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= idx;
+	buf.type	= pu->type;
+	buf.memory	= V4L2_MEMORY_USERPTR;
+	buf.length	= 1;
+	buf.bytesused	= bytesused;
+	buf.m.planes[0].bytesused	= bytesused;
+	buf.m.planes[0].length		= length;
+	buf.m.planes[0].m.userptr	= (unsigned long)paddr;
+
+	t = get_time_us();
+	if (ioctl(pu->fd, VIDIOC_QBUF, &buf) < 0)
+		return -1;
+	t = get_time_us() - t;
+
+	pu->stat.qbufs++;
+	if (hit) {
+		pu->stat.hits++;
+		pu->stat.hit_us += t;
+	} else {
+		pu->stat.misses++;
+		pu->stat.miss_us += t;
+		if (pslot->addr != 0)
+			pu->stat.evictions++;
+	}
+
+	pslot->addr	= (unsigned long)paddr;
+	pslot->length	= length;
+	pslot->queued	= true;
+	pslot->last	= pu->stat.qbufs;
+	return idx;
+}
+
+void *vsp2_userptr_dqbuf(struct vsp2_userptr *pu, struct v4l2_buffer *pbuf)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	if (pbuf == NULL)
+		pbuf = &buf;
+
+	memset(pbuf, 0, sizeof(*pbuf));
+	memset(planes, 0, sizeof(planes));
+	pbuf->m.planes	= planes;
+	pbuf->type	= pu->type;
+	pbuf->memory	= V4L2_MEMORY_USERPTR;
+	pbuf->length	= VIDEO_MAX_PLANES;
+	if (ioctl(pu->fd, VIDIOC_DQBUF, pbuf) < 0)
+		return NULL;
+	if (pbuf->index >= pu->num) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* the caller's planes array is gone after the return */
+	if (pbuf != &buf)
+		pbuf->m.planes = NULL;
+	pu->slot[pbuf->index].queued = false;
+	return (void *)pu->slot[pbuf->index].addr;
+}
+
+void vsp2_userptr_stat(struct vsp2_userptr *pu,
+		       struct vsp2_userptr_stat *pstat)
+{
+	*pstat = pu->stat;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int find_slot(struct vsp2_userptr *pu, unsigned long addr,
+		     unsigned long length)
+{
+	struct userptr_slot	*pslot;
+	int			unused = -1;
+	int			idle = -1;
+	unsigned int		i;
+
+	for (i = 0; i < pu->num; i++) {
+		pslot = &pu->slot[i];
+		if (pslot->addr == addr && pslot->length == length) {
+			if (pslot->queued) {
+				/* queued twice : the driver would refuse */
+				errno = EBUSY;
+				return -1;
+			}
+			return i;
+		}
+		if (pslot->addr == 0) {
+			if (unused < 0)
+				unused = i;
+		} else if (!pslot->queued &&
+			   (idle < 0 || pslot->last < pu->slot[idle].last)) {
+			idle = i;
+		}
+	}
+
+	if (unused >= 0)
+		return unused;
+	if (idle >= 0)
+		return idle;
+	errno = EBUSY;
+	return -1;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
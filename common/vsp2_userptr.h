@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  userptr registration : a USERPTR queue whose buffer indexes stay with
+ *  the user buffers. vb2 pins and maps the pages of a QBUF again unless
+ *  the same address and length come back at the same index; here every
+ *  buffer keeps its index while it is in use, so a pool of buffers cycled
+ *  through the queue is pinned once. An index goes to a new buffer only
+ *  when all are taken, the least recently queued idle one first.
+ *
+ *    pu = vsp2_userptr_new(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 8);
+ *    vsp2_userptr_qbuf(pu, psrc, size, size);
+ *    psrc = vsp2_userptr_dqbuf(pu, NULL);
+ *
+ *  Single plane; one thread per queue.
+ ******************************************************************************/
+#ifndef VSP2_USERPTR_H
+#define VSP2_USERPTR_H
+
+#include <linux/videodev2.h>
+
+struct vsp2_userptr;
+
+struct vsp2_userptr_stat {
+	unsigned long long	qbufs;
+	unsigned long long	hits;		/* same buffer at the index */
+	unsigned long long	misses;		/* pinned again */
+	unsigned long long	evictions;	/* of them, index taken from
+						 * another buffer */
+	long long		hit_us;		/* QBUF time */
+	long long		miss_us;
+};
+
+/* REQBUFS num USERPTR buffers on the queue, NULL on failure */
+struct vsp2_userptr	*vsp2_userptr_new(int fd, unsigned int type,
+					  unsigned int num);
+/* REQBUFS 0 : the driver lets go of every pinned page */
+void	vsp2_userptr_free(struct vsp2_userptr *pu);
+
+/* index used, or -1 with errno (EBUSY : every index is queued) */
+int	vsp2_userptr_qbuf(struct vsp2_userptr *pu, void *paddr,
+			  unsigned long length, unsigned int bytesused);
+/* the buffer back, or NULL with errno; pbuf may be NULL */
+void	*vsp2_userptr_dqbuf(struct vsp2_userptr *pu, struct v4l2_buffer *pbuf);
+
+void	vsp2_userptr_stat(struct vsp2_userptr *pu,
+			  struct vsp2_userptr_stat *pstat);
+
+#endif /* VSP2_USERPTR_H */
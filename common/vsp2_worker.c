@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  pipeline worker
+ *  The thread drains its job ring into submit(), then sleeps in one
+ *  poll() on the job ring eventfd and the watched fds. The mutex and
+ *  condition are used for the start handshake only.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "vsp2_ring.h"
+#include "vsp2_worker.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define WORKER_FD_MAX		(8)
+#define WORKER_MAX		(16)		/* per vsp2_worker_wait() */
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_worker {
+	char				name[16];
+	const struct vsp2_worker_ops	*pops;
+	void				*pctx;
+	struct vsp2_ring		*pjob;		/* owner -> worker */
+	struct vsp2_ring		*pdone;		/* worker -> owner */
+	pthread_t			thread;
+
+	/* start handshake */
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+	bool				started;
+	int				start_ret;
+
+	_Atomic int			quit;
+	_Atomic int			failed;
+
+	/* worker thread only */
+	int				fd[WORKER_FD_MAX];
+	int				fd_num;
+	unsigned long long		jobs;
+	unsigned long long		sleeps;
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void	*worker_main(void *parg);
+static void	worker_fail(struct vsp2_worker *pworker);
+
+/******************************************************************************
+ *  owner thread
+ ******************************************************************************/
+struct vsp2_worker *vsp2_worker_start(const char *pname,
+				      const struct vsp2_worker_ops *pops,
+				      void *pctx, unsigned int depth)
+{
+	struct vsp2_worker	*pworker;
+	int			ret;
+
+	pworker = calloc(1, sizeof(*pworker));
+	if (pworker == NULL)
+		return NULL;
+
+	snprintf(pworker->name, sizeof(pworker->name), "%s", pname);
+	pworker->pops	= pops;
+	pworker->pctx	= pctx;
+	pworker->pjob	= vsp2_ring_new(depth);
+	pworker->pdone	= vsp2_ring_new(depth);
+	if (pworker->pjob == NULL || pworker->pdone == NULL)
+		goto err;
+
+	pthread_mutex_init(&pworker->lock, NULL);
+	pthread_cond_init(&pworker->cond, NULL);
+
+	ret = pthread_create(&pworker->thread, NULL, worker_main, pworker);
+	if (ret != 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, ret);
+		goto err;
+	}
+	pthread_setname_np(pworker->thread, pworker->name);
+
+	pthread_mutex_lock(&pworker->lock);
+	while (!pworker->started)
+		pthread_cond_wait(&pworker->cond, &pworker->lock);
+	pthread_mutex_unlock(&pworker->lock);
+
+	if (pworker->start_ret < 0) {
+		pthread_join(pworker->thread, NULL);
+		goto err;
+	}
+	return pworker;
+
+err:
+	vsp2_ring_free(pworker->pjob);
+	vsp2_ring_free(pworker->pdone);
+	free(pworker);
+	return NULL;
+}
+
+int vsp2_worker_submit(struct vsp2_worker *pworker, void *pjob)
+{
+	if (!vsp2_ring_push(pworker->pjob, pjob)) {
+		errno = EAGAIN;
+		return -1;
+	}
+	return 0;
+}
+
+void *vsp2_worker_reap(struct vsp2_worker *pworker)
+{
+	return vsp2_ring_pop(pworker->pdone);
+}
+
+int vsp2_worker_wait(struct vsp2_worker **ppworker, int num, int timeout_ms)
+{
+	struct pollfd	pfd[WORKER_MAX];
+	bool		ready = false;
+	bool		failed = false;
+	int		i;
+
+	if (num > WORKER_MAX)
+		num = WORKER_MAX;
+
+	for (i = 0; i < num; i++) {
+		if (!vsp2_ring_arm(ppworker[i]->pdone))
+			ready = true;
+		if (atomic_load(&ppworker[i]->failed))
+			failed = true;
+		pfd[i].fd	= vsp2_ring_fd(ppworker[i]->pdone);
+		pfd[i].events	= POLLIN;
+	}
+
+	if (!ready && !failed) {
+		if (poll(pfd, num, timeout_ms) < 0 && errno != EINTR)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+	}
+
+	for (i = 0; i < num; i++) {
+		vsp2_ring_disarm(ppworker[i]->pdone);
+		if (atomic_load(&ppworker[i]->failed))
+			failed = true;
+	}
+	return failed ? -1 : 0;
+}
+
+void vsp2_worker_stop(struct vsp2_worker *pworker,
+		      struct vsp2_worker_stat *pstat)
+{
+	unsigned long long	pushed;
+
+	if (pworker == NULL)
+		return;
+
+	atomic_store(&pworker->quit, 1);
+	vsp2_ring_kick(pworker->pjob);
+	pthread_join(pworker->thread, NULL);
+
+	if (pstat != NULL) {
+		memset(pstat, 0, sizeof(*pstat));
+		pstat->jobs	= pworker->jobs;
+		pstat->sleeps	= pworker->sleeps;
+		vsp2_ring_stat(pworker->pjob, &pushed, &pstat->job_signals);
+		vsp2_ring_stat(pworker->pdone, &pushed, &pstat->done_signals);
+	}
+
+	pthread_mutex_destroy(&pworker->lock);
+	pthread_cond_destroy(&pworker->cond);
+	vsp2_ring_free(pworker->pjob);
+	vsp2_ring_free(pworker->pdone);
+	free(pworker);
+}
+
+/******************************************************************************
+ *  worker thread
+ ******************************************************************************/
+int vsp2_worker_watch(struct vsp2_worker *pworker, int fd)
+{
+	if (pworker->fd_num >= WORKER_FD_MAX) {
+		errno = ENOSPC;
+		return -1;
+	}
+	pworker->fd[pworker->fd_num++] = fd;
+	return 0;
+}
+
+void vsp2_worker_done(struct vsp2_worker *pworker, void *pjob)
+{
+	/* the owner keeps at most depth jobs out, so this has room */
+	if (!vsp2_ring_push(pworker->pdone, pjob)) {
+		printf("error line=%d %s: done ring full\n", __LINE__,
+		       pworker->name);
+		worker_fail(pworker);
+	}
+}
+
+static void *worker_main(void *parg)
+{
+	struct vsp2_worker		*pworker = parg;
+	const struct vsp2_worker_ops	*pops = pworker->pops;
+	struct pollfd			pfd[WORKER_FD_MAX + 1];
+	void				*pjob;
+	int				timeout;
+	int				ret;
+	int				i;
+
+	ret = pops->start(pworker, pworker->pctx);
+
+	pthread_mutex_lock(&pworker->lock);
+	pworker->start_ret	= ret;
+	pworker->started	= true;
+	pthread_cond_signal(&pworker->cond);
+	pthread_mutex_unlock(&pworker->lock);
+	if (ret < 0) {
+		pops->stop(pworker, pworker->pctx);
+		return NULL;
+	}
+
+	while (!atomic_load_explicit(&pworker->quit, memory_order_relaxed)) {
+		while ((pjob = vsp2_ring_pop(pworker->pjob)) != NULL) {
+			pworker->jobs++;
+			if (pops->submit(pworker, pworker->pctx, pjob) < 0)
+				goto fail;
+		}
+
+		/* sleep only when the job ring is really empty */
+		timeout = vsp2_ring_arm(pworker->pjob) ? -1 : 0;
+
+		pfd[0].fd	= vsp2_ring_fd(pworker->pjob);
+		pfd[0].events	= POLLIN;
+		for (i = 0; i < pworker->fd_num; i++) {
+			pfd[i + 1].fd		= pworker->fd[i];
+			pfd[i + 1].events	= POLLIN;
+			pfd[i + 1].revents	= 0;
+		}
+
+		ret = poll(pfd, pworker->fd_num + 1, timeout);
+		if (timeout < 0) {
+			vsp2_ring_disarm(pworker->pjob);
+			pworker->sleeps++;
+		}
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto fail;
+		}
+
+		for (i = 0; ret > 0 && i < pworker->fd_num; i++) {
+			if (pfd[i + 1].revents == 0)
+				continue;
+			if (pops->event(pworker, pworker->pctx,
+					pworker->fd[i]) < 0)
+				goto fail;
+		}
+	}
+
+	pops->stop(pworker, pworker->pctx);
+	return NULL;
+
+fail:
+	worker_fail(pworker);
+	pops->stop(pworker, pworker->pctx);
+	return NULL;
+}
+
+static void worker_fail(struct vsp2_worker *pworker)
+{
+	/* the owner sees failed in vsp2_worker_wait() */
+	atomic_store(&pworker->failed, 1);
+	vsp2_ring_kick(pworker->pdone);
+}
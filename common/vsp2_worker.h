@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  pipeline worker : one thread that owns one pipeline - its device fds,
+ *  buffers and tables - and runs the jobs handed to it.
+ *
+ *  Jobs go in through one spsc ring and come back through another, so the
+ *  thread that submits must also be the one that reaps, and the per-frame
+ *  path takes no lock. The callbacks run on the worker thread; a job
+ *  may finish inside submit() or later in event(), when one of the fds
+ *  given to vsp2_worker_watch() becomes readable.
+ *
+ *  At most depth jobs may be out at a time (submitted and not reaped).
+ ******************************************************************************/
+#ifndef VSP2_WORKER_H
+#define VSP2_WORKER_H
+
+struct vsp2_worker;
+
+struct vsp2_worker_ops {
+	/* 0 : success, -1 : error; the worker stops on an error and
+	 * calls stop(), also after a failed start() */
+	int	(*start)(struct vsp2_worker *pworker, void *pctx);
+	int	(*submit)(struct vsp2_worker *pworker, void *pctx, void *pjob);
+	int	(*event)(struct vsp2_worker *pworker, void *pctx, int fd);
+	void	(*stop)(struct vsp2_worker *pworker, void *pctx);
+};
+
+struct vsp2_worker_stat {
+	unsigned long long	jobs;
+	unsigned long long	job_signals;	/* eventfd writes to wake it */
+	unsigned long long	done_signals;	/* eventfd writes it made */
+	unsigned long long	sleeps;
+};
+
+/* owner thread; start() has returned when vsp2_worker_start() does */
+struct vsp2_worker	*vsp2_worker_start(const char *pname,
+					   const struct vsp2_worker_ops *pops,
+					   void *pctx, unsigned int depth);
+int	vsp2_worker_submit(struct vsp2_worker *pworker, void *pjob);
+void	*vsp2_worker_reap(struct vsp2_worker *pworker);
+int	vsp2_worker_wait(struct vsp2_worker **ppworker, int num,
+			 int timeout_ms);
+void	vsp2_worker_stop(struct vsp2_worker *pworker,
+			 struct vsp2_worker_stat *pstat);
+
+/* worker thread, from the callbacks */
+int	vsp2_worker_watch(struct vsp2_worker *pworker, int fd);
+void	vsp2_worker_done(struct vsp2_worker *pworker, void *pjob);
+
+#endif /* VSP2_WORKER_H */
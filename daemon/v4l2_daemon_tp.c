@@ -0,0 +1,750 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : as vsp2d sets it up for the module
+ *  memory type : dmabuf, passed to vsp2d over its socket
+ *
+ *  Client of vsp2d. Allocates one source and destination pair per job kept
+ *  out at the daemon, exports them as dmabuf and sends the fds with each
+ *  job; the next job of a pair goes out when its done message is back.
+ *  The frames are never copied, the outputs are only read at the end.
+ *
+ *  With -r the pairs are registered once and jobs go through the shared
+ *  rings of vsp2d_ring.h: every completion reaped is resubmitted in one
+ *  batch, and the report shows how many system calls a job still costs.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_mem.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+#include "vsp2d.h"
+#include "vsp2d_ring.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* source parameter */
+#define SRC_FILENAME		"1280_720_ARGB32.argb"
+#define SRC_WIDTH		(1280)			/* src: width */
+#define SRC_HEIGHT		(720)			/* src: height */
+#define SRC_SIZE		(SRC_WIDTH*SRC_HEIGHT*4)
+
+/* client parameter */
+#define CLIENT_JOB_NUM		(100)
+#define CLIENT_PAIR_NUM		(4)		/* jobs out at once */
+#define CLIENT_PAIR_MAX		(8)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct client_module {
+	const char	*pname;
+	const char	*ptag;		/* output file name */
+};
+
+struct client_pair {
+	MMNGR_ID		src_id;
+	MMNGR_ID		dst_id;
+	unsigned long		src_virt;
+	unsigned long		dst_virt;
+	int			src_mbid;
+	int			dst_mbid;
+	int			src_dmafd;	/* -1 : not exported */
+	int			dst_dmafd;
+	int			src_buf;	/* registered index, -r */
+	int			dst_buf;
+	int			job;		/* out at the daemon, -1 : none */
+	long long		t_send;
+	unsigned long long	hash;
+};
+
+struct client_stat {
+	int			done;
+	int			failed;
+	int			warm;
+	int			mismatch;
+	long long		total_us;
+	long long		first_us;	/* round trip of job 0 */
+	long long		trip_us;
+	long long		trip_max_us;
+	long long		wait_us;	/* in the daemon, from vsp2d */
+	long long		process_us;
+	struct vsp2d_ring_stat	ring;		/* -r */
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct client_module client_module[] = {
+	{ "copy",	"COPY" },
+	{ "uds",	"UDS" },
+	{ "lut",	"LUT" },
+	{ "clu",	"CLU" },
+};
+
+static const struct client_module	*pclient_mod = &client_module[2];
+static unsigned int			dst_width = SRC_WIDTH;
+static unsigned int			dst_height = SRC_HEIGHT;
+static struct client_pair		client_pair[CLIENT_PAIR_MAX];
+static bool				use_ring;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	set_module(const char *pspec);
+static int	test_daemon(const char *psocket, int job_num, int pair_num);
+static int	run_socket(const char *psocket, struct client_stat *pstat,
+			   int job_num, int pair_num);
+static int	run_ring(const char *psocket, struct client_stat *pstat,
+			 int job_num, int pair_num);
+static struct client_pair	*take_done(struct client_stat *pstat,
+					   const struct vsp2d_done *pdone,
+					   int pair_num);
+static void	make_job(struct vsp2d_job *pjob, int job);
+static int	alloc_pair(struct client_pair *ppair, unsigned char *pimage);
+static void	free_pair(struct client_pair *ppair);
+static int	connect_daemon(const char *psocket);
+static int	send_job(int fd, struct client_pair *ppair, int job);
+static void	print_client_stat(struct client_stat *pstat, int job_num,
+				  int pair_num);
+static unsigned long long	calc_hash(unsigned long long hash,
+					  const void *pdata, size_t len);
+static long long	get_time_us(void);
+
+static int	read_file(unsigned char*, unsigned int, const char*);
+static int	write_file(unsigned char*, unsigned int, const char*);
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -p <module>: copy, uds:<w>x<h>, lut or clu [lut]\n");
+	printf("        -n <num>: jobs [%d]\n", CLIENT_JOB_NUM);
+	printf("        -q <num>: jobs out at once, 1 - %d [%d]\n",
+	       CLIENT_PAIR_MAX, CLIENT_PAIR_NUM);
+	printf("        -s <path>: vsp2d socket [%s]\n", VSP2D_SOCKET_PATH);
+	printf("        -r: jobs through shared rings, buffers registered\n");
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char	*psocket = VSP2D_SOCKET_PATH;
+	int		job_num = CLIENT_JOB_NUM;
+	int		pair_num = CLIENT_PAIR_NUM;
+	int		opt;
+	int		ret;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "p:n:q:s:rh")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (set_module(optarg) < 0)
+				exit(1);
+			break;
+		case 'n':
+			job_num = atoi(optarg);
+			break;
+		case 'q':
+			pair_num = atoi(optarg);
+			break;
+		case 's':
+			psocket = optarg;
+			break;
+		case 'r':
+			use_ring = true;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (job_num < 1 || pair_num < 1 || pair_num > CLIENT_PAIR_MAX) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+
+	printf("exec DAEMON %s, %d job(s), %d out at once, %s %s\n",
+	       pclient_mod->pname, job_num, pair_num,
+	       use_ring ? "rings on" : "socket", psocket);
+
+	ret = test_daemon(psocket, job_num, pair_num);
+
+	exit(ret < 0 ? 1 : 0);
+}
+
+static int set_module(const char *pspec)
+{
+	const char	*p;
+	size_t		len;
+	int		i;
+
+	p = strchr(pspec, ':');
+	len = p ? (size_t)(p - pspec) : strlen(pspec);
+
+	pclient_mod = NULL;
+	for (i = 0; i < (int)(sizeof(client_module) / sizeof(client_module[0]));
+	     i++) {
+		if (strlen(client_module[i].pname) == len &&
+		    strncmp(client_module[i].pname, pspec, len) == 0)
+			pclient_mod = &client_module[i];
+	}
+	if (pclient_mod == NULL) {
+		printf("Error : unknown module (%s)\n", pspec);
+		return -1;
+	}
+
+	dst_width	= SRC_WIDTH;
+	dst_height	= SRC_HEIGHT;
+	if (strcmp(pclient_mod->pname, "uds") == 0 &&
+	    (p == NULL ||
+	     sscanf(p + 1, "%ux%u", &dst_width, &dst_height) != 2)) {
+		printf("Error : uds needs an output size (uds:<w>x<h>)\n");
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ *  client
+ ******************************************************************************/
+static int test_daemon(const char *psocket, int job_num, int pair_num)
+{
+	struct client_stat	stat;
+	unsigned char		*pimage = NULL;
+	char			filename[128];
+	int			ret = -1;
+	int			i;
+
+	memset(&stat, 0, sizeof(stat));
+	for (i = 0; i < pair_num; i++) {
+		client_pair[i].src_dmafd = -1;
+		client_pair[i].dst_dmafd = -1;
+		client_pair[i].src_buf	 = -1;
+		client_pair[i].dst_buf	 = -1;
+		client_pair[i].job	 = -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file, once for every source buffer                          */
+	/*-------------------------------------------------------------------*/
+	pimage = malloc(SRC_SIZE);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+	if (read_file(pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Allocate memory by mmngr, get dma buffer file descriptors        */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < pair_num; i++) {
+		if (alloc_pair(&client_pair[i], pimage) < 0)
+			goto out;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Jobs                                                             */
+	/*-------------------------------------------------------------------*/
+	if (use_ring)
+		ret = run_ring(psocket, &stat, job_num, pair_num);
+	else
+		ret = run_socket(psocket, &stat, job_num, pair_num);
+	if (ret < 0)
+		goto out;
+	ret = -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Outputs : every pair holds the same image                        */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < pair_num && i < job_num; i++) {
+		if (vsp2_sync_begin(client_pair[i].dst_dmafd,
+				    VSP2_SYNC_READ) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		client_pair[i].hash = calc_hash(0xcbf29ce484222325ULL,
+				(void *)client_pair[i].dst_virt,
+				dst_width * dst_height * 4);
+		if (i == 0) {
+			snprintf(filename, sizeof(filename),
+				 "%u_%u_ARGB32_%s_DAEMON.argb", dst_width,
+				 dst_height, pclient_mod->ptag);
+			if (write_file((unsigned char *)client_pair[0].dst_virt,
+				       dst_width * dst_height * 4,
+				       filename) == 0)
+				goto out;
+		}
+		if (vsp2_sync_end(client_pair[i].dst_dmafd,
+				  VSP2_SYNC_READ) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		if (client_pair[i].hash != client_pair[0].hash)
+			stat.mismatch++;
+	}
+
+	print_client_stat(&stat, job_num, pair_num);
+	ret = (stat.done == job_num && stat.mismatch == 0) ? 0 : -1;
+
+out:
+	/*-------------------------------------------------------------------*/
+	/*  Release dma buffer file descriptors / Free buffer                */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < pair_num; i++)
+		free_pair(&client_pair[i]);
+	free(pimage);
+	return ret;
+}
+
+static int run_socket(const char *psocket, struct client_stat *pstat,
+		      int job_num, int pair_num)
+{
+	struct client_pair	*ppair;
+	struct vsp2d_done	done;
+	long long		t_start;
+	int			sock_fd;
+	int			next = 0;
+	int			out = 0;
+	int			ret = -1;
+	int			i;
+
+	sock_fd = connect_daemon(psocket);
+	if (sock_fd < 0)
+		return -1;
+
+	/* the next job of a pair goes out when it is back */
+	t_start = get_time_us();
+	for (i = 0; i < pair_num && next < job_num; i++) {
+		if (send_job(sock_fd, &client_pair[i], next++) < 0)
+			goto out;
+		out++;
+	}
+
+	while (out > 0) {
+		vsp2_trace_begin("wait");
+		i = recv(sock_fd, &done, sizeof(done), 0);
+		vsp2_trace_end();
+		if (i != sizeof(done) || done.type != VSP2D_MSG_DONE) {
+			printf("Error : vsp2d reply (%d) errno=(%d)\n", i,
+			       errno);
+			goto out;
+		}
+
+		ppair = take_done(pstat, &done, pair_num);
+		if (ppair == NULL)
+			goto out;
+		out--;
+
+		if (next < job_num) {
+			if (send_job(sock_fd, ppair, next++) < 0)
+				goto out;
+			out++;
+		}
+	}
+	pstat->total_us = get_time_us() - t_start;
+	ret = 0;
+
+out:
+	close(sock_fd);
+	return ret;
+}
+
+static int run_ring(const char *psocket, struct client_stat *pstat,
+		    int job_num, int pair_num)
+{
+	struct vsp2d_ring	*pr;
+	struct client_pair	*ppair;
+	struct vsp2d_sqe	sqe[CLIENT_PAIR_MAX];
+	struct vsp2d_done	done[CLIENT_PAIR_MAX];
+	long long		t_start;
+	int			next = 0;
+	int			out = 0;
+	int			ret = -1;
+	int			i, n, num;
+
+	pr = vsp2d_ring_open(psocket, pair_num);
+	if (pr == NULL)
+		return -1;
+
+	/* once, the jobs name the buffers by index afterwards */
+	for (i = 0; i < pair_num; i++) {
+		client_pair[i].src_buf = vsp2d_ring_register(pr,
+					client_pair[i].src_dmafd);
+		client_pair[i].dst_buf = vsp2d_ring_register(pr,
+					client_pair[i].dst_dmafd);
+		if (client_pair[i].src_buf < 0 || client_pair[i].dst_buf < 0)
+			goto out;
+	}
+
+	t_start = get_time_us();
+	num = 0;
+	for (i = 0; i < pair_num && next < job_num; i++) {
+		ppair = &client_pair[i];
+		sqe[num].src_buf	= ppair->src_buf;
+		sqe[num].dst_buf	= ppair->dst_buf;
+		ppair->job		= next;
+		ppair->t_send		= t_start;
+		make_job(&sqe[num++].job, next++);
+	}
+
+	while (num > 0 || out > 0) {
+		/* every job reaped goes back in one batch */
+		if (num > 0) {
+			if (vsp2d_ring_submit(pr, sqe, num) != num) {
+				printf("Error : ring full\n");
+				goto out;
+			}
+			out += num;
+			num = 0;
+		}
+
+		vsp2_trace_begin("wait");
+		n = vsp2d_ring_reap(pr, done, CLIENT_PAIR_MAX, true);
+		vsp2_trace_end();
+		if (n <= 0)
+			goto out;
+
+		for (i = 0; i < n; i++) {
+			ppair = take_done(pstat, &done[i], pair_num);
+			if (ppair == NULL)
+				goto out;
+			out--;
+
+			if (next < job_num) {
+				sqe[num].src_buf	= ppair->src_buf;
+				sqe[num].dst_buf	= ppair->dst_buf;
+				ppair->job		= next;
+				ppair->t_send		= get_time_us();
+				make_job(&sqe[num++].job, next++);
+			}
+		}
+	}
+	pstat->total_us = get_time_us() - t_start;
+	ret = 0;
+
+out:
+	vsp2d_ring_close(pr, &pstat->ring);
+	return ret;
+}
+
+static struct client_pair *take_done(struct client_stat *pstat,
+				     const struct vsp2d_done *pdone,
+				     int pair_num)
+{
+	struct client_pair	*ppair = NULL;
+	long long		t = get_time_us();
+	int			i;
+
+	for (i = 0; i < pair_num; i++) {
+		if (client_pair[i].job == (int)pdone->id)
+			ppair = &client_pair[i];
+	}
+	if (ppair == NULL) {
+		printf("Error : vsp2d reply for job %u\n", pdone->id);
+		return NULL;
+	}
+	ppair->job = -1;
+
+	if (pdone->result != 0) {
+		printf("Error : job %u result=(%d)\n", pdone->id,
+		       pdone->result);
+		pstat->failed++;
+	} else {
+		pstat->done++;
+		pstat->warm		+= pdone->warm ? 1 : 0;
+		pstat->wait_us		+= pdone->wait_us;
+		pstat->process_us	+= pdone->process_us;
+	}
+	if (pdone->id == 0)
+		pstat->first_us = t - ppair->t_send;
+	pstat->trip_us += t - ppair->t_send;
+	if (t - ppair->t_send > pstat->trip_max_us)
+		pstat->trip_max_us = t - ppair->t_send;
+	return ppair;
+}
+
+static void make_job(struct vsp2d_job *pjob, int job)
+{
+	memset(pjob, 0, sizeof(*pjob));
+	pjob->type		= VSP2D_MSG_JOB;
+	pjob->id		= job;
+	snprintf(pjob->module, sizeof(pjob->module), "%s",
+		 pclient_mod->pname);
+	pjob->src_width		= SRC_WIDTH;
+	pjob->src_height	= SRC_HEIGHT;
+	pjob->dst_width		= dst_width;
+	pjob->dst_height	= dst_height;
+}
+
+static int alloc_pair(struct client_pair *ppair, unsigned char *pimage)
+{
+	unsigned long	phys, hard;
+	int		ret;
+
+	ret = mmngr_alloc_in_user(&ppair->src_id, SRC_SIZE, &phys, &hard,
+				  &ppair->src_virt, MMNGR_VA_SUPPORT);
+	if (ret) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		ppair->src_virt = 0;
+		return -1;
+	}
+	ret = mmngr_export_start_in_user(&ppair->src_mbid, SRC_SIZE, hard,
+					 &ppair->src_dmafd);
+	if (ret) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		ppair->src_dmafd = -1;
+		return -1;
+	}
+	if (vsp2_sync_begin(ppair->src_dmafd, VSP2_SYNC_WRITE) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	memcpy((void *)ppair->src_virt, pimage, SRC_SIZE);
+	if (vsp2_sync_end(ppair->src_dmafd, VSP2_SYNC_WRITE) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	ret = mmngr_alloc_in_user(&ppair->dst_id, dst_width * dst_height * 4,
+				  &phys, &hard, &ppair->dst_virt,
+				  MMNGR_VA_SUPPORT);
+	if (ret) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		ppair->dst_virt = 0;
+		return -1;
+	}
+	ret = mmngr_export_start_in_user(&ppair->dst_mbid,
+					 dst_width * dst_height * 4, hard,
+					 &ppair->dst_dmafd);
+	if (ret) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		ppair->dst_dmafd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void free_pair(struct client_pair *ppair)
+{
+	if (ppair->src_dmafd != -1)
+		mmngr_export_end_in_user(ppair->src_mbid);
+	if (ppair->dst_dmafd != -1)
+		mmngr_export_end_in_user(ppair->dst_mbid);
+	if (ppair->src_virt != 0)
+		mmngr_free_in_user(ppair->src_id);
+	if (ppair->dst_virt != 0)
+		mmngr_free_in_user(ppair->dst_id);
+}
+
+static int connect_daemon(const char *psocket)
+{
+	struct sockaddr_un	addr;
+	int			fd;
+
+	if (strlen(psocket) >= sizeof(addr.sun_path)) {
+		printf("Error : socket path too long (%s)\n", psocket);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, psocket);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		printf("Error : vsp2d not running on %s errno=(%d)\n",
+		       psocket, errno);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int send_job(int fd, struct client_pair *ppair, int job)
+{
+	struct vsp2d_job	msg_job;
+	struct msghdr		msg;
+	struct iovec		iov;
+	struct cmsghdr		*pcmsg;
+	union {
+		char		buf[CMSG_SPACE(sizeof(int) * 2)];
+		struct cmsghdr	align;
+	} ctrl;
+	int			fds[2];
+
+	make_job(&msg_job, job);
+
+	/* the daemon gets its own references to the buffers */
+	fds[0] = ppair->src_dmafd;
+	fds[1] = ppair->dst_dmafd;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctrl, 0, sizeof(ctrl));
+	iov.iov_base		= &msg_job;
+	iov.iov_len		= sizeof(msg_job);
+	msg.msg_iov		= &iov;
+	msg.msg_iovlen		= 1;
+	msg.msg_control		= ctrl.buf;
+	msg.msg_controllen	= sizeof(ctrl.buf);
+
+	pcmsg = CMSG_FIRSTHDR(&msg);
+	pcmsg->cmsg_level	= SOL_SOCKET;
+	pcmsg->cmsg_type	= SCM_RIGHTS;
+	pcmsg->cmsg_len		= CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(pcmsg), fds, sizeof(fds));
+
+	ppair->job	= job;
+	ppair->t_send	= get_time_us();
+	if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(msg_job)) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		ppair->job = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void print_client_stat(struct client_stat *pstat, int job_num,
+			      int pair_num)
+{
+	double n = pstat->done ? pstat->done : 1;
+
+	printf("\n----- DAEMON %s -----\n", pclient_mod->ptag);
+	printf("jobs          : %d of %d, %d failed, %d out at once\n",
+	       pstat->done, job_num, pstat->failed, pair_num);
+	printf("warm          : %d, pipeline already set up in vsp2d\n",
+	       pstat->warm);
+	printf("total         : %.1f ms, %.1f jobs/s, %.1f Mpixel/s\n",
+	       pstat->total_us / 1000.0,
+	       pstat->total_us ? pstat->done * 1e6 / pstat->total_us : 0,
+	       pstat->total_us ? (double)pstat->done * SRC_WIDTH *
+				 SRC_HEIGHT / pstat->total_us : 0);
+	printf("round trip    : first %.2f ms, avg %.2f ms, max %.2f ms\n",
+	       pstat->first_us / 1000.0,
+	       pstat->trip_us / (double)(pstat->done + pstat->failed ?
+					 pstat->done + pstat->failed : 1) /
+	       1000, pstat->trip_max_us / 1000.0);
+	printf("in vsp2d      : wait %.2f ms, process %.2f ms per job\n",
+	       pstat->wait_us / n / 1000, pstat->process_us / n / 1000);
+	if (use_ring)
+		printf("ring          : %.2f doorbells, %.2f waits per job\n",
+		       pstat->ring.doorbells / n, pstat->ring.waits / n);
+	printf("output        : %016llx, %d mismatch(es)\n",
+	       client_pair[0].hash, pstat->mismatch);
+	printf("result        : %s\n",
+	       (pstat->done == job_num && pstat->mismatch == 0) ? "OK" : "NG");
+	printf("----------------------\n");
+}
+
+static unsigned long long calc_hash(unsigned long long hash,
+				    const void *pdata, size_t len)
+{
+	const unsigned char *p = pdata;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	/* file input */
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int write_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("write file");
+
+	/* file output */
+	fp = fopen(pfilename, "wb");
+	if (!fp) {
+		printf("output file open error..\n");
+		ret = 0;
+	} else {
+		ret = fwrite(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer write error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
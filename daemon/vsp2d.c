@@ -0,0 +1,1722 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : rpf -> [uds | lut | clu] -> wpf, per VSP as jobs need it
+ *  memory type : dmabuf, the clients' own buffers
+ *
+ *  VSP service. Clients send jobs over a Unix socket with the source and
+ *  destination dmabuf fds attached (vsp2d.h) and get a done message back;
+ *  the frames are never copied. Each VSP keeps the pipeline of its last
+ *  job: links, formats, tables and queues stay as they are while jobs of
+ *  the same module and sizes come in, and a VSP is set up again only when
+ *  no VSP set up for a job is free. One thread sleeps in one epoll on the
+ *  socket, the clients and the wpf nodes of the busy VSPs.
+ *
+ *  Clients with shared rings register their buffers once and pass jobs and
+ *  completions through memory. The rings are looked at on every turn of
+ *  the loop; only before the thread sleeps are they armed, so a client
+ *  rings the doorbell only for a daemon that really sleeps.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_trace.h"
+#include "vsp2d.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#ifndef USE_M3
+/* for h3 */
+#define MEDIA_DEV_NAME		"/dev/media3"		/* fe9a0000.vsp */
+#else
+/* for m3 */
+#define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
+#endif
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* lut / clu parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+#define CLU_GRID		(17)
+#define CLU_TBL_NUM		(CLU_GRID*CLU_GRID*CLU_GRID)
+#define CLU_REG_DATA		(0x00007404)
+
+/* daemon parameter */
+#define VSP2D_DEV_MAX		(4)
+#define VSP2D_MODULE_NUM	(4)		/* copy, uds, lut, clu */
+#define VSP2D_CLIENT_MAX	(64)
+#define VSP2D_SLOT_MAX		(8)
+#define VSP2D_SLOT_NUM		(4)		/* jobs queued per VSP */
+#define VSP2D_SIZE_MAX		(8190)		/* width and height */
+#define VSP2D_EVENT_MAX		(16)
+
+/* epoll data : what << 32 | index */
+#define EV_LISTEN		(0ULL)
+#define EV_SIGNAL		(1ULL)
+#define EV_CLIENT		(2ULL)
+#define EV_DEVICE		(3ULL)
+#define EV_RING			(4ULL)
+#define EV_DATA(what, idx)	((what) << 32 | (unsigned int)(idx))
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+#define VIDIOC_VSP2_CLU_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct vsp2_clu_config {
+	unsigned char	mode;
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned char	fxa;
+	unsigned short	tbl_num;	/* 1 to 9826 */
+};
+
+struct vsp2d_module {
+	const char	*pname;
+	const char	*pentity;	/* NULL : rpf.0 -> wpf.0 */
+};
+
+/* what a VSP is set up for */
+struct vsp2d_config {
+	int		module;		/* -1 : nothing */
+	unsigned int	src_width;
+	unsigned int	src_height;
+	unsigned int	dst_width;
+	unsigned int	dst_height;
+};
+
+struct vsp2d_client {
+	bool			used;
+	int			fd;		/* -1 : hung up, jobs still out */
+	int			refs;		/* jobs not done yet */
+
+	/* registered buffers */
+	int			buf_fd[VSP2D_BUF_MAX];
+	ino_t			buf_ino[VSP2D_BUF_MAX];
+	off_t			buf_size[VSP2D_BUF_MAX];
+	int			buf_num;
+
+	/* shared rings, NULL : socket jobs only */
+	struct vsp2d_ring_hdr	*pring;
+	struct vsp2d_sqe	*psq;
+	struct vsp2d_done	*pcq;
+	size_t			ring_size;
+	unsigned int		entries;	/* checked copy of the hdr's */
+	unsigned int		sq_head;	/* own indexes */
+	unsigned int		cq_tail;
+	int			sq_fd;		/* doorbell */
+	int			cq_fd;
+};
+
+struct vsp2d_req {
+	struct vsp2d_client	*pclient;
+	struct vsp2d_job	job;
+	struct vsp2d_config	cfg;
+	int			src_dmafd;
+	int			dst_dmafd;
+	ino_t			src_ino;
+	ino_t			dst_ino;
+	long long		t_recv;
+	long long		t_queue;
+	unsigned int		device;
+	bool			warm;
+	bool			ring;		/* registered buffers, done in
+						 * the completion ring */
+	struct vsp2d_req	*pnext;		/* pending list */
+};
+
+struct vsp2d_slot {
+	struct vsp2d_req	*preq;		/* NULL : free */
+	ino_t			src_ino;	/* buffers it held last */
+	ino_t			dst_ino;
+};
+
+struct vsp2d_dev {
+	const char		*pdevnode;
+	struct vsp2_media	*pmedia;
+	bool			cap[VSP2D_MODULE_NUM];	/* has the entity */
+	int			src_fd;		/* -1 : not set up */
+	int			dst_fd;
+	bool			streaming;
+	struct vsp2d_config	cfg;
+	struct vsp2d_slot	slot[VSP2D_SLOT_MAX];
+	int			inflight;
+	MMNGR_ID		lut_id;
+	unsigned long		lut_virt;
+	MMNGR_ID		clu_id;
+	unsigned long		clu_virt;
+
+	unsigned long long	jobs;
+	unsigned long long	configs;
+	long long		config_us;
+};
+
+struct vsp2d_stat {
+	unsigned long long	clients;
+	unsigned long long	jobs;		/* done messages */
+	unsigned long long	failed;
+	unsigned long long	rejected;	/* bad messages or buffers */
+	unsigned long long	warm;
+	unsigned long long	max_pending;
+	unsigned long long	ring_jobs;
+	unsigned long long	doorbells;	/* woken by a ring client */
+	unsigned long long	signals;	/* ring clients woken */
+	long long		wait_us;
+	long long		process_us;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct vsp2d_module vsp2d_module[VSP2D_MODULE_NUM] = {
+	{ "copy",	NULL },
+	{ "uds",	"uds.0" },
+	{ "lut",	"lut" },
+	{ "clu",	"clu" },
+};
+
+static struct vsp2d_dev		vsp2d_dev[VSP2D_DEV_MAX];
+static int			vsp2d_dev_num;
+static int			vsp2d_slot_num = VSP2D_SLOT_NUM;
+static struct vsp2d_client	vsp2d_client[VSP2D_CLIENT_MAX];
+static struct vsp2d_req		*pending_head;
+static struct vsp2d_req		*pending_tail;
+static unsigned long long	pending_num;
+static unsigned long long	job_limit;	/* 0 : run until a signal */
+static struct vsp2d_stat	vsp2d_stat;
+static int			ep_fd = -1;
+static int			listen_fd = -1;
+static bool			quit;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	run_daemon(const char *psocket);
+static int	open_listen(const char *psocket);
+static void	accept_client(void);
+static void	recv_msgs(int idx);
+static void	recv_job(struct vsp2d_client *pclient,
+			 const struct vsp2d_job *pjob, int *pfds, int fd_num);
+static void	close_client(int idx);
+static void	free_client(struct vsp2d_client *pclient);
+static int	check_job(struct vsp2d_req *preq, off_t src_size,
+			  off_t dst_size);
+static int	check_buffer(int fd, ino_t *pino, off_t *psize);
+static void	queue_job(struct vsp2d_req *preq);
+static void	reply(struct vsp2d_client *pclient, unsigned int id,
+		      int result, struct vsp2d_req *preq);
+static int	add_buffer(struct vsp2d_client *pclient, int fd);
+static int	add_ring(struct vsp2d_client *pclient, int *pfds);
+static bool	ring_arm(void);
+static void	ring_disarm(void);
+static void	ring_poll(struct vsp2d_client *pclient);
+static void	ring_complete(struct vsp2d_client *pclient,
+			      const struct vsp2d_done *pdone);
+static void	finish_job(struct vsp2d_req *preq, int result);
+static void	stop(void);
+static void	dispatch(void);
+static struct vsp2d_dev	*pick_dev(const struct vsp2d_config *pcfg,
+				  bool *pwarm, bool *pnone);
+static int	dev_config(struct vsp2d_dev *pdev,
+			   const struct vsp2d_config *pcfg);
+static int	dev_table(struct vsp2d_dev *pdev, int module);
+static void	dev_release(struct vsp2d_dev *pdev);
+static int	dev_queue(struct vsp2d_dev *pdev, struct vsp2d_req *preq);
+static void	dev_complete(struct vsp2d_dev *pdev);
+static void	dev_fail(struct vsp2d_dev *pdev);
+static void	print_vsp2d_stat(void);
+static long long	get_time_us(void);
+
+static int	call_media_ctl(struct vsp2d_dev *pdev, int module);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity, int flags);
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -d <media>: a VSP to serve, up to %d [%s]\n",
+	       VSP2D_DEV_MAX, MEDIA_DEV_NAME);
+	printf("        -s <path>: socket [%s]\n", VSP2D_SOCKET_PATH);
+	printf("        -q <num>: jobs queued per VSP, 1 - %d [%d]\n",
+	       VSP2D_SLOT_MAX, VSP2D_SLOT_NUM);
+	printf("        -n <num>: exit after <num> jobs [run until signal]\n");
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char	*psocket = VSP2D_SOCKET_PATH;
+	int		opt;
+	int		ret;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "d:s:q:n:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			if (vsp2d_dev_num >= VSP2D_DEV_MAX) {
+				printf("Error : too many devices (max %d)\n",
+				       VSP2D_DEV_MAX);
+				exit(1);
+			}
+			vsp2d_dev[vsp2d_dev_num++].pdevnode = optarg;
+			break;
+		case 's':
+			psocket = optarg;
+			break;
+		case 'q':
+			vsp2d_slot_num = atoi(optarg);
+			if (vsp2d_slot_num < 1 ||
+			    vsp2d_slot_num > VSP2D_SLOT_MAX) {
+				printf("Error : -q 1 - %d\n", VSP2D_SLOT_MAX);
+				exit(1);
+			}
+			break;
+		case 'n':
+			job_limit = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (vsp2d_dev_num == 0)
+		vsp2d_dev[vsp2d_dev_num++].pdevnode = MEDIA_DEV_NAME;
+
+	ret = run_daemon(psocket);
+
+	exit(ret < 0 ? 1 : 0);
+}
+
+/******************************************************************************
+ *  service
+ ******************************************************************************/
+static int run_daemon(const char *psocket)
+{
+	struct epoll_event	ev[VSP2D_EVENT_MAX];
+	struct epoll_event	add;
+	struct signalfd_siginfo	si;
+	struct vsp2d_dev	*pdev;
+	sigset_t		mask;
+	unsigned long long	what;
+	unsigned long long	bell;
+	int			sig_fd = -1;
+	int			busy;
+	int			num;
+	int			ret = -1;
+	int			i, m;
+
+	/*-------------------------------------------------------------------*/
+	/*  Devices, set up by the first job that needs them                 */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < vsp2d_dev_num; i++) {
+		pdev = &vsp2d_dev[i];
+		pdev->src_fd		= -1;
+		pdev->dst_fd		= -1;
+		pdev->cfg.module	= -1;
+
+		pdev->pmedia = vsp2_media_open(pdev->pdevnode);
+		if (pdev->pmedia == NULL) {
+			printf("Error : vsp2_media_open(%s)\n",
+			       pdev->pdevnode);
+			goto out;
+		}
+		for (m = 0; m < VSP2D_MODULE_NUM; m++) {
+			pdev->cap[m] = vsp2d_module[m].pentity == NULL ||
+				       vsp2_media_has_entity(pdev->pmedia,
+						vsp2d_module[m].pentity);
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Socket, signals                                                  */
+	/*-------------------------------------------------------------------*/
+	ep_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (ep_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	listen_fd = open_listen(psocket);
+	if (listen_fd < 0)
+		goto out;
+
+	/* a client that goes away must not take the daemon with it */
+	signal(SIGPIPE, SIG_IGN);
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	sig_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if (sig_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	memset(&add, 0, sizeof(add));
+	add.events	= EPOLLIN;
+	add.data.u64	= EV_DATA(EV_LISTEN, 0);
+	if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, listen_fd, &add) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+	add.data.u64	= EV_DATA(EV_SIGNAL, 0);
+	if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, sig_fd, &add) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	printf("exec VSP2D on %d device(s), %d job(s) per VSP, socket %s\n",
+	       vsp2d_dev_num, vsp2d_slot_num, psocket);
+	fflush(stdout);
+
+	/*-------------------------------------------------------------------*/
+	/*  Serve until a signal, then finish what the VSPs have             */
+	/*-------------------------------------------------------------------*/
+	ret = 0;
+	for (;;) {
+		busy = 0;
+		for (i = 0; i < vsp2d_dev_num; i++)
+			busy += vsp2d_dev[i].inflight;
+		if (quit && busy == 0)
+			break;
+
+		/* only look for events while a ring has work */
+		num = epoll_wait(ep_fd, ev, VSP2D_EVENT_MAX,
+				 ring_arm() ? -1 : 0);
+		ring_disarm();
+		if (num < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			ret = -1;
+			break;
+		}
+
+		for (i = 0; i < num; i++) {
+			what = ev[i].data.u64 >> 32;
+			m = (int)(ev[i].data.u64 & 0xffffffff);
+
+			if (what == EV_LISTEN) {
+				accept_client();
+			} else if (what == EV_SIGNAL) {
+				while (read(sig_fd, &si, sizeof(si)) ==
+				       sizeof(si))
+					;
+				quit = true;
+			} else if (what == EV_CLIENT) {
+				recv_msgs(m);
+			} else if (what == EV_DEVICE) {
+				dev_complete(&vsp2d_dev[m]);
+			} else if (what == EV_RING) {
+				if (read(vsp2d_client[m].sq_fd, &bell,
+					 sizeof(bell)) == sizeof(bell))
+					vsp2d_stat.doorbells++;
+			}
+		}
+
+		for (i = 0; i < VSP2D_CLIENT_MAX; i++) {
+			if (vsp2d_client[i].used && vsp2d_client[i].fd >= 0 &&
+			    vsp2d_client[i].pring != NULL)
+				ring_poll(&vsp2d_client[i]);
+		}
+
+		/* completions free slots, new jobs want them */
+		dispatch();
+		if (quit)
+			stop();
+	}
+
+	print_vsp2d_stat();
+
+out:
+	stop();
+	for (i = 0; i < VSP2D_CLIENT_MAX; i++) {
+		if (vsp2d_client[i].used && vsp2d_client[i].fd >= 0)
+			close_client(i);
+	}
+
+	for (i = 0; i < vsp2d_dev_num; i++) {
+		pdev = &vsp2d_dev[i];
+		dev_release(pdev);
+		if (pdev->lut_virt != 0)
+			mmngr_free_in_user(pdev->lut_id);
+		if (pdev->clu_virt != 0)
+			mmngr_free_in_user(pdev->clu_id);
+		vsp2_media_close(pdev->pmedia);
+	}
+
+	if (sig_fd >= 0)
+		close(sig_fd);
+	if (ep_fd >= 0)
+		close(ep_fd);
+	unlink(psocket);
+	return ret;
+}
+
+static int open_listen(const char *psocket)
+{
+	struct sockaddr_un	addr;
+	int			fd;
+
+	if (strlen(psocket) >= sizeof(addr.sun_path)) {
+		printf("Error : socket path too long (%s)\n", psocket);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK,
+		    0);
+	if (fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, psocket);
+
+	/* a socket left by a daemon that did not exit cleanly */
+	unlink(psocket);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, VSP2D_CLIENT_MAX) < 0) {
+		printf("Error : bind(%s) errno=(%d)\n", psocket, errno);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void accept_client(void)
+{
+	struct epoll_event	add;
+	int			fd;
+	int			i;
+
+	while ((fd = accept4(listen_fd, NULL, NULL,
+			     SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+		for (i = 0; i < VSP2D_CLIENT_MAX; i++) {
+			if (!vsp2d_client[i].used)
+				break;
+		}
+		if (i == VSP2D_CLIENT_MAX) {
+			printf("Error : too many clients (max %d)\n",
+			       VSP2D_CLIENT_MAX);
+			close(fd);
+			continue;
+		}
+
+		memset(&add, 0, sizeof(add));
+		add.events	= EPOLLIN;
+		add.data.u64	= EV_DATA(EV_CLIENT, i);
+		if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &add) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			close(fd);
+			continue;
+		}
+
+		vsp2d_client[i].used	= true;
+		vsp2d_client[i].fd	= fd;
+		vsp2d_client[i].refs	= 0;
+		vsp2d_stat.clients++;
+	}
+	if (errno != EAGAIN && errno != EWOULDBLOCK)
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+}
+
+static void recv_msgs(int idx)
+{
+	struct vsp2d_client	*pclient = &vsp2d_client[idx];
+	union {
+		struct vsp2d_job	job;
+		struct vsp2d_ctrl	ctrl;
+	} m;
+	struct msghdr		msg;
+	struct iovec		iov;
+	struct cmsghdr		*pcmsg;
+	union {
+		char		buf[CMSG_SPACE(sizeof(int) * 3)];
+		struct cmsghdr	align;
+	} ctrl;
+	int			fds[3];
+	int			fd_num;
+	int			result;
+	ssize_t			len;
+	int			i, n;
+
+	while (pclient->fd >= 0) {
+		memset(&msg, 0, sizeof(msg));
+		memset(&m, 0, sizeof(m));
+		iov.iov_base		= &m;
+		iov.iov_len		= sizeof(m);
+		msg.msg_iov		= &iov;
+		msg.msg_iovlen		= 1;
+		msg.msg_control		= ctrl.buf;
+		msg.msg_controllen	= sizeof(ctrl.buf);
+
+		len = recvmsg(pclient->fd, &msg, MSG_DONTWAIT |
+			      MSG_CMSG_CLOEXEC);
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (len <= 0) {
+			/* hung up : what it queued is of no use to anyone */
+			close_client(idx);
+			return;
+		}
+
+		fd_num = 0;
+		for (pcmsg = CMSG_FIRSTHDR(&msg); pcmsg != NULL;
+		     pcmsg = CMSG_NXTHDR(&msg, pcmsg)) {
+			if (pcmsg->cmsg_level != SOL_SOCKET ||
+			    pcmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			n = (pcmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (i = 0; i < n; i++) {
+				if (fd_num < 3)
+					memcpy(&fds[fd_num++],
+					       CMSG_DATA(pcmsg) +
+					       i * sizeof(int), sizeof(int));
+			}
+		}
+
+		result = -EINVAL;
+		if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+			/* too long, or too many fds */
+		} else if (m.ctrl.type == VSP2D_MSG_JOB &&
+			   len == sizeof(m.job) && fd_num == 2) {
+			recv_job(pclient, &m.job, fds, fd_num);
+			continue;
+		} else if (m.ctrl.type == VSP2D_MSG_REGISTER &&
+			   len == sizeof(m.ctrl) && fd_num == 1) {
+			result = add_buffer(pclient, fds[0]);
+			fd_num = result < 0 ? 1 : 0;
+		} else if (m.ctrl.type == VSP2D_MSG_RING &&
+			   len == sizeof(m.ctrl) && fd_num == 3) {
+			result = add_ring(pclient, fds);
+			fd_num = result < 0 ? 3 : 0;
+		}
+
+		/* fds not taken over are closed */
+		for (i = 0; i < fd_num; i++)
+			close(fds[i]);
+		if (result < 0)
+			vsp2d_stat.rejected++;
+		reply(pclient, m.ctrl.id, result, NULL);
+	}
+}
+
+static void recv_job(struct vsp2d_client *pclient,
+		     const struct vsp2d_job *pjob, int *pfds, int fd_num)
+{
+	struct vsp2d_req	*preq;
+	off_t			src_size, dst_size;
+	int			result;
+
+	preq = calloc(1, sizeof(*preq));
+	if (preq == NULL) {
+		close(pfds[0]);
+		close(pfds[1]);
+		reply(pclient, pjob->id, -ENOMEM, NULL);
+		return;
+	}
+	preq->pclient	= pclient;
+	preq->job	= *pjob;
+	preq->src_dmafd	= pfds[0];
+	preq->dst_dmafd	= pfds[1];
+	preq->t_recv	= get_time_us();
+
+	result = check_buffer(preq->src_dmafd, &preq->src_ino, &src_size);
+	if (result == 0)
+		result = check_buffer(preq->dst_dmafd, &preq->dst_ino,
+				      &dst_size);
+	if (result == 0)
+		result = quit ? -ECANCELED :
+				check_job(preq, src_size, dst_size);
+	if (result < 0) {
+		close(preq->src_dmafd);
+		close(preq->dst_dmafd);
+		free(preq);
+		vsp2d_stat.rejected++;
+		reply(pclient, pjob->id, result, NULL);
+		return;
+	}
+
+	queue_job(preq);
+}
+
+static void close_client(int idx)
+{
+	struct vsp2d_client	*pclient = &vsp2d_client[idx];
+	struct vsp2d_req	*preq, *pprev = NULL, *pnext;
+
+	if (pclient->fd >= 0) {
+		epoll_ctl(ep_fd, EPOLL_CTL_DEL, pclient->fd, NULL);
+		close(pclient->fd);
+		pclient->fd = -1;
+	}
+
+	/* no completions go out any more, the rings can go now */
+	if (pclient->pring != NULL) {
+		epoll_ctl(ep_fd, EPOLL_CTL_DEL, pclient->sq_fd, NULL);
+		munmap(pclient->pring, pclient->ring_size);
+		close(pclient->sq_fd);
+		close(pclient->cq_fd);
+		pclient->pring = NULL;
+	}
+
+	/* queued jobs go, those on a VSP finish without a reply */
+	for (preq = pending_head; preq != NULL; preq = pnext) {
+		pnext = preq->pnext;
+		if (preq->pclient != pclient) {
+			pprev = preq;
+			continue;
+		}
+		if (pprev != NULL)
+			pprev->pnext = pnext;
+		else
+			pending_head = pnext;
+		if (pending_tail == preq)
+			pending_tail = pprev;
+		pending_num--;
+		finish_job(preq, -ECANCELED);
+	}
+
+	if (pclient->refs == 0)
+		free_client(pclient);
+}
+
+static void free_client(struct vsp2d_client *pclient)
+{
+	int i;
+
+	/* registered buffers stay as long as a job may use them */
+	for (i = 0; i < pclient->buf_num; i++)
+		close(pclient->buf_fd[i]);
+	pclient->buf_num	= 0;
+	pclient->used		= false;
+}
+
+static int check_job(struct vsp2d_req *preq, off_t src_size,
+		     off_t dst_size)
+{
+	struct vsp2d_job	*pjob = &preq->job;
+	struct vsp2d_config	*pcfg = &preq->cfg;
+	bool			scale;
+	int			m;
+
+	pjob->module[VSP2D_MODULE_LEN - 1] = '\0';
+	pcfg->module = -1;
+	for (m = 0; m < VSP2D_MODULE_NUM; m++) {
+		if (strcmp(pjob->module, vsp2d_module[m].pname) == 0)
+			pcfg->module = m;
+	}
+	if (pcfg->module < 0)
+		return -EINVAL;
+
+	pcfg->src_width		= pjob->src_width;
+	pcfg->src_height	= pjob->src_height;
+	pcfg->dst_width		= pjob->dst_width ? pjob->dst_width :
+						    pjob->src_width;
+	pcfg->dst_height	= pjob->dst_height ? pjob->dst_height :
+						     pjob->src_height;
+
+	/* only the scaler changes the size */
+	scale = (strcmp(vsp2d_module[pcfg->module].pname, "uds") == 0);
+	if (pcfg->src_width < 16 || pcfg->src_width > VSP2D_SIZE_MAX ||
+	    pcfg->src_height < 16 || pcfg->src_height > VSP2D_SIZE_MAX ||
+	    pcfg->dst_width < 16 || pcfg->dst_width > VSP2D_SIZE_MAX ||
+	    pcfg->dst_height < 16 || pcfg->dst_height > VSP2D_SIZE_MAX)
+		return -EINVAL;
+	if (!scale && (pcfg->dst_width != pcfg->src_width ||
+		       pcfg->dst_height != pcfg->src_height))
+		return -EINVAL;
+
+	if (src_size < (off_t)pcfg->src_width * pcfg->src_height * 4 ||
+	    dst_size < (off_t)pcfg->dst_width * pcfg->dst_height * 4)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int check_buffer(int fd, ino_t *pino, off_t *psize)
+{
+	struct stat	st;
+	off_t		len;
+
+	/* a dmabuf tells its size by seeking to its end */
+	if (fstat(fd, &st) < 0)
+		return -EBADF;
+	len = lseek(fd, 0, SEEK_END);
+	if (len < 0)
+		return -EBADF;
+
+	*pino = st.st_ino;
+	if (psize != NULL)
+		*psize = len;
+	return 0;
+}
+
+static void queue_job(struct vsp2d_req *preq)
+{
+	/* in arrival order, dispatch() places it */
+	preq->pclient->refs++;
+	if (pending_tail != NULL)
+		pending_tail->pnext = preq;
+	else
+		pending_head = preq;
+	pending_tail = preq;
+	pending_num++;
+	if (pending_num > vsp2d_stat.max_pending)
+		vsp2d_stat.max_pending = pending_num;
+}
+
+static void reply(struct vsp2d_client *pclient, unsigned int id,
+		  int result, struct vsp2d_req *preq)
+{
+	struct vsp2d_done done;
+
+	if (pclient->fd < 0)
+		return;
+
+	memset(&done, 0, sizeof(done));
+	done.type	= VSP2D_MSG_DONE;
+	done.id		= id;
+	done.result	= result;
+	if (preq != NULL) {
+		done.device	= preq->device;
+		done.warm	= preq->warm;
+		if (preq->t_queue != 0) {
+			done.wait_us	= preq->t_queue - preq->t_recv;
+			done.process_us	= get_time_us() - preq->t_queue;
+		}
+		if (preq->ring) {
+			ring_complete(pclient, &done);
+			return;
+		}
+	}
+
+	/*
+	 * a client that does not read its replies is cut off; it goes when
+	 * its hang up is read, not under the caller's feet
+	 */
+	if (send(pclient->fd, &done, sizeof(done),
+		 MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(done)) {
+		printf("Error : client reply errno=(%d)\n", errno);
+		shutdown(pclient->fd, SHUT_RDWR);
+	}
+}
+
+static int add_buffer(struct vsp2d_client *pclient, int fd)
+{
+	int	result;
+
+	if (pclient->buf_num >= VSP2D_BUF_MAX)
+		return -ENOSPC;
+
+	result = check_buffer(fd, &pclient->buf_ino[pclient->buf_num],
+			      &pclient->buf_size[pclient->buf_num]);
+	if (result < 0)
+		return result;
+
+	pclient->buf_fd[pclient->buf_num] = fd;
+	return pclient->buf_num++;
+}
+
+static int add_ring(struct vsp2d_client *pclient, int *pfds)
+{
+	struct vsp2d_ring_hdr	*pring;
+	struct epoll_event	add;
+	struct stat		st;
+	unsigned int		entries;
+	int			seals;
+
+	if (pclient->pring != NULL)
+		return -EBUSY;
+
+	/* a ring that can shrink under the daemon would fault it */
+	seals = fcntl(pfds[0], F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK))
+		return -EINVAL;
+	if (fstat(pfds[0], &st) < 0)
+		return -EBADF;
+	if (st.st_size < (off_t)sizeof(*pring))
+		return -EINVAL;
+
+	pring = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		     pfds[0], 0);
+	if (pring == MAP_FAILED)
+		return -ENOMEM;
+
+	/* read once, the client may change it afterwards */
+	entries = pring->entries;
+	if (entries == 0 || entries > VSP2D_RING_MAX ||
+	    (entries & (entries - 1)) != 0 ||
+	    st.st_size < (off_t)VSP2D_RING_SIZE(entries)) {
+		munmap(pring, st.st_size);
+		return -EINVAL;
+	}
+
+	memset(&add, 0, sizeof(add));
+	add.events	= EPOLLIN;
+	add.data.u64	= EV_DATA(EV_RING, pclient - vsp2d_client);
+	if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, pfds[1], &add) < 0) {
+		munmap(pring, st.st_size);
+		return -EINVAL;
+	}
+
+	pclient->pring		= pring;
+	pclient->psq		= VSP2D_RING_SQ(pring);
+	pclient->pcq		= VSP2D_RING_CQ(pring, entries);
+	pclient->ring_size	= st.st_size;
+	pclient->entries	= entries;
+	pclient->sq_head	= atomic_load(&pring->sq_head);
+	pclient->cq_tail	= atomic_load(&pring->cq_tail);
+	pclient->sq_fd		= pfds[1];
+	pclient->cq_fd		= pfds[2];
+
+	/* the memfd itself is not needed, the mapping holds it */
+	close(pfds[0]);
+	return 0;
+}
+
+static bool ring_arm(void)
+{
+	struct vsp2d_client	*pclient;
+	struct vsp2d_ring_hdr	*pring;
+	bool			sleep = true;
+	int			i;
+
+	for (i = 0; i < VSP2D_CLIENT_MAX; i++) {
+		pclient = &vsp2d_client[i];
+		if (pclient->used && pclient->fd >= 0 &&
+		    pclient->pring != NULL)
+			atomic_store(&pclient->pring->sq_armed, 1);
+	}
+
+	/* pairs with the fence after the client's tail store */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	for (i = 0; i < VSP2D_CLIENT_MAX; i++) {
+		pclient = &vsp2d_client[i];
+		pring = pclient->pring;
+		if (!pclient->used || pclient->fd < 0 || pring == NULL)
+			continue;
+		if (atomic_load_explicit(&pring->sq_tail,
+					 memory_order_acquire) !=
+		    pclient->sq_head &&
+		    pclient->sq_head - atomic_load_explicit(&pring->cq_head,
+					memory_order_acquire) <
+		    pclient->entries)
+			sleep = false;
+	}
+	return sleep;
+}
+
+static void ring_disarm(void)
+{
+	struct vsp2d_client	*pclient;
+	int			i;
+
+	for (i = 0; i < VSP2D_CLIENT_MAX; i++) {
+		pclient = &vsp2d_client[i];
+		if (pclient->used && pclient->fd >= 0 &&
+		    pclient->pring != NULL)
+			atomic_store_explicit(&pclient->pring->sq_armed, 0,
+					      memory_order_relaxed);
+	}
+}
+
+static void ring_poll(struct vsp2d_client *pclient)
+{
+	struct vsp2d_ring_hdr	*pring = pclient->pring;
+	struct vsp2d_req	*preq;
+	struct vsp2d_sqe	sqe;
+	unsigned int		tail, cq_head;
+	int			result;
+
+	tail = atomic_load_explicit(&pring->sq_tail, memory_order_acquire);
+	if (tail - pclient->sq_head > pclient->entries) {
+		printf("Error : client ring overrun\n");
+		shutdown(pclient->fd, SHUT_RDWR);
+		return;
+	}
+	cq_head = atomic_load_explicit(&pring->cq_head, memory_order_acquire);
+
+	/* no more out than the completion ring holds */
+	while (pclient->sq_head != tail &&
+	       pclient->sq_head - cq_head < pclient->entries) {
+		preq = calloc(1, sizeof(*preq));
+		if (preq == NULL)
+			break;
+
+		/* a copy, the client may write the entry again at once */
+		sqe = pclient->psq[pclient->sq_head & (pclient->entries - 1)];
+		pclient->sq_head++;
+
+		preq->pclient	= pclient;
+		preq->job	= sqe.job;
+		preq->ring	= true;
+		preq->t_recv	= get_time_us();
+
+		if (sqe.src_buf >= pclient->buf_num ||
+		    sqe.dst_buf >= pclient->buf_num) {
+			result = -EINVAL;
+		} else {
+			preq->src_dmafd	= pclient->buf_fd[sqe.src_buf];
+			preq->dst_dmafd	= pclient->buf_fd[sqe.dst_buf];
+			preq->src_ino	= pclient->buf_ino[sqe.src_buf];
+			preq->dst_ino	= pclient->buf_ino[sqe.dst_buf];
+			result = quit ? -ECANCELED :
+				 check_job(preq,
+					   pclient->buf_size[sqe.src_buf],
+					   pclient->buf_size[sqe.dst_buf]);
+		}
+		if (result < 0) {
+			vsp2d_stat.rejected++;
+			reply(pclient, sqe.job.id, result, preq);
+			free(preq);
+			continue;
+		}
+
+		queue_job(preq);
+	}
+
+	atomic_store_explicit(&pring->sq_head, pclient->sq_head,
+			      memory_order_release);
+}
+
+static void ring_complete(struct vsp2d_client *pclient,
+			  const struct vsp2d_done *pdone)
+{
+	struct vsp2d_ring_hdr	*pring = pclient->pring;
+	unsigned long long	one = 1;
+
+	pclient->pcq[pclient->cq_tail & (pclient->entries - 1)] = *pdone;
+	pclient->cq_tail++;
+	atomic_store_explicit(&pring->cq_tail, pclient->cq_tail,
+			      memory_order_release);
+
+	/* pairs with the fence after the client arms */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&pring->cq_armed, memory_order_relaxed) &&
+	    atomic_exchange(&pring->cq_armed, 0)) {
+		if (write(pclient->cq_fd, &one, sizeof(one)) != sizeof(one))
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		vsp2d_stat.signals++;
+	}
+}
+
+static void finish_job(struct vsp2d_req *preq, int result)
+{
+	struct vsp2d_client	*pclient = preq->pclient;
+	long long		t = get_time_us();
+
+	if (result == 0) {
+		vsp2d_stat.jobs++;
+		vsp2d_stat.wait_us	+= preq->t_queue - preq->t_recv;
+		vsp2d_stat.process_us	+= t - preq->t_queue;
+		if (preq->warm)
+			vsp2d_stat.warm++;
+		if (preq->ring)
+			vsp2d_stat.ring_jobs++;
+	} else {
+		vsp2d_stat.failed++;
+	}
+
+	/* registered buffers are the client's, not the job's */
+	if (!preq->ring) {
+		close(preq->src_dmafd);
+		close(preq->dst_dmafd);
+	}
+	pclient->refs--;
+	reply(pclient, preq->job.id, result, preq);
+	free(preq);
+
+	if (pclient->fd < 0 && pclient->refs == 0)
+		free_client(pclient);
+
+	/* the main loop stops */
+	if (job_limit != 0 &&
+	    vsp2d_stat.jobs + vsp2d_stat.failed >= job_limit)
+		quit = true;
+}
+
+static void stop(void)
+{
+	struct vsp2d_req *preq;
+
+	/* no new jobs; the queued ones are cancelled, the VSPs finish */
+	quit = true;
+	if (listen_fd >= 0) {
+		epoll_ctl(ep_fd, EPOLL_CTL_DEL, listen_fd, NULL);
+		close(listen_fd);
+		listen_fd = -1;
+	}
+	while ((preq = pending_head) != NULL) {
+		pending_head = preq->pnext;
+		pending_num--;
+		finish_job(preq, -ECANCELED);
+	}
+	pending_tail = NULL;
+}
+
+/******************************************************************************
+ *  dispatch
+ ******************************************************************************/
+static void dispatch(void)
+{
+	struct vsp2d_req	*preq, *pprev = NULL, *pnext;
+	struct vsp2d_dev	*pdev;
+	bool			warm, none;
+
+	for (preq = pending_head; preq != NULL; preq = pnext) {
+		pnext = preq->pnext;
+
+		pdev = pick_dev(&preq->cfg, &warm, &none);
+		if (pdev == NULL && !none) {
+			/* waits, jobs behind it for other VSPs go on */
+			pprev = preq;
+			continue;
+		}
+
+		if (pprev != NULL)
+			pprev->pnext = pnext;
+		else
+			pending_head = pnext;
+		if (pending_tail == preq)
+			pending_tail = pprev;
+		pending_num--;
+		preq->pnext = NULL;
+
+		if (pdev == NULL) {
+			finish_job(preq, -ENODEV);
+			continue;
+		}
+		if (!warm && dev_config(pdev, &preq->cfg) < 0) {
+			finish_job(preq, -EIO);
+			continue;
+		}
+		preq->warm = warm;
+		if (dev_queue(pdev, preq) < 0)
+			finish_job(preq, -EIO);
+	}
+}
+
+static struct vsp2d_dev *pick_dev(const struct vsp2d_config *pcfg,
+				  bool *pwarm, bool *pnone)
+{
+	struct vsp2d_dev	*pdev;
+	struct vsp2d_dev	*pidle = NULL;
+	int			i;
+
+	*pwarm = false;
+	*pnone = true;
+
+	/* a VSP set up for it with room, then an idle one, empty first */
+	for (i = 0; i < vsp2d_dev_num; i++) {
+		pdev = &vsp2d_dev[i];
+		if (!pdev->cap[pcfg->module])
+			continue;
+		*pnone = false;
+
+		if (memcmp(&pdev->cfg, pcfg, sizeof(*pcfg)) == 0) {
+			if (pdev->inflight < vsp2d_slot_num) {
+				*pwarm = true;
+				return pdev;
+			}
+			continue;
+		}
+		if (pdev->inflight == 0 &&
+		    (pidle == NULL || (pidle->cfg.module >= 0 &&
+				       pdev->cfg.module < 0)))
+			pidle = pdev;
+	}
+	return pidle;
+}
+
+/******************************************************************************
+ *  device
+ ******************************************************************************/
+static int dev_config(struct vsp2d_dev *pdev,
+		      const struct vsp2d_config *pcfg)
+{
+	struct v4l2_mbus_framefmt	format;
+	struct v4l2_format		fmt;
+	struct v4l2_requestbuffers	req_buf;
+	const char			*pentity;
+	long long			t_start;
+	int				i;
+
+	vsp2_trace_begin("configure");
+	t_start = get_time_us();
+
+	/* the queues must be idle and empty to change the pipeline */
+	dev_release(pdev);
+	pentity = vsp2d_module[pcfg->module].pentity;
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	if (call_media_ctl(pdev, pcfg->module) < 0) {
+		printf("Error : media-ctl call failed.\n");
+		goto err;
+	}
+
+	format.width	= pcfg->src_width;
+	format.height	= pcfg->src_height;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pdev->pmedia, "rpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pdev->pmedia, "rpf.0", 1, &format) != 0 ||
+	    (pentity != NULL &&
+	     vsp2_media_set_format(pdev->pmedia, pentity, 0, &format) != 0)) {
+		printf("Error : vsp2_media_set_format(%ux%u)\n",
+		       pcfg->src_width, pcfg->src_height);
+		goto err;
+	}
+
+	format.width	= pcfg->dst_width;
+	format.height	= pcfg->dst_height;
+	if ((pentity != NULL &&
+	     vsp2_media_set_format(pdev->pmedia, pentity, 1, &format) != 0) ||
+	    vsp2_media_set_format(pdev->pmedia, "wpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pdev->pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(%ux%u)\n",
+		       pcfg->dst_width, pcfg->dst_height);
+		goto err;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device, completions are polled                              */
+	/*-------------------------------------------------------------------*/
+	pdev->src_fd = open_video_device(pdev->pmedia, SRC_INPUT_DEV,
+					 O_RDWR | O_NONBLOCK);
+	if (pdev->src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		goto err;
+	}
+
+	pdev->dst_fd = open_video_device(pdev->pmedia, DST_OUTPUT_DEV,
+					 O_RDWR | O_NONBLOCK);
+	if (pdev->dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		goto err;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= pcfg->src_width;
+	fmt.fmt.pix_mp.height		= pcfg->src_height;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	if (ioctl(pdev->src_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= pcfg->dst_width;
+	fmt.fmt.pix_mp.height		= pcfg->dst_height;
+	/* the source stride came back in it, a smaller output wants its own */
+	memset(fmt.fmt.pix_mp.plane_fmt, 0, sizeof(fmt.fmt.pix_mp.plane_fmt));
+
+	if (ioctl(pdev->dst_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Lookup table - VIDIOC_VSP2_LUT_CONFIG / VIDIOC_VSP2_CLU_CONFIG   */
+	/*-------------------------------------------------------------------*/
+	if (dev_table(pdev, pcfg->module) < 0)
+		goto err;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (dmabuf, one slot per job on the VSP)             */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= vsp2d_slot_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_DMABUF;
+
+	if (ioctl(pdev->src_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+	    (int)req_buf.count != vsp2d_slot_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	req_buf.count	= vsp2d_slot_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(pdev->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+	    (int)req_buf.count != vsp2d_slot_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	for (i = 0; i < VSP2D_SLOT_MAX; i++)
+		memset(&pdev->slot[i], 0, sizeof(pdev->slot[i]));
+	pdev->cfg = *pcfg;
+	pdev->configs++;
+	pdev->config_us += get_time_us() - t_start;
+	vsp2_trace_end();
+	return 0;
+
+err:
+	dev_release(pdev);
+	vsp2_trace_end();
+	return -1;
+}
+
+static int dev_table(struct vsp2d_dev *pdev, int module)
+{
+	struct vsp2_lut_config	lut_par;
+	struct vsp2_clu_config	clu_par;
+	unsigned int		*ptbl;
+	unsigned long		phys, hard;
+	bool			lut;
+	int			fd;
+	int			ret;
+	int			r, g, b;
+	int			i;
+
+	lut = (strcmp(vsp2d_module[module].pname, "lut") == 0);
+	if (!lut && strcmp(vsp2d_module[module].pname, "clu") != 0)
+		return 0;
+
+	/* filled once, given to the module at every set up */
+	if (lut && pdev->lut_virt == 0) {
+		ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &pdev->lut_id,
+				     LUT_TBL_NUM * 8, &phys, &hard,
+				     &pdev->lut_virt, MMNGR_VA_SUPPORT);
+		if (ret != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			pdev->lut_virt = 0;
+			return -1;
+		}
+
+		/* negative */
+		ptbl = (unsigned int *)pdev->lut_virt;
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			ptbl[i*2]	= LUT_REG_ADDR + i*4;
+			ptbl[i*2+1]	= (255 - i) << 16
+					| (255 - i) << 8
+					| (255 - i);
+		}
+	}
+	if (!lut && pdev->clu_virt == 0) {
+		ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &pdev->clu_id,
+				     CLU_TBL_NUM * 8, &phys, &hard,
+				     &pdev->clu_virt, MMNGR_VA_SUPPORT);
+		if (ret != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			pdev->clu_virt = 0;
+			return -1;
+		}
+
+		/* sepia */
+		ptbl = (unsigned int *)pdev->clu_virt;
+		for (b = 0; b < CLU_GRID; b++) {
+			for (g = 0; g < CLU_GRID; g++) {
+				for (r = 0; r < CLU_GRID; r++) {
+					i = (r * 77 + g * 150 + b * 29) *
+					    255 / 16 / 256;
+					*ptbl++ = CLU_REG_DATA;
+					*ptbl++ = (i * 240 / 255 + 15) << 16
+						| (i * 200 / 255 + 10) << 8
+						| (i * 145 / 255);
+				}
+			}
+		}
+	}
+
+	fd = open_video_device(pdev->pmedia, vsp2d_module[module].pentity,
+			       O_RDWR);
+	if (fd == -1) {
+		printf("Error open %s device: %s (%d).\n",
+		       vsp2d_module[module].pentity, strerror(errno), errno);
+		return -1;
+	}
+
+	if (lut) {
+		memset(&lut_par, 0, sizeof(lut_par));
+		lut_par.addr	= (void *)pdev->lut_virt;
+		lut_par.tbl_num	= LUT_TBL_NUM;
+		lut_par.fxa	= 0x80;
+		ret = ioctl(fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+	} else {
+		memset(&clu_par, 0, sizeof(clu_par));
+		clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
+		clu_par.addr	= (void *)pdev->clu_virt;
+		clu_par.tbl_num	= CLU_TBL_NUM;
+		ret = ioctl(fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par);
+	}
+	close(fd);
+
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static void dev_release(struct vsp2d_dev *pdev)
+{
+	struct v4l2_requestbuffers	req_buf;
+	unsigned int			type;
+
+	if (pdev->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(pdev->src_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pdev->dst_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		pdev->streaming = false;
+	}
+
+	/* the dmabuf attachments go with the buffers */
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.memory	= V4L2_MEMORY_DMABUF;
+	if (pdev->src_fd != -1) {
+		req_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		ioctl(pdev->src_fd, VIDIOC_REQBUFS, &req_buf);
+		close(pdev->src_fd);
+		pdev->src_fd = -1;
+	}
+	if (pdev->dst_fd != -1) {
+		req_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		ioctl(pdev->dst_fd, VIDIOC_REQBUFS, &req_buf);
+		if (pdev->inflight > 0)
+			epoll_ctl(ep_fd, EPOLL_CTL_DEL, pdev->dst_fd, NULL);
+		close(pdev->dst_fd);
+		pdev->dst_fd = -1;
+	}
+	pdev->cfg.module = -1;
+}
+
+static int dev_queue(struct vsp2d_dev *pdev, struct vsp2d_req *preq)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	struct vsp2d_slot	*pslot = NULL;
+	struct epoll_event	add;
+	unsigned int		src_size, dst_size;
+	unsigned int		type;
+	int			i;
+
+	/*
+	 * a buffer that comes back goes to the slot that held it last, so
+	 * its attachment and mapping are still in place
+	 */
+	for (i = 0; i < vsp2d_slot_num; i++) {
+		if (pdev->slot[i].preq != NULL)
+			continue;
+		if (pdev->slot[i].dst_ino == preq->dst_ino &&
+		    pdev->slot[i].src_ino == preq->src_ino) {
+			pslot = &pdev->slot[i];
+			break;
+		}
+		if (pslot == NULL || (pslot->dst_ino != 0 &&
+				      pdev->slot[i].dst_ino == 0))
+			pslot = &pdev->slot[i];
+	}
+	if (pslot == NULL)
+		return -1;
+
+	src_size = preq->cfg.src_width * preq->cfg.src_height * 4;
+	dst_size = preq->cfg.dst_width * preq->cfg.dst_height * 4;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QBUF                                                      */
+	/*-------------------------------------------------------------------*/
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= pslot - pdev->slot;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_DMABUF;
+	buf.length	= 1;
+	buf.m.planes[0].m.fd		= preq->dst_dmafd;
+	buf.m.planes[0].bytesused	= dst_size;
+	buf.m.planes[0].length		= dst_size;
+	buf.bytesused			= dst_size;
+
+	if (ioctl(pdev->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.m.planes[0].m.fd		= preq->src_dmafd;
+	buf.m.planes[0].bytesused	= src_size;
+	buf.m.planes[0].length		= src_size;
+	buf.bytesused			= src_size;
+
+	if (ioctl(pdev->src_fd, VIDIOC_QBUF, &buf) < 0) {
+		/* the wpf buffer is out, only a new set up gets it back */
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		dev_fail(pdev);
+		return -1;
+	}
+
+	pslot->preq	= preq;
+	pslot->src_ino	= preq->src_ino;
+	pslot->dst_ino	= preq->dst_ino;
+	preq->device	= pdev - vsp2d_dev;
+	preq->t_queue	= get_time_us();
+
+	/* the wpf node is watched only while it has something to give */
+	if (pdev->inflight++ == 0) {
+		memset(&add, 0, sizeof(add));
+		add.events	= EPOLLIN;
+		add.data.u64	= EV_DATA(EV_DEVICE, pdev - vsp2d_dev);
+		if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, pdev->dst_fd, &add) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			dev_fail(pdev);
+			return 0;
+		}
+	}
+
+	if (pdev->streaming)
+		return 0;
+
+	/* the queues start on their first buffers */
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (ioctl(pdev->src_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		dev_fail(pdev);
+		return 0;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(pdev->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		dev_fail(pdev);
+		return 0;
+	}
+	pdev->streaming = true;
+
+	return 0;
+}
+
+static void dev_complete(struct vsp2d_dev *pdev)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	struct vsp2d_slot	*pslot;
+	struct vsp2d_req	*preq;
+	unsigned int		idx;
+	int			result;
+
+	while (pdev->inflight > 0) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= V4L2_MEMORY_DMABUF;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		if (ioctl(pdev->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+			if (errno == EAGAIN)
+				return;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			dev_fail(pdev);
+			return;
+		}
+		idx	= buf.index;
+		result	= (buf.flags & V4L2_BUF_FLAG_ERROR) ? -EIO : 0;
+
+		/* the source of a finished frame is done as well */
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		if (ioctl(pdev->src_fd, VIDIOC_DQBUF, &buf) < 0 ||
+		    buf.index != idx || idx >= (unsigned int)vsp2d_slot_num ||
+		    pdev->slot[idx].preq == NULL) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			dev_fail(pdev);
+			return;
+		}
+
+		pslot		= &pdev->slot[idx];
+		preq		= pslot->preq;
+		pslot->preq	= NULL;
+		if (--pdev->inflight == 0)
+			epoll_ctl(ep_fd, EPOLL_CTL_DEL, pdev->dst_fd, NULL);
+		pdev->jobs++;
+		finish_job(preq, result);
+	}
+}
+
+static void dev_fail(struct vsp2d_dev *pdev)
+{
+	struct vsp2d_req	*preq;
+	int			i;
+
+	/* everything on it fails, the next job sets it up from scratch */
+	dev_release(pdev);
+	for (i = 0; i < VSP2D_SLOT_MAX; i++) {
+		preq = pdev->slot[i].preq;
+		pdev->slot[i].preq = NULL;
+		if (preq != NULL)
+			finish_job(preq, -EIO);
+	}
+	pdev->inflight = 0;
+}
+
+static void print_vsp2d_stat(void)
+{
+	struct vsp2d_dev	*pdev;
+	double			n = vsp2d_stat.jobs ? vsp2d_stat.jobs : 1;
+	int			i;
+
+	printf("\n----- VSP2D -----\n");
+	printf("clients       : %llu\n", vsp2d_stat.clients);
+	printf("jobs          : %llu done, %llu failed, %llu rejected\n",
+	       vsp2d_stat.jobs, vsp2d_stat.failed, vsp2d_stat.rejected);
+	printf("warm          : %llu of %llu (%.1f %%), %llu queued at most\n",
+	       vsp2d_stat.warm, vsp2d_stat.jobs,
+	       vsp2d_stat.warm * 100.0 / n, vsp2d_stat.max_pending);
+	printf("per job       : wait %.2f ms, process %.2f ms\n",
+	       vsp2d_stat.wait_us / n / 1000,
+	       vsp2d_stat.process_us / n / 1000);
+	printf("rings         : %llu jobs, %llu doorbells, %llu signals\n",
+	       vsp2d_stat.ring_jobs, vsp2d_stat.doorbells, vsp2d_stat.signals);
+	for (i = 0; i < vsp2d_dev_num; i++) {
+		pdev = &vsp2d_dev[i];
+		printf("%-13s : %llu jobs, %llu set up(s) in %.2f ms\n",
+		       pdev->pdevnode, pdev->jobs, pdev->configs,
+		       pdev->config_us / 1000.0);
+	}
+	printf("----------------------\n");
+	fflush(stdout);
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int call_media_ctl(struct vsp2d_dev *pdev, int module)
+{
+	struct vsp2_media	*pmedia = pdev->pmedia;
+	const char		*pentity = vsp2d_module[module].pentity;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [module] -> wpf.0:0   */
+	/*----------------------------------*/
+	if (pentity == NULL) {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
+			return -1;
+		}
+	} else {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pentity, 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> %s)\n",
+			       pentity);
+			return -1;
+		}
+		if (vsp2_media_setup_link(pmedia, pentity, 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(%s -> wpf)\n",
+			       pentity);
+			return -1;
+		}
+	}
+
+	/*----------------------------------*/
+	/* wpf.0:1 -> wpf.0 output          */
+	/*----------------------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/* the reset applies when the nodes are opened again */
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity,
+			     int flags)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, flags);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
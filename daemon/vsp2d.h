@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2d protocol : one SOCK_SEQPACKET message per job and per completion.
+ *
+ *    client -> vsp2d : struct vsp2d_job, with the source and destination
+ *                      dmabuf fds attached as SCM_RIGHTS, in that order
+ *    vsp2d -> client : struct vsp2d_done, when the destination is written
+ *
+ *  Frames are ARGB32. The daemon keeps its own references to the buffers
+ *  until the job is done, so the client may close its fds right after the
+ *  send; it must not touch the destination before the done message.
+ *
+ *  Shared rings : a client may instead register its buffers once and set
+ *  up a ring pair in a memfd (struct vsp2d_ring_hdr, then the submission
+ *  and the completion entries). Jobs and completions then pass through
+ *  memory only; an eventfd is written only when the other side sleeps,
+ *  announced by its armed flag. daemon/vsp2d_ring.h does the client side.
+ *
+ *    VSP2D_MSG_REGISTER : struct vsp2d_ctrl, one dmabuf fd attached;
+ *                         result is the buffer index
+ *    VSP2D_MSG_RING     : struct vsp2d_ctrl, the ring memfd, then the
+ *                         submit and the complete eventfds attached
+ *
+ *  Both are answered by a struct vsp2d_done on the socket. Registered
+ *  buffers stay with the daemon until the client hangs up.
+ ******************************************************************************/
+#ifndef VSP2D_H
+#define VSP2D_H
+
+#include <stdatomic.h>
+
+#define VSP2D_SOCKET_PATH	"/tmp/vsp2d.sock"
+#define VSP2D_MODULE_LEN	(16)
+#define VSP2D_BUF_MAX		(64)	/* registered buffers per client */
+#define VSP2D_RING_MAX		(256)	/* entries, a power of two */
+#define VSP2D_RING_LINE		(64)	/* cache line */
+
+enum vsp2d_msg_type {
+	VSP2D_MSG_JOB = 1,
+	VSP2D_MSG_DONE,
+	VSP2D_MSG_REGISTER,
+	VSP2D_MSG_RING,
+};
+
+struct vsp2d_job {
+	unsigned int	type;		/* VSP2D_MSG_JOB */
+	unsigned int	id;		/* echoed in the done message */
+	char		module[VSP2D_MODULE_LEN];	/* copy, uds, lut, clu */
+	unsigned int	src_width;
+	unsigned int	src_height;
+	unsigned int	dst_width;	/* uds only, 0 : as the source */
+	unsigned int	dst_height;
+};
+
+struct vsp2d_done {
+	unsigned int	type;		/* VSP2D_MSG_DONE */
+	unsigned int	id;
+	int		result;		/* 0, or a negative errno */
+	unsigned int	device;		/* index of the VSP that ran it */
+	unsigned int	warm;		/* 1 : the pipeline was set up already */
+	unsigned int	reserved;
+	long long	wait_us;	/* received -> queued to the VSP */
+	long long	process_us;	/* queued -> destination done */
+};
+
+struct vsp2d_ctrl {
+	unsigned int	type;		/* VSP2D_MSG_REGISTER / _RING */
+	unsigned int	id;		/* echoed in the done message */
+};
+
+/* submission entry : a job on registered buffers */
+struct vsp2d_sqe {
+	struct vsp2d_job	job;	/* type is not looked at */
+	unsigned int		src_buf;
+	unsigned int		dst_buf;
+};
+
+/* at the start of the ring memfd; each index is written by one side */
+struct vsp2d_ring_hdr {
+	unsigned int		entries;	/* set by the client */
+
+	/* submission : the client produces, vsp2d consumes */
+	_Atomic unsigned int	sq_tail __attribute__((aligned(VSP2D_RING_LINE)));
+	_Atomic unsigned int	sq_head __attribute__((aligned(VSP2D_RING_LINE)));
+	_Atomic int		sq_armed;	/* vsp2d sleeps */
+
+	/* completion : vsp2d produces, the client consumes */
+	_Atomic unsigned int	cq_tail __attribute__((aligned(VSP2D_RING_LINE)));
+	_Atomic unsigned int	cq_head __attribute__((aligned(VSP2D_RING_LINE)));
+	_Atomic int		cq_armed;	/* the client sleeps */
+} __attribute__((aligned(VSP2D_RING_LINE)));
+
+#define VSP2D_RING_SQ(phdr) \
+	((struct vsp2d_sqe *)((char *)(phdr) + sizeof(struct vsp2d_ring_hdr)))
+#define VSP2D_RING_CQ(phdr, entries) \
+	((struct vsp2d_done *)(VSP2D_RING_SQ(phdr) + (entries)))
+#define VSP2D_RING_SIZE(entries) \
+	(sizeof(struct vsp2d_ring_hdr) + \
+	 (entries) * (sizeof(struct vsp2d_sqe) + sizeof(struct vsp2d_done)))
+
+#endif /* VSP2D_H */
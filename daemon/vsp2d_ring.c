@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2d ring client
+ *  The ring pair lives in a sealed memfd mapped by both sides. sq_tail and
+ *  cq_head are written here only, sq_head and cq_tail by vsp2d only; the
+ *  indexes run freely and are masked on access. No more jobs are out than
+ *  the ring has entries, so a completion always finds a free entry.
+ *
+ *  armed is the sleep handshake of common/vsp2_ring.c : the sleeping side
+ *  sets it and rechecks the tail, the other side publishes the tail and
+ *  checks armed, with a full fence on both sides.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "vsp2d_ring.h"
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2d_ring {
+	int			sock_fd;
+	int			sq_fd;		/* doorbell to vsp2d */
+	int			cq_fd;		/* vsp2d wakes us */
+	struct vsp2d_ring_hdr	*phdr;
+	struct vsp2d_sqe	*psq;
+	struct vsp2d_done	*pcq;
+	size_t			size;
+	unsigned int		entries;
+	unsigned int		sq_tail;	/* own indexes */
+	unsigned int		cq_head;
+	unsigned int		ctrl_id;
+	struct vsp2d_ring_stat	stat;
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	send_ctrl(struct vsp2d_ring *pr, unsigned int type, int *pfds,
+			  int fd_num);
+
+/******************************************************************************
+ *  interface
+ ******************************************************************************/
+struct vsp2d_ring *vsp2d_ring_open(const char *psocket, unsigned int entries)
+{
+	struct vsp2d_ring	*pr;
+	struct sockaddr_un	addr;
+	unsigned int		num = 1;
+	int			fds[3];
+	int			mem_fd = -1;
+
+	if (entries == 0 || entries > VSP2D_RING_MAX ||
+	    strlen(psocket) >= sizeof(addr.sun_path)) {
+		printf("Error : vsp2d_ring_open(%s, %u)\n", psocket, entries);
+		return NULL;
+	}
+	while (num < entries)
+		num <<= 1;
+
+	pr = calloc(1, sizeof(*pr));
+	if (pr == NULL)
+		return NULL;
+	pr->sock_fd	= -1;
+	pr->sq_fd	= -1;
+	pr->cq_fd	= -1;
+	pr->phdr	= MAP_FAILED;
+	pr->entries	= num;
+	pr->size	= VSP2D_RING_SIZE(num);
+
+	pr->sock_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (pr->sock_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, psocket);
+	if (connect(pr->sock_fd, (struct sockaddr *)&addr,
+		    sizeof(addr)) < 0) {
+		printf("Error : vsp2d not running on %s errno=(%d)\n",
+		       psocket, errno);
+		goto err;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Ring memory : sealed, it cannot shrink under the daemon          */
+	/*-------------------------------------------------------------------*/
+	mem_fd = memfd_create("vsp2d ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (mem_fd < 0 || ftruncate(mem_fd, pr->size) < 0 ||
+	    fcntl(mem_fd, F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+	pr->phdr = mmap(NULL, pr->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			mem_fd, 0);
+	if (pr->phdr == MAP_FAILED) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+	pr->phdr->entries	= num;
+	pr->psq			= VSP2D_RING_SQ(pr->phdr);
+	pr->pcq			= VSP2D_RING_CQ(pr->phdr, num);
+
+	pr->sq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	pr->cq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (pr->sq_fd < 0 || pr->cq_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto err;
+	}
+
+	fds[0] = mem_fd;
+	fds[1] = pr->sq_fd;
+	fds[2] = pr->cq_fd;
+	if (send_ctrl(pr, VSP2D_MSG_RING, fds, 3) < 0)
+		goto err;
+
+	/* the mapping holds the memory */
+	close(mem_fd);
+	return pr;
+
+err:
+	if (mem_fd >= 0)
+		close(mem_fd);
+	vsp2d_ring_close(pr, NULL);
+	return NULL;
+}
+
+void vsp2d_ring_close(struct vsp2d_ring *pr, struct vsp2d_ring_stat *pstat)
+{
+	if (pr == NULL)
+		return;
+
+	if (pstat != NULL)
+		*pstat = pr->stat;
+
+	/* vsp2d lets go of the ring and the buffers when we hang up */
+	if (pr->sock_fd >= 0)
+		close(pr->sock_fd);
+	if (pr->phdr != MAP_FAILED)
+		munmap(pr->phdr, pr->size);
+	if (pr->sq_fd >= 0)
+		close(pr->sq_fd);
+	if (pr->cq_fd >= 0)
+		close(pr->cq_fd);
+	free(pr);
+}
+
+int vsp2d_ring_register(struct vsp2d_ring *pr, int dmabuf_fd)
+{
+	return send_ctrl(pr, VSP2D_MSG_REGISTER, &dmabuf_fd, 1);
+}
+
+int vsp2d_ring_submit(struct vsp2d_ring *pr, const struct vsp2d_sqe *psqe,
+		      int num)
+{
+	struct vsp2d_ring_hdr	*phdr = pr->phdr;
+	unsigned int		space;
+	unsigned long long	one = 1;
+	int			i;
+
+	/* jobs out, not the submission ring alone, bound what goes in */
+	space = pr->entries - (pr->sq_tail - pr->cq_head);
+	if (num > (int)space)
+		num = space;
+	if (num <= 0)
+		return 0;
+
+	for (i = 0; i < num; i++)
+		pr->psq[(pr->sq_tail + i) & (pr->entries - 1)] = psqe[i];
+	pr->sq_tail += num;
+	atomic_store_explicit(&phdr->sq_tail, pr->sq_tail,
+			      memory_order_release);
+	pr->stat.submitted += num;
+
+	/* pairs with the fence after vsp2d arms */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&phdr->sq_armed, memory_order_relaxed) &&
+	    atomic_exchange(&phdr->sq_armed, 0)) {
+		if (write(pr->sq_fd, &one, sizeof(one)) != sizeof(one))
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		pr->stat.doorbells++;
+	}
+	return num;
+}
+
+int vsp2d_ring_reap(struct vsp2d_ring *pr, struct vsp2d_done *pdone,
+		    int max, bool wait)
+{
+	struct vsp2d_ring_hdr	*phdr = pr->phdr;
+	struct pollfd		pfd[2];
+	unsigned long long	val;
+	unsigned int		tail;
+	int			n;
+
+	for (;;) {
+		tail = atomic_load_explicit(&phdr->cq_tail,
+					    memory_order_acquire);
+		for (n = 0; n < max && pr->cq_head != tail; n++) {
+			pdone[n] = pr->pcq[pr->cq_head & (pr->entries - 1)];
+			pr->cq_head++;
+		}
+		if (n > 0) {
+			atomic_store_explicit(&phdr->cq_head, pr->cq_head,
+					      memory_order_release);
+			pr->stat.reaped += n;
+			return n;
+		}
+		if (!wait || pr->sq_tail == pr->cq_head)
+			return 0;
+
+		/* arm, then look once more before sleeping */
+		atomic_store(&phdr->cq_armed, 1);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (atomic_load_explicit(&phdr->cq_tail,
+					 memory_order_acquire) != pr->cq_head) {
+			atomic_store(&phdr->cq_armed, 0);
+			continue;
+		}
+
+		/* the socket only says something when vsp2d goes away */
+		pfd[0].fd	= pr->cq_fd;
+		pfd[0].events	= POLLIN;
+		pfd[1].fd	= pr->sock_fd;
+		pfd[1].events	= POLLIN;
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		if (pfd[1].revents != 0) {
+			printf("Error : vsp2d hung up\n");
+			return -1;
+		}
+		if (read(pr->cq_fd, &val, sizeof(val)) == sizeof(val))
+			pr->stat.waits++;
+	}
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int send_ctrl(struct vsp2d_ring *pr, unsigned int type, int *pfds,
+		     int fd_num)
+{
+	struct vsp2d_ctrl	msg_ctrl;
+	struct vsp2d_done	done;
+	struct msghdr		msg;
+	struct iovec		iov;
+	struct cmsghdr		*pcmsg;
+	union {
+		char		buf[CMSG_SPACE(sizeof(int) * 3)];
+		struct cmsghdr	align;
+	} ctrl;
+	ssize_t			len;
+
+	memset(&msg_ctrl, 0, sizeof(msg_ctrl));
+	msg_ctrl.type	= type;
+	msg_ctrl.id	= pr->ctrl_id++;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctrl, 0, sizeof(ctrl));
+	iov.iov_base		= &msg_ctrl;
+	iov.iov_len		= sizeof(msg_ctrl);
+	msg.msg_iov		= &iov;
+	msg.msg_iovlen		= 1;
+	msg.msg_control		= ctrl.buf;
+	msg.msg_controllen	= CMSG_SPACE(sizeof(int) * fd_num);
+
+	pcmsg = CMSG_FIRSTHDR(&msg);
+	pcmsg->cmsg_level	= SOL_SOCKET;
+	pcmsg->cmsg_type	= SCM_RIGHTS;
+	pcmsg->cmsg_len		= CMSG_LEN(sizeof(int) * fd_num);
+	memcpy(CMSG_DATA(pcmsg), pfds, sizeof(int) * fd_num);
+
+	if (sendmsg(pr->sock_fd, &msg, MSG_NOSIGNAL) != sizeof(msg_ctrl)) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/* ring jobs complete in the ring, the next message is the answer */
+	len = recv(pr->sock_fd, &done, sizeof(done), 0);
+	if (len != sizeof(done) || done.type != VSP2D_MSG_DONE ||
+	    done.id != msg_ctrl.id) {
+		printf("Error : vsp2d reply (%d) errno=(%d)\n", (int)len,
+		       errno);
+		return -1;
+	}
+	if (done.result < 0) {
+		printf("Error : vsp2d type %u result=(%d)\n", type,
+		       done.result);
+		return -1;
+	}
+	return done.result;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2d ring client : submits jobs to vsp2d and reaps their completions
+ *  through a ring pair shared with the daemon (vsp2d.h). The socket is
+ *  used to set up only; vsp2d_ring_submit() and vsp2d_ring_reap() make a
+ *  system call only to wake a sleeping daemon or to sleep themselves.
+ *
+ *    pr = vsp2d_ring_open(VSP2D_SOCKET_PATH, 64);
+ *    src = vsp2d_ring_register(pr, src_dmafd); ...
+ *    vsp2d_ring_submit(pr, sqe, n);
+ *    n = vsp2d_ring_reap(pr, done, max, true);
+ *
+ *  One thread at a time per ring.
+ ******************************************************************************/
+#ifndef VSP2D_RING_H
+#define VSP2D_RING_H
+
+#include <stdbool.h>
+
+#include "vsp2d.h"
+
+struct vsp2d_ring;
+
+struct vsp2d_ring_stat {
+	unsigned long long	submitted;
+	unsigned long long	reaped;
+	unsigned long long	doorbells;	/* eventfd writes to vsp2d */
+	unsigned long long	waits;		/* eventfd reads, slept */
+};
+
+/* entries : 1 - VSP2D_RING_MAX, rounded up to a power of two */
+struct vsp2d_ring	*vsp2d_ring_open(const char *psocket,
+					 unsigned int entries);
+void	vsp2d_ring_close(struct vsp2d_ring *pr, struct vsp2d_ring_stat *pstat);
+
+/* buffer index for vsp2d_sqe, or -1; the fd stays the caller's */
+int	vsp2d_ring_register(struct vsp2d_ring *pr, int dmabuf_fd);
+
+/* jobs taken, fewer when the ring or the jobs out reach entries */
+int	vsp2d_ring_submit(struct vsp2d_ring *pr, const struct vsp2d_sqe *psqe,
+			  int num);
+/* completions copied to pdone, 0 - max; with wait, at least one unless
+ * nothing is out; -1 on error */
+int	vsp2d_ring_reap(struct vsp2d_ring *pr, struct vsp2d_done *pdone,
+			int max, bool wait);
+
+#endif /* VSP2D_RING_H */
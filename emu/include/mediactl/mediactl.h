@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  libmediactl subset provided by the vsp2 emulator (emu/)
+ ******************************************************************************/
+#ifndef __MEDIA_H__
+#define __MEDIA_H__
+
+#include <stddef.h>
+#include <linux/media.h>
+
+struct media_device;
+struct media_entity;
+
+struct media_pad {
+	struct media_entity	*entity;
+	__u32			index;
+	__u32			flags;
+	__u32			padding[3];
+};
+
+struct media_link {
+	struct media_pad	*source;
+	struct media_pad	*sink;
+	struct media_link	*twin;
+	__u32			flags;
+	__u32			padding[3];
+};
+
+struct media_device *media_device_new(const char *devnode);
+struct media_device *media_device_ref(struct media_device *media);
+void media_device_unref(struct media_device *media);
+int media_device_enumerate(struct media_device *media);
+const struct media_device_info *media_get_info(struct media_device *media);
+
+struct media_entity *media_get_entity_by_name(struct media_device *media,
+					      const char *name, size_t length);
+const char *media_entity_get_devname(struct media_entity *entity);
+const struct media_pad *media_entity_get_pad(struct media_entity *entity,
+					     unsigned int index);
+
+int media_reset_links(struct media_device *media);
+int media_setup_link(struct media_device *media, struct media_pad *source,
+		     struct media_pad *sink, __u32 flags);
+struct media_link *media_parse_link(struct media_device *media,
+				    const char *p, char **endp);
+struct media_pad *media_parse_pad(struct media_device *media,
+				  const char *p, char **endp);
+
+#endif
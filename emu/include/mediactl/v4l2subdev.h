@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  libv4l2subdev subset provided by the vsp2 emulator (emu/)
+ ******************************************************************************/
+#ifndef __SUBDEV_H__
+#define __SUBDEV_H__
+
+#include <linux/v4l2-subdev.h>
+
+#ifndef V4L2_MBUS_FMT_ARGB8888_1X32
+#define V4L2_MBUS_FMT_ARGB8888_1X32	MEDIA_BUS_FMT_ARGB8888_1X32
+#endif
+
+struct media_entity;
+
+int v4l2_subdev_set_format(struct media_entity *entity,
+			   struct v4l2_mbus_framefmt *format, unsigned int pad,
+			   enum v4l2_subdev_format_whence which);
+int v4l2_subdev_set_selection(struct media_entity *entity,
+			      struct v4l2_rect *rect, unsigned int pad,
+			      unsigned int target,
+			      enum v4l2_subdev_format_whence which);
+
+#endif
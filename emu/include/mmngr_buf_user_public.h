@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  mmngrbuf subset provided by the vsp2 emulator (emu/)
+ ******************************************************************************/
+#ifndef __MMNGR_BUF_USER_PUBLIC_H__
+#define __MMNGR_BUF_USER_PUBLIC_H__
+
+int mmngr_export_start_in_user(int *pid, unsigned long size,
+			       unsigned long hard_addr, int *pbuf);
+int mmngr_export_end_in_user(int id);
+int mmngr_import_start_in_user(int *pid, unsigned long *psize,
+			       unsigned long *phard_addr, int buf);
+int mmngr_import_end_in_user(int id);
+
+#endif
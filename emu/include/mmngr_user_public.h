@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  mmngr subset provided by the vsp2 emulator (emu/)
+ ******************************************************************************/
+#ifndef __MMNGR_USER_PUBLIC_H__
+#define __MMNGR_USER_PUBLIC_H__
+
+typedef int MMNGR_ID;
+
+#define MMNGR_VA_SUPPORT	0
+#define MMNGR_PA_SUPPORT	1
+#define MMNGR_MARK		2
+#define MMNGR_VA_SUPPORT_CACHED	3
+#define MMNGR_PA_SUPPORT_CACHED	4
+
+#define R_MM_OK			0
+#define R_MM_FATAL		-1
+#define R_MM_SEQERR		-2
+#define R_MM_PARE		-3
+#define R_MM_NOMEM		-4
+
+int mmngr_alloc_in_user(MMNGR_ID *pid, unsigned long size,
+			unsigned long *pphy_addr, unsigned long *phard_addr,
+			unsigned long *puser_virt_addr, unsigned long flag);
+int mmngr_free_in_user(MMNGR_ID id);
+
+#endif
@@ -0,0 +1,856 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2 emulator : media graph, libmediactl / libv4l2subdev API and the
+ *  frame engine. Every /dev/mediaN is one emulated VSP with its own graph,
+ *  lock and engine thread, created on first use. It lives for the whole
+ *  process, like the kernel device outlives media_device_unref().
+ *
+ *    VSP2_EMU_MPIXS=<n> : limit the engine to n Mpixel/s [no limit]
+ *    VSP2_EMU_UNITS=<n>=<unit>[,<unit>...][;<n>=...]
+ *                       : give /dev/media<n> only the listed units out of
+ *                         uds.0, lut, clu, bru and hgo, as on a real SoC
+ *                         where the instances differ [all units]
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "vsp2_emu.h"
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct media_device	emu_device[EMU_DEV_MAX];
+static pthread_mutex_t		emu_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* bus of /dev/mediaN, in the order of the H3 device tree */
+static const char		*emu_bus_name[EMU_DEV_MAX] = {
+	"fea20000.vsp", "fea28000.vsp", "fe960000.vsp",
+	"fe9a0000.vsp", "fe9b0000.vsp", "fea30000.vsp",
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void	emu_init(struct media_device *pdev, int num);
+static bool	emu_has_unit(int num, const char *pname);
+static struct emu_entity	*emu_add_entity(struct media_device *pdev,
+						const char *pname,
+						enum emu_entity_type type,
+						int index, int pad_num,
+						unsigned int source_pads);
+static void	emu_add_link(struct media_device *pdev, struct media_pad *psrc,
+			     struct media_pad *psink, __u32 flags);
+static struct emu_entity	*emu_find_entity(struct media_device *pdev,
+						 const char *pname);
+static struct media_link	*emu_find_link(struct media_device *pdev,
+					       struct media_pad *psrc,
+					       struct media_pad *psink);
+static struct emu_entity	*emu_source_of(struct media_device *pdev,
+					       struct emu_entity *pent,
+					       int pad);
+static bool	emu_is_histogram(const struct media_pad *ppad);
+static bool	emu_any_streaming(struct media_device *pdev);
+static bool	emu_collect_rpf(struct media_device *pdev,
+				struct emu_entity *pent,
+				struct emu_video **pvideo, int *pnum);
+static struct emu_image	*emu_render(struct media_device *pdev,
+				    struct emu_entity *pent);
+static void	*emu_worker(void *parg);
+
+/******************************************************************************
+ *  device model
+ ******************************************************************************/
+struct media_device *emu_device_get(int num)
+{
+	struct media_device *pdev;
+
+	if (num < 0 || num >= EMU_DEV_MAX)
+		return NULL;
+
+	pdev = &emu_device[num];
+	pthread_mutex_lock(&emu_lock);
+	if (!pdev->created)
+		emu_init(pdev, num);
+	pthread_mutex_unlock(&emu_lock);
+	return pdev;
+}
+
+struct emu_entity *emu_find_node(const char *ppath)
+{
+	struct emu_entity	*pent = NULL;
+	int			n, i;
+
+	pthread_mutex_lock(&emu_lock);
+	for (n = 0; n < EMU_DEV_MAX && pent == NULL; n++) {
+		if (!emu_device[n].created)
+			continue;
+		for (i = 0; i < emu_device[n].entity_num; i++) {
+			if (strcmp(emu_device[n].entity[i].devname,
+				   ppath) == 0) {
+				pent = &emu_device[n].entity[i];
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&emu_lock);
+	return pent;
+}
+
+static void emu_init(struct media_device *pdev, int num)
+{
+	struct emu_entity	*psrc[EMU_RPF_NUM + 4];
+	struct emu_entity	*psink[4];
+	struct emu_entity	*prpf, *pvideo, *pwpf;
+	const char		*p;
+	char			name[32];
+	int			src_num = 0;
+	int			sink_num = 0;
+	int			i, j, s, k;
+
+	/* called with emu_lock held */
+	memset(pdev, 0, sizeof(*pdev));
+	pthread_mutex_init(&pdev->lock, NULL);
+	pthread_cond_init(&pdev->cond, NULL);
+	pdev->bus_name = emu_bus_name[num];
+
+	strcpy(pdev->info.driver, "vsp1");
+	strcpy(pdev->info.model, "VSP2 emulator");
+	snprintf(pdev->info.bus_info, sizeof(pdev->info.bus_info),
+		 "platform:%s", pdev->bus_name);
+
+	p = getenv("VSP2_EMU_MPIXS");
+	if (p != NULL)
+		pdev->pixel_rate = atoll(p) * 1000000LL;
+
+	/* rpf.N with its input video node */
+	for (i = 0; i < EMU_RPF_NUM; i++) {
+		snprintf(name, sizeof(name), "rpf.%d", i);
+		prpf = emu_add_entity(pdev, name, EMU_ENT_RPF, i, 2, 1 << 1);
+		snprintf(name, sizeof(name), "rpf.%d input", i);
+		pvideo = emu_add_entity(pdev, name, EMU_ENT_VIDEO_IN, i, 1,
+					1 << 0);
+		prpf->ppeer = pvideo;
+		pvideo->ppeer = prpf;
+		emu_add_link(pdev, &pvideo->pad[0], &prpf->pad[0],
+			     MEDIA_LNK_FL_ENABLED | MEDIA_LNK_FL_IMMUTABLE);
+		psrc[src_num++] = prpf;
+	}
+
+	/* wpf.0 with its output video node */
+	pwpf = emu_add_entity(pdev, "wpf.0", EMU_ENT_WPF, 0, 2, 1 << 1);
+	pvideo = emu_add_entity(pdev, "wpf.0 output", EMU_ENT_VIDEO_OUT, 0,
+				1, 0);
+	pwpf->ppeer = pvideo;
+	pvideo->ppeer = pwpf;
+	emu_add_link(pdev, &pwpf->pad[1], &pvideo->pad[0],
+		     MEDIA_LNK_FL_ENABLED | MEDIA_LNK_FL_IMMUTABLE);
+
+	if (emu_has_unit(num, "uds.0"))
+		psink[sink_num++] = emu_add_entity(pdev, "uds.0", EMU_ENT_UDS,
+						   0, 2, 1 << 1);
+	if (emu_has_unit(num, "lut"))
+		psink[sink_num++] = emu_add_entity(pdev, "lut", EMU_ENT_LUT,
+						   0, 2, 1 << 1);
+	if (emu_has_unit(num, "clu"))
+		psink[sink_num++] = emu_add_entity(pdev, "clu", EMU_ENT_CLU,
+						   0, 2, 1 << 1);
+	if (emu_has_unit(num, "bru"))
+		psink[sink_num++] = emu_add_entity(pdev, "bru", EMU_ENT_BRU,
+						   0, 6, 1 << 5);
+	if (emu_has_unit(num, "hgo"))
+		emu_add_entity(pdev, "hgo", EMU_ENT_HGO, 0, 1, 0);
+	for (i = 0; i < sink_num; i++)
+		psrc[src_num++] = psink[i];
+
+	/* every processing source may feed every processing sink */
+	for (i = 0; i < src_num; i++) {
+		s = psrc[i]->pad_num - 1;
+		for (j = 0; j < sink_num; j++) {
+			if (psink[j] == psrc[i])
+				continue;
+			for (k = 0; k < psink[j]->pad_num - 1; k++)
+				emu_add_link(pdev, &psrc[i]->pad[s],
+					     &psink[j]->pad[k], 0);
+		}
+		emu_add_link(pdev, &psrc[i]->pad[s], &pwpf->pad[0], 0);
+	}
+	pdev->created = true;
+}
+
+static bool emu_has_unit(int num, const char *pname)
+{
+	const char	*p = getenv("VSP2_EMU_UNITS");
+	char		list[256];
+	char		*pdev, *punit, *pdev_save, *punit_save;
+
+	if (p == NULL)
+		return true;
+
+	/* "2=bru;3=uds.0,lut,clu,hgo" : devices not named keep every unit */
+	snprintf(list, sizeof(list), "%s", p);
+	for (pdev = strtok_r(list, ";", &pdev_save); pdev != NULL;
+	     pdev = strtok_r(NULL, ";", &pdev_save)) {
+		if (strchr(pdev, '=') == NULL || atoi(pdev) != num)
+			continue;
+		for (punit = strtok_r(strchr(pdev, '=') + 1, ",", &punit_save);
+		     punit != NULL; punit = strtok_r(NULL, ",", &punit_save)) {
+			if (strcmp(punit, pname) == 0)
+				return true;
+		}
+		return false;
+	}
+	return true;
+}
+
+static struct emu_entity *emu_add_entity(struct media_device *pdev,
+					 const char *pname,
+					 enum emu_entity_type type,
+					 int index, int pad_num,
+					 unsigned int source_pads)
+{
+	static int		video_num;
+	static int		subdev_num;
+	struct emu_entity	*pent = &pdev->entity[pdev->entity_num++];
+	int			i;
+
+	snprintf(pent->name, sizeof(pent->name), "%s %s", pdev->bus_name,
+		 pname);
+	pent->pdev	= pdev;
+	pent->type	= type;
+	pent->index	= index;
+	pent->pad_num	= pad_num;
+
+	for (i = 0; i < pad_num; i++) {
+		pent->pad[i].entity	= (struct media_entity *)pent;
+		pent->pad[i].index	= i;
+		pent->pad[i].flags	= (source_pads & (1 << i))
+					? MEDIA_PAD_FL_SOURCE
+					: MEDIA_PAD_FL_SINK;
+	}
+
+	if (type == EMU_ENT_VIDEO_IN || type == EMU_ENT_VIDEO_OUT) {
+		snprintf(pent->devname, sizeof(pent->devname), "%svideo%d",
+			 EMU_DEV_DIR, video_num++);
+		pent->pvideo = calloc(1, sizeof(*pent->pvideo));
+		pent->pvideo->pentity	= pent;
+		pent->pvideo->type	= (type == EMU_ENT_VIDEO_IN)
+					? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
+					: V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		pent->pvideo->active	= -1;
+		pent->pvideo->owner_fd	= -1;
+		pent->pvideo->evfd	= -1;
+	} else {
+		snprintf(pent->devname, sizeof(pent->devname),
+			 "%sv4l-subdev%d", EMU_DEV_DIR, subdev_num++);
+	}
+
+	return pent;
+}
+
+static void emu_add_link(struct media_device *pdev, struct media_pad *psrc,
+			 struct media_pad *psink, __u32 flags)
+{
+	struct media_link *plink = &pdev->link[pdev->link_num++];
+
+	plink->source	= psrc;
+	plink->sink	= psink;
+	plink->twin	= plink;
+	plink->flags	= flags;
+}
+
+static struct emu_entity *emu_find_entity(struct media_device *pdev,
+					  const char *pname)
+{
+	int i;
+
+	for (i = 0; i < pdev->entity_num; i++) {
+		if (strcmp(pdev->entity[i].name, pname) == 0)
+			return &pdev->entity[i];
+	}
+	return NULL;
+}
+
+static struct media_link *emu_find_link(struct media_device *pdev,
+					struct media_pad *psrc,
+					struct media_pad *psink)
+{
+	int i;
+
+	for (i = 0; i < pdev->link_num; i++) {
+		if (pdev->link[i].source == psrc &&
+		    pdev->link[i].sink == psink)
+			return &pdev->link[i];
+	}
+	return NULL;
+}
+
+static struct emu_entity *emu_source_of(struct media_device *pdev,
+					struct emu_entity *pent, int pad)
+{
+	int i;
+
+	for (i = 0; i < pdev->link_num; i++) {
+		if (pdev->link[i].sink == &pent->pad[pad] &&
+		    (pdev->link[i].flags & MEDIA_LNK_FL_ENABLED))
+			return (struct emu_entity *)
+				pdev->link[i].source->entity;
+	}
+	return NULL;
+}
+
+static bool emu_is_histogram(const struct media_pad *ppad)
+{
+	return ((const struct emu_entity *)ppad->entity)->type == EMU_ENT_HGO;
+}
+
+static bool emu_any_streaming(struct media_device *pdev)
+{
+	int i;
+
+	for (i = 0; i < pdev->entity_num; i++) {
+		if (pdev->entity[i].pvideo != NULL &&
+		    pdev->entity[i].pvideo->streaming)
+			return true;
+	}
+	return false;
+}
+
+/******************************************************************************
+ *  libmediactl
+ ******************************************************************************/
+struct media_device *media_device_new(const char *devnode)
+{
+	struct media_device	*pdev;
+	char			*pend;
+	long			num;
+
+	if (devnode == NULL || strncmp(devnode, "/dev/media", 10) != 0)
+		return NULL;
+	num = strtol(devnode + 10, &pend, 10);
+	if (pend == devnode + 10 || *pend != '\0')
+		return NULL;
+
+	pdev = emu_device_get(num);
+	if (pdev == NULL)
+		return NULL;
+	pthread_mutex_lock(&pdev->lock);
+	pdev->ref++;
+	pthread_mutex_unlock(&pdev->lock);
+	return pdev;
+}
+
+struct media_device *media_device_ref(struct media_device *media)
+{
+	pthread_mutex_lock(&media->lock);
+	media->ref++;
+	pthread_mutex_unlock(&media->lock);
+	return media;
+}
+
+void media_device_unref(struct media_device *media)
+{
+	if (media == NULL)
+		return;
+	pthread_mutex_lock(&media->lock);
+	media->ref--;
+	pthread_mutex_unlock(&media->lock);
+}
+
+int media_device_enumerate(struct media_device *media)
+{
+	return 0;
+}
+
+const struct media_device_info *media_get_info(struct media_device *media)
+{
+	return &media->info;
+}
+
+struct media_entity *media_get_entity_by_name(struct media_device *media,
+					      const char *name, size_t length)
+{
+	char buf[48];
+
+	if (length >= sizeof(buf))
+		return NULL;
+	memcpy(buf, name, length);
+	buf[length] = '\0';
+
+	return (struct media_entity *)emu_find_entity(media, buf);
+}
+
+const char *media_entity_get_devname(struct media_entity *entity)
+{
+	return ((struct emu_entity *)entity)->devname;
+}
+
+const struct media_pad *media_entity_get_pad(struct media_entity *entity,
+					     unsigned int index)
+{
+	struct emu_entity *pent = (struct emu_entity *)entity;
+
+	if (index >= pent->pad_num)
+		return NULL;
+	return &pent->pad[index];
+}
+
+int media_reset_links(struct media_device *media)
+{
+	int i;
+
+	pthread_mutex_lock(&media->lock);
+	if (emu_any_streaming(media)) {
+		pthread_mutex_unlock(&media->lock);
+		return -EBUSY;
+	}
+	for (i = 0; i < media->link_num; i++) {
+		if (!(media->link[i].flags & MEDIA_LNK_FL_IMMUTABLE))
+			media->link[i].flags &= ~MEDIA_LNK_FL_ENABLED;
+	}
+	pthread_mutex_unlock(&media->lock);
+	return 0;
+}
+
+int media_setup_link(struct media_device *media, struct media_pad *source,
+		     struct media_pad *sink, __u32 flags)
+{
+	struct media_link	*plink, *pother;
+	int			ret = 0;
+	int			i;
+
+	pthread_mutex_lock(&media->lock);
+
+	plink = emu_find_link(media, source, sink);
+	if (plink == NULL) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (plink->flags & MEDIA_LNK_FL_IMMUTABLE) {
+		if (!(flags & MEDIA_LNK_FL_ENABLED))
+			ret = -EINVAL;
+		goto out;
+	}
+	if (emu_any_streaming(media)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	/* a sink pad takes one enabled link, a source pad feeds one but for
+	 * the links into hgo */
+	if (flags & MEDIA_LNK_FL_ENABLED) {
+		for (i = 0; i < media->link_num; i++) {
+			pother = &media->link[i];
+			if (pother == plink ||
+			    !(pother->flags & MEDIA_LNK_FL_ENABLED))
+				continue;
+			if (pother->sink == sink ||
+			    (pother->source == source &&
+			     !emu_is_histogram(pother->sink) &&
+			     !emu_is_histogram(sink))) {
+				ret = -EBUSY;
+				goto out;
+			}
+		}
+		plink->flags |= MEDIA_LNK_FL_ENABLED;
+	} else {
+		plink->flags &= ~MEDIA_LNK_FL_ENABLED;
+	}
+
+out:
+	pthread_mutex_unlock(&media->lock);
+	return ret;
+}
+
+struct media_pad *media_parse_pad(struct media_device *media,
+				  const char *p, char **endp)
+{
+	struct emu_entity	*pent = NULL;
+	const char		*pend;
+	char			name[48];
+	unsigned long		pad;
+	char			*pnum;
+
+	while (*p == ' ')
+		p++;
+
+	if (*p == '\'' || *p == '"') {
+		pend = strchr(p + 1, *p);
+		if (pend == NULL || pend - p - 1 >= (int)sizeof(name))
+			return NULL;
+		memcpy(name, p + 1, pend - p - 1);
+		name[pend - p - 1] = '\0';
+		pent = emu_find_entity(media, name);
+		p = pend + 1;
+	} else {
+		/* entity id, 1 based as in MEDIA_IOC_ENUM_ENTITIES */
+		unsigned long id = strtoul(p, &pnum, 10);
+
+		if (pnum != p && id >= 1 && id <= media->entity_num)
+			pent = &media->entity[id - 1];
+		p = pnum;
+	}
+
+	if (pent == NULL || *p != ':')
+		return NULL;
+
+	pad = strtoul(p + 1, &pnum, 10);
+	if (pnum == p + 1 || pad >= pent->pad_num)
+		return NULL;
+	if (endp != NULL)
+		*endp = pnum;
+
+	return &pent->pad[pad];
+}
+
+struct media_link *media_parse_link(struct media_device *media,
+				    const char *p, char **endp)
+{
+	struct media_pad	*psrc, *psink;
+	char			*end;
+
+	psrc = media_parse_pad(media, p, &end);
+	if (psrc == NULL)
+		return NULL;
+
+	p = end;
+	while (*p == ' ')
+		p++;
+	if (p[0] != '-' || p[1] != '>')
+		return NULL;
+
+	psink = media_parse_pad(media, p + 2, &end);
+	if (psink == NULL)
+		return NULL;
+	if (endp != NULL)
+		*endp = end;
+
+	return emu_find_link(media, psrc, psink);
+}
+
+/******************************************************************************
+ *  libv4l2subdev
+ ******************************************************************************/
+int v4l2_subdev_set_format(struct media_entity *entity,
+			   struct v4l2_mbus_framefmt *format, unsigned int pad,
+			   enum v4l2_subdev_format_whence which)
+{
+	struct emu_entity	*pent = (struct emu_entity *)entity;
+	struct media_device	*pdev = pent->pdev;
+
+	if (pad >= pent->pad_num)
+		return -EINVAL;
+	if (format->width < 1 || format->width > 8190 ||
+	    format->height < 1 || format->height > 8190)
+		return -EINVAL;
+	if (which != V4L2_SUBDEV_FORMAT_ACTIVE)
+		return 0;
+
+	pthread_mutex_lock(&pdev->lock);
+	pent->fmt[pad] = *format;
+
+	/* a new format resets the rectangles of that pad */
+	pent->crop_set[pad]	= false;
+	pent->compose_set[pad]	= false;
+	pthread_mutex_unlock(&pdev->lock);
+
+	return 0;
+}
+
+int v4l2_subdev_set_selection(struct media_entity *entity,
+			      struct v4l2_rect *rect, unsigned int pad,
+			      unsigned int target,
+			      enum v4l2_subdev_format_whence which)
+{
+	struct emu_entity	*pent = (struct emu_entity *)entity;
+	struct media_device	*pdev = pent->pdev;
+	int			ret = 0;
+
+	if (pad >= pent->pad_num)
+		return -EINVAL;
+	if (which != V4L2_SUBDEV_FORMAT_ACTIVE)
+		return 0;
+
+	pthread_mutex_lock(&pdev->lock);
+	switch (target) {
+	case V4L2_SEL_TGT_CROP:
+		pent->crop[pad]		= *rect;
+		pent->crop_set[pad]	= true;
+		break;
+	case V4L2_SEL_TGT_COMPOSE:
+		pent->compose[pad]	= *rect;
+		pent->compose_set[pad]	= true;
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+	pthread_mutex_unlock(&pdev->lock);
+
+	return ret;
+}
+
+/******************************************************************************
+ *  frame engine
+ ******************************************************************************/
+void emu_signal(int evfd, int count)
+{
+	unsigned long long	val = count;
+	ssize_t			ret;
+
+	/* eventfd counts the done buffers, so poll() sees them */
+	if (evfd < 0)
+		return;
+	ret = write(evfd, &val, sizeof(val));
+	(void)ret;
+}
+
+void emu_engine_kick(struct media_device *pdev)
+{
+	/* called with the lock held */
+	if (!pdev->worker_run) {
+		pdev->worker_run = true;
+		pthread_create(&pdev->worker, NULL, emu_worker, pdev);
+		pthread_detach(pdev->worker);
+	}
+	pthread_cond_broadcast(&pdev->cond);
+}
+
+static bool emu_collect_rpf(struct media_device *pdev,
+			    struct emu_entity *pent,
+			    struct emu_video **pvideo, int *pnum)
+{
+	struct emu_entity	*psrc;
+	bool			linked = false;
+	int			pad;
+
+	if (pent->type == EMU_ENT_RPF) {
+		pvideo[(*pnum)++] = pent->ppeer->pvideo;
+		return true;
+	}
+
+	for (pad = 0; pad < pent->pad_num; pad++) {
+		if (pent->pad[pad].flags & MEDIA_PAD_FL_SOURCE)
+			continue;
+		psrc = emu_source_of(pdev, pent, pad);
+		if (psrc == NULL)
+			continue;
+		if (!emu_collect_rpf(pdev, psrc, pvideo, pnum))
+			return false;
+		linked = true;
+	}
+	return linked;
+}
+
+static struct emu_image *emu_render(struct media_device *pdev,
+				    struct emu_entity *pent)
+{
+	struct emu_image	*psrc, *pout = &pent->img;
+	struct emu_video	*pvideo;
+	struct emu_buffer	*pbuf;
+	struct emu_entity	*pin;
+	struct v4l2_rect	rect;
+	int			pad, width, height;
+
+	switch (pent->type) {
+	case EMU_ENT_RPF:
+		pvideo	= pent->ppeer->pvideo;
+		pbuf	= &pvideo->buf[pvideo->active];
+		rect.left	= 0;
+		rect.top	= 0;
+		rect.width	= pvideo->fmt.width;
+		rect.height	= pvideo->fmt.height;
+		if (pent->crop_set[0] &&
+		    pent->crop[0].left + pent->crop[0].width <= rect.width &&
+		    pent->crop[0].top + pent->crop[0].height <= rect.height)
+			rect = pent->crop[0];
+
+		/* borrowed view into the queued buffer */
+		pout->cap	= 0;
+		pout->width	= rect.width;
+		pout->height	= rect.height;
+		pout->stride	= pvideo->fmt.plane_fmt[0].bytesperline / 4;
+		pout->ppix	= (uint32_t *)pbuf->pmem +
+				  rect.top * pout->stride + rect.left;
+		pout->premul	= (pvideo->fmt.flags &
+				   V4L2_PIX_FMT_FLAG_PREMUL_ALPHA) != 0;
+
+		if (pdev->hgo.addr != NULL && pdev->hgo.sampling == pent->index)
+			emu_proc_hgo(pout, &pdev->hgo);
+		return pout;
+
+	case EMU_ENT_WPF:
+		pin = emu_source_of(pdev, pent, 0);
+		return emu_render(pdev, pin);
+
+	case EMU_ENT_UDS:
+		psrc = emu_render(pdev, emu_source_of(pdev, pent, 0));
+		width	= pent->fmt[1].width ? pent->fmt[1].width
+					     : psrc->width;
+		height	= pent->fmt[1].height ? pent->fmt[1].height
+					      : psrc->height;
+		if (emu_image_alloc(pout, width, height) < 0)
+			return psrc;
+		emu_proc_scale(psrc, pout);
+		pout->premul = psrc->premul;
+		return pout;
+
+	case EMU_ENT_LUT:
+		psrc = emu_render(pdev, emu_source_of(pdev, pent, 0));
+		if (!pdev->lut_valid ||
+		    emu_image_alloc(pout, psrc->width, psrc->height) < 0)
+			return psrc;
+		emu_proc_lut(psrc, pout, pdev->lut);
+		pout->premul = psrc->premul;
+		return pout;
+
+	case EMU_ENT_CLU:
+		psrc = emu_render(pdev, emu_source_of(pdev, pent, 0));
+		if (!pdev->clu_valid ||
+		    emu_image_alloc(pout, psrc->width, psrc->height) < 0)
+			return psrc;
+		emu_proc_clu(psrc, pout, pdev->clu);
+		pout->premul = psrc->premul;
+		return pout;
+
+	case EMU_ENT_BRU:
+		width	= pent->fmt[5].width;
+		height	= pent->fmt[5].height;
+		if (width == 0 || height == 0) {
+			pin = emu_source_of(pdev, pent, 0);
+			psrc = emu_render(pdev, pin);
+			width	= psrc->width;
+			height	= psrc->height;
+		}
+		if (emu_image_alloc(pout, width, height) < 0)
+			return NULL;
+		memset(pout->ppix, 0, (size_t)width * height * 4);
+		pout->premul = false;
+
+		/* pad 0 is the bottom layer */
+		for (pad = 0; pad < 5; pad++) {
+			pin = emu_source_of(pdev, pent, pad);
+			if (pin == NULL)
+				continue;
+			psrc = emu_render(pdev, pin);
+			if (pent->compose_set[pad])
+				emu_proc_blend(pout, psrc,
+					       pent->compose[pad].left,
+					       pent->compose[pad].top);
+			else
+				emu_proc_blend(pout, psrc, 0, 0);
+		}
+		return pout;
+
+	default:
+		return NULL;
+	}
+}
+
+static void *emu_worker(void *parg)
+{
+	struct media_device	*pdev = parg;
+	struct emu_video	*pin[EMU_RPF_NUM * 2];
+	struct emu_video	*pout;
+	struct emu_entity	*pwpf;
+	struct emu_image	*pimg;
+	struct emu_buffer	*pbuf;
+	struct timespec		t_start, t_end;
+	long long		busy_ns, want_ns;
+	char			name[48];
+	int			in_num;
+	int			i;
+	bool			ready;
+
+	snprintf(name, sizeof(name), "%s wpf.0", pdev->bus_name);
+	pwpf = emu_find_entity(pdev, name);
+
+	pthread_mutex_lock(&pdev->lock);
+	while (pdev->worker_run) {
+		/* a frame needs a capture buffer and one per input rpf */
+		pout = pwpf->ppeer->pvideo;
+		in_num = 0;
+		ready = pout->streaming && pout->queue_num > 0 &&
+			emu_collect_rpf(pdev, pwpf, pin, &in_num);
+		for (i = 0; ready && i < in_num; i++)
+			ready = pin[i]->streaming && pin[i]->queue_num > 0;
+
+		if (!ready) {
+			pthread_cond_wait(&pdev->cond, &pdev->lock);
+			continue;
+		}
+
+		/* frame start : take the buffers, latch the configs */
+		pin[in_num++] = pout;
+		for (i = 0; i < in_num; i++) {
+			pin[i]->active = pin[i]->queue[0];
+			memmove(&pin[i]->queue[0], &pin[i]->queue[1],
+				--pin[i]->queue_num * sizeof(int));
+			pin[i]->buf[pin[i]->active].state = EMU_BUF_ACTIVE;
+		}
+		if (pdev->lut_pend_valid) {
+			memcpy(pdev->lut, pdev->lut_pend, sizeof(pdev->lut));
+			pdev->lut_valid = true;
+			pdev->lut_pend_valid = false;
+		}
+		if (pdev->clu_pend_valid) {
+			memcpy(pdev->clu, pdev->clu_pend, sizeof(pdev->clu));
+			pdev->clu_valid = true;
+			pdev->clu_pend_valid = false;
+		}
+		if (pdev->hgo_pend_valid) {
+			pdev->hgo = pdev->hgo_pend;
+			pdev->hgo_pend_valid = false;
+		}
+		pthread_mutex_unlock(&pdev->lock);
+
+		/* process without the lock, as the hardware runs alone */
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		pimg = emu_render(pdev, pwpf);
+		pbuf = &pout->buf[pout->active];
+		if (pimg != NULL)
+			emu_proc_store(pimg, pbuf->pmem, pout->fmt.width,
+				       pout->fmt.height,
+				       pout->fmt.plane_fmt[0].bytesperline);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+		if (pdev->pixel_rate > 0) {
+			busy_ns = (t_end.tv_sec - t_start.tv_sec) * 1000000000LL
+				+ t_end.tv_nsec - t_start.tv_nsec;
+			want_ns = (long long)pout->fmt.width *
+				  pout->fmt.height * 1000000000LL /
+				  pdev->pixel_rate;
+			if (want_ns > busy_ns)
+				usleep((want_ns - busy_ns) / 1000);
+		}
+
+		/* frame end */
+		pthread_mutex_lock(&pdev->lock);
+		for (i = 0; i < in_num; i++) {
+			pbuf = &pin[i]->buf[pin[i]->active];
+			pbuf->state	= EMU_BUF_DONE;
+			pbuf->sequence	= pin[i]->sequence++;
+			pbuf->timestamp.tv_sec	= t_end.tv_sec;
+			pbuf->timestamp.tv_usec	= t_end.tv_nsec / 1000;
+			if (pin[i] == pout)
+				pbuf->bytesused =
+					pout->fmt.plane_fmt[0].sizeimage;
+			pin[i]->done[pin[i]->done_num++] = pin[i]->active;
+			pin[i]->active = -1;
+			emu_signal(pin[i]->evfd, 1);
+		}
+		pdev->frames++;
+		pthread_cond_broadcast(&pdev->cond);
+	}
+	pthread_mutex_unlock(&pdev->lock);
+
+	return NULL;
+}
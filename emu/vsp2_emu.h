@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2 emulator : internal definitions
+ ******************************************************************************/
+#ifndef VSP2_EMU_H
+#define VSP2_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <linux/videodev2.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define EMU_DEV_DIR		"/dev/vsp2emu/"
+#define EMU_DEV_MAX		(6)		/* /dev/media0 - 5 */
+#define EMU_RPF_NUM		(5)
+#define EMU_ENTITY_MAX		(24)
+#define EMU_PAD_MAX		(6)
+#define EMU_LINK_MAX		(128)
+#define EMU_BUF_MAX		(VIDEO_MAX_FRAME)
+#define EMU_FD_MAX		(1024)
+
+#define EMU_LUT_NUM		(256)
+#define EMU_LUT_REG		(0x00007000)
+#define EMU_CLU_GRID		(17)
+#define EMU_CLU_NUM		(EMU_CLU_GRID*EMU_CLU_GRID*EMU_CLU_GRID)
+#define EMU_CLU_ADDR_REG	(0x00007400)
+#define EMU_CLU_DATA_REG	(0x00007404)
+#define EMU_HGO_SIZE		(1088)
+
+/* argb32 is a:r:g:b in byte order, little endian word */
+#define EMU_A(p)		((p) & 0xff)
+#define EMU_R(p)		(((p) >> 8) & 0xff)
+#define EMU_G(p)		(((p) >> 16) & 0xff)
+#define EMU_B(p)		((p) >> 24)
+#define EMU_ARGB(a, r, g, b)	((uint32_t)(a) | (uint32_t)(r) << 8 | \
+				 (uint32_t)(g) << 16 | (uint32_t)(b) << 24)
+
+/* private ioctl of vsp2driver */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+#define VIDIOC_VSP2_CLU_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
+#define VIDIOC_VSP2_HGO_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 3, struct vsp2_hgo_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct vsp2_clu_config {
+	unsigned char	mode;
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned char	fxa;
+	unsigned short	tbl_num;	/* 1 to 9826 */
+};
+
+struct vsp2_hgo_config {
+	void		*addr;	/* Allocate memory size is 1088 bytes. */
+	unsigned short	width;
+	unsigned short	height;
+	unsigned short	x_offset;
+	unsigned short	y_offset;
+	unsigned char	binary_mode;
+	unsigned char	maxrgb_mode;
+	unsigned char	step_mode;
+	unsigned long	sampling;	/* sampling module */
+};
+
+enum emu_entity_type {
+	EMU_ENT_RPF,
+	EMU_ENT_WPF,
+	EMU_ENT_VIDEO_IN,	/* rpf.N input : OUTPUT queue */
+	EMU_ENT_VIDEO_OUT,	/* wpf.N output : CAPTURE queue */
+	EMU_ENT_UDS,
+	EMU_ENT_BRU,
+	EMU_ENT_LUT,
+	EMU_ENT_CLU,
+	EMU_ENT_HGO,
+};
+
+/* pixels of one stage, stride in pixels */
+struct emu_image {
+	int		width;
+	int		height;
+	int		stride;
+	uint32_t	*ppix;
+	bool		premul;
+	size_t		cap;		/* owned scratch, 0 : borrowed */
+};
+
+enum emu_buf_state {
+	EMU_BUF_IDLE = 0,
+	EMU_BUF_QUEUED,
+	EMU_BUF_ACTIVE,		/* being processed */
+	EMU_BUF_DONE,
+};
+
+struct emu_buffer {
+	enum emu_buf_state	state;
+	unsigned int		length;
+	unsigned int		bytesused;
+	unsigned long		offset;		/* mmap cookie */
+	int			memfd;		/* MMAP backing, -1 : none */
+	void			*pmem;		/* memory the engine uses */
+	unsigned long		userptr;
+	unsigned long		user_len;	/* pinned at userptr */
+	int			dmafd;		/* DMABUF, cached mapping */
+	void			*pdma;
+	size_t			dma_len;
+	unsigned int		sequence;
+	struct timeval		timestamp;
+};
+
+struct emu_video {
+	struct emu_entity		*pentity;
+	unsigned int			type;
+	struct v4l2_pix_format_mplane	fmt;
+	unsigned int			memory;
+	unsigned int			num;
+	struct emu_buffer		buf[EMU_BUF_MAX];
+	int				queue[EMU_BUF_MAX];
+	int				queue_num;
+	int				done[EMU_BUF_MAX];
+	int				done_num;
+	int				active;	/* -1 : none */
+	bool				streaming;
+	int				owner_fd;	/* fd of REQBUFS */
+	int				evfd;	/* readable : done buffers */
+	unsigned int			sequence;
+};
+
+struct emu_entity {
+	char				name[48];
+	enum emu_entity_type		type;
+	int				index;		/* rpf.N */
+	char				devname[48];
+	int				pad_num;
+	struct media_pad		pad[EMU_PAD_MAX];
+	struct v4l2_mbus_framefmt	fmt[EMU_PAD_MAX];
+	struct v4l2_rect		crop[EMU_PAD_MAX];
+	struct v4l2_rect		compose[EMU_PAD_MAX];
+	bool				crop_set[EMU_PAD_MAX];
+	bool				compose_set[EMU_PAD_MAX];
+	struct emu_video		*pvideo;
+	struct emu_entity		*ppeer;	/* video <-> rpf / wpf */
+	struct media_device		*pdev;	/* owning device */
+	struct emu_image		img;	/* scratch for this stage */
+};
+
+struct media_device {
+	bool				created;
+	const char			*bus_name;
+	struct emu_entity		entity[EMU_ENTITY_MAX];
+	int				entity_num;
+	struct media_link		link[EMU_LINK_MAX];
+	int				link_num;
+	struct media_device_info	info;
+	int				ref;
+
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+	pthread_t			worker;
+	bool				worker_run;
+	long long			pixel_rate;	/* pixel/s, 0 : no limit */
+
+	/* config tables, pending until the next frame starts */
+	uint32_t			lut[EMU_LUT_NUM];
+	uint32_t			lut_pend[EMU_LUT_NUM];
+	bool				lut_valid;
+	bool				lut_pend_valid;
+	uint32_t			clu[EMU_CLU_NUM];
+	uint32_t			clu_pend[EMU_CLU_NUM];
+	bool				clu_valid;
+	bool				clu_pend_valid;
+	struct vsp2_hgo_config		hgo;
+	struct vsp2_hgo_config		hgo_pend;
+	bool				hgo_pend_valid;
+
+	unsigned long long		frames;
+};
+
+/******************************************************************************
+ *  function
+ ******************************************************************************/
+/* vsp2_emu.c */
+struct media_device	*emu_device_get(int num);
+struct emu_entity	*emu_find_node(const char *ppath);
+void	emu_engine_kick(struct media_device *pdev);
+void	emu_signal(int evfd, int count);
+
+/* vsp2_emu_proc.c */
+int	emu_image_alloc(struct emu_image *pimg, int width, int height);
+void	emu_proc_scale(const struct emu_image *psrc, struct emu_image *pdst);
+void	emu_proc_lut(const struct emu_image *psrc, struct emu_image *pdst,
+		     const uint32_t *ptbl);
+void	emu_proc_clu(const struct emu_image *psrc, struct emu_image *pdst,
+		     const uint32_t *ptbl);
+void	emu_proc_blend(struct emu_image *pdst, const struct emu_image *psrc,
+		       int left, int top);
+void	emu_proc_hgo(const struct emu_image *psrc,
+		     const struct vsp2_hgo_config *pcfg);
+void	emu_proc_store(const struct emu_image *psrc, void *pmem,
+		       int width, int height, int bytesperline);
+
+/* vsp2_emu_fd.c */
+int	emu_real_open(const char *ppath, int flags, int mode);
+int	emu_real_close(int fd);
+int	emu_real_ioctl(int fd, unsigned long request, void *parg);
+void	*emu_real_mmap(void *paddr, size_t length, int prot, int flags,
+		       int fd, off_t offset);
+
+/* vsp2_emu_mmngr.c */
+int	emu_dmabuf_sync(int fd, void *parg);
+
+/* vsp2_emu_video.c */
+int	emu_video_open(struct media_device *pdev, struct emu_entity *pent,
+		       int flags);
+void	emu_video_close(struct media_device *pdev, int fd);
+int	emu_video_ioctl(struct media_device *pdev, int fd,
+			unsigned long request, void *parg);
+void	*emu_video_mmap(struct media_device *pdev, int fd, size_t length,
+			int prot, int flags, off_t offset);
+struct emu_entity	*emu_fd_entity(int fd);
+
+#endif /* VSP2_EMU_H */
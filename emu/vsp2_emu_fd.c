@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2 emulator : system call entry points
+ *  Linked into the test program, these take precedence over libc. Paths
+ *  under /dev/vsp2emu/ and the fds opened from them are served here,
+ *  everything else goes on to the libc function.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/dma-buf.h>
+
+#include "vsp2_emu.h"
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct emu_libc {
+	int	(*popen)(const char *, int, ...);
+	int	(*pclose)(int);
+	int	(*pioctl)(int, unsigned long, ...);
+	void	*(*pmmap)(void *, size_t, int, int, int, off_t);
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct emu_libc	emu_libc;
+static pthread_once_t	emu_libc_once = PTHREAD_ONCE_INIT;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void	emu_libc_init(void);
+static int	emu_open(const char *ppath, int flags, int mode);
+
+/******************************************************************************
+ *  libc
+ ******************************************************************************/
+static void emu_libc_init(void)
+{
+	emu_libc.popen	= dlsym(RTLD_NEXT, "open");
+	emu_libc.pclose	= dlsym(RTLD_NEXT, "close");
+	emu_libc.pioctl	= dlsym(RTLD_NEXT, "ioctl");
+	emu_libc.pmmap	= dlsym(RTLD_NEXT, "mmap");
+}
+
+int emu_real_open(const char *ppath, int flags, int mode)
+{
+	pthread_once(&emu_libc_once, emu_libc_init);
+	return emu_libc.popen(ppath, flags, mode);
+}
+
+int emu_real_close(int fd)
+{
+	pthread_once(&emu_libc_once, emu_libc_init);
+	return emu_libc.pclose(fd);
+}
+
+int emu_real_ioctl(int fd, unsigned long request, void *parg)
+{
+	pthread_once(&emu_libc_once, emu_libc_init);
+	return emu_libc.pioctl(fd, request, parg);
+}
+
+void *emu_real_mmap(void *paddr, size_t length, int prot, int flags, int fd,
+		    off_t offset)
+{
+	pthread_once(&emu_libc_once, emu_libc_init);
+	return emu_libc.pmmap(paddr, length, prot, flags, fd, offset);
+}
+
+/******************************************************************************
+ *  entry points
+ ******************************************************************************/
+static int emu_open(const char *ppath, int flags, int mode)
+{
+	struct emu_entity	*pent;
+
+	if (ppath == NULL || strncmp(ppath, EMU_DEV_DIR,
+				     strlen(EMU_DEV_DIR)) != 0)
+		return emu_real_open(ppath, flags, mode);
+
+	pent = emu_find_node(ppath);
+	if (pent == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	return emu_video_open(pent->pdev, pent, flags);
+}
+
+int open(const char *ppath, int flags, ...)
+{
+	va_list	ap;
+	int	mode = 0;
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+	return emu_open(ppath, flags, mode);
+}
+
+int open64(const char *ppath, int flags, ...)
+{
+	va_list	ap;
+	int	mode = 0;
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+	return emu_open(ppath, flags | O_LARGEFILE, mode);
+}
+
+int close(int fd)
+{
+	struct emu_entity *pent = emu_fd_entity(fd);
+
+	if (pent != NULL)
+		emu_video_close(pent->pdev, fd);
+	return emu_real_close(fd);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	struct emu_entity	*pent = emu_fd_entity(fd);
+	va_list			ap;
+	void			*parg;
+
+	va_start(ap, request);
+	parg = va_arg(ap, void *);
+	va_end(ap);
+
+	/* a dmabuf is a memfd here, the sync is the exporter's */
+	if (pent == NULL && request == DMA_BUF_IOCTL_SYNC)
+		return emu_dmabuf_sync(fd, parg);
+	if (pent == NULL)
+		return emu_real_ioctl(fd, request, parg);
+	return emu_video_ioctl(pent->pdev, fd, request, parg);
+}
+
+void *mmap(void *paddr, size_t length, int prot, int flags, int fd,
+	   off_t offset)
+{
+	struct emu_entity *pent = emu_fd_entity(fd);
+
+	if (pent == NULL)
+		return emu_real_mmap(paddr, length, prot, flags, fd, offset);
+	return emu_video_mmap(pent->pdev, fd, length, prot, flags, offset);
+}
+
+void *mmap64(void *paddr, size_t length, int prot, int flags, int fd,
+	     off_t offset)
+{
+	return mmap(paddr, length, prot, flags, fd, offset);
+}
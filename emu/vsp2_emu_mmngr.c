@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2 emulator : libmmngr / libmmngrbuf
+ *  Buffers are memfd pages. The hard address is a made up bus address,
+ *  unique per buffer, that the export call maps back to the memfd, so a
+ *  dmabuf fd is simply another reference to the same pages. The pages are
+ *  coherent, so DMA_BUF_IOCTL_SYNC only checks its arguments.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+
+#include "vsp2_emu.h"
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define MMNGR_EMU_MAX		(64)
+#define MMNGR_EMU_HARD_BASE	(0x40000000UL)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct mmngr_emu_buf {
+	bool		used;
+	int		memfd;
+	void		*pvirt;
+	unsigned long	size;
+	unsigned long	hard_addr;
+	int		export_fd;	/* -1 : not exported */
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct mmngr_emu_buf	mmngr_buf[MMNGR_EMU_MAX];
+static unsigned long		mmngr_hard_next = MMNGR_EMU_HARD_BASE;
+static pthread_mutex_t		mmngr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+ *  libmmngr
+ ******************************************************************************/
+int mmngr_alloc_in_user(MMNGR_ID *pid, unsigned long size,
+			unsigned long *pphy_addr, unsigned long *phard_addr,
+			unsigned long *puser_virt_addr, unsigned long flag)
+{
+	struct mmngr_emu_buf	*pbuf = NULL;
+	int			ret = R_MM_OK;
+	int			i;
+
+	if (pid == NULL || size == 0 || flag == MMNGR_MARK)
+		return R_MM_PARE;
+
+	pthread_mutex_lock(&mmngr_lock);
+	for (i = 0; i < MMNGR_EMU_MAX; i++) {
+		if (!mmngr_buf[i].used) {
+			pbuf = &mmngr_buf[i];
+			break;
+		}
+	}
+	if (pbuf == NULL) {
+		ret = R_MM_NOMEM;
+		goto out;
+	}
+
+	pbuf->memfd = memfd_create("vsp2emu-mmngr", MFD_CLOEXEC);
+	if (pbuf->memfd < 0 || ftruncate(pbuf->memfd, size) < 0) {
+		if (pbuf->memfd >= 0)
+			emu_real_close(pbuf->memfd);
+		ret = R_MM_NOMEM;
+		goto out;
+	}
+	pbuf->pvirt = emu_real_mmap(NULL, size, PROT_READ | PROT_WRITE,
+				    MAP_SHARED, pbuf->memfd, 0);
+	if (pbuf->pvirt == MAP_FAILED) {
+		emu_real_close(pbuf->memfd);
+		ret = R_MM_NOMEM;
+		goto out;
+	}
+
+	pbuf->used	= true;
+	pbuf->size	= size;
+	pbuf->hard_addr	= mmngr_hard_next;
+	pbuf->export_fd	= -1;
+	mmngr_hard_next += (size + 0xfffffUL) & ~0xfffffUL;
+
+	*pid = i;
+	if (pphy_addr != NULL)
+		*pphy_addr = pbuf->hard_addr;
+	if (phard_addr != NULL)
+		*phard_addr = pbuf->hard_addr;
+	if (puser_virt_addr != NULL)
+		*puser_virt_addr = (unsigned long)pbuf->pvirt;
+out:
+	pthread_mutex_unlock(&mmngr_lock);
+	return ret;
+}
+
+int mmngr_free_in_user(MMNGR_ID id)
+{
+	struct mmngr_emu_buf *pbuf;
+
+	if (id < 0 || id >= MMNGR_EMU_MAX)
+		return R_MM_PARE;
+
+	pthread_mutex_lock(&mmngr_lock);
+	pbuf = &mmngr_buf[id];
+	if (!pbuf->used) {
+		pthread_mutex_unlock(&mmngr_lock);
+		return R_MM_SEQERR;
+	}
+	munmap(pbuf->pvirt, pbuf->size);
+	emu_real_close(pbuf->memfd);
+	pbuf->used = false;
+	pthread_mutex_unlock(&mmngr_lock);
+
+	return R_MM_OK;
+}
+
+/******************************************************************************
+ *  libmmngrbuf
+ ******************************************************************************/
+int mmngr_export_start_in_user(int *pid, unsigned long size,
+			       unsigned long hard_addr, int *pbuf)
+{
+	struct mmngr_emu_buf	*pent;
+	int			ret = R_MM_PARE;
+	int			i;
+
+	if (pid == NULL || pbuf == NULL)
+		return R_MM_PARE;
+
+	pthread_mutex_lock(&mmngr_lock);
+	for (i = 0; i < MMNGR_EMU_MAX; i++) {
+		pent = &mmngr_buf[i];
+		if (!pent->used || pent->hard_addr != hard_addr ||
+		    size > pent->size)
+			continue;
+		if (pent->export_fd >= 0) {
+			ret = R_MM_SEQERR;
+			break;
+		}
+		pent->export_fd = fcntl(pent->memfd, F_DUPFD_CLOEXEC, 0);
+		if (pent->export_fd < 0) {
+			ret = R_MM_FATAL;
+			break;
+		}
+		*pid	= i;
+		*pbuf	= pent->export_fd;
+		ret	= R_MM_OK;
+		break;
+	}
+	pthread_mutex_unlock(&mmngr_lock);
+
+	return ret;
+}
+
+int mmngr_export_end_in_user(int id)
+{
+	struct mmngr_emu_buf *pent;
+
+	if (id < 0 || id >= MMNGR_EMU_MAX)
+		return R_MM_PARE;
+
+	pthread_mutex_lock(&mmngr_lock);
+	pent = &mmngr_buf[id];
+	if (pent->export_fd < 0) {
+		pthread_mutex_unlock(&mmngr_lock);
+		return R_MM_SEQERR;
+	}
+	emu_real_close(pent->export_fd);
+	pent->export_fd = -1;
+	pthread_mutex_unlock(&mmngr_lock);
+
+	return R_MM_OK;
+}
+
+int mmngr_import_start_in_user(int *pid, unsigned long *psize,
+			       unsigned long *phard_addr, int buf)
+{
+	/* no other device imports in the emulator */
+	return R_MM_FATAL;
+}
+
+int mmngr_import_end_in_user(int id)
+{
+	return R_MM_FATAL;
+}
+
+/******************************************************************************
+ *  dma-buf
+ ******************************************************************************/
+int emu_dmabuf_sync(int fd, void *parg)
+{
+	struct dma_buf_sync *psync = parg;
+
+	/* only memfds are dmabufs; anything else is not ours to sync */
+	if (fcntl(fd, F_GET_SEALS) < 0) {
+		errno = ENOTTY;
+		return -1;
+	}
+	if (psync == NULL ||
+	    (psync->flags & ~(DMA_BUF_SYNC_RW | DMA_BUF_SYNC_END)) != 0 ||
+	    (psync->flags & DMA_BUF_SYNC_RW) == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
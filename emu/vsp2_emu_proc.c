@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2 emulator : pixel processing of the modules
+ *  Straightforward reference code, no attempt to be bit exact with the
+ *  hardware; the test programs check geometry, tables and statistics.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "vsp2_emu.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define EMU_HGO_BIN		(64)
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static uint32_t	emu_lerp(uint32_t p0, uint32_t p1, int frac);
+static uint32_t	emu_clu_point(const uint32_t *ptbl, int r, int g, int b);
+static int	emu_clu_ch(uint32_t rgb, int shift);
+
+/******************************************************************************
+ *  image
+ ******************************************************************************/
+int emu_image_alloc(struct emu_image *pimg, int width, int height)
+{
+	size_t	size = (size_t)width * height * 4;
+	void	*p;
+
+	if (pimg->cap < size) {
+		p = realloc(pimg->cap ? pimg->ppix : NULL, size);
+		if (p == NULL)
+			return -1;
+		pimg->ppix	= p;
+		pimg->cap	= size;
+	}
+	pimg->width	= width;
+	pimg->height	= height;
+	pimg->stride	= width;
+	return 0;
+}
+
+void emu_proc_store(const struct emu_image *psrc, void *pmem,
+		    int width, int height, int bytesperline)
+{
+	uint8_t	*pdst = pmem;
+	int	w = psrc->width < width ? psrc->width : width;
+	int	y;
+
+	/* wpf writes the source size, the rest of the frame is cleared */
+	for (y = 0; y < height; y++) {
+		if (y < psrc->height) {
+			memcpy(pdst, psrc->ppix + (size_t)y * psrc->stride,
+			       w * 4);
+			memset(pdst + w * 4, 0, bytesperline - w * 4);
+		} else {
+			memset(pdst, 0, bytesperline);
+		}
+		pdst += bytesperline;
+	}
+}
+
+/******************************************************************************
+ *  uds : bilinear
+ ******************************************************************************/
+void emu_proc_scale(const struct emu_image *psrc, struct emu_image *pdst)
+{
+	const uint32_t	*prow0, *prow1;
+	uint32_t	*pout;
+	long long	fx, fy;
+	int		x, y, x0, y0, x1, y1;
+
+	for (y = 0; y < pdst->height; y++) {
+		/* 16.16 fixed point source position of the pixel centre */
+		fy = ((2LL * y + 1) * psrc->height * 65536 / pdst->height -
+		      65536) / 2;
+		if (fy < 0)
+			fy = 0;
+		y0 = fy >> 16;
+		y1 = y0 + 1 < psrc->height ? y0 + 1 : y0;
+		prow0 = psrc->ppix + (size_t)y0 * psrc->stride;
+		prow1 = psrc->ppix + (size_t)y1 * psrc->stride;
+		pout = pdst->ppix + (size_t)y * pdst->stride;
+
+		for (x = 0; x < pdst->width; x++) {
+			fx = ((2LL * x + 1) * psrc->width * 65536 /
+			      pdst->width - 65536) / 2;
+			if (fx < 0)
+				fx = 0;
+			x0 = fx >> 16;
+			x1 = x0 + 1 < psrc->width ? x0 + 1 : x0;
+
+			pout[x] = emu_lerp(
+				emu_lerp(prow0[x0], prow0[x1], (fx >> 8) & 0xff),
+				emu_lerp(prow1[x0], prow1[x1], (fx >> 8) & 0xff),
+				(fy >> 8) & 0xff);
+		}
+	}
+}
+
+static uint32_t emu_lerp(uint32_t p0, uint32_t p1, int frac)
+{
+	uint32_t	out = 0;
+	int		shift, c0, c1;
+
+	if (frac == 0)
+		return p0;
+	for (shift = 0; shift < 32; shift += 8) {
+		c0 = (p0 >> shift) & 0xff;
+		c1 = (p1 >> shift) & 0xff;
+		out |= (uint32_t)((c0 * (256 - frac) + c1 * frac + 128) >> 8)
+		       << shift;
+	}
+	return out;
+}
+
+/******************************************************************************
+ *  lut : one table entry per level, r:g:b in bits 23:16, 15:8, 7:0
+ ******************************************************************************/
+void emu_proc_lut(const struct emu_image *psrc, struct emu_image *pdst,
+		  const uint32_t *ptbl)
+{
+	const uint32_t	*pin;
+	uint32_t	*pout, p;
+	int		x, y;
+
+	for (y = 0; y < psrc->height; y++) {
+		pin	= psrc->ppix + (size_t)y * psrc->stride;
+		pout	= pdst->ppix + (size_t)y * pdst->stride;
+		for (x = 0; x < psrc->width; x++) {
+			p = pin[x];
+			pout[x] = EMU_ARGB(EMU_A(p),
+					   (ptbl[EMU_R(p)] >> 16) & 0xff,
+					   (ptbl[EMU_G(p)] >> 8) & 0xff,
+					   ptbl[EMU_B(p)] & 0xff);
+		}
+	}
+}
+
+/******************************************************************************
+ *  clu : 17x17x17 grid, trilinear
+ ******************************************************************************/
+void emu_proc_clu(const struct emu_image *psrc, struct emu_image *pdst,
+		  const uint32_t *ptbl)
+{
+	const uint32_t	*pin;
+	uint32_t	*pout, p, c[8];
+	int		x, y, i, shift;
+	int		pos[3], idx[3], frac[3];
+	int		v, v00, v01, v10, v11, v0, v1;
+
+	for (y = 0; y < psrc->height; y++) {
+		pin	= psrc->ppix + (size_t)y * psrc->stride;
+		pout	= pdst->ppix + (size_t)y * pdst->stride;
+		for (x = 0; x < psrc->width; x++) {
+			p = pin[x];
+			/* grid step is 16 levels, 255 maps onto the 17th */
+			pos[0] = EMU_R(p) == 255 ? 256 : EMU_R(p);
+			pos[1] = EMU_G(p) == 255 ? 256 : EMU_G(p);
+			pos[2] = EMU_B(p) == 255 ? 256 : EMU_B(p);
+			for (i = 0; i < 3; i++) {
+				idx[i]	= pos[i] >> 4;
+				frac[i]	= pos[i] & 15;
+				if (idx[i] == EMU_CLU_GRID - 1) {
+					idx[i]--;
+					frac[i] = 16;
+				}
+			}
+			for (i = 0; i < 8; i++)
+				c[i] = emu_clu_point(ptbl,
+						     idx[0] + (i & 1),
+						     idx[1] + ((i >> 1) & 1),
+						     idx[2] + ((i >> 2) & 1));
+
+			pout[x] = EMU_A(p);
+			for (shift = 16; shift >= 0; shift -= 8) {
+				v00 = emu_clu_ch(c[0], shift) * (16 - frac[0]) +
+				      emu_clu_ch(c[1], shift) * frac[0];
+				v01 = emu_clu_ch(c[2], shift) * (16 - frac[0]) +
+				      emu_clu_ch(c[3], shift) * frac[0];
+				v10 = emu_clu_ch(c[4], shift) * (16 - frac[0]) +
+				      emu_clu_ch(c[5], shift) * frac[0];
+				v11 = emu_clu_ch(c[6], shift) * (16 - frac[0]) +
+				      emu_clu_ch(c[7], shift) * frac[0];
+				v0 = v00 * (16 - frac[1]) + v01 * frac[1];
+				v1 = v10 * (16 - frac[1]) + v11 * frac[1];
+				v  = (v0 * (16 - frac[2]) + v1 * frac[2] +
+				      2048) >> 12;
+				if (v > 255)
+					v = 255;
+				/* table r:g:b 23:0 to the a:r:g:b byte order */
+				pout[x] |= (uint32_t)v << (24 - shift);
+			}
+		}
+	}
+}
+
+static uint32_t emu_clu_point(const uint32_t *ptbl, int r, int g, int b)
+{
+	/* r is the innermost index */
+	return ptbl[(b * EMU_CLU_GRID + g) * EMU_CLU_GRID + r];
+}
+
+static int emu_clu_ch(uint32_t rgb, int shift)
+{
+	return (rgb >> shift) & 0xff;
+}
+
+/******************************************************************************
+ *  bru : source over, per pixel alpha
+ ******************************************************************************/
+void emu_proc_blend(struct emu_image *pdst, const struct emu_image *psrc,
+		    int left, int top)
+{
+	const uint32_t	*pin;
+	uint32_t	*pout, s, d;
+	int		x, y, x0, x1, y0, y1;
+	int		a, ia, r, g, b, da;
+
+	x0 = left < 0 ? -left : 0;
+	y0 = top < 0 ? -top : 0;
+	x1 = psrc->width;
+	y1 = psrc->height;
+	if (left + x1 > pdst->width)
+		x1 = pdst->width - left;
+	if (top + y1 > pdst->height)
+		y1 = pdst->height - top;
+
+	for (y = y0; y < y1; y++) {
+		pin	= psrc->ppix + (size_t)y * psrc->stride;
+		pout	= pdst->ppix + (size_t)(y + top) * pdst->stride + left;
+		for (x = x0; x < x1; x++) {
+			s	= pin[x];
+			d	= pout[x];
+			a	= EMU_A(s);
+			ia	= 255 - a;
+			if (psrc->premul) {
+				r = EMU_R(s) + (EMU_R(d) * ia + 127) / 255;
+				g = EMU_G(s) + (EMU_G(d) * ia + 127) / 255;
+				b = EMU_B(s) + (EMU_B(d) * ia + 127) / 255;
+			} else {
+				r = (EMU_R(s) * a + EMU_R(d) * ia + 127) / 255;
+				g = (EMU_G(s) * a + EMU_G(d) * ia + 127) / 255;
+				b = (EMU_B(s) * a + EMU_B(d) * ia + 127) / 255;
+			}
+			da = a + (EMU_A(d) * ia + 127) / 255;
+			pout[x] = EMU_ARGB(da, r > 255 ? 255 : r,
+					   g > 255 ? 255 : g,
+					   b > 255 ? 255 : b);
+		}
+	}
+}
+
+/******************************************************************************
+ *  hgo : 3 x 64 bins of r, g, b, or 256 bins of max(r, g, b)
+ ******************************************************************************/
+void emu_proc_hgo(const struct emu_image *psrc,
+		  const struct vsp2_hgo_config *pcfg)
+{
+	uint32_t	*phist = pcfg->addr;
+	const uint32_t	*pin;
+	uint32_t	p, m;
+	int		x, y, x1, y1;
+
+	memset(phist, 0, EMU_HGO_SIZE);
+
+	x1 = pcfg->x_offset + pcfg->width;
+	y1 = pcfg->y_offset + pcfg->height;
+	if (x1 > psrc->width)
+		x1 = psrc->width;
+	if (y1 > psrc->height)
+		y1 = psrc->height;
+
+	for (y = pcfg->y_offset; y < y1; y++) {
+		pin = psrc->ppix + (size_t)y * psrc->stride;
+		for (x = pcfg->x_offset; x < x1; x++) {
+			p = pin[x];
+			if (pcfg->step_mode == 0) {
+				phist[EMU_R(p) >> 2]++;
+				phist[EMU_HGO_BIN + (EMU_G(p) >> 2)]++;
+				phist[EMU_HGO_BIN * 2 + (EMU_B(p) >> 2)]++;
+			} else {
+				m = EMU_R(p);
+				if (EMU_G(p) > m)
+					m = EMU_G(p);
+				if (EMU_B(p) > m)
+					m = EMU_B(p);
+				phist[m]++;
+			}
+		}
+	}
+}
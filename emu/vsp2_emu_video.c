@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  vsp2 emulator : video node and subdev node file operations
+ *  An open node is backed by a real eventfd, so the fd number is unique,
+ *  close() works and poll() wakes up when a buffer is done.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#include "vsp2_emu.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define EMU_PAGE_ALIGN(x)	(((x) + 4095UL) & ~4095UL)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct emu_file {
+	struct emu_entity	*pentity;	/* NULL : not emulated */
+	int			flags;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct emu_file	emu_file[EMU_FD_MAX];
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	emu_querycap(struct emu_entity *pent, struct v4l2_capability *pcap);
+static int	emu_s_fmt(struct emu_video *pvideo, struct v4l2_format *pfmt,
+			  bool try_only);
+static int	emu_reqbufs(struct media_device *pdev, struct emu_video *pvideo,
+			    int fd, struct v4l2_requestbuffers *preq);
+static void	emu_release_bufs(struct emu_video *pvideo);
+static void	emu_fill_buf(struct emu_video *pvideo, int index,
+			     struct v4l2_buffer *pbuf);
+static int	emu_qbuf(struct media_device *pdev, struct emu_video *pvideo,
+			 struct v4l2_buffer *pbuf);
+static void	emu_pin_user(unsigned long userptr, unsigned long len);
+static int	emu_dqbuf(struct media_device *pdev, struct emu_video *pvideo,
+			  int fd, struct v4l2_buffer *pbuf);
+static int	emu_streamon(struct media_device *pdev,
+			     struct emu_video *pvideo);
+static int	emu_streamoff(struct media_device *pdev,
+			      struct emu_video *pvideo);
+static int	emu_expbuf(struct emu_video *pvideo,
+			   struct v4l2_exportbuffer *pexp);
+static int	emu_subdev_ioctl(struct media_device *pdev,
+				 struct emu_entity *pent,
+				 unsigned long request, void *parg);
+static int	emu_load_table(uint32_t *pdst, int num, const uint32_t *ptbl,
+			       int tbl_num, uint32_t reg_addr, uint32_t reg_data);
+
+/******************************************************************************
+ *  file operations
+ ******************************************************************************/
+struct emu_entity *emu_fd_entity(int fd)
+{
+	if (fd < 0 || fd >= EMU_FD_MAX)
+		return NULL;
+	return emu_file[fd].pentity;
+}
+
+int emu_video_open(struct media_device *pdev, struct emu_entity *pent,
+		   int flags)
+{
+	struct emu_video	*pvideo = pent->pvideo;
+	int			fd;
+
+	pthread_mutex_lock(&pdev->lock);
+
+	/* one counter per video node, each open is a dup of it */
+	if (pvideo != NULL && pvideo->evfd < 0)
+		pvideo->evfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK |
+				       EFD_SEMAPHORE);
+	if (pvideo != NULL)
+		fd = dup(pvideo->evfd);
+	else
+		fd = eventfd(0, EFD_CLOEXEC);
+
+	if (fd >= EMU_FD_MAX) {
+		emu_real_close(fd);
+		fd = -1;
+		errno = EMFILE;
+	}
+	if (fd >= 0) {
+		emu_file[fd].pentity	= pent;
+		emu_file[fd].flags	= flags;
+	}
+
+	pthread_mutex_unlock(&pdev->lock);
+	return fd;
+}
+
+void emu_video_close(struct media_device *pdev, int fd)
+{
+	struct emu_entity	*pent = emu_fd_entity(fd);
+	struct emu_video	*pvideo;
+
+	if (pent == NULL)
+		return;
+
+	pvideo = pent->pvideo;
+	if (pvideo != NULL && pvideo->owner_fd == fd) {
+		/* the queue owner goes away : stop and free like the driver */
+		emu_streamoff(pdev, pvideo);
+		pthread_mutex_lock(&pdev->lock);
+		emu_release_bufs(pvideo);
+		pvideo->owner_fd = -1;
+		pthread_mutex_unlock(&pdev->lock);
+	}
+	emu_file[fd].pentity = NULL;
+}
+
+void *emu_video_mmap(struct media_device *pdev, int fd, size_t length,
+		     int prot, int flags, off_t offset)
+{
+	struct emu_entity	*pent = emu_fd_entity(fd);
+	struct emu_video	*pvideo = pent->pvideo;
+	void			*paddr = MAP_FAILED;
+	unsigned int		i;
+
+	pthread_mutex_lock(&pdev->lock);
+	if (pvideo != NULL && pvideo->memory == V4L2_MEMORY_MMAP) {
+		for (i = 0; i < pvideo->num; i++) {
+			if (pvideo->buf[i].offset != (unsigned long)offset)
+				continue;
+			if (length > pvideo->buf[i].length)
+				break;
+			/* a new mapping of the same pages the engine uses */
+			paddr = emu_real_mmap(NULL, length, prot, flags,
+					      pvideo->buf[i].memfd, 0);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pdev->lock);
+
+	if (paddr == MAP_FAILED)
+		errno = EINVAL;
+	return paddr;
+}
+
+int emu_video_ioctl(struct media_device *pdev, int fd,
+		    unsigned long request, void *parg)
+{
+	struct emu_entity	*pent = emu_fd_entity(fd);
+	struct emu_video	*pvideo = pent->pvideo;
+	int			ret;
+
+	if (pvideo == NULL)
+		return emu_subdev_ioctl(pdev, pent, request, parg);
+
+	switch (request) {
+	case VIDIOC_QUERYCAP:
+		return emu_querycap(pent, parg);
+	case VIDIOC_STREAMON:
+	case VIDIOC_STREAMOFF:
+		if (*(unsigned int *)parg != pvideo->type) {
+			errno = EINVAL;
+			return -1;
+		}
+		return request == VIDIOC_STREAMON
+		     ? emu_streamon(pdev, pvideo)
+		     : emu_streamoff(pdev, pvideo);
+	case VIDIOC_DQBUF:
+		return emu_dqbuf(pdev, pvideo, fd, parg);
+	default:
+		break;
+	}
+
+	pthread_mutex_lock(&pdev->lock);
+	switch (request) {
+	case VIDIOC_G_FMT:
+		if (((struct v4l2_format *)parg)->type != pvideo->type) {
+			errno = EINVAL;
+			ret = -1;
+			break;
+		}
+		((struct v4l2_format *)parg)->fmt.pix_mp = pvideo->fmt;
+		ret = 0;
+		break;
+	case VIDIOC_S_FMT:
+	case VIDIOC_TRY_FMT:
+		ret = emu_s_fmt(pvideo, parg, request == VIDIOC_TRY_FMT);
+		break;
+	case VIDIOC_REQBUFS:
+		ret = emu_reqbufs(pdev, pvideo, fd, parg);
+		break;
+	case VIDIOC_QUERYBUF:
+		if (((struct v4l2_buffer *)parg)->index >= pvideo->num ||
+		    ((struct v4l2_buffer *)parg)->type != pvideo->type) {
+			errno = EINVAL;
+			ret = -1;
+			break;
+		}
+		emu_fill_buf(pvideo, ((struct v4l2_buffer *)parg)->index,
+			     parg);
+		ret = 0;
+		break;
+	case VIDIOC_QBUF:
+		ret = emu_qbuf(pdev, pvideo, parg);
+		break;
+	case VIDIOC_EXPBUF:
+		ret = emu_expbuf(pvideo, parg);
+		break;
+	default:
+		errno = ENOTTY;
+		ret = -1;
+		break;
+	}
+	pthread_mutex_unlock(&pdev->lock);
+
+	return ret;
+}
+
+/******************************************************************************
+ *  video ioctl
+ ******************************************************************************/
+static int emu_querycap(struct emu_entity *pent, struct v4l2_capability *pcap)
+{
+	unsigned int caps;
+
+	caps = (pent->type == EMU_ENT_VIDEO_IN)
+	     ? V4L2_CAP_VIDEO_OUTPUT_MPLANE : V4L2_CAP_VIDEO_CAPTURE_MPLANE;
+
+	memset(pcap, 0, sizeof(*pcap));
+	strcpy((char *)pcap->driver, "vsp1");
+	snprintf((char *)pcap->card, sizeof(pcap->card), "%.31s", pent->name);
+	snprintf((char *)pcap->bus_info, sizeof(pcap->bus_info),
+		 "platform:%s", pent->pdev->bus_name);
+	pcap->device_caps	= caps | V4L2_CAP_STREAMING;
+	pcap->capabilities	= pcap->device_caps | V4L2_CAP_DEVICE_CAPS;
+	return 0;
+}
+
+static int emu_s_fmt(struct emu_video *pvideo, struct v4l2_format *pfmt,
+		     bool try_only)
+{
+	struct v4l2_pix_format_mplane	*pix = &pfmt->fmt.pix_mp;
+	unsigned int			bpl;
+
+	if (pfmt->type != pvideo->type) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!try_only && pvideo->num > 0) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	/* 32 bit rgb only, as the test programs use */
+	if (pix->pixelformat != V4L2_PIX_FMT_ARGB32 &&
+	    pix->pixelformat != V4L2_PIX_FMT_XRGB32)
+		pix->pixelformat = V4L2_PIX_FMT_ARGB32;
+	if (pix->width < 1)
+		pix->width = 1;
+	if (pix->width > 8190)
+		pix->width = 8190;
+	if (pix->height < 1)
+		pix->height = 1;
+	if (pix->height > 8190)
+		pix->height = 8190;
+
+	bpl = pix->width * 4;
+	if (pix->plane_fmt[0].bytesperline > bpl)
+		bpl = (pix->plane_fmt[0].bytesperline + 3) & ~3U;
+	pix->num_planes			= 1;
+	pix->plane_fmt[0].bytesperline	= bpl;
+	pix->plane_fmt[0].sizeimage	= bpl * pix->height;
+
+	if (!try_only)
+		pvideo->fmt = *pix;
+	return 0;
+}
+
+static int emu_reqbufs(struct media_device *pdev, struct emu_video *pvideo,
+		       int fd, struct v4l2_requestbuffers *preq)
+{
+	struct emu_buffer	*pbuf;
+	unsigned long		offset = 0;
+	unsigned int		i;
+
+	if (preq->type != pvideo->type ||
+	    (preq->memory != V4L2_MEMORY_MMAP &&
+	     preq->memory != V4L2_MEMORY_USERPTR &&
+	     preq->memory != V4L2_MEMORY_DMABUF)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (pvideo->streaming ||
+	    (pvideo->owner_fd >= 0 && pvideo->owner_fd != fd &&
+	     pvideo->num > 0)) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	emu_release_bufs(pvideo);
+	if (preq->count == 0) {
+		pvideo->owner_fd = -1;
+		return 0;
+	}
+	if (pvideo->fmt.width == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (preq->count > EMU_BUF_MAX)
+		preq->count = EMU_BUF_MAX;
+
+	for (i = 0; i < preq->count; i++) {
+		pbuf = &pvideo->buf[i];
+		memset(pbuf, 0, sizeof(*pbuf));
+		pbuf->memfd	= -1;
+		pbuf->dmafd	= -1;
+		pbuf->length	= pvideo->fmt.plane_fmt[0].sizeimage;
+
+		if (preq->memory != V4L2_MEMORY_MMAP)
+			continue;
+
+		/* driver owned pages, the engine keeps its own mapping */
+		pbuf->memfd = memfd_create("vsp2emu-buf", MFD_CLOEXEC);
+		if (pbuf->memfd < 0 ||
+		    ftruncate(pbuf->memfd, pbuf->length) < 0) {
+			pvideo->num = i + 1;
+			emu_release_bufs(pvideo);
+			errno = ENOMEM;
+			return -1;
+		}
+		pbuf->pmem = emu_real_mmap(NULL, pbuf->length,
+					   PROT_READ | PROT_WRITE, MAP_SHARED,
+					   pbuf->memfd, 0);
+		pbuf->offset = offset;
+		offset += EMU_PAGE_ALIGN(pbuf->length);
+	}
+
+	pvideo->num		= preq->count;
+	pvideo->memory		= preq->memory;
+	pvideo->owner_fd	= fd;
+	return 0;
+}
+
+static void emu_release_bufs(struct emu_video *pvideo)
+{
+	struct emu_buffer	*pbuf;
+	unsigned int		i;
+
+	for (i = 0; i < pvideo->num; i++) {
+		pbuf = &pvideo->buf[i];
+		if (pbuf->memfd >= 0) {
+			munmap(pbuf->pmem, pbuf->length);
+			emu_real_close(pbuf->memfd);
+		}
+		if (pbuf->dmafd >= 0) {
+			munmap(pbuf->pdma, pbuf->dma_len);
+			emu_real_close(pbuf->dmafd);
+		}
+		memset(pbuf, 0, sizeof(*pbuf));
+	}
+	pvideo->num		= 0;
+	pvideo->queue_num	= 0;
+	pvideo->done_num	= 0;
+}
+
+static void emu_fill_buf(struct emu_video *pvideo, int index,
+			 struct v4l2_buffer *pbuf)
+{
+	struct emu_buffer	*pemu = &pvideo->buf[index];
+	struct v4l2_plane	*pplane = pbuf->m.planes;
+
+	pbuf->index	= index;
+	pbuf->type	= pvideo->type;
+	pbuf->memory	= pvideo->memory;
+	pbuf->field	= V4L2_FIELD_NONE;
+	pbuf->sequence	= pemu->sequence;
+	pbuf->timestamp	= pemu->timestamp;
+	pbuf->flags	= V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	if (pemu->state == EMU_BUF_QUEUED || pemu->state == EMU_BUF_ACTIVE)
+		pbuf->flags |= V4L2_BUF_FLAG_QUEUED;
+	if (pemu->state == EMU_BUF_DONE)
+		pbuf->flags |= V4L2_BUF_FLAG_DONE;
+
+	if (pplane == NULL || pbuf->length < 1)
+		return;
+	pbuf->length		= 1;
+	pplane[0].length	= pemu->length;
+	pplane[0].bytesused	= pemu->bytesused;
+	pplane[0].data_offset	= 0;
+	switch (pvideo->memory) {
+	case V4L2_MEMORY_MMAP:
+		pplane[0].m.mem_offset = pemu->offset;
+		break;
+	case V4L2_MEMORY_USERPTR:
+		pplane[0].m.userptr = pemu->userptr;
+		break;
+	case V4L2_MEMORY_DMABUF:
+		pplane[0].m.fd = pemu->dmafd;
+		break;
+	}
+}
+
+static int emu_qbuf(struct media_device *pdev, struct emu_video *pvideo,
+		    struct v4l2_buffer *pbuf)
+{
+	struct emu_buffer	*pemu;
+	struct v4l2_plane	*pplane = pbuf->m.planes;
+	struct stat		st_new, st_old;
+	size_t			len;
+
+	if (pbuf->type != pvideo->type || pbuf->index >= pvideo->num ||
+	    pbuf->memory != pvideo->memory || pplane == NULL ||
+	    pbuf->length < 1) {
+		errno = EINVAL;
+		return -1;
+	}
+	pemu = &pvideo->buf[pbuf->index];
+	if (pemu->state != EMU_BUF_IDLE) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	switch (pvideo->memory) {
+	case V4L2_MEMORY_USERPTR:
+		if (pplane[0].m.userptr == 0 ||
+		    pplane[0].length < pvideo->fmt.plane_fmt[0].sizeimage) {
+			errno = EINVAL;
+			return -1;
+		}
+		/* pinned again only when the memory changes, as vb2 does */
+		if (pemu->userptr != pplane[0].m.userptr ||
+		    pemu->user_len != pplane[0].length)
+			emu_pin_user(pplane[0].m.userptr, pplane[0].length);
+		pemu->userptr	= pplane[0].m.userptr;
+		pemu->user_len	= pplane[0].length;
+		pemu->pmem	= (void *)pplane[0].m.userptr;
+		break;
+
+	case V4L2_MEMORY_DMABUF:
+		/* keep the attachment while the same buffer comes back */
+		if (fstat(pplane[0].m.fd, &st_new) < 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (pemu->dmafd >= 0 &&
+		    (fstat(pemu->dmafd, &st_old) < 0 ||
+		     st_old.st_ino != st_new.st_ino ||
+		     st_old.st_dev != st_new.st_dev)) {
+			munmap(pemu->pdma, pemu->dma_len);
+			emu_real_close(pemu->dmafd);
+			pemu->dmafd = -1;
+		}
+		if (pemu->dmafd < 0) {
+			len = lseek(pplane[0].m.fd, 0, SEEK_END);
+			if (len < pvideo->fmt.plane_fmt[0].sizeimage) {
+				errno = EINVAL;
+				return -1;
+			}
+			pemu->pdma = emu_real_mmap(NULL, len,
+					PROT_READ | PROT_WRITE, MAP_SHARED,
+					pplane[0].m.fd, 0);
+			if (pemu->pdma == MAP_FAILED) {
+				errno = EINVAL;
+				return -1;
+			}
+			pemu->dmafd	= fcntl(pplane[0].m.fd,
+						F_DUPFD_CLOEXEC, 0);
+			pemu->dma_len	= len;
+		}
+		pemu->pmem = pemu->pdma;
+		break;
+
+	default:
+		break;
+	}
+
+	pemu->bytesused	= pplane[0].bytesused;
+	pemu->state	= EMU_BUF_QUEUED;
+	pvideo->queue[pvideo->queue_num++] = pbuf->index;
+	emu_fill_buf(pvideo, pbuf->index, pbuf);
+
+	emu_engine_kick(pdev);
+	return 0;
+}
+
+static void emu_pin_user(unsigned long userptr, unsigned long len)
+{
+	unsigned long		start = userptr & ~4095UL;
+	unsigned long		end = EMU_PAGE_ALIGN(userptr + len);
+	volatile unsigned char	*p;
+
+	/*
+	 * the driver's get_user_pages : every page is faulted in and walked,
+	 * so the cost follows the number of pages, not the bytes
+	 */
+#ifdef MADV_POPULATE_WRITE
+	if (madvise((void *)start, end - start, MADV_POPULATE_WRITE) == 0)
+		return;
+#endif
+	for (p = (unsigned char *)start; p < (unsigned char *)end; p += 4096)
+		(void)*p;
+}
+
+static int emu_dqbuf(struct media_device *pdev, struct emu_video *pvideo,
+		     int fd, struct v4l2_buffer *pbuf)
+{
+	unsigned long long	val;
+	int			index;
+	ssize_t			ret;
+
+	if (pbuf->type != pvideo->type || pbuf->m.planes == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&pdev->lock);
+	for (;;) {
+		if (!pvideo->streaming) {
+			pthread_mutex_unlock(&pdev->lock);
+			errno = EINVAL;
+			return -1;
+		}
+		if (pvideo->done_num > 0)
+			break;
+		if (emu_file[fd].flags & O_NONBLOCK) {
+			pthread_mutex_unlock(&pdev->lock);
+			errno = EAGAIN;
+			return -1;
+		}
+		pthread_cond_wait(&pdev->cond, &pdev->lock);
+	}
+
+	index = pvideo->done[0];
+	memmove(&pvideo->done[0], &pvideo->done[1],
+		--pvideo->done_num * sizeof(int));
+	ret = read(pvideo->evfd, &val, sizeof(val));
+	(void)ret;
+
+	emu_fill_buf(pvideo, index, pbuf);
+	pvideo->buf[index].state = EMU_BUF_IDLE;
+	pbuf->flags &= ~V4L2_BUF_FLAG_DONE;
+	pthread_mutex_unlock(&pdev->lock);
+
+	return 0;
+}
+
+static int emu_streamon(struct media_device *pdev, struct emu_video *pvideo)
+{
+	pthread_mutex_lock(&pdev->lock);
+	if (!pvideo->streaming) {
+		pvideo->streaming	= true;
+		pvideo->sequence	= 0;
+	}
+	emu_engine_kick(pdev);
+	pthread_mutex_unlock(&pdev->lock);
+	return 0;
+}
+
+static int emu_streamoff(struct media_device *pdev, struct emu_video *pvideo)
+{
+	unsigned long long	val;
+	unsigned int		i;
+	ssize_t			ret;
+
+	pthread_mutex_lock(&pdev->lock);
+	pvideo->streaming = false;
+
+	/* the frame in flight completes first */
+	while (pvideo->active >= 0)
+		pthread_cond_wait(&pdev->cond, &pdev->lock);
+
+	for (i = 0; i < pvideo->num; i++)
+		pvideo->buf[i].state = EMU_BUF_IDLE;
+	while (pvideo->done_num > 0) {
+		ret = read(pvideo->evfd, &val, sizeof(val));
+		(void)ret;
+		pvideo->done_num--;
+	}
+	pvideo->queue_num = 0;
+
+	pthread_cond_broadcast(&pdev->cond);	/* wake blocked DQBUF */
+	pthread_mutex_unlock(&pdev->lock);
+	return 0;
+}
+
+static int emu_expbuf(struct emu_video *pvideo,
+		      struct v4l2_exportbuffer *pexp)
+{
+	if (pexp->type != pvideo->type || pexp->index >= pvideo->num ||
+	    pvideo->memory != V4L2_MEMORY_MMAP || pexp->plane != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pexp->fd = fcntl(pvideo->buf[pexp->index].memfd,
+			 (pexp->flags & O_CLOEXEC) ? F_DUPFD_CLOEXEC : F_DUPFD,
+			 0);
+	return pexp->fd < 0 ? -1 : 0;
+}
+
+/******************************************************************************
+ *  subdev ioctl
+ ******************************************************************************/
+static int emu_subdev_ioctl(struct media_device *pdev,
+			    struct emu_entity *pent,
+			    unsigned long request, void *parg)
+{
+	struct vsp2_lut_config	*plut = parg;
+	struct vsp2_clu_config	*pclu = parg;
+	struct vsp2_hgo_config	*phgo = parg;
+	int			ret = 0;
+
+	pthread_mutex_lock(&pdev->lock);
+
+	/* tables are read at the ioctl, used from the next frame start */
+	if (request == VIDIOC_VSP2_LUT_CONFIG && pent->type == EMU_ENT_LUT) {
+		if (plut->addr == NULL || plut->tbl_num < 1 ||
+		    plut->tbl_num > EMU_LUT_NUM) {
+			ret = -1;
+		} else {
+			if (!pdev->lut_pend_valid)
+				memcpy(pdev->lut_pend, pdev->lut,
+				       sizeof(pdev->lut));
+			ret = emu_load_table(pdev->lut_pend, EMU_LUT_NUM,
+					     plut->addr, plut->tbl_num,
+					     EMU_LUT_REG, 0);
+			pdev->lut_pend_valid = (ret == 0);
+		}
+	} else if (request == VIDIOC_VSP2_CLU_CONFIG &&
+		   pent->type == EMU_ENT_CLU) {
+		if (pclu->addr == NULL || pclu->tbl_num < 1 ||
+		    pclu->tbl_num > EMU_CLU_NUM * 2) {
+			ret = -1;
+		} else {
+			if (!pdev->clu_pend_valid)
+				memcpy(pdev->clu_pend, pdev->clu,
+				       sizeof(pdev->clu));
+			ret = emu_load_table(pdev->clu_pend, EMU_CLU_NUM,
+					     pclu->addr, pclu->tbl_num,
+					     EMU_CLU_ADDR_REG,
+					     EMU_CLU_DATA_REG);
+			pdev->clu_pend_valid = (ret == 0);
+		}
+	} else if (request == VIDIOC_VSP2_HGO_CONFIG &&
+		   pent->type == EMU_ENT_HGO) {
+		if (phgo->addr == NULL || phgo->width == 0 ||
+		    phgo->height == 0) {
+			ret = -1;
+		} else {
+			pdev->hgo_pend		= *phgo;
+			pdev->hgo_pend_valid	= true;
+		}
+	} else {
+		errno = ENOTTY;
+		pthread_mutex_unlock(&pdev->lock);
+		return -1;
+	}
+
+	pthread_mutex_unlock(&pdev->lock);
+	if (ret < 0)
+		errno = EINVAL;
+	return ret;
+}
+
+static int emu_load_table(uint32_t *pdst, int num, const uint32_t *ptbl,
+			  int tbl_num, uint32_t reg_addr, uint32_t reg_data)
+{
+	uint32_t	addr, data;
+	int		index = 0;
+	int		i;
+
+	/* address / data pairs : direct table, or index and data port */
+	for (i = 0; i < tbl_num; i++) {
+		addr = ptbl[i * 2];
+		data = ptbl[i * 2 + 1];
+
+		if (reg_data == 0) {
+			index = (addr - reg_addr) / 4;
+			if (addr < reg_addr || index >= num)
+				return -1;
+			pdst[index] = data;
+		} else if (addr == reg_addr) {
+			index = data;
+		} else if (addr == reg_data) {
+			if (index >= num)
+				return -1;
+			pdst[index++] = data;
+		} else {
+			return -1;
+		}
+	}
+	return 0;
+}
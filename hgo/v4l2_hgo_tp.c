@@ -15,6 +15,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
@@ -24,12 +25,27 @@
 #include "mmngr_user_public.h"
 #include "mmngr_buf_user_public.h"
 
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+
 
 /******************************************************************************
  *  macros
  ******************************************************************************/
 #define HGO_BUFF_SIZE	(1088)
 #define HISTGRAM_LEN	(192)
+#define HGO_BINS	(64)		/* VSP_STEP_64 */
+#define HGO_CH_NUM	(3)		/* R, G, B */
+#define HGO_RING_NUM	(8)		/* frames kept, > STREAM_BUF_NUM */
+#define HGO_BIN_CENTER(i)	((i) * 4.0f + 1.5f)
+#define HGO_TILE_MAX	(64)		/* up to 8x8 tiles */
+
+/* stream parameter : one frame in flight. VIDIOC_VSP2_HGO_CONFIG is
+ * device-global and latched at frame start, so with more queued a frame
+ * takes the result address (and window) meant for a later one. */
+#define STREAM_BUF_NUM	(1)
 
 /* device name */
 #ifndef USE_M3
@@ -40,9 +56,9 @@
 #define MEDIA_DEV_NAME		"/dev/media2"	/* fe9a0000.vsp */
 #endif
 
-#define SRC_INPUT_DEV		"%s rpf.0 input"
-#define DST_OUTPUT_DEV		"%s wpf.0 output"
-#define HGO_DEV			"%s hgo"
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+#define HGO_DEV			"hgo"
 
 /* source parameter */
 #define SRC_FILENAME		"1280_720_ARGB32.argb"
@@ -62,14 +78,6 @@
 #define VIDIOC_VSP2_HGO_CONFIG \
 	_IOWR('V', BASE_VIDIOC_PRIVATE + 3, struct vsp2_hgo_config)
 
-/******************************************************************************
- *  structure
- ******************************************************************************/
-struct dev_pads {
-	struct media_pad	*ppad0;
-	struct media_pad	*ppad1;
-};
-
 struct vsp2_hgo_config {
 	void		*addr;	/* Allocate memory size is 1088 bytes. */
 	unsigned short	width;
@@ -82,6 +90,53 @@ struct vsp2_hgo_config {
 	unsigned long	sampling;	/* sampling module */
 };
 
+struct hgo_chan_stat {
+	float	mean;
+	float	p01;
+	float	p50;
+	float	p99;
+	float	clip_lo;	/* ratio of pixels in the lowest bin */
+	float	clip_hi;	/* ratio of pixels in the highest bin */
+	float	energy;		/* mean square level */
+};
+
+/* one per frame, also the binary export format */
+struct hgo_stat_record {
+	unsigned int		sequence;
+	unsigned int		pixels;
+	long long		timestamp_us;
+	struct hgo_chan_stat	frame[HGO_CH_NUM];
+	struct hgo_chan_stat	window[HGO_CH_NUM];	/* last ring frames */
+};
+
+struct hgo_tile_grid {
+	int		cols;
+	int		rows;
+	int		num;		/* cols * rows, 0 : full frame */
+	bool		cpu;		/* CPU histograms for the other tiles */
+
+	unsigned int	hist[HGO_TILE_MAX][HISTGRAM_LEN];
+	unsigned int	sequence[HGO_TILE_MAX];	/* frame of last refresh */
+	bool		fresh[HGO_TILE_MAX];	/* refreshed in this sweep */
+	int		fresh_num;
+	int		slot_tile[HGO_RING_NUM]; /* tile latched per result slot */
+	int		empty;		/* hgo results that came back empty */
+	int		sweep_start;	/* frame the current sweep started */
+	int		sweeps;
+	long long	sweep_frames;
+
+	long long	config_us;	/* VIDIOC_VSP2_HGO_CONFIG total */
+	long long	cpu_us;		/* CPU histogram total */
+};
+
+struct hgo_ring {
+	unsigned int		hist[HGO_RING_NUM][HISTGRAM_LEN];
+	unsigned int		sequence[HGO_RING_NUM];
+	int			pos;
+	int			num;
+	unsigned long long	acc[HISTGRAM_LEN];	/* sum of the ring */
+};
+
 
 /******************************************************************************
  *  internal function
@@ -89,14 +144,42 @@ struct vsp2_hgo_config {
 static int	test_hgo_mmap(void);
 static int	test_hgo_userptr(void);
 static int	test_hgo_dmabuf(void);
+static int	test_hgo_stream(int frame_num, FILE *pcsv, FILE *pbin,
+				struct hgo_tile_grid *pgrid);
 static int	read_file(unsigned char *, unsigned int, const char *);
 static int	write_file(unsigned char *, unsigned int, const char *);
-static int	call_media_ctl(struct media_device **, const char **);
-static int	set_hgo(struct media_device *pmedia, void *pvirt_addr,
-			char *pentity_base, const char *pmedia_name);
+static int	call_media_ctl(struct vsp2_media **);
+static int	set_hgo(struct vsp2_media *pmedia, void *pvirt_addr,
+			const char *pentity);
 static void	print_histogram(unsigned long addr, unsigned long data_len);
-static int	open_video_device(struct media_device *pmedia,
-				  char *pentity_base, const char *pmedia_name);
+static int	config_hgo(int hgo_fd, void *pvirt_addr, int x, int y,
+			   int width, int height);
+static int	config_hgo_frame(int hgo_fd, unsigned long virt_addr,
+				 struct hgo_tile_grid *pgrid, int frame);
+static void	get_tile_rect(const struct hgo_tile_grid *pgrid, int tile,
+			      int *px, int *py, int *pwidth, int *pheight);
+static void	calc_cpu_histogram(const unsigned char *pframe, int x, int y,
+				   int width, int height, unsigned int *phist);
+static void	write_tile_csv(FILE *fp, const struct hgo_tile_grid *pgrid,
+			       int tile, const char *psource);
+static void	update_tile_grid(struct hgo_tile_grid *pgrid,
+				 const unsigned int *presult,
+				 const unsigned char *pframe,
+				 int frame, unsigned int sequence, FILE *pcsv);
+static void	print_tile_grid(const struct hgo_tile_grid *pgrid,
+				int frame_num);
+static long long	get_time_us(void);
+static int	queue_stream_buf(int src_fd, int dst_fd,
+				 int src_idx, int dst_idx);
+static void	calc_hgo_chan_stat(const unsigned long long *phist,
+				   struct hgo_chan_stat *pstat);
+static void	update_hgo_ring(struct hgo_ring *pring,
+				const unsigned int *presult,
+				struct hgo_stat_record *prec);
+static void	write_hgo_csv_header(FILE *fp);
+static void	write_hgo_csv(FILE *fp, const struct hgo_stat_record *prec);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
 
 /******************************************************************************
  *  main
@@ -115,35 +198,103 @@ void print_usage(const char *pname)
 	printf("        -m: use MMAP [default]\n");
 	printf("        -u: use USERPTR\n");
 	printf("        -d: use DMABUF\n");
+	printf("        -n: stream <n> frames (MMAP), one histogram each\n");
+	printf("        -o: write per-frame statistics as CSV\n");
+	printf("        -b: write per-frame statistics as binary records\n");
+	printf("        -t: <cols>x<rows> ROI grid, HGO window moves each frame\n");
+	printf("        -C: fill the other tiles with CPU histograms (with -t)\n");
 	printf("        -h: print usage\n");
 	printf("----------------------------------\n");
 }
 
 int main(int argc, char *argv[])
 {
-	int opt;
-
-	opt = getopt(argc, argv, "mudh");
-
-	switch (opt) {
+	int	opt;
+	int	mem_type = 0;
+	int	frame_num = 0;
+	int	ret;
+	FILE	*pcsv = NULL;
+	FILE	*pbin = NULL;
+
+	vsp2_trace_begin("run");
+
+	static struct hgo_tile_grid	grid;
+
+	while ((opt = getopt(argc, argv, "mudn:o:b:t:Ch")) != -1) {
+		switch (opt) {
+		case 'm':
+		case 'u':
+		case 'd':
+			mem_type = opt;
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 'o':
+			pcsv = fopen(optarg, "w");
+			if (pcsv == NULL) {
+				printf("output file open error..\n");
+				exit(1);
+			}
+			break;
+		case 'b':
+			pbin = fopen(optarg, "wb");
+			if (pbin == NULL) {
+				printf("output file open error..\n");
+				exit(1);
+			}
+			break;
+		case 't':
+			if (sscanf(optarg, "%dx%d", &grid.cols,
+				   &grid.rows) != 2 ||
+			    grid.cols < 1 || grid.rows < 1 ||
+			    grid.cols * grid.rows > HGO_TILE_MAX) {
+				printf("Error : bad tile grid (%s)\n", optarg);
+				exit(1);
+			}
+			grid.num = grid.cols * grid.rows;
+			break;
+		case 'C':
+			grid.cpu = true;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	if (frame_num > 0) {
+		printf("exec STREAM (%d frames)\n", frame_num);
+		vsp2_mem_pipeline("hgo stream");
+		ret = test_hgo_stream(frame_num, pcsv, pbin, &grid);
+		if (pcsv != NULL)
+			fclose(pcsv);
+		if (pbin != NULL)
+			fclose(pbin);
+		exit(ret < 0 ? 1 : 0);
+	}
+
+	switch (mem_type) {
 	case 'm':
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("hgo mmap");
 		test_hgo_mmap();
 		break;
 	case 'u':
 		printf("exec USERPTR\n");
+		vsp2_mem_pipeline("hgo userptr");
 		test_hgo_userptr();
 		break;
 	case 'd':
 		printf("exec DMABUF\n");
+		vsp2_mem_pipeline("hgo dmabuf");
 		test_hgo_dmabuf();
 		break;
-	case 'h':
-		print_usage(argv[0]);
-		break;
 	default:
 		print_usage(argv[0]);
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("hgo mmap");
 		test_hgo_mmap();
 		break;
 	}
@@ -156,7 +307,7 @@ int main(int argc, char *argv[])
  ******************************************************************************/
 static int test_hgo_mmap(void)
 {
-	struct media_device	*pmedia;
+	struct vsp2_media	*pmedia;
 
 	unsigned char	*psrc_buf;
 	unsigned char	*pdst_buf;
@@ -182,15 +333,13 @@ static int test_hgo_mmap(void)
 	unsigned long		mmngr_hgo_hard;
 	unsigned long		mmngr_hgo_virt;
 
-	const char *pmedia_name;
-
 	/*--------------------------------------------------------------------*/
 	/*  Allocate memory for histogram                                     */
 	/*--------------------------------------------------------------------*/
 
-	ercd = mmngr_alloc_in_user(&mmngr_hgo_fd, HGO_BUFF_SIZE,
-				   &mmngr_hgo_phys, &mmngr_hgo_hard,
-				   &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_hgo_fd, HGO_BUFF_SIZE,
+			      &mmngr_hgo_phys, &mmngr_hgo_hard,
+			      &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
 	if (ercd != 0) {
 		printf("Error : mmngr_alloc_in_user()\n");
 		return -1;
@@ -199,7 +348,9 @@ static int test_hgo_mmap(void)
 	/*--------------------------------------------------------------------*/
 	/*  Call media-ctl                                                    */
 	/*--------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -209,7 +360,7 @@ static int test_hgo_mmap(void)
 	/*  Open device                                                       */
 	/*--------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -217,7 +368,7 @@ static int test_hgo_mmap(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -261,7 +412,7 @@ static int test_hgo_mmap(void)
 	/*--------------------------------------------------------------------*/
 	/*  Make histogram - VIDIOC_VSP2_HGO_CONFIG                           */
 	/*--------------------------------------------------------------------*/
-	ret = set_hgo(pmedia, (void *)mmngr_hgo_virt, HGO_DEV, pmedia_name);
+	ret = set_hgo(pmedia, (void *)mmngr_hgo_virt, HGO_DEV);
 	if (ret != 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -628,7 +779,7 @@ static int test_hgo_mmap(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -638,7 +789,7 @@ static int test_hgo_mmap(void)
  ******************************************************************************/
 static int test_hgo_userptr(void)
 {
-	struct media_device	*pmedia;
+	struct vsp2_media	*pmedia;
 
 	unsigned char	*psrc_buf;
 	unsigned char	*pdst_buf;
@@ -674,14 +825,12 @@ static int test_hgo_userptr(void)
 	unsigned long	dst_hard;
 	unsigned long	dst_virt;
 
-	const char *pmedia_name;
-
 	/*--------------------------------------------------------------------*/
 	/*  Allocate memory for histogram                                     */
 	/*--------------------------------------------------------------------*/
-	ercd = mmngr_alloc_in_user(&mmngr_hgo_fd, HGO_BUFF_SIZE,
-				   &mmngr_hgo_phys, &mmngr_hgo_hard,
-				   &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_hgo_fd, HGO_BUFF_SIZE,
+			      &mmngr_hgo_phys, &mmngr_hgo_hard,
+			      &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
 	if (ercd != 0) {
 		printf("Error : mmngr_alloc_in_user()\n");
 		return -1;
@@ -690,7 +839,9 @@ static int test_hgo_userptr(void)
 	/*--------------------------------------------------------------------*/
 	/*  Call media-ctl                                                    */
 	/*--------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -700,7 +851,7 @@ static int test_hgo_userptr(void)
 	/*  Open device                                                       */
 	/*--------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -708,7 +859,7 @@ static int test_hgo_userptr(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -752,7 +903,7 @@ static int test_hgo_userptr(void)
 	/*--------------------------------------------------------------------*/
 	/*  Make histogram - VIDIOC_VSP2_HGO_CONFIG                           */
 	/*--------------------------------------------------------------------*/
-	ret = set_hgo(pmedia, (void *)mmngr_hgo_virt, HGO_DEV, pmedia_name);
+	ret = set_hgo(pmedia, (void *)mmngr_hgo_virt, HGO_DEV);
 	if (ret != 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -1099,7 +1250,7 @@ static int test_hgo_userptr(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -1109,7 +1260,7 @@ static int test_hgo_userptr(void)
  ******************************************************************************/
 static int test_hgo_dmabuf(void)
 {
-	struct media_device	*pmedia;
+	struct vsp2_media	*pmedia;
 
 	unsigned char	*psrc_buf;
 	unsigned char	*pdst_buf;
@@ -1149,15 +1300,13 @@ static int test_hgo_dmabuf(void)
 	int		dst_mbid;
 	int		dst_dmafd;
 
-	const char *pmedia_name;
-
 	/*--------------------------------------------------------------------*/
 	/*  Allocate memory for histogram                                     */
 	/*--------------------------------------------------------------------*/
 
-	ercd = mmngr_alloc_in_user(&mmngr_hgo_fd, HGO_BUFF_SIZE,
-				   &mmngr_hgo_phys, &mmngr_hgo_hard,
-				   &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_hgo_fd, HGO_BUFF_SIZE,
+			      &mmngr_hgo_phys, &mmngr_hgo_hard,
+			      &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
 	if (ercd != 0) {
 		printf("Error : mmngr_alloc_in_user()\n");
 		return -1;
@@ -1166,7 +1315,9 @@ static int test_hgo_dmabuf(void)
 	/*--------------------------------------------------------------------*/
 	/*  Call media-ctl                                                    */
 	/*--------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -1176,7 +1327,7 @@ static int test_hgo_dmabuf(void)
 	/*  Open device                                                       */
 	/*--------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1184,7 +1335,7 @@ static int test_hgo_dmabuf(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1228,7 +1379,7 @@ static int test_hgo_dmabuf(void)
 	/*--------------------------------------------------------------------*/
 	/*  Make histogram - VIDIOC_VSP2_HGO_CONFIG                           */
 	/*--------------------------------------------------------------------*/
-	ret = set_hgo(pmedia, (void *)mmngr_hgo_virt, HGO_DEV, pmedia_name);
+	ret = set_hgo(pmedia, (void *)mmngr_hgo_virt, HGO_DEV);
 	if (ret != 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -1316,11 +1467,21 @@ static int test_hgo_dmabuf(void)
 	/*--------------------------------------------------------------------*/
 	/*  Read file                                                         */
 	/*--------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = read_file(psrc_buf, SRC_SIZE, SRC_FILENAME);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*--------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                       */
@@ -1486,11 +1647,21 @@ static int test_hgo_dmabuf(void)
 	/*--------------------------------------------------------------------*/
 	/*  Write file                                                        */
 	/*--------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = write_file(pdst_buf, DST_SIZE, DST_FILENAME_DMABUF);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*********************************************************************
 	 *  src
@@ -1614,8 +1785,418 @@ static int test_hgo_dmabuf(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
+
+	return 0;
+}
+
+/******************************************************************************
+ *  stream (per-frame histogram ring)
+ ******************************************************************************/
+static int test_hgo_stream(int frame_num, FILE *pcsv, FILE *pbin,
+			   struct hgo_tile_grid *pgrid)
+{
+	struct vsp2_media	*pmedia;
+
+	unsigned char	*psrc_buf[STREAM_BUF_NUM];
+	unsigned char	*pdst_buf[STREAM_BUF_NUM];
+
+	int src_fd	= -1;		/* src file descriptor */
+	int dst_fd	= -1;		/* dst file descriptor */
+	int hgo_fd	= -1;		/* hgo subdev file descriptor */
+
+	unsigned int	type;
+	int		ret = -1;
+	int		ercd = 0;
+
+	struct v4l2_format		fmt;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+
+	MMNGR_ID		mmngr_hgo_fd;
+	unsigned long		mmngr_hgo_phys;
+	unsigned long		mmngr_hgo_hard;
+	unsigned long		mmngr_hgo_virt;
+
+	static struct hgo_ring	ring;
+	struct hgo_stat_record	rec;
+	struct hgo_chan_stat	sum[HGO_CH_NUM];
+	int			buf_num;
+	int			valid = 0;	/* frames with a histogram */
+	int			frame;
+	int			slot;
+	int			i, ch;
+
+	buf_num = (frame_num < STREAM_BUF_NUM) ? frame_num : STREAM_BUF_NUM;
+
+	memset(&ring, 0, sizeof(ring));
+	memset(sum, 0, sizeof(sum));
+
+	/*--------------------------------------------------------------------*/
+	/*  Allocate memory for histogram ring                                */
+	/*--------------------------------------------------------------------*/
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_hgo_fd,
+			      HGO_BUFF_SIZE * HGO_RING_NUM,
+			      &mmngr_hgo_phys, &mmngr_hgo_hard,
+			      &mmngr_hgo_virt, MMNGR_VA_SUPPORT);
+	if (ercd != 0) {
+		printf("Error : mmngr_alloc_in_user()\n");
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  Call media-ctl                                                    */
+	/*--------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  Open device                                                       */
+	/*--------------------------------------------------------------------*/
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
+	if (src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
+	if (dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/* hgo subdev stays open to move the result address every frame */
+	hgo_fd = open_video_device(pmedia, HGO_DEV);
+	if (hgo_fd == -1) {
+		printf("Error open hgo device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                      */
+	/*--------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(src_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= DST_WIDTH;
+	fmt.fmt.pix_mp.height		= DST_HEIGHT;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.num_planes	= 1;		/* argb32 */
+
+	ret = ioctl(dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS ( alloc )                                          */
+	/*--------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	req_buf.count	= buf_num;
+
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                            */
+	/*--------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		ret = ioctl(src_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		psrc_buf[i] = mmap(0, SRC_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, src_fd, planes[0].m.mem_offset);
+		if (psrc_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(dst_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pdst_buf[i] = mmap(0, DST_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, dst_fd, planes[0].m.mem_offset);
+		if (pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  Read file (same input for every frame)                            */
+	/*--------------------------------------------------------------------*/
+	ret = read_file(psrc_buf[0], SRC_SIZE, SRC_FILENAME);
+	if (ret == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	for (i = 1; i < buf_num; i++)
+		memcpy(psrc_buf[i], psrc_buf[0], SRC_SIZE);
+
+	/*--------------------------------------------------------------------*/
+	/*  VIDIOC_VSP2_HGO_CONFIG / VIDIOC_QBUF / VIDIOC_STREAMON            */
+	/*--------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		ret = config_hgo_frame(hgo_fd, mmngr_hgo_virt, pgrid, i);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		if (queue_stream_buf(src_fd, dst_fd, i, i) < 0)
+			return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	if (pcsv != NULL && pgrid->num == 0)
+		write_hgo_csv_header(pcsv);
+	else if (pcsv != NULL)
+		fprintf(pcsv, "sequence,tile,source,r_mean,g_mean,b_mean\n");
+
+	/*--------------------------------------------------------------------*/
+	/*  Streaming loop                                                    */
+	/*--------------------------------------------------------------------*/
+	for (frame = 0; frame < frame_num; frame++) {
+		int src_idx, dst_idx;
+
+		/* dst */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		ret = ioctl(dst_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		dst_idx = buf.index;
+
+		/* histogram of this frame, in queue order */
+		slot = frame % HGO_RING_NUM;
+
+		if (pgrid->num > 0) {
+			vsp2_trace_begin("tile grid");
+			update_tile_grid(pgrid, (unsigned int *)(mmngr_hgo_virt
+					 + slot * HGO_BUFF_SIZE),
+					 pdst_buf[dst_idx], frame,
+					 buf.sequence, pcsv);
+			vsp2_trace_end();
+			goto dequeue_src;
+		}
+
+		memset(&rec, 0, sizeof(rec));
+		rec.sequence	 = buf.sequence;
+		rec.timestamp_us = (long long)buf.timestamp.tv_sec * 1000000
+				 + buf.timestamp.tv_usec;
+		vsp2_trace_begin("histogram stat");
+		update_hgo_ring(&ring, (unsigned int *)(mmngr_hgo_virt +
+				slot * HGO_BUFF_SIZE), &rec);
+		vsp2_trace_end();
+
+		/* an empty result is a missed frame, not a black one */
+		for (ch = 0; ch < HGO_CH_NUM && rec.pixels != 0; ch++) {
+			sum[ch].mean	+= rec.frame[ch].mean;
+			sum[ch].p50	+= rec.frame[ch].p50;
+			sum[ch].clip_lo	+= rec.frame[ch].clip_lo;
+			sum[ch].clip_hi	+= rec.frame[ch].clip_hi;
+			sum[ch].energy	+= rec.frame[ch].energy;
+		}
+		if (rec.pixels != 0)
+			valid++;
+
+		if (pcsv != NULL)
+			write_hgo_csv(pcsv, &rec);
+		if (pbin != NULL && fwrite(&rec, sizeof(rec), 1, pbin) != 1) {
+			printf("buffer write error...\n");
+			pbin = NULL;
+		}
+
+dequeue_src:
+		/* src */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= 1;
+
+		ret = ioctl(src_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		src_idx = buf.index;
+
+		/* next frame writes into the next ring slot */
+		if (frame + buf_num < frame_num) {
+			ret = config_hgo_frame(hgo_fd, mmngr_hgo_virt, pgrid,
+					       frame + buf_num);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n",
+					__LINE__, errno);
+				return -1;
+			}
+			if (queue_stream_buf(src_fd, dst_fd, src_idx,
+					     dst_idx) < 0)
+				return -1;
+		}
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                  */
+	/*--------------------------------------------------------------------*/
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS ( release )                         */
+	/*--------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		munmap(psrc_buf[i], SRC_SIZE);
+		munmap(pdst_buf[i], DST_SIZE);
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  Print statistics summary                                          */
+	/*--------------------------------------------------------------------*/
+	if (pgrid->num > 0) {
+		print_tile_grid(pgrid, frame_num);
+	} else {
+		printf("\n----- HISTOGRAM STATISTICS (%d frames) -----\n",
+			valid);
+		printf("ch | mean   | p50    | clip lo | clip hi | energy\n");
+		for (ch = 0; ch < HGO_CH_NUM && valid > 0; ch++) {
+			printf(" %c | %6.2f | %6.2f | %7.4f | %7.4f | %9.1f\n",
+				"RGB"[ch],
+				sum[ch].mean / valid,
+				sum[ch].p50 / valid,
+				sum[ch].clip_lo / valid,
+				sum[ch].clip_hi / valid,
+				sum[ch].energy / valid);
+		}
+		if (valid != frame_num)
+			printf("empty histograms : %d of %d frames (NG)\n",
+				frame_num - valid, frame_num);
+		printf("--------------------------------------------\n");
+	}
+
+	/*--------------------------------------------------------------------*/
+	/*  Release memory for histogram                                      */
+	/*--------------------------------------------------------------------*/
+	ret = mmngr_free_in_user(mmngr_hgo_fd);
+	if (ret < 0) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		return -1;
+	}
+
+	close(hgo_fd);
+	close(src_fd);
+	close(dst_fd);
+
+	vsp2_media_close(pmedia);
 
+	if (pgrid->num == 0 && valid != frame_num)
+		return -1;
+	if (pgrid->num > 0 && pgrid->empty > 0)
+		return -1;
 	return 0;
 }
 
@@ -1631,6 +2212,8 @@ static int read_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("read file");
+
 	fp = fopen(pfilename, "rb");
 	if (fp == NULL) {
 		printf("file open error...\n");
@@ -1641,6 +2224,7 @@ static int read_file(
 			printf("buffer read error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
@@ -1653,6 +2237,8 @@ static int write_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("write file");
+
 	/* file output */
 	fp = fopen(pfilename, "wb");
 	if (!fp) {
@@ -1664,113 +2250,42 @@ static int write_file(
 			printf("buffer write error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
-static int call_media_ctl(struct media_device **ppmedia,
-			  const char **ppmedia_name)
+static int call_media_ctl(struct vsp2_media **ppmedia)
 {
-	struct media_device		*pmedia;
-	struct media_link		*plink;
-	char				*endp;
-	struct dev_pads			rpfpad;
-	struct dev_pads			wpfpad;
+	struct vsp2_media		*pmedia;
 	struct v4l2_mbus_framefmt	format;
 
-	const struct media_device_info	*pinfo;
-	char		*p;
-	const char	*pname;
-	char		buf[128];
-
 	/* Initialize v4l2 media controller */
-	pmedia = media_device_new(MEDIA_DEV_NAME);
+	pmedia = vsp2_media_open(MEDIA_DEV_NAME);
 	if (!pmedia) {
-		printf("Error : media_device_new()\n");
+		printf("Error : vsp2_media_open()\n");
 		return -1;
 	}
 
 	*ppmedia = pmedia;
 
-	if (media_device_enumerate(pmedia) != 0) {
-		printf("Error : media_device_enumerate()\n");
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
 		return -1;
 	}
 
-	if (media_reset_links(pmedia) != 0) {
-		printf("Error : media_reset_links()\n");
-		return -1;
-	}
-
-	/* get media device name */
-	pinfo = media_get_info(pmedia);
-	p = strchr(pinfo->bus_info, ':');
-	if (p)
-		pname = p + 1;
-	else
-		pname = pinfo->bus_info;
-
-	*ppmedia_name = pname;
-
 	/*----------------------*/
 	/* rpf.0:1 -> wpf.0:0   */
 	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1 -> '%s wpf.0':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(rpf -> wpf)\n");
-		return -1;
-	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(rpf -> wpf)\n");
+	if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1 -> output    */
 	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1 -> '%s wpf.0 output':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(wpf -> output)\n");
-		return -1;
-	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(wpf -> output)\n");
-		return -1;
-	}
-
-	/*------------------------------------------ get pads */
-	/*----------------------*/
-	/* rpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':0", pname);
-	rpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 0)\n");
-		return -1;
-	}
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1", pname);
-	rpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 1)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* wpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':0", pname);
-	wpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
-		return -1;
-	}
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1", pname);
-	wpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 1)\n");
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
 		return -1;
 	}
 
@@ -1781,84 +2296,47 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC_WIDTH;
 	format.height	= SRC_HEIGHT;
 	format.code		= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(rpfpad.ppad0->entity, &format,
-				   rpfpad.ppad0->index,
-				   V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(rpfpad.ppad1->entity, &format,
-				   rpfpad.ppad1->index,
-				   V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:0              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad0->entity, &format,
-				   wpfpad.ppad0->index,
-				   V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad1->entity, &format,
-				   wpfpad.ppad1->index,
-				   V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
 		return -1;
 	}
 	return 0;
 }
 
-static int set_hgo(struct media_device *pmedia, void *pvirt_addr,
-		    char *pentity_base, const char *pmedia_name)
+static int set_hgo(struct vsp2_media *pmedia, void *pvirt_addr,
+		    const char *pentity)
 {
-	struct vsp2_hgo_config	hgo_par;
-	char			entity_name[32];
-	const char		*pdevname;
-	struct media_entity	*pentity;
 	int			hgo_fd = -1;
 
 	int ret = -1;
 
 	/* Set config */
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-					   strlen(entity_name));
-	if (pentity == NULL) {
-		printf("Error media_get_entity(%s)\n", entity_name);
-		return -1;
-	}
-	pdevname = media_entity_get_devname(pentity);
-
-	if (pdevname == NULL) {
-		printf("Error media_entity_get_devname(%s)\n", entity_name);
-		return -1;
-	}
-	hgo_fd = open(pdevname, O_RDWR);
+	hgo_fd = open_video_device(pmedia, pentity);
 
 	if (hgo_fd != -1) {
-		hgo_par.addr		= pvirt_addr;
-		hgo_par.width		= SRC_WIDTH;
-		hgo_par.height		= SRC_HEIGHT;
-		hgo_par.x_offset	= 0;
-		hgo_par.y_offset	= 0;
-		/* VSP_STRAIGHT_BINARY(0x00) / VSP_OFFSET_BINARY(0x50) */
-		hgo_par.binary_mode	= 0x00;
-		/* VSP_MAXRGB_OFF(0x00) / VSP_MAXRGB_ON(0x80) */
-		hgo_par.maxrgb_mode	= 0x00;
-		/* VSP_STEP_64(0x00) / VSP_STEP_256(0x04) */
-		hgo_par.step_mode	= 0x00;
-		hgo_par.sampling	= 0;	/* VSP_SMPPT_SRC1 */
-
-		if (ioctl(hgo_fd, VIDIOC_VSP2_HGO_CONFIG, &hgo_par) != -1)
+		if (config_hgo(hgo_fd, pvirt_addr, 0, 0,
+			       SRC_WIDTH, SRC_HEIGHT) != -1)
 			ret = 0; /* success !! */
 		close(hgo_fd);
 	}
@@ -1879,21 +2357,368 @@ static void print_histogram(unsigned long addr, unsigned long data_len)
 	printf("\n----------------------------\n");
 }
 
-static int open_video_device(struct media_device *pmedia, char *pentity_base,
-			     const char *pmedia_name)
+static int config_hgo(int hgo_fd, void *pvirt_addr, int x, int y,
+		      int width, int height)
+{
+	struct vsp2_hgo_config	hgo_par;
+
+	memset(&hgo_par, 0, sizeof(hgo_par));
+	hgo_par.addr		= pvirt_addr;
+	hgo_par.width		= width;
+	hgo_par.height		= height;
+	hgo_par.x_offset	= x;
+	hgo_par.y_offset	= y;
+	/* VSP_STRAIGHT_BINARY(0x00) / VSP_OFFSET_BINARY(0x50) */
+	hgo_par.binary_mode	= 0x00;
+	/* VSP_MAXRGB_OFF(0x00) / VSP_MAXRGB_ON(0x80) */
+	hgo_par.maxrgb_mode	= 0x00;
+	/* VSP_STEP_64(0x00) / VSP_STEP_256(0x04) */
+	hgo_par.step_mode	= 0x00;
+	hgo_par.sampling	= 0;	/* VSP_SMPPT_SRC1 */
+
+	return ioctl(hgo_fd, VIDIOC_VSP2_HGO_CONFIG, &hgo_par);
+}
+
+static int queue_stream_buf(int src_fd, int dst_fd, int src_idx, int dst_idx)
 {
-	char entity_name[32];
-	const char *pdevname;
-	struct media_entity *pentity;
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= dst_idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= DST_SIZE;
+
+	if (ioctl(dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= src_idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= SRC_SIZE;
+	buf.bytesused			= SRC_SIZE;
 
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-					   strlen(entity_name));
-	if (!pentity) {
-		printf("Error media_get_entity(%s)\n", entity_name);
+	if (ioctl(src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	pdevname = media_entity_get_devname(pentity);
 
-	return open(pdevname, O_RDWR);
+	return 0;
+}
+
+static void calc_hgo_chan_stat(const unsigned long long *phist,
+			       struct hgo_chan_stat *pstat)
+{
+	unsigned long long	total = 0;
+	unsigned long long	cum = 0;
+	double			sum = 0.0, sum2 = 0.0, c;
+	int			p01 = -1, p50 = -1, p99 = -1;
+	int			i;
+
+	memset(pstat, 0, sizeof(*pstat));
+
+	for (i = 0; i < HGO_BINS; i++) {
+		c = HGO_BIN_CENTER(i);
+		total += phist[i];
+		sum   += c * phist[i];
+		sum2  += c * c * phist[i];
+	}
+	if (total == 0)
+		return;
+
+	for (i = 0; i < HGO_BINS; i++) {
+		cum += phist[i];
+		if (p01 < 0 && cum * 100 >= total * 1)
+			p01 = i;
+		if (p50 < 0 && cum * 100 >= total * 50)
+			p50 = i;
+		if (p99 < 0 && cum * 100 >= total * 99)
+			p99 = i;
+	}
+
+	pstat->mean	= sum / total;
+	pstat->p01	= HGO_BIN_CENTER(p01);
+	pstat->p50	= HGO_BIN_CENTER(p50);
+	pstat->p99	= HGO_BIN_CENTER(p99);
+	pstat->clip_lo	= (float)phist[0] / total;
+	pstat->clip_hi	= (float)phist[HGO_BINS - 1] / total;
+	pstat->energy	= sum2 / total;
+}
+
+static void update_hgo_ring(struct hgo_ring *pring, const unsigned int *presult,
+			    struct hgo_stat_record *prec)
+{
+	unsigned int		*pslot;
+	unsigned long long	hist[HGO_BINS];
+	int			ch, i;
+
+	pslot = pring->hist[pring->pos];
+
+	/* window sum : drop the oldest frame, add the new one */
+	if (pring->num == HGO_RING_NUM) {
+		for (i = 0; i < HISTGRAM_LEN; i++)
+			pring->acc[i] -= pslot[i];
+	} else {
+		pring->num++;
+	}
+	memcpy(pslot, presult, HISTGRAM_LEN * sizeof(*pslot));
+	pring->sequence[pring->pos] = prec->sequence;
+	for (i = 0; i < HISTGRAM_LEN; i++)
+		pring->acc[i] += pslot[i];
+
+	pring->pos = (pring->pos + 1) % HGO_RING_NUM;
+
+	prec->pixels = 0;
+	for (ch = 0; ch < HGO_CH_NUM; ch++) {
+		for (i = 0; i < HGO_BINS; i++)
+			hist[i] = pslot[ch * HGO_BINS + i];
+		calc_hgo_chan_stat(hist, &prec->frame[ch]);
+		calc_hgo_chan_stat(&pring->acc[ch * HGO_BINS],
+				   &prec->window[ch]);
+	}
+	for (i = 0; i < HGO_BINS; i++)
+		prec->pixels += pslot[i];
+}
+
+static void write_hgo_csv_header(FILE *fp)
+{
+	const char	*pname[] = {"mean", "p01", "p50", "p99",
+				    "clip_lo", "clip_hi", "energy"};
+	int		ch, i;
+
+	fprintf(fp, "sequence,timestamp_us,pixels");
+	for (ch = 0; ch < HGO_CH_NUM; ch++)
+		for (i = 0; i < 7; i++)
+			fprintf(fp, ",%c_%s", "rgb"[ch], pname[i]);
+	for (ch = 0; ch < HGO_CH_NUM; ch++)
+		fprintf(fp, ",%c_win_mean,%c_win_p50", "rgb"[ch], "rgb"[ch]);
+	fprintf(fp, "\n");
+}
+
+static void write_hgo_csv(FILE *fp, const struct hgo_stat_record *prec)
+{
+	const struct hgo_chan_stat	*ps;
+	int				ch;
+
+	fprintf(fp, "%u,%lld,%u", prec->sequence, prec->timestamp_us,
+		prec->pixels);
+	for (ch = 0; ch < HGO_CH_NUM; ch++) {
+		ps = &prec->frame[ch];
+		fprintf(fp, ",%.2f,%.1f,%.1f,%.1f,%.5f,%.5f,%.1f",
+			ps->mean, ps->p01, ps->p50, ps->p99,
+			ps->clip_lo, ps->clip_hi, ps->energy);
+	}
+	for (ch = 0; ch < HGO_CH_NUM; ch++)
+		fprintf(fp, ",%.2f,%.1f", prec->window[ch].mean,
+			prec->window[ch].p50);
+	fprintf(fp, "\n");
+}
+
+static int config_hgo_frame(int hgo_fd, unsigned long virt_addr,
+			    struct hgo_tile_grid *pgrid, int frame)
+{
+	void		*paddr;
+	long long	t_start;
+	int		x = 0, y = 0;
+	int		width = SRC_WIDTH, height = SRC_HEIGHT;
+	int		ret;
+
+	paddr = (void *)(virt_addr + (frame % HGO_RING_NUM) * HGO_BUFF_SIZE);
+
+	/* with a grid the window moves to the next tile every frame; the
+	 * result slot keeps the tile, as the frame that latches it is the
+	 * one whose result lands there */
+	if (pgrid->num > 0) {
+		pgrid->slot_tile[frame % HGO_RING_NUM] = frame % pgrid->num;
+		get_tile_rect(pgrid, frame % pgrid->num,
+			      &x, &y, &width, &height);
+	}
+
+	t_start = get_time_us();
+	ret = config_hgo(hgo_fd, paddr, x, y, width, height);
+	pgrid->config_us += get_time_us() - t_start;
+
+	return ret;
+}
+
+static void get_tile_rect(const struct hgo_tile_grid *pgrid, int tile,
+			  int *px, int *py, int *pwidth, int *pheight)
+{
+	int col = tile % pgrid->cols;
+	int row = tile / pgrid->cols;
+
+	/* last column / row takes the remainder */
+	*pwidth  = SRC_WIDTH / pgrid->cols;
+	*pheight = SRC_HEIGHT / pgrid->rows;
+	*px	 = col * *pwidth;
+	*py	 = row * *pheight;
+	if (col == pgrid->cols - 1)
+		*pwidth = SRC_WIDTH - *px;
+	if (row == pgrid->rows - 1)
+		*pheight = SRC_HEIGHT - *py;
+}
+
+static void calc_cpu_histogram(const unsigned char *pframe, int x, int y,
+			       int width, int height, unsigned int *phist)
+{
+	const unsigned int	*pline;
+	unsigned int		wk;
+	int			ix, iy;
+
+	memset(phist, 0, HISTGRAM_LEN * sizeof(*phist));
+
+	/* same binning as VSP_STEP_64, argb32 is a:r:g:b in byte order */
+	for (iy = y; iy < y + height; iy++) {
+		pline = (const unsigned int *)pframe + iy * DST_WIDTH + x;
+		for (ix = 0; ix < width; ix++) {
+			wk = *pline++;
+			phist[0 * HGO_BINS + ((wk >> 10) & 0x3f)]++;
+			phist[1 * HGO_BINS + ((wk >> 18) & 0x3f)]++;
+			phist[2 * HGO_BINS + ((wk >> 26) & 0x3f)]++;
+		}
+	}
+}
+
+static void write_tile_csv(FILE *fp, const struct hgo_tile_grid *pgrid,
+			   int tile, const char *psource)
+{
+	unsigned long long	hist[HGO_BINS];
+	struct hgo_chan_stat	stat;
+	int			ch, i;
+
+	fprintf(fp, "%u,%d,%s", pgrid->sequence[tile], tile, psource);
+	for (ch = 0; ch < HGO_CH_NUM; ch++) {
+		for (i = 0; i < HGO_BINS; i++)
+			hist[i] = pgrid->hist[tile][ch * HGO_BINS + i];
+		calc_hgo_chan_stat(hist, &stat);
+		fprintf(fp, ",%.2f", stat.mean);
+	}
+	fprintf(fp, "\n");
+}
+
+static void update_tile_grid(struct hgo_tile_grid *pgrid,
+			     const unsigned int *presult,
+			     const unsigned char *pframe,
+			     int frame, unsigned int sequence, FILE *pcsv)
+{
+	long long	t_start;
+	unsigned int	pixels = 0;
+	int		hw_tile = pgrid->slot_tile[frame % HGO_RING_NUM];
+	int		x, y, width, height;
+	int		tile, i;
+
+	/* an empty result refreshes nothing; the tile waits for its turn */
+	for (i = 0; i < HGO_BINS; i++)
+		pixels += presult[i];
+	if (pixels == 0) {
+		pgrid->empty++;
+		hw_tile = -1;
+	} else {
+		memcpy(pgrid->hist[hw_tile], presult,
+		       HISTGRAM_LEN * sizeof(*presult));
+		pgrid->sequence[hw_tile] = sequence;
+		if (!pgrid->fresh[hw_tile]) {
+			pgrid->fresh[hw_tile] = true;
+			pgrid->fresh_num++;
+		}
+		if (pcsv != NULL)
+			write_tile_csv(pcsv, pgrid, hw_tile, "hgo");
+	}
+
+	if (pgrid->cpu) {
+		t_start = get_time_us();
+		for (tile = 0; tile < pgrid->num; tile++) {
+			if (tile == hw_tile)
+				continue;
+			get_tile_rect(pgrid, tile, &x, &y, &width, &height);
+			calc_cpu_histogram(pframe, x, y, width, height,
+					   pgrid->hist[tile]);
+			pgrid->sequence[tile] = sequence;
+			if (!pgrid->fresh[tile]) {
+				pgrid->fresh[tile] = true;
+				pgrid->fresh_num++;
+			}
+		}
+		pgrid->cpu_us += get_time_us() - t_start;
+
+		if (pcsv != NULL) {
+			for (tile = 0; tile < pgrid->num; tile++)
+				if (tile != hw_tile)
+					write_tile_csv(pcsv, pgrid, tile, "cpu");
+		}
+	}
+
+	/* whole grid refreshed : one sweep done */
+	if (pgrid->fresh_num == pgrid->num) {
+		pgrid->sweeps++;
+		pgrid->sweep_frames += frame + 1 - pgrid->sweep_start;
+		pgrid->sweep_start = frame + 1;
+		pgrid->fresh_num = 0;
+		memset(pgrid->fresh, 0, sizeof(pgrid->fresh));
+	}
+}
+
+static void print_tile_grid(const struct hgo_tile_grid *pgrid, int frame_num)
+{
+	unsigned long long	hist[HGO_BINS];
+	struct hgo_chan_stat	stat;
+	int			tile, i;
+
+	printf("\n----- TILED HISTOGRAM (%dx%d, %s) -----\n",
+		pgrid->cols, pgrid->rows, pgrid->cpu ? "hgo + cpu" : "hgo");
+	printf("frames            : %d\n", frame_num);
+	if (pgrid->sweeps)
+		printf("full grid refresh : every %.1f frames (%d sweeps)\n",
+			(double)pgrid->sweep_frames / pgrid->sweeps,
+			pgrid->sweeps);
+	else
+		printf("full grid refresh : not reached (needs %d frames)\n",
+			pgrid->num);
+	printf("hgo config ioctl  : %lld us / frame\n",
+		pgrid->config_us / frame_num);
+	printf("cpu histogram     : %lld us / frame\n",
+		pgrid->cpu_us / frame_num);
+	if (pgrid->empty)
+		printf("empty hgo results : %d of %d frames (NG)\n",
+			pgrid->empty, frame_num);
+
+	printf("green mean per tile\n");
+	for (tile = 0; tile < pgrid->num; tile++) {
+		for (i = 0; i < HGO_BINS; i++)
+			hist[i] = pgrid->hist[tile][1 * HGO_BINS + i];
+		calc_hgo_chan_stat(hist, &stat);
+		printf(" %6.1f", stat.mean);
+		if (tile % pgrid->cols == pgrid->cols - 1)
+			printf("\n");
+	}
+	printf("-----------------------------------------\n");
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
 }
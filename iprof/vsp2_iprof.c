@@ -0,0 +1,704 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  ioctl profiler : LD_PRELOAD library
+ *  Interposes open / close / mmap / ioctl on video, subdev and media nodes
+ *  and reports count, latency distribution and arguments per request.
+ *  Calls a program makes to its own definitions of these, as the emulator
+ *  (emu/) links in, never reach the library and are not seen.
+ *
+ *  LD_PRELOAD=./libvsp2_iprof.so <program>
+ *    VSP2_IPROF_OUT=<file> : report to file [stderr]
+ *    VSP2_IPROF_LOG=<file> : one line per call with decoded arguments
+ *    VSP2_IPROF_ALL=1      : profile every fd, not only v4l2 / media nodes
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <linux/videodev2.h>
+#include <linux/v4l2-subdev.h>
+#include <linux/media.h>
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+#define IPROF_FD_MAX		(1024)
+#define IPROF_REQ_MAX		(256)		/* distinct requests, power of 2 */
+#define IPROF_BUCKETS		(24)		/* log2 ns : 1ns .. 8ms+ */
+#define IPROF_ARG_LEN		(96)
+
+/* private ioctl of vsp2driver */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+#define VIDIOC_VSP2_CLU_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
+#define VIDIOC_VSP2_HGO_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 3, struct vsp2_hgo_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct vsp2_clu_config {
+	unsigned char	mode;
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned char	fxa;
+	unsigned short	tbl_num;	/* 1 to 9826 */
+};
+
+struct vsp2_hgo_config {
+	void		*addr;	/* Allocate memory size is 1088 bytes. */
+	unsigned short	width;
+	unsigned short	height;
+	unsigned short	x_offset;
+	unsigned short	y_offset;
+	unsigned char	binary_mode;
+	unsigned char	maxrgb_mode;
+	unsigned char	step_mode;
+	unsigned long	sampling;	/* sampling module */
+};
+
+/* statistics of one request code (or open / mmap / close) */
+struct iprof_req {
+	unsigned long		request;	/* 0 : free slot */
+	bool			ready;		/* pname, min_ns set */
+	const char		*pname;
+	unsigned long long	count;
+	unsigned long long	errors;
+	unsigned long long	total_ns;
+	unsigned long long	min_ns;
+	unsigned long long	max_ns;
+	unsigned long long	bucket[IPROF_BUCKETS];
+	char			last_arg[IPROF_ARG_LEN];
+};
+
+struct iprof_name {
+	unsigned long	request;
+	const char	*pname;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static int	(*real_open)(const char *, int, ...);
+static int	(*real_open64)(const char *, int, ...);
+static int	(*real_openat)(int, const char *, int, ...);
+static int	(*real_close)(int);
+static int	(*real_ioctl)(int, unsigned long, ...);
+static void	*(*real_mmap)(void *, size_t, int, int, int, off_t);
+static void	*(*real_mmap64)(void *, size_t, int, int, int, off64_t);
+
+static bool		iprof_all;
+static FILE		*piprof_log;
+static pthread_mutex_t	iprof_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char	iprof_fd[IPROF_FD_MAX];	/* 1 : profiled */
+static struct iprof_req	iprof_req[IPROF_REQ_MAX];
+static struct iprof_req	iprof_other = {	/* table full */
+	.request	= ~0UL,
+	.ready		= true,
+	.pname		= "other",
+	.min_ns		= ~0ULL,
+};
+
+/* pseudo request codes, never valid ioctl numbers */
+#define IPROF_REQ_OPEN	(1UL)
+#define IPROF_REQ_CLOSE	(2UL)
+#define IPROF_REQ_MMAP	(3UL)
+
+#define IPROF_NAME(x)	{ x, #x }
+static const struct iprof_name iprof_names[] = {
+	{ IPROF_REQ_OPEN,  "open" },
+	{ IPROF_REQ_CLOSE, "close" },
+	{ IPROF_REQ_MMAP,  "mmap" },
+	IPROF_NAME(VIDIOC_QUERYCAP),
+	IPROF_NAME(VIDIOC_ENUM_FMT),
+	IPROF_NAME(VIDIOC_G_FMT),
+	IPROF_NAME(VIDIOC_S_FMT),
+	IPROF_NAME(VIDIOC_TRY_FMT),
+	IPROF_NAME(VIDIOC_REQBUFS),
+	IPROF_NAME(VIDIOC_QUERYBUF),
+	IPROF_NAME(VIDIOC_QBUF),
+	IPROF_NAME(VIDIOC_DQBUF),
+	IPROF_NAME(VIDIOC_EXPBUF),
+	IPROF_NAME(VIDIOC_CREATE_BUFS),
+	IPROF_NAME(VIDIOC_PREPARE_BUF),
+	IPROF_NAME(VIDIOC_STREAMON),
+	IPROF_NAME(VIDIOC_STREAMOFF),
+	IPROF_NAME(VIDIOC_G_CTRL),
+	IPROF_NAME(VIDIOC_S_CTRL),
+	IPROF_NAME(VIDIOC_G_SELECTION),
+	IPROF_NAME(VIDIOC_S_SELECTION),
+	IPROF_NAME(VIDIOC_SUBDEV_G_FMT),
+	IPROF_NAME(VIDIOC_SUBDEV_S_FMT),
+	IPROF_NAME(VIDIOC_SUBDEV_G_SELECTION),
+	IPROF_NAME(VIDIOC_SUBDEV_S_SELECTION),
+	IPROF_NAME(MEDIA_IOC_DEVICE_INFO),
+	IPROF_NAME(MEDIA_IOC_ENUM_ENTITIES),
+	IPROF_NAME(MEDIA_IOC_ENUM_LINKS),
+	IPROF_NAME(MEDIA_IOC_SETUP_LINK),
+	IPROF_NAME(VIDIOC_VSP2_LUT_CONFIG),
+	IPROF_NAME(VIDIOC_VSP2_CLU_CONFIG),
+	IPROF_NAME(VIDIOC_VSP2_HGO_CONFIG),
+};
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void	iprof_resolve(void);
+static unsigned long long	iprof_now(void);
+static bool	iprof_is_target(const char *ppath);
+static bool	iprof_fd_tracked(int fd);
+static struct iprof_req	*iprof_get_req(unsigned long request);
+static void	iprof_record(unsigned long request, unsigned long long ns,
+			     int fail, const char *parg);
+static void	iprof_decode(unsigned long request, void *parg, int before,
+			     char *pout, size_t len);
+static const char	*iprof_memory_name(unsigned int memory);
+static const char	*iprof_type_name(unsigned int type);
+static int	iprof_open_common(int ret, const char *ppath,
+				  unsigned long long t_start);
+static void	iprof_mmap_common(void *pret, int fd, size_t length,
+				  unsigned long long offset,
+				  unsigned long long t_start);
+
+/******************************************************************************
+ *  setup / report
+ ******************************************************************************/
+__attribute__((constructor))
+static void iprof_init(void)
+{
+	const char *p;
+
+	iprof_resolve();
+
+	p = getenv("VSP2_IPROF_ALL");
+	iprof_all = (p != NULL && p[0] == '1');
+
+	p = getenv("VSP2_IPROF_LOG");
+	if (p != NULL && p[0] != '\0')
+		piprof_log = fopen(p, "w");
+}
+
+__attribute__((destructor))
+static void iprof_report(void)
+{
+	struct iprof_req	*preq;
+	const char		*p;
+	FILE			*fp = stderr;
+	int			i, b;
+
+	p = getenv("VSP2_IPROF_OUT");
+	if (p != NULL && p[0] != '\0') {
+		fp = fopen(p, "w");
+		if (fp == NULL)
+			fp = stderr;
+	}
+
+	fprintf(fp, "\n----- IOCTL PROFILE -----\n");
+	fprintf(fp, "%-26s %8s %5s %9s %9s %9s  %s\n", "request", "count",
+		"err", "avg us", "min us", "max us", "last argument");
+
+	for (i = 0; i <= IPROF_REQ_MAX; i++) {
+		preq = i < IPROF_REQ_MAX ? &iprof_req[i] : &iprof_other;
+		if (!__atomic_load_n(&preq->ready, __ATOMIC_ACQUIRE) ||
+		    preq->count == 0)
+			continue;
+		fprintf(fp, "%-26s %8llu %5llu %9.1f %9.1f %9.1f  %s\n",
+			preq->pname, preq->count, preq->errors,
+			preq->total_ns / 1000.0 / preq->count,
+			preq->min_ns / 1000.0, preq->max_ns / 1000.0,
+			preq->last_arg);
+	}
+
+	/* latency distribution, bucket b holds [2^b, 2^(b+1)) ns */
+	fprintf(fp, "\nlatency distribution (count per log2 bucket)\n");
+	for (i = 0; i <= IPROF_REQ_MAX; i++) {
+		preq = i < IPROF_REQ_MAX ? &iprof_req[i] : &iprof_other;
+		if (!__atomic_load_n(&preq->ready, __ATOMIC_ACQUIRE) ||
+		    preq->count == 0)
+			continue;
+		fprintf(fp, "%-26s", preq->pname);
+		for (b = 0; b < IPROF_BUCKETS; b++) {
+			if (preq->bucket[b] == 0)
+				continue;
+			if (b < 10)
+				fprintf(fp, " <%lluns:%llu", 2ULL << b,
+					preq->bucket[b]);
+			else
+				fprintf(fp, " <%lluus:%llu",
+					(2ULL << b) / 1000, preq->bucket[b]);
+		}
+		fprintf(fp, "\n");
+	}
+	fprintf(fp, "-------------------------\n");
+
+	if (fp != stderr)
+		fclose(fp);
+	if (piprof_log != NULL)
+		fclose(piprof_log);
+}
+
+/******************************************************************************
+ *  interposed functions
+ ******************************************************************************/
+int open(const char *ppath, int flags, ...)
+{
+	unsigned long long	t_start;
+	mode_t			mode = 0;
+	va_list			ap;
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if (real_open == NULL)
+		iprof_resolve();
+
+	t_start = iprof_now();
+	return iprof_open_common(real_open(ppath, flags, mode), ppath,
+				 t_start);
+}
+
+int open64(const char *ppath, int flags, ...)
+{
+	unsigned long long	t_start;
+	mode_t			mode = 0;
+	va_list			ap;
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if (real_open64 == NULL)
+		iprof_resolve();
+
+	t_start = iprof_now();
+	return iprof_open_common(real_open64(ppath, flags, mode), ppath,
+				 t_start);
+}
+
+int openat(int dirfd, const char *ppath, int flags, ...)
+{
+	unsigned long long	t_start;
+	mode_t			mode = 0;
+	va_list			ap;
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if (real_openat == NULL)
+		iprof_resolve();
+
+	t_start = iprof_now();
+	return iprof_open_common(real_openat(dirfd, ppath, flags, mode),
+				 ppath, t_start);
+}
+
+int close(int fd)
+{
+	unsigned long long	t_start;
+	char			arg[IPROF_ARG_LEN];
+	bool			tracked;
+	int			ret;
+
+	if (real_close == NULL)
+		iprof_resolve();
+
+	tracked = iprof_fd_tracked(fd);
+	t_start = iprof_now();
+	ret = real_close(fd);
+
+	if (tracked) {
+		__atomic_store_n(&iprof_fd[fd], 0, __ATOMIC_RELAXED);
+		snprintf(arg, sizeof(arg), "fd=%d", fd);
+		iprof_record(IPROF_REQ_CLOSE, iprof_now() - t_start,
+			     ret < 0, arg);
+	}
+	return ret;
+}
+
+void *mmap(void *paddr, size_t length, int prot, int flags, int fd,
+	   off_t offset)
+{
+	unsigned long long	t_start;
+	void			*pret;
+
+	if (real_mmap == NULL)
+		iprof_resolve();
+
+	if (!iprof_fd_tracked(fd))
+		return real_mmap(paddr, length, prot, flags, fd, offset);
+
+	t_start = iprof_now();
+	pret = real_mmap(paddr, length, prot, flags, fd, offset);
+	iprof_mmap_common(pret, fd, length, offset, t_start);
+	return pret;
+}
+
+void *mmap64(void *paddr, size_t length, int prot, int flags, int fd,
+	     off64_t offset)
+{
+	unsigned long long	t_start;
+	void			*pret;
+
+	if (real_mmap64 == NULL)
+		iprof_resolve();
+
+	if (!iprof_fd_tracked(fd))
+		return real_mmap64(paddr, length, prot, flags, fd, offset);
+
+	t_start = iprof_now();
+	pret = real_mmap64(paddr, length, prot, flags, fd, offset);
+	iprof_mmap_common(pret, fd, length, offset, t_start);
+	return pret;
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	unsigned long long	t_start, ns;
+	char			arg[IPROF_ARG_LEN];
+	char			result[IPROF_ARG_LEN];
+	void			*parg;
+	va_list			ap;
+	int			ret;
+
+	va_start(ap, request);
+	parg = va_arg(ap, void *);
+	va_end(ap);
+
+	if (real_ioctl == NULL)
+		iprof_resolve();
+
+	if (!iprof_fd_tracked(fd))
+		return real_ioctl(fd, request, parg);
+
+	/* arguments as passed in, and as returned by the driver */
+	iprof_decode(request, parg, 1, arg, sizeof(arg));
+	t_start = iprof_now();
+	ret = real_ioctl(fd, request, parg);
+	ns = iprof_now() - t_start;
+
+	if (ret == 0) {
+		iprof_decode(request, parg, 0, result, sizeof(result));
+		if (result[0] != '\0')
+			strncat(arg, result, sizeof(arg) - strlen(arg) - 1);
+	}
+	iprof_record(request, ns, ret < 0, arg);
+
+	if (piprof_log != NULL) {
+		pthread_mutex_lock(&iprof_log_lock);
+		fprintf(piprof_log, "%llu fd=%d %s ret=%d %.1fus %s\n",
+			t_start, fd, iprof_get_req(request)->pname, ret,
+			ns / 1000.0, arg);
+		pthread_mutex_unlock(&iprof_log_lock);
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static void iprof_resolve(void)
+{
+	real_open	= dlsym(RTLD_NEXT, "open");
+	real_open64	= dlsym(RTLD_NEXT, "open64");
+	real_openat	= dlsym(RTLD_NEXT, "openat");
+	real_close	= dlsym(RTLD_NEXT, "close");
+	real_ioctl	= dlsym(RTLD_NEXT, "ioctl");
+	real_mmap	= dlsym(RTLD_NEXT, "mmap");
+	real_mmap64	= dlsym(RTLD_NEXT, "mmap64");
+}
+
+static unsigned long long iprof_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool iprof_is_target(const char *ppath)
+{
+	if (iprof_all)
+		return true;
+
+	return strncmp(ppath, "/dev/video", 10) == 0 ||
+	       strncmp(ppath, "/dev/v4l-subdev", 15) == 0 ||
+	       strncmp(ppath, "/dev/media", 10) == 0;
+}
+
+static bool iprof_fd_tracked(int fd)
+{
+	if (fd < 0 || fd >= IPROF_FD_MAX)
+		return false;
+	return __atomic_load_n(&iprof_fd[fd], __ATOMIC_RELAXED) != 0;
+}
+
+static int iprof_open_common(int ret, const char *ppath,
+			     unsigned long long t_start)
+{
+	char arg[IPROF_ARG_LEN];
+
+	if (ppath == NULL || !iprof_is_target(ppath))
+		return ret;
+
+	if (ret >= 0 && ret < IPROF_FD_MAX)
+		__atomic_store_n(&iprof_fd[ret], 1, __ATOMIC_RELAXED);
+
+	snprintf(arg, sizeof(arg), "%s fd=%d", ppath, ret);
+	iprof_record(IPROF_REQ_OPEN, iprof_now() - t_start, ret < 0, arg);
+	return ret;
+}
+
+static void iprof_mmap_common(void *pret, int fd, size_t length,
+			      unsigned long long offset,
+			      unsigned long long t_start)
+{
+	char arg[IPROF_ARG_LEN];
+
+	snprintf(arg, sizeof(arg), "fd=%d len=%zu off=0x%llx", fd, length,
+		 offset);
+	iprof_record(IPROF_REQ_MMAP, iprof_now() - t_start,
+		     pret == MAP_FAILED, arg);
+}
+
+static struct iprof_req *iprof_get_req(unsigned long request)
+{
+	struct iprof_req	*preq;
+	unsigned long		expected;
+	unsigned int		slot;
+	unsigned int		i;
+
+	slot = (request * 0x9e3779b1UL) >> 8;
+	for (i = 0; i < IPROF_REQ_MAX; i++) {
+		preq = &iprof_req[(slot + i) & (IPROF_REQ_MAX - 1)];
+		expected = __atomic_load_n(&preq->request, __ATOMIC_ACQUIRE);
+		if (expected == 0 &&
+		    __atomic_compare_exchange_n(&preq->request, &expected,
+						request, false,
+						__ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE)) {
+			unsigned int	n;
+			static char	unknown[IPROF_REQ_MAX][32];
+
+			preq->pname = NULL;
+			for (n = 0; n < sizeof(iprof_names) /
+					sizeof(iprof_names[0]); n++) {
+				if (iprof_names[n].request == request)
+					preq->pname = iprof_names[n].pname;
+			}
+			if (preq->pname == NULL) {
+				snprintf(unknown[(slot + i) &
+					 (IPROF_REQ_MAX - 1)], 32,
+					 "ioctl 0x%08lx", request);
+				preq->pname = unknown[(slot + i) &
+						      (IPROF_REQ_MAX - 1)];
+			}
+			preq->min_ns = ~0ULL;
+			/* published : the slot is usable from here on */
+			__atomic_store_n(&preq->ready, true, __ATOMIC_RELEASE);
+			return preq;
+		}
+		if (expected == request) {
+			/* claimed by another thread, wait for its name */
+			while (!__atomic_load_n(&preq->ready,
+						__ATOMIC_ACQUIRE))
+				;
+			return preq;
+		}
+	}
+
+	return &iprof_other;	/* table full : one bucket for the rest */
+}
+
+static void iprof_record(unsigned long request, unsigned long long ns,
+			 int fail, const char *parg)
+{
+	struct iprof_req	*preq = iprof_get_req(request);
+	unsigned long long	cur;
+	int			b = 0;
+
+	while (b < IPROF_BUCKETS - 1 && (2ULL << b) <= ns)
+		b++;
+
+	__atomic_fetch_add(&preq->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&preq->total_ns, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&preq->bucket[b], 1, __ATOMIC_RELAXED);
+	if (fail)
+		__atomic_fetch_add(&preq->errors, 1, __ATOMIC_RELAXED);
+
+	cur = __atomic_load_n(&preq->min_ns, __ATOMIC_RELAXED);
+	while (ns < cur && !__atomic_compare_exchange_n(&preq->min_ns, &cur,
+				ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	cur = __atomic_load_n(&preq->max_ns, __ATOMIC_RELAXED);
+	while (ns > cur && !__atomic_compare_exchange_n(&preq->max_ns, &cur,
+				ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+
+	/* last argument only, a torn string here is harmless */
+	strncpy(preq->last_arg, parg, IPROF_ARG_LEN - 1);
+}
+
+static const char *iprof_memory_name(unsigned int memory)
+{
+	switch (memory) {
+	case V4L2_MEMORY_MMAP:		return "mmap";
+	case V4L2_MEMORY_USERPTR:	return "userptr";
+	case V4L2_MEMORY_DMABUF:	return "dmabuf";
+	default:			return "?";
+	}
+}
+
+static const char *iprof_type_name(unsigned int type)
+{
+	switch (type) {
+	case V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE:		return "out-mp";
+	case V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE:	return "cap-mp";
+	case V4L2_BUF_TYPE_VIDEO_OUTPUT:		return "out";
+	case V4L2_BUF_TYPE_VIDEO_CAPTURE:		return "cap";
+	default:					return "?";
+	}
+}
+
+static void iprof_decode(unsigned long request, void *parg, int before,
+			 char *pout, size_t len)
+{
+	pout[0] = '\0';
+	if (parg == NULL)
+		return;
+
+	switch (request) {
+	case VIDIOC_S_FMT:
+	case VIDIOC_G_FMT:
+	case VIDIOC_TRY_FMT: {
+		struct v4l2_format *pfmt = parg;
+
+		if (before)
+			snprintf(pout, len, "%s %ux%u %.4s planes=%u",
+				 iprof_type_name(pfmt->type),
+				 pfmt->fmt.pix_mp.width,
+				 pfmt->fmt.pix_mp.height,
+				 (char *)&pfmt->fmt.pix_mp.pixelformat,
+				 pfmt->fmt.pix_mp.num_planes);
+		break;
+	}
+	case VIDIOC_REQBUFS: {
+		struct v4l2_requestbuffers *preq = parg;
+
+		if (before)
+			snprintf(pout, len, "%s %s count=%u",
+				 iprof_type_name(preq->type),
+				 iprof_memory_name(preq->memory), preq->count);
+		else
+			snprintf(pout, len, " -> %u", preq->count);
+		break;
+	}
+	case VIDIOC_QUERYBUF:
+	case VIDIOC_QBUF:
+	case VIDIOC_DQBUF: {
+		struct v4l2_buffer *pbuf = parg;
+
+		if (before)
+			snprintf(pout, len, "%s %s",
+				 iprof_type_name(pbuf->type),
+				 iprof_memory_name(pbuf->memory));
+		else
+			snprintf(pout, len, " index=%u seq=%u", pbuf->index,
+				 pbuf->sequence);
+		break;
+	}
+	case VIDIOC_EXPBUF: {
+		struct v4l2_exportbuffer *pexp = parg;
+
+		if (before)
+			snprintf(pout, len, "%s index=%u",
+				 iprof_type_name(pexp->type), pexp->index);
+		else
+			snprintf(pout, len, " -> fd=%d", pexp->fd);
+		break;
+	}
+	case VIDIOC_STREAMON:
+	case VIDIOC_STREAMOFF:
+		if (before)
+			snprintf(pout, len, "%s",
+				 iprof_type_name(*(unsigned int *)parg));
+		break;
+	case VIDIOC_SUBDEV_S_FMT:
+	case VIDIOC_SUBDEV_G_FMT: {
+		struct v4l2_subdev_format *psfmt = parg;
+
+		if (before)
+			snprintf(pout, len, "pad=%u %ux%u code=0x%x",
+				 psfmt->pad, psfmt->format.width,
+				 psfmt->format.height, psfmt->format.code);
+		break;
+	}
+	case MEDIA_IOC_SETUP_LINK: {
+		struct media_link_desc *plink = parg;
+
+		if (before)
+			snprintf(pout, len, "%u:%u -> %u:%u flags=0x%x",
+				 plink->source.entity, plink->source.index,
+				 plink->sink.entity, plink->sink.index,
+				 plink->flags);
+		break;
+	}
+	case VIDIOC_VSP2_LUT_CONFIG: {
+		struct vsp2_lut_config *plut = parg;
+
+		if (before)
+			snprintf(pout, len, "addr=%p tbl_num=%u fxa=0x%02x",
+				 plut->addr, plut->tbl_num, plut->fxa);
+		break;
+	}
+	case VIDIOC_VSP2_CLU_CONFIG: {
+		struct vsp2_clu_config *pclu = parg;
+
+		if (before)
+			snprintf(pout, len,
+				 "mode=%u addr=%p tbl_num=%u fxa=0x%02x",
+				 pclu->mode, pclu->addr, pclu->tbl_num,
+				 pclu->fxa);
+		break;
+	}
+	case VIDIOC_VSP2_HGO_CONFIG: {
+		struct vsp2_hgo_config *phgo = parg;
+
+		if (before)
+			snprintf(pout, len,
+				 "addr=%p %ux%u+%u+%u step=0x%02x smp=%lu",
+				 phgo->addr, phgo->width, phgo->height,
+				 phgo->x_offset, phgo->y_offset,
+				 phgo->step_mode, phgo->sampling);
+		break;
+	}
+	default:
+		break;
+	}
+}
@@ -5,7 +5,7 @@
  */
 
 /******************************************************************************
- *  link state  : rpf -> lut -> wpf
+ *  link state  : rpf -> lut -> wpf (hgo samples rpf for auto exposure)
  *  memory type : mmap / userptr / dmabuf
  ******************************************************************************/
 #include <stdio.h>
@@ -15,6 +15,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <math.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
@@ -24,6 +26,12 @@
 #include "mmngr_user_public.h"
 #include "mmngr_buf_user_public.h"
 
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_profile.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+
 /******************************************************************************
  *  macros
  ******************************************************************************/
@@ -36,9 +44,10 @@
 #define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
 #endif
 
-#define SRC_INPUT_DEV		"%s rpf.0 input"
-#define DST_OUTPUT_DEV		"%s wpf.0 output"
-#define LUT_DEV			"%s lut"
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+#define LUT_DEV			"lut"
+#define HGO_DEV			"hgo"
 
 /* source parameter */
 #define SRC_FILENAME		"1280_720_ARGB32.argb"
@@ -54,17 +63,32 @@
 #define DST_HEIGHT		(720)			/* dst: height */
 #define DST_SIZE		(DST_WIDTH*DST_HEIGHT*4)
 
+/* lut parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+#define LUT_CACHE_MAX		(16)		/* number of prebuilt looks */
+#define LUT_SPEC_LEN		(128)
+#define CUBE_1D_MAX		(65536)		/* max LUT_1D_SIZE */
+
+/* stream parameter */
+#define STREAM_BUF_NUM		(3)
+#define STREAM_BANDS		(8)		/* checksum bands per frame */
+#define STREAM_SWAP_PERIOD	(10)		/* frames between swaps */
+
+/* auto exposure parameter */
+#define HGO_BUFF_SIZE		(1088)
+#define HGO_BINS		(64)		/* VSP_STEP_64 */
+#define HGO_CH_NUM		(3)		/* R, G, B */
+#define AE_TARGET		(118.0)		/* mid grey in sRGB */
+#define AE_DAMPING		(0.5)		/* share of the new curve */
+#define AE_GAIN_MAX		(8.0)
+#define AE_CHECK_POINTS		(64)		/* pixels checked per frame */
+
 /* ioctl */
 #define VIDIOC_VSP2_LUT_CONFIG \
 	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
-
-/******************************************************************************
- *  structure
- ******************************************************************************/
-struct dev_pads {
-	struct media_pad	*ppad0;
-	struct media_pad	*ppad1;
-};
+#define VIDIOC_VSP2_HGO_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 3, struct vsp2_hgo_config)
 
 struct vsp2_lut_config {
 	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
@@ -72,19 +96,121 @@ struct vsp2_lut_config {
 	unsigned char	fxa;
 };
 
+struct vsp2_hgo_config {
+	void		*addr;	/* Allocate memory size is 1088 bytes. */
+	unsigned short	width;
+	unsigned short	height;
+	unsigned short	x_offset;
+	unsigned short	y_offset;
+	unsigned char	binary_mode;
+	unsigned char	maxrgb_mode;
+	unsigned char	step_mode;
+	unsigned long	sampling;	/* sampling module */
+};
+
+/* prebuilt look, keyed by the hash of its description and source data */
+struct lut_cache_entry {
+	unsigned long long	key;
+	char			spec[LUT_SPEC_LEN];
+	unsigned int		tbl[LUT_TBL_NUM*2];	/* addr / data pairs */
+};
+
+struct min_max {
+	long long	sum;
+	long long	max;
+	long long	num;
+};
+
+struct swap_stat {
+	int		cur;		/* look in effect */
+	int		pend;		/* committed look, -1 : none */
+	long long	commit_us;
+	int		wait_frames;	/* frames output since the commit */
+	unsigned int	last_seq;
+
+	/* band checksums of each look, rendered on the cpu */
+	unsigned long long	ref[LUT_CACHE_MAX][STREAM_BANDS];
+
+	int		swaps;
+	int		applied;
+	int		dropped;
+	int		torn;
+	struct min_max	ioctl_us;
+	struct min_max	apply_us;
+	struct min_max	apply_frames;
+};
+
+enum ae_mode {
+	AE_MODE_NONE = 0,
+	AE_MODE_EQUALIZE,	/* histogram equalization */
+	AE_MODE_EXPOSURE,	/* gain towards a target mean */
+};
+
+struct ae_stat {
+	double		gain;		/* exposure gain in effect */
+	double		mean_in;	/* mean level seen by the hgo */
+	int		on_time;	/* output used the curve of frame N-1 */
+	int		late;		/* output used an older curve */
+	int		mismatch;	/* output matches no known curve */
+	unsigned int	last_seq;
+	int		dropped;
+	struct min_max	cpu_us;		/* histogram -> curve -> table */
+	struct min_max	ioctl_us;	/* VIDIOC_VSP2_LUT_CONFIG */
+	struct min_max	loop_us;	/* histogram ready -> next frame queued */
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static struct lut_cache_entry	lut_cache[LUT_CACHE_MAX];
+static int			lut_cache_num;
+
 /******************************************************************************
  *  internal function
  ******************************************************************************/
 static int	test_lut_mmap(void);
 static int	test_lut_userptr(void);
 static int	test_lut_dmabuf(void);
+static int	test_lut_stream(int frame_num, int swap_period);
 static int	read_file(unsigned char*, unsigned int, const char*);
 static int	write_file(unsigned char*, unsigned int, const char*);
-static int	call_media_ctl(struct media_device **, const char **);
-static int	set_lut(struct media_device *pmedia, void *plut_table,
-			char *pentity_base, const char *pmedia_name);
-static int	open_video_device(struct media_device *pmedia,
-				  char *pentity_base, const char *pmedia_name);
+static int	call_media_ctl(struct vsp2_media **);
+static int	set_lut(struct vsp2_media *pmedia, void *plut_table,
+			const char *pentity);
+static int	add_lut_look(const char *pspec);
+static int	make_lut_curve(const char *pspec, unsigned char curve[][3]);
+static int	read_cube_1d(const char *pfilename, unsigned char curve[][3]);
+static unsigned long long	calc_hash(unsigned long long hash,
+					  const void *pdata, size_t len);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
+static int	commit_lut(int lut_fd, void *plut_table);
+static int	queue_stream_buf(int src_fd, int dst_fd,
+				 int src_idx, int dst_idx);
+static int	profile_mem_type(void);
+static long long	get_time_us(void);
+static void	stat_add(struct min_max *pmm, long long val);
+static void	calc_bands(const unsigned char *pframe,
+			   unsigned long long *pband);
+static int	calc_swap_ref(const unsigned char *psrc,
+			      const unsigned int *ptbl,
+			      unsigned long long *pband);
+static void	check_swap_frame(struct swap_stat *pstat,
+				 unsigned char *pframe);
+static int	print_swap_stat(struct swap_stat *pstat, int frame_num);
+static int	test_lut_ae(int frame_num, enum ae_mode mode, double target);
+static int	config_hgo(int hgo_fd, void *pvirt_addr);
+static void	calc_ae_curve(const unsigned int *phist, enum ae_mode mode,
+			      double target, struct ae_stat *pstat,
+			      unsigned char *pcurve);
+static void	make_ae_table(const unsigned char *pcurve, unsigned int *ptbl);
+static void	check_ae_frame(struct ae_stat *pstat,
+			       const unsigned char *psrc,
+			       const unsigned char *pdst,
+			       const unsigned char *pcurve,
+			       const unsigned char *pprev);
+static int	print_ae_stat(struct ae_stat *pstat, enum ae_mode mode,
+			      int frame_num);
 
 /******************************************************************************
  *  main
@@ -100,9 +226,26 @@ void print_usage(const char *pname)
 	printf("----------------------------------\n");
 	printf(" Usage : %s [option]\n", pname);
 	printf("    option\n");
-	printf("        -m: use MMAP [default]\n");
+	printf("        -m: use MMAP [default, unless tuned]\n");
 	printf("        -u: use USERPTR\n");
 	printf("        -d: use DMABUF\n");
+	printf("        -c: look of lookup table, repeatable up to %d :\n",
+		LUT_CACHE_MAX);
+	printf("            the 1st is used, -n swaps through them all\n");
+	printf("              negative [default]\n");
+	printf("              gamma:<g>\n");
+	printf("              srgb2linear / linear2srgb\n");
+	printf("              contrast:<gain>:<offset>\n");
+	printf("              posterize:<levels>\n");
+	printf("              channel:<gamma r>:<gamma g>:<gamma b>\n");
+	printf("              cube:<1D .cube file>\n");
+	printf("        -n: stream <n> frames (MMAP) and swap looks live\n");
+	printf("        -s: frames between look swaps [%d]\n",
+		STREAM_SWAP_PERIOD);
+	printf("        -a: auto exposure from the hgo while streaming (-n)\n");
+	printf("              eq            : histogram equalization\n");
+	printf("              exp[:<mean>]  : exposure to mean [%.0f]\n",
+		AE_TARGET);
 	printf("        -h: print usage\n");
 	printf("----------------------------------\n");
 }
@@ -110,28 +253,99 @@ void print_usage(const char *pname)
 int main(int argc, char *argv[])
 {
 	int opt;
+	int mem_type = 0;
+	int frame_num = 0;
+	int swap_period = STREAM_SWAP_PERIOD;
+	enum ae_mode ae_mode = AE_MODE_NONE;
+	double ae_target = AE_TARGET;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "mudc:n:s:a:h")) != -1) {
+		switch (opt) {
+		case 'm':
+		case 'u':
+		case 'd':
+			mem_type = opt;
+			break;
+		case 'c':
+			if (add_lut_look(optarg) < 0)
+				exit(1);
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 's':
+			swap_period = atoi(optarg);
+			if (swap_period < 1)
+				swap_period = 1;
+			break;
+		case 'a':
+			if (strcmp(optarg, "eq") == 0) {
+				ae_mode = AE_MODE_EQUALIZE;
+			} else if (strncmp(optarg, "exp", 3) == 0) {
+				ae_mode = AE_MODE_EXPOSURE;
+				if (optarg[3] == ':')
+					ae_target = atof(optarg + 4);
+			} else {
+				printf("Error : unknown auto exposure (%s)\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	/* Build all looks up front, only the upload is left per config */
+	if (lut_cache_num == 0) {
+		if (add_lut_look("negative") < 0)
+			exit(1);
+	}
+
+	if (frame_num > 0 && ae_mode != AE_MODE_NONE) {
+		printf("exec AUTO EXPOSURE (%d frames)\n", frame_num);
+		vsp2_mem_pipeline("lut ae");
+		if (test_lut_ae(frame_num, ae_mode, ae_target) < 0)
+			exit(1);
+		exit(0);
+	}
+
+	if (frame_num > 0) {
+		printf("exec STREAM (%d frames)\n", frame_num);
+		vsp2_mem_pipeline("lut stream");
+		if (test_lut_stream(frame_num, swap_period) < 0)
+			exit(1);
+		exit(0);
+	}
 
-	opt = getopt(argc, argv, "mudh");
+	/* none given : the one tune found fastest on this VSP, if any */
+	if (mem_type == 0)
+		mem_type = profile_mem_type();
 
-	switch (opt) {
+	switch (mem_type) {
 	case 'm':
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("lut mmap");
 		test_lut_mmap();
 		break;
 	case 'u':
 		printf("exec USERPTR\n");
+		vsp2_mem_pipeline("lut userptr");
 		test_lut_userptr();
 		break;
 	case 'd':
 		printf("exec DMABUF\n");
+		vsp2_mem_pipeline("lut dmabuf");
 		test_lut_dmabuf();
 		break;
-	case 'h':
-		print_usage(argv[0]);
-		break;
 	default:
 		print_usage(argv[0]);
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("lut mmap");
 		test_lut_mmap();
 		break;
 	}
@@ -144,7 +358,7 @@ int main(int argc, char *argv[])
  ******************************************************************************/
 static int test_lut_mmap(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -164,23 +378,19 @@ static int test_lut_mmap(void)
 	unsigned int        caps;
 	struct v4l2_format  gfmt;
 
-	unsigned char	*plut_table = NULL;
-
-	const char *pmedia_name;
+	unsigned int	*plut_table = NULL;
 
 	/*-------------------------------------------------------------------*/
-	/*  Allocate memory for lookup table                                 */
+	/*  Get prebuilt lookup table                                        */
 	/*-------------------------------------------------------------------*/
-	plut_table = malloc(256*8);
-	if (plut_table == NULL) {
-		printf("Error : malloc()\n");
-		return -1;
-	}
+	plut_table = lut_cache[0].tbl;
 
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -190,7 +400,7 @@ static int test_lut_mmap(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -198,7 +408,7 @@ static int test_lut_mmap(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -242,7 +452,7 @@ static int test_lut_mmap(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make lookup table - VIDIOC_VSP2_LUT_CONFIG                       */
 	/*-------------------------------------------------------------------*/
-	ret = set_lut(pmedia, plut_table, LUT_DEV, pmedia_name);
+	ret = set_lut(pmedia, plut_table, LUT_DEV);
 	if (ret == -1) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -592,15 +802,10 @@ static int test_lut_mmap(void)
 		return -1;
 	}
 
-	/*-------------------------------------------------------------------*/
-	/*  Release memory for lookup table                                  */
-	/*-------------------------------------------------------------------*/
-	free(plut_table);
-
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -610,7 +815,7 @@ static int test_lut_mmap(void)
  ******************************************************************************/
 static int test_lut_userptr(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -640,23 +845,19 @@ static int test_lut_userptr(void)
 	unsigned long	dst_hard;
 	unsigned long	dst_virt;
 
-	unsigned char	*plut_table = NULL;
-
-	const char *pmedia_name;
+	unsigned int	*plut_table = NULL;
 
 	/*-------------------------------------------------------------------*/
-	/*  Allocate memory for lookup table                                 */
+	/*  Get prebuilt lookup table                                        */
 	/*-------------------------------------------------------------------*/
-	plut_table = malloc(256*8);
-	if (plut_table == NULL) {
-		printf("Error : malloc()\n");
-		return -1;
-	}
+	plut_table = lut_cache[0].tbl;
 
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -666,7 +867,7 @@ static int test_lut_userptr(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -674,7 +875,7 @@ static int test_lut_userptr(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -718,7 +919,7 @@ static int test_lut_userptr(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make lookup table - VIDIOC_VSP2_LUT_CONFIG                       */
 	/*-------------------------------------------------------------------*/
-	ret = set_lut(pmedia, plut_table, LUT_DEV, pmedia_name);
+	ret = set_lut(pmedia, plut_table, LUT_DEV);
 	if (ret == -1) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -1048,15 +1249,10 @@ static int test_lut_userptr(void)
 		return -1;
 	}
 
-	/*-------------------------------------------------------------------*/
-	/*  Release memory for lookup table                                  */
-	/*-------------------------------------------------------------------*/
-	free(plut_table);
-
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -1066,7 +1262,7 @@ static int test_lut_userptr(void)
  ******************************************************************************/
 static int test_lut_dmabuf(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -1100,23 +1296,19 @@ static int test_lut_dmabuf(void)
 	int		dst_mbid;
 	int		dst_dmafd;
 
-	unsigned char	*plut_table = NULL;
-
-	const char *pmedia_name;
+	unsigned int	*plut_table = NULL;
 
 	/*-------------------------------------------------------------------*/
-	/*  Allocate memory for lookup table                                 */
+	/*  Get prebuilt lookup table                                        */
 	/*-------------------------------------------------------------------*/
-	plut_table = malloc(256*8);
-	if (plut_table == NULL) {
-		printf("Error : malloc()\n");
-		return -1;
-	}
+	plut_table = lut_cache[0].tbl;
 
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -1126,7 +1318,7 @@ static int test_lut_dmabuf(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1134,7 +1326,7 @@ static int test_lut_dmabuf(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1178,7 +1370,7 @@ static int test_lut_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Make lookup table - VIDIOC_VSP2_LUT_CONFIG                       */
 	/*-------------------------------------------------------------------*/
-	ret = set_lut(pmedia, plut_table, LUT_DEV, pmedia_name);
+	ret = set_lut(pmedia, plut_table, LUT_DEV);
 	if (ret == -1) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
@@ -1266,11 +1458,21 @@ static int test_lut_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Read file                                                        */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = read_file(psrc_buf, SRC_SIZE, SRC_FILENAME);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -1436,11 +1638,21 @@ static int test_lut_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Write file                                                       */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = write_file(pdst_buf, DST_SIZE, DST_FILENAME_DMABUF);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*********************************************************************
 	 *  src
@@ -1547,346 +1759,1556 @@ static int test_lut_dmabuf(void)
 		return -1;
 	}
 
-	/*-------------------------------------------------------------------*/
-	/*  Release memory for lookup table                                  */
-	/*-------------------------------------------------------------------*/
-	free(plut_table);
-
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
 
 /******************************************************************************
- *  internal function
+ *  stream (live look swap)
  ******************************************************************************/
-static int read_file(
-	unsigned char	*pbuffers,
-	unsigned int	size,
-	const char	*pfilename
-	)
+static int test_lut_stream(int frame_num, int swap_period)
 {
-	FILE	*fp;
-	int	ret;
+	struct vsp2_media  *pmedia;
 
-	fp = fopen(pfilename, "rb");
-	if (fp == NULL) {
-		printf("file open error...\n");
-		ret = 0;
-	} else {
-		ret = fread(pbuffers, size, 1, fp);
-		if (ret == 0)
-			printf("buffer read error...\n");
-		fclose(fp);
-	}
-	return ret;
-}
+	unsigned char  *psrc_buf[STREAM_BUF_NUM];
+	unsigned char  *pdst_buf[STREAM_BUF_NUM];
 
-static int write_file(
-	unsigned char	*pbuffers,
-	unsigned int	size,
-	const char	*pfilename
-	)
-{
-	FILE	*fp;
-	int	ret;
+	int src_fd = -1;	/* src file descriptor */
+	int dst_fd = -1;	/* dst file descriptor */
+	int lut_fd = -1;	/* lut subdev file descriptor */
 
-	/* file output */
-	fp = fopen(pfilename, "wb");
-	if (!fp) {
-		printf("output file open error..\n");
-		ret = 0;
-	} else {
-		ret = fwrite(pbuffers, size, 1, fp);
-		if (ret == 0)
-			printf("buffer write error...\n");
-		fclose(fp);
-	}
-	return ret;
-}
+	unsigned int  type;
+	int           ret = -1;
+	int           ercd = 0;
 
-static int call_media_ctl(struct media_device **ppmedia,
-			  const char **ppmedia_name)
-{
-	struct media_device		*pmedia;
-	struct media_link		*plink;
-	char				*endp;
-	struct dev_pads			rpfpad;
-	struct dev_pads			lutpad;
-	struct dev_pads			wpfpad;
-	struct v4l2_mbus_framefmt	format;
+	struct v4l2_format          fmt;
+	struct v4l2_requestbuffers  req_buf;
+	struct v4l2_buffer          buf;
+	struct v4l2_plane           planes[VIDEO_MAX_PLANES];
 
-	const struct media_device_info	*pinfo;
-	char		*p;
-	const char	*pname;
-	char		buf[128];
+	MMNGR_ID	mmngr_lut_fd[2];
+	unsigned long	mmngr_lut_phys[2];
+	unsigned long	mmngr_lut_hard[2];
+	unsigned long	mmngr_lut_virt[2];
+	int		tbl_side = 0;	/* table buffer in use by hardware */
 
-	/* Initialize v4l2 media controller */
-	pmedia = media_device_new(MEDIA_DEV_NAME);
-	if (!pmedia) {
-		printf("Error : media_device_new()\n");
-		return -1;
-	}
+	struct swap_stat	stat;
+	long long		t_start;
+	int			buf_num;
+	int			frame;
+	int			i;
 
-	*ppmedia = pmedia;
+	/* need two different looks to swap between */
+	if (lut_cache_num < 2)
+		add_lut_look("gamma:1.0");
+	if (lut_cache_num < 2)
+		add_lut_look("negative");
 
-	if (media_device_enumerate(pmedia) != 0) {
-		printf("Error : media_device_enumerate()\n");
-		return -1;
+	buf_num = (frame_num < STREAM_BUF_NUM) ? frame_num : STREAM_BUF_NUM;
+
+	memset(&stat, 0, sizeof(stat));
+	stat.pend = -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Allocate memory by mmngr for double buffered lookup table        */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < 2; i++) {
+		ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_lut_fd[i],
+			LUT_TBL_NUM*8, &mmngr_lut_phys[i], &mmngr_lut_hard[i],
+			&mmngr_lut_virt[i], MMNGR_VA_SUPPORT);
+		if (ercd != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			return -1;
+		}
 	}
 
-	if (media_reset_links(pmedia) != 0) {
-		printf("Error : media_reset_links()\n");
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
 		return -1;
 	}
 
-	/* get media device name */
-	pinfo = media_get_info(pmedia);
-	p = strchr(pinfo->bus_info, ':');
-	if (p)
-		pname = p + 1;
-	else
-		pname = pinfo->bus_info;
-
-	*ppmedia_name = pname;
-
-	/*----------------------*/
-	/* rpf.0:1 -> lut:0     */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1 -> '%s lut':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(rpf -> lut)\n");
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
+	if (src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
 		return -1;
 	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(rpf -> lut)\n");
+
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
+	if (dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
 		return -1;
 	}
-	/*----------------------*/
-	/* lut:1 -> wpf.0:0     */
-	/*----------------------*/
-	sprintf(buf, "'%s lut':1 -> '%s wpf.0':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(lut -> wpf)\n");
+
+	/* lut subdev stays open for the commits while streaming */
+	lut_fd = open_video_device(pmedia, LUT_DEV);
+	if (lut_fd == -1) {
+		printf("Error open lut device: %s (%d).\n",
+			strerror(errno), errno);
 		return -1;
 	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(lut -> wpf)\n");
+
+	/*-------------------------------------------------------------------*/
+	/*  Initial lookup table - VIDIOC_VSP2_LUT_CONFIG                    */
+	/*-------------------------------------------------------------------*/
+	memcpy((void *)mmngr_lut_virt[tbl_side], lut_cache[0].tbl,
+	       sizeof(lut_cache[0].tbl));
+	ret = commit_lut(lut_fd, (void *)mmngr_lut_virt[tbl_side]);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	/*----------------------*/
-	/* wpf.0:1 -> output    */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1 -> '%s wpf.0 output':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(wpf -> output)\n");
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(src_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(wpf -> output)\n");
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= DST_WIDTH;
+	fmt.fmt.pix_mp.height		= DST_HEIGHT;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.num_planes	= 1;		/* argb32 */
+
+	ret = ioctl(dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
 
-	/*-------------------------------------------------- get pads*/
-	/*----------------------*/
-	/* rpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':0", pname);
-	rpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 0)\n");
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1", pname);
-	rpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 1)\n");
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	req_buf.count	= buf_num;
+
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	/*----------------------*/
-	/* lut pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s lut':0", pname);
-	lutpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (lutpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 0)\n");
-		return -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                           */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		ret = ioctl(src_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		psrc_buf[i] = mmap(0, SRC_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, src_fd, planes[0].m.mem_offset);
+		if (psrc_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(dst_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pdst_buf[i] = mmap(0, DST_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, dst_fd, planes[0].m.mem_offset);
+		if (pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap", __LINE__);
+			return -1;
+		}
 	}
-	/*----------------------*/
-	sprintf(buf, "'%s lut':1", pname);
-	lutpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (lutpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 1)\n");
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file (same input for every frame)                           */
+	/*-------------------------------------------------------------------*/
+	ret = read_file(psrc_buf[0], SRC_SIZE, SRC_FILENAME);
+	if (ret == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	/*----------------------*/
-	/* wpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':0", pname);
-	wpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
-		return -1;
+	for (i = 1; i < buf_num; i++)
+		memcpy(psrc_buf[i], psrc_buf[0], SRC_SIZE);
+
+	/* what each look must give, to tell an applied swap from a late one */
+	for (i = 0; i < lut_cache_num; i++) {
+		ret = calc_swap_ref(psrc_buf[0], lut_cache[i].tbl,
+				    stat.ref[i]);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
 	}
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1", pname);
-	wpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QBUF / VIDIOC_STREAMON                                    */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		if (queue_stream_buf(src_fd, dst_fd, i, i) < 0)
+			return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
 
-	/*----------------------------------------------------- set format */
-	/*----------------------*/
-	/* rpf.0:0              */
-	/*----------------------*/
-	format.width	= SRC_WIDTH;
-	format.height	= SRC_HEIGHT;
-	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(rpfpad.ppad0->entity, &format,
-		rpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 0)\n");
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Streaming loop                                                   */
+	/*-------------------------------------------------------------------*/
+	for (frame = 0; frame < frame_num; frame++) {
+		int src_idx, dst_idx;
+
+		/* dst */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		ret = ioctl(dst_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		dst_idx = buf.index;
+
+		if (frame > 0 && buf.sequence != stat.last_seq + 1)
+			stat.dropped += buf.sequence - stat.last_seq - 1;
+		stat.last_seq = buf.sequence;
+
+		vsp2_trace_begin("check frame");
+		check_swap_frame(&stat, pdst_buf[dst_idx]);
+		vsp2_trace_end();
+
+		/* src */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= 1;
+
+		ret = ioctl(src_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		src_idx = buf.index;
+
+		/* commit the next look while the hardware keeps running,
+		 * only while the frame queued below is there to latch it */
+		if ((frame + 1) % swap_period == 0 && stat.pend < 0 &&
+		    frame + buf_num < frame_num) {
+			int next = (stat.cur + 1) % lut_cache_num;
+
+			tbl_side ^= 1;
+			memcpy((void *)mmngr_lut_virt[tbl_side],
+			       lut_cache[next].tbl, sizeof(lut_cache[next].tbl));
+
+			t_start = get_time_us();
+			ret = commit_lut(lut_fd, (void *)mmngr_lut_virt[tbl_side]);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n",
+					__LINE__, errno);
+				return -1;
+			}
+			stat.commit_us = get_time_us();
+			stat_add(&stat.ioctl_us, stat.commit_us - t_start);
+			stat.pend = next;
+			stat.wait_frames = 0;
+			stat.swaps++;
+		}
+
+		if (frame + buf_num < frame_num) {
+			if (queue_stream_buf(src_fd, dst_fd, src_idx,
+					     dst_idx) < 0)
+				return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < buf_num; i++) {
+		munmap(psrc_buf[i], SRC_SIZE);
+		munmap(pdst_buf[i], DST_SIZE);
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for lookup table                                  */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < 2; i++) {
+		ret = mmngr_free_in_user(mmngr_lut_fd[i]);
+		if (ret < 0) {
+			printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+			return -1;
+		}
+	}
+
+	ret = print_swap_stat(&stat, frame_num);
+
+	close(lut_fd);
+	close(src_fd);
+	close(dst_fd);
+
+	vsp2_media_close(pmedia);
+
+	return ret;
+}
+
+/******************************************************************************
+ *  auto exposure
+ ******************************************************************************/
+static int test_lut_ae(int frame_num, enum ae_mode mode, double target)
+{
+	struct vsp2_media  *pmedia;
+
+	unsigned char  *psrc_buf;
+	unsigned char  *pdst_buf;
+
+	int src_fd = -1;	/* src file descriptor */
+	int dst_fd = -1;	/* dst file descriptor */
+	int lut_fd = -1;	/* lut subdev file descriptor */
+	int hgo_fd = -1;	/* hgo subdev file descriptor */
+
+	unsigned int  type;
+	int           ret = -1;
+	int           ercd = 0;
+
+	struct v4l2_format          fmt;
+	struct v4l2_requestbuffers  req_buf;
+	struct v4l2_buffer          buf;
+	struct v4l2_plane           planes[VIDEO_MAX_PLANES];
+
+	MMNGR_ID	mmngr_lut_fd[2];
+	unsigned long	mmngr_lut_phys[2];
+	unsigned long	mmngr_lut_hard[2];
+	unsigned long	mmngr_lut_virt[2];
+	int		tbl_side = 0;	/* table buffer in use by hardware */
+
+	MMNGR_ID	mmngr_hgo_fd;
+	unsigned long	mmngr_hgo_phys;
+	unsigned long	mmngr_hgo_hard;
+	unsigned long	mmngr_hgo_virt;
+
+	/* curve of the frame in flight and of the one before */
+	unsigned char	curve[2][LUT_TBL_NUM];
+	struct ae_stat	stat;
+	long long	t_hist, t_start, t_end;
+	int		frame;
+	int		i;
+
+	memset(&stat, 0, sizeof(stat));
+	stat.gain = 1.0;
+	for (i = 0; i < LUT_TBL_NUM; i++)
+		curve[0][i] = curve[1][i] = i;
+
+	/*-------------------------------------------------------------------*/
+	/*  Allocate memory by mmngr for lookup table and histogram          */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < 2; i++) {
+		ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_lut_fd[i],
+			LUT_TBL_NUM*8, &mmngr_lut_phys[i], &mmngr_lut_hard[i],
+			&mmngr_lut_virt[i], MMNGR_VA_SUPPORT);
+		if (ercd != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			return -1;
+		}
+	}
+
+	ercd = vsp2_mem_alloc(VSP2_MEM_TABLE, &mmngr_hgo_fd,
+		HGO_BUFF_SIZE, &mmngr_hgo_phys, &mmngr_hgo_hard,
+		&mmngr_hgo_virt, MMNGR_VA_SUPPORT);
+	if (ercd != 0) {
+		printf("Error : mmngr_alloc_in_user()\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
+	if (src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
+	if (dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	lut_fd = open_video_device(pmedia, LUT_DEV);
+	if (lut_fd == -1) {
+		printf("Error open lut device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	hgo_fd = open_video_device(pmedia, HGO_DEV);
+	if (hgo_fd == -1) {
+		printf("Error open hgo device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Initial lookup table (identity) - VIDIOC_VSP2_LUT_CONFIG         */
+	/*-------------------------------------------------------------------*/
+	make_ae_table(curve[0], (unsigned int *)mmngr_lut_virt[tbl_side]);
+	ret = commit_lut(lut_fd, (void *)mmngr_lut_virt[tbl_side]);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(src_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= DST_WIDTH;
+	fmt.fmt.pix_mp.height		= DST_HEIGHT;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.num_planes	= 1;		/* argb32 */
+
+	ret = ioctl(dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*  One frame in flight: the curve from frame N is always in place   */
+	/*  before frame N+1 is queued, so the loop latency is one frame.    */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 1;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != 1) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	req_buf.count	= 1;
+
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != 1) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.index	= 0;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+	buf.m.planes	= planes;
+
+	ret = ioctl(src_fd, VIDIOC_QUERYBUF, &buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	psrc_buf = mmap(0, SRC_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, src_fd, planes[0].m.mem_offset);
+	if (psrc_buf == MAP_FAILED) {
+		printf("Error(%d) : mmap", __LINE__);
+		return -1;
+	}
+
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.length	= VIDEO_MAX_PLANES;
+	memset(planes, 0, sizeof(planes));
+
+	ret = ioctl(dst_fd, VIDIOC_QUERYBUF, &buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	pdst_buf = mmap(0, DST_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, dst_fd, planes[0].m.mem_offset);
+	if (pdst_buf == MAP_FAILED) {
+		printf("Error(%d) : mmap", __LINE__);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file (same input for every frame)                           */
+	/*-------------------------------------------------------------------*/
+	ret = read_file(psrc_buf, SRC_SIZE, SRC_FILENAME);
+	if (ret == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_VSP2_HGO_CONFIG / VIDIOC_QBUF / VIDIOC_STREAMON           */
+	/*-------------------------------------------------------------------*/
+	ret = config_hgo(hgo_fd, (void *)mmngr_hgo_virt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	if (queue_stream_buf(src_fd, dst_fd, 0, 0) < 0)
+		return -1;
+
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Control loop : histogram of N -> curve -> lut of N+1             */
+	/*-------------------------------------------------------------------*/
+	for (frame = 0; frame < frame_num; frame++) {
+		/* dst */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		ret = ioctl(dst_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		t_hist = get_time_us();
+
+		if (frame > 0 && buf.sequence != stat.last_seq + 1)
+			stat.dropped += buf.sequence - stat.last_seq - 1;
+		stat.last_seq = buf.sequence;
+
+		/* src */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= 1;
+
+		ret = ioctl(src_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		/* was frame N made with the curve committed after N-1 ? */
+		vsp2_trace_begin("check frame");
+		check_ae_frame(&stat, psrc_buf, pdst_buf,
+			       curve[frame & 1], curve[(frame & 1) ^ 1]);
+		vsp2_trace_end();
+
+		if (frame + 1 >= frame_num)
+			break;
+
+		/* cpu kernel : histogram -> curve -> table */
+		vsp2_trace_begin("ae curve");
+		t_start = get_time_us();
+		memcpy(curve[(frame + 1) & 1], curve[frame & 1],
+		       sizeof(curve[0]));
+		calc_ae_curve((unsigned int *)mmngr_hgo_virt, mode, target,
+			      &stat, curve[(frame + 1) & 1]);
+		tbl_side ^= 1;
+		make_ae_table(curve[(frame + 1) & 1],
+			      (unsigned int *)mmngr_lut_virt[tbl_side]);
+		t_end = get_time_us();
+		vsp2_trace_end();
+		stat_add(&stat.cpu_us, t_end - t_start);
+
+		ret = commit_lut(lut_fd, (void *)mmngr_lut_virt[tbl_side]);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		t_start = get_time_us();
+		stat_add(&stat.ioctl_us, t_start - t_end);
+
+		ret = config_hgo(hgo_fd, (void *)mmngr_hgo_virt);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		if (queue_stream_buf(src_fd, dst_fd, 0, 0) < 0)
+			return -1;
+		stat_add(&stat.loop_us, get_time_us() - t_hist);
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	ret = ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+	munmap(psrc_buf, SRC_SIZE);
+	munmap(pdst_buf, DST_SIZE);
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	ret = ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for lookup table and histogram                    */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < 2; i++) {
+		ret = mmngr_free_in_user(mmngr_lut_fd[i]);
+		if (ret < 0) {
+			printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+			return -1;
+		}
+	}
+
+	ret = mmngr_free_in_user(mmngr_hgo_fd);
+	if (ret < 0) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		return -1;
+	}
+
+	ret = print_ae_stat(&stat, mode, frame_num);
+
+	close(hgo_fd);
+	close(lut_fd);
+	close(src_fd);
+	close(dst_fd);
+
+	vsp2_media_close(pmedia);
+
+	return ret;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int write_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("write file");
+
+	/* file output */
+	fp = fopen(pfilename, "wb");
+	if (!fp) {
+		printf("output file open error..\n");
+		ret = 0;
+	} else {
+		ret = fwrite(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer write error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int call_media_ctl(struct vsp2_media **ppmedia)
+{
+	struct vsp2_media		*pmedia;
+	struct v4l2_mbus_framefmt	format;
+
+	/* Initialize v4l2 media controller */
+	pmedia = vsp2_media_open(MEDIA_DEV_NAME);
+	if (!pmedia) {
+		printf("Error : vsp2_media_open()\n");
+		return -1;
+	}
+
+	*ppmedia = pmedia;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------*/
+	/* rpf.0:1 -> lut:0     */
+	/*----------------------*/
+	if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "lut", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf -> lut)\n");
+		return -1;
+	}
+	/*----------------------*/
+	/* lut:1 -> wpf.0:0     */
+	/*----------------------*/
+	if (vsp2_media_setup_link(pmedia, "lut", 1, "wpf.0", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(lut -> wpf)\n");
+		return -1;
+	}
+	/*----------------------*/
+	/* wpf.0:1 -> output    */
+	/*----------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/*----------------------------------------------------- set format */
+	/*----------------------*/
+	/* rpf.0:0              */
+	/*----------------------*/
+	format.width	= SRC_WIDTH;
+	format.height	= SRC_HEIGHT;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(rpfpad.ppad1->entity, &format,
-		rpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* lut:0                */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(lutpad.ppad0->entity, &format,
-		lutpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(lut pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "lut", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(lut pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* lut:1                */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(lutpad.ppad1->entity, &format,
-		lutpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(lut pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "lut", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(lut pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:0              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad0->entity, &format,
-		wpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad1->entity, &format,
-		wpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
 		return -1;
 	}
 	return 0;
 }
 
-static int set_lut(struct media_device *pmedia, void *plut_table,
-		   char *pentity_base, const char *pmedia_name)
+static int set_lut(struct vsp2_media *pmedia, void *plut_table,
+		   const char *pentity)
 {
 	struct vsp2_lut_config	lut_par;
-	char			entity_name[32];
-	const char		*psubdevname;
-	struct media_entity	*pentity;
-	unsigned int		*pdata;
-	unsigned int		lut_addr;
 	int			lut_fd = -1;
-	unsigned char		r, g, b;
-	unsigned char		sub;
 
-	int	i   = 0;
 	int	ret = -1;
 
 	memset(&lut_par, 0, sizeof(lut_par));
 
-	pdata = (unsigned int *)plut_table;
-
 	/* Set config */
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-		                           strlen(entity_name));
-	if (pentity == NULL) {
-		printf("Error media_get_entity_by_name(%s)\n", entity_name);
+	lut_fd = open_video_device(pmedia, pentity);
+
+	if (lut_fd != -1) {
+		/* Create config param (table is prebuilt by add_lut_look) */
+		lut_par.addr	= plut_table;
+		lut_par.tbl_num	= LUT_TBL_NUM;
+		lut_par.fxa	= 0x80;
+
+		if (ioctl(lut_fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par) == 0)
+			ret = 0; /* success !! */
+		close(lut_fd);
+	}
+
+	return ret;
+}
+
+static int add_lut_look(const char *pspec)
+{
+	struct lut_cache_entry	*pentry;
+	unsigned long long	key;
+	unsigned char		curve[LUT_TBL_NUM][3];
+	unsigned char		fbuf[4096];
+	FILE			*fp;
+	size_t			len;
+	int			i;
+
+	if (strlen(pspec) >= LUT_SPEC_LEN) {
+		printf("Error : look description too long (%s)\n", pspec);
+		return -1;
+	}
+
+	/* key is the description plus the contents of a referenced file */
+	key = calc_hash(0xcbf29ce484222325ULL, pspec, strlen(pspec));
+	if (strncmp(pspec, "cube:", 5) == 0) {
+		fp = fopen(pspec + 5, "rb");
+		if (fp == NULL) {
+			printf("Error : cannot open %s\n", pspec + 5);
+			return -1;
+		}
+		while ((len = fread(fbuf, 1, sizeof(fbuf), fp)) > 0)
+			key = calc_hash(key, fbuf, len);
+		fclose(fp);
+	}
+
+	for (i = 0; i < lut_cache_num; i++) {
+		if (lut_cache[i].key == key)
+			return i;	/* already built */
+	}
+
+	if (lut_cache_num >= LUT_CACHE_MAX) {
+		printf("Error : too many looks (max %d)\n", LUT_CACHE_MAX);
 		return -1;
 	}
-	psubdevname = media_entity_get_devname(pentity);
 
-	if (psubdevname == NULL) {
-		printf("Error media_entity_get_devname(%s)\n", entity_name);
+	if (make_lut_curve(pspec, curve) < 0)
 		return -1;
+
+	pentry = &lut_cache[lut_cache_num];
+	pentry->key = key;
+	strcpy(pentry->spec, pspec);
+
+	for (i = 0; i < LUT_TBL_NUM; i++) {
+		pentry->tbl[i*2]	= LUT_REG_ADDR + i*4;
+		pentry->tbl[i*2+1]	= curve[i][0] << 16
+					| curve[i][1] << 8
+					| curve[i][2];
 	}
-	lut_fd = open(psubdevname, O_RDWR);
 
-	if (lut_fd != -1) {
-		/* Set lut table */
-		lut_addr = 0x00007000;
-
-		/* Negative */
-		r = 0xff;
-		g = 0xff;
-		b = 0xff;
-		sub = 0x01;
-
-		for (i = 0; i < 256; i++) {
-			*pdata = lut_addr;
-			pdata++;
-			*pdata = r << 16 | g << 8 | b;
-			pdata++;
-
-			r -= sub;
-			g -= sub;
-			b -= sub;
-			lut_addr += 4;
+	return lut_cache_num++;
+}
+
+static unsigned char clip_lut_value(double val)
+{
+	if (val <= 0.0)
+		return 0;
+	if (val >= 255.0)
+		return 255;
+	return (unsigned char)(val + 0.5);
+}
+
+static double srgb_to_linear(double c)
+{
+	return (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb(double c)
+{
+	return (c <= 0.0031308) ? c * 12.92 : 1.055 * pow(c, 1.0/2.4) - 0.055;
+}
+
+static int make_lut_curve(const char *pspec, unsigned char curve[][3])
+{
+	double	p1 = 1.0, p2 = 0.0, p3 = 1.0;
+	double	gam[3];
+	double	x, y;
+	int	i, ch;
+
+	if (strcmp(pspec, "negative") == 0) {
+		for (i = 0; i < LUT_TBL_NUM; i++)
+			for (ch = 0; ch < 3; ch++)
+				curve[i][ch] = 0xff - i;
+	} else if (sscanf(pspec, "gamma:%lf", &p1) == 1 && p1 > 0.0) {
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			y = 255.0 * pow(i / 255.0, 1.0 / p1);
+			for (ch = 0; ch < 3; ch++)
+				curve[i][ch] = clip_lut_value(y);
 		}
+	} else if (strcmp(pspec, "srgb2linear") == 0 ||
+		   strcmp(pspec, "linear2srgb") == 0) {
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			x = i / 255.0;
+			y = (pspec[0] == 's') ? srgb_to_linear(x)
+					      : linear_to_srgb(x);
+			for (ch = 0; ch < 3; ch++)
+				curve[i][ch] = clip_lut_value(y * 255.0);
+		}
+	} else if (sscanf(pspec, "contrast:%lf:%lf", &p1, &p2) >= 1) {
+		/* gain around mid grey, then brightness offset */
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			y = (i - 128.0) * p1 + 128.0 + p2;
+			for (ch = 0; ch < 3; ch++)
+				curve[i][ch] = clip_lut_value(y);
+		}
+	} else if (sscanf(pspec, "posterize:%lf", &p1) == 1 &&
+		   p1 >= 2.0 && p1 <= 256.0) {
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			y = floor(i * p1 / 256.0) * 255.0 / (p1 - 1.0);
+			for (ch = 0; ch < 3; ch++)
+				curve[i][ch] = clip_lut_value(y);
+		}
+	} else if (sscanf(pspec, "channel:%lf:%lf:%lf", &p1, &p2, &p3) == 3 &&
+		   p1 > 0.0 && p2 > 0.0 && p3 > 0.0) {
+		gam[0] = p1;
+		gam[1] = p2;
+		gam[2] = p3;
+		for (i = 0; i < LUT_TBL_NUM; i++)
+			for (ch = 0; ch < 3; ch++)
+				curve[i][ch] = clip_lut_value(
+					255.0 * pow(i / 255.0, 1.0 / gam[ch]));
+	} else if (strncmp(pspec, "cube:", 5) == 0) {
+		return read_cube_1d(pspec + 5, curve);
+	} else {
+		printf("Error : unknown look (%s)\n", pspec);
+		return -1;
+	}
 
-		/* Create config param */
-		lut_par.addr	= plut_table;
-		lut_par.tbl_num	= 256;
-		lut_par.fxa	= 0x80;
+	return 0;
+}
 
-		if (ioctl(lut_fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par) == 0)
-			ret = 0; /* success !! */
-		close(lut_fd);
+static int read_cube_1d(const char *pfilename, unsigned char curve[][3])
+{
+	FILE	*fp;
+	char	line[256];
+	float	(*pin)[3] = NULL;
+	float	dmin[3] = {0.0f, 0.0f, 0.0f};
+	float	dmax[3] = {1.0f, 1.0f, 1.0f};
+	float	v[3];
+	double	pos, frac;
+	int	size = 0;
+	int	num = 0;
+	int	i, ch, idx;
+	int	ret = -1;
+
+	fp = fopen(pfilename, "r");
+	if (fp == NULL) {
+		printf("Error : cannot open %s\n", pfilename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+			continue;
+		if (sscanf(line, "LUT_1D_SIZE %d", &size) == 1) {
+			if (size < 2 || size > CUBE_1D_MAX || pin != NULL) {
+				printf("Error : bad LUT_1D_SIZE in %s\n",
+					pfilename);
+				goto out;
+			}
+			pin = malloc(sizeof(*pin) * size);
+			if (pin == NULL) {
+				printf("Error : malloc()\n");
+				goto out;
+			}
+			continue;
+		}
+		if (strncmp(line, "LUT_3D_SIZE", 11) == 0) {
+			printf("Error : %s is a 3D LUT, use the clu tool\n",
+				pfilename);
+			goto out;
+		}
+		/* the domain is the input range the entries span */
+		if (strncmp(line, "DOMAIN_MIN", 10) == 0) {
+			if (sscanf(line, "DOMAIN_MIN %f %f %f",
+				   &dmin[0], &dmin[1], &dmin[2]) != 3) {
+				printf("Error : bad DOMAIN_MIN in %s\n",
+					pfilename);
+				goto out;
+			}
+			continue;
+		}
+		if (strncmp(line, "DOMAIN_MAX", 10) == 0) {
+			if (sscanf(line, "DOMAIN_MAX %f %f %f",
+				   &dmax[0], &dmax[1], &dmax[2]) != 3) {
+				printf("Error : bad DOMAIN_MAX in %s\n",
+					pfilename);
+				goto out;
+			}
+			continue;
+		}
+		if (sscanf(line, "%f %f %f", &v[0], &v[1], &v[2]) != 3)
+			continue;	/* TITLE and other keywords */
+
+		if (pin == NULL || num >= size) {
+			printf("Error : unexpected data in %s\n", pfilename);
+			goto out;
+		}
+		for (ch = 0; ch < 3; ch++)
+			pin[num][ch] = v[ch];
+		num++;
 	}
 
+	if (pin == NULL || num != size) {
+		printf("Error : %s has %d of %d entries\n", pfilename, num, size);
+		goto out;
+	}
+	for (ch = 0; ch < 3; ch++) {
+		if (!(dmax[ch] > dmin[ch])) {
+			printf("Error : DOMAIN_MAX is not above DOMAIN_MIN in "
+			       "%s\n", pfilename);
+			goto out;
+		}
+	}
+
+	/* resample to 256 entries with linear interpolation, each input
+	 * code placed in the domain; codes outside it take the end entry */
+	for (i = 0; i < LUT_TBL_NUM; i++) {
+		for (ch = 0; ch < 3; ch++) {
+			pos = ((double)i / (LUT_TBL_NUM - 1) - dmin[ch]) /
+			      (dmax[ch] - dmin[ch]) * (size - 1);
+			if (pos < 0.0)
+				pos = 0.0;
+			if (pos > size - 1)
+				pos = size - 1;
+			idx = (int)pos;
+			if (idx >= size - 1)
+				idx = size - 2;
+			frac = pos - idx;
+			curve[i][ch] = clip_lut_value(255.0 *
+				(pin[idx][ch] * (1.0 - frac) +
+				 pin[idx+1][ch] * frac));
+		}
+	}
+	ret = 0;
+
+out:
+	free(pin);
+	fclose(fp);
 	return ret;
 }
 
-static int open_video_device(struct media_device *pmedia, char *pentity_base,
-			     const char *pmedia_name)
+static unsigned long long calc_hash(unsigned long long hash,
+				    const void *pdata, size_t len)
+{
+	const unsigned char *p = pdata;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static int commit_lut(int lut_fd, void *plut_table)
+{
+	struct vsp2_lut_config	lut_par;
+
+	memset(&lut_par, 0, sizeof(lut_par));
+	lut_par.addr	= plut_table;
+	lut_par.tbl_num	= LUT_TBL_NUM;
+	lut_par.fxa	= 0x80;
+
+	return ioctl(lut_fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+}
+
+static int queue_stream_buf(int src_fd, int dst_fd, int src_idx, int dst_idx)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= dst_idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= DST_SIZE;
+
+	if (ioctl(dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= src_idx;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= SRC_SIZE;
+	buf.bytesused			= SRC_SIZE;
+
+	if (ioctl(src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int profile_mem_type(void)
+{
+	struct vsp2_profile	prof;
+
+	if (vsp2_profile_load(MEDIA_DEV_NAME, "lut", SRC_WIDTH, SRC_HEIGHT,
+			      &prof) < 0)
+		return 0;
+
+	printf("profile : %s, %.1f fps when tuned\n",
+	       vsp2_profile_memory_name(prof.memory), prof.fps);
+	switch (prof.memory) {
+	case V4L2_MEMORY_USERPTR:
+		return 'u';
+	case V4L2_MEMORY_DMABUF:
+		return 'd';
+	default:
+		return 'm';
+	}
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void stat_add(struct min_max *pmm, long long val)
+{
+	if (pmm->num == 0 || val > pmm->max)
+		pmm->max = val;
+	pmm->sum += val;
+	pmm->num++;
+}
+
+static void calc_bands(const unsigned char *pframe, unsigned long long *pband)
+{
+	const unsigned int	*p = (const unsigned int *)pframe;
+	int			words = DST_SIZE / 4 / STREAM_BANDS;
+	int			i, j;
+
+	/* checksum per horizontal band, a torn frame mixes two looks */
+	for (i = 0; i < STREAM_BANDS; i++) {
+		pband[i] = 0xcbf29ce484222325ULL;
+		for (j = 0; j < words; j++) {
+			pband[i] ^= *p++;
+			pband[i] *= 0x100000001b3ULL;
+		}
+	}
+}
+
+static int calc_swap_ref(const unsigned char *psrc, const unsigned int *ptbl,
+			 unsigned long long *pband)
 {
-	char entity_name[32];
-	const char *pdevname;
-	struct media_entity *pentity;
+	unsigned char	*pdst;
+	int		i;
 
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-					   strlen(entity_name));
-	if (!pentity) {
-		printf("Error media_get_entity(%s)\n", entity_name);
+	pdst = malloc(DST_SIZE);
+	if (pdst == NULL)
 		return -1;
+
+	/* argb32 is a:r:g:b in byte order, table data is r:g:b in 23:0 */
+	for (i = 0; i < DST_SIZE; i += 4) {
+		pdst[i]     = psrc[i];
+		pdst[i + 1] = ptbl[psrc[i + 1] * 2 + 1] >> 16;
+		pdst[i + 2] = ptbl[psrc[i + 2] * 2 + 1] >> 8;
+		pdst[i + 3] = ptbl[psrc[i + 3] * 2 + 1];
+	}
+	calc_bands(pdst, pband);
+
+	free(pdst);
+	return 0;
+}
+
+static void check_swap_frame(struct swap_stat *pstat, unsigned char *pframe)
+{
+	unsigned long long	band[STREAM_BANDS];
+	int			nold = 0, nnew = 0;
+	int			i;
+
+	calc_bands(pframe, band);
+	for (i = 0; i < STREAM_BANDS; i++) {
+		if (band[i] == pstat->ref[pstat->cur][i])
+			nold++;
+		if (pstat->pend >= 0 && band[i] == pstat->ref[pstat->pend][i])
+			nnew++;
+	}
+
+	if (pstat->pend < 0) {
+		if (nold != STREAM_BANDS)
+			pstat->torn++;
+		return;
+	}
+
+	/* applied only once the output is the new look as rendered on the
+	 * cpu; a frame that is neither look is torn */
+	if (nnew != STREAM_BANDS) {
+		if (nold != STREAM_BANDS)
+			pstat->torn++;
+		pstat->wait_frames++;
+		return;
+	}
+
+	stat_add(&pstat->apply_us, get_time_us() - pstat->commit_us);
+	stat_add(&pstat->apply_frames, pstat->wait_frames);
+	pstat->cur  = pstat->pend;
+	pstat->pend = -1;
+	pstat->applied++;
+}
+
+static int print_swap_stat(struct swap_stat *pstat, int frame_num)
+{
+	bool	ok = pstat->dropped == 0 && pstat->torn == 0 &&
+		     pstat->applied == pstat->swaps;
+
+	printf("\n----- LIVE TABLE SWAP -----\n");
+	printf("frames        : %d\n", frame_num);
+	printf("swaps         : %d committed, %d applied\n",
+		pstat->swaps, pstat->applied);
+	printf("dropped frame : %d\n", pstat->dropped);
+	printf("torn frame    : %d\n", pstat->torn);
+	if (pstat->ioctl_us.num)
+		printf("commit ioctl  : avg %lld us, max %lld us\n",
+			pstat->ioctl_us.sum / pstat->ioctl_us.num,
+			pstat->ioctl_us.max);
+	if (pstat->apply_us.num)
+		printf("update latency: avg %lld us (%lld frames), "
+		       "max %lld us (%lld frames)\n",
+			pstat->apply_us.sum / pstat->apply_us.num,
+			pstat->apply_frames.sum / pstat->apply_frames.num,
+			pstat->apply_us.max, pstat->apply_frames.max);
+	printf("result        : %s\n", ok ? "OK" : "NG");
+	printf("---------------------------\n");
+	return ok ? 0 : -1;
+}
+
+static int config_hgo(int hgo_fd, void *pvirt_addr)
+{
+	struct vsp2_hgo_config	hgo_par;
+
+	memset(&hgo_par, 0, sizeof(hgo_par));
+	hgo_par.addr		= pvirt_addr;
+	hgo_par.width		= SRC_WIDTH;
+	hgo_par.height		= SRC_HEIGHT;
+	hgo_par.x_offset	= 0;
+	hgo_par.y_offset	= 0;
+	hgo_par.binary_mode	= 0x00;	/* VSP_STRAIGHT_BINARY */
+	hgo_par.maxrgb_mode	= 0x00;	/* VSP_MAXRGB_OFF */
+	hgo_par.step_mode	= 0x00;	/* VSP_STEP_64 */
+	hgo_par.sampling	= 0;	/* VSP_SMPPT_SRC1 : before the lut */
+
+	return ioctl(hgo_fd, VIDIOC_VSP2_HGO_CONFIG, &hgo_par);
+}
+
+static void calc_ae_curve(const unsigned int *phist, enum ae_mode mode,
+			  double target, struct ae_stat *pstat,
+			  unsigned char *pcurve)
+{
+	unsigned long long	bin[HGO_BINS];
+	unsigned long long	total = 0;
+	double			cdf[HGO_BINS + 1];
+	double			sum = 0.0;
+	double			gain, val;
+	int			ch, i;
+
+	/* R, G and B bins folded into one level histogram */
+	for (i = 0; i < HGO_BINS; i++) {
+		bin[i] = 0;
+		for (ch = 0; ch < HGO_CH_NUM; ch++)
+			bin[i] += phist[ch * HGO_BINS + i];
+		total += bin[i];
+		sum += bin[i] * (i * 4.0 + 1.5);
+	}
+	if (total == 0)
+		return;		/* keep the previous curve */
+
+	pstat->mean_in = sum / total;
+
+	if (mode == AE_MODE_EQUALIZE) {
+		cdf[0] = 0.0;
+		for (i = 0; i < HGO_BINS; i++)
+			cdf[i + 1] = cdf[i] + (double)bin[i] / total;
+
+		/* linear inside a bin, damped against the previous curve */
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			val = cdf[i >> 2] + (cdf[(i >> 2) + 1] - cdf[i >> 2])
+			    * ((i & 3) + 0.5) / 4.0;
+			pcurve[i] = clip_lut_value(
+				AE_DAMPING * val * 255.0 +
+				(1.0 - AE_DAMPING) * pcurve[i]);
+		}
+		return;
+	}
+
+	/* exposure : gain moves towards target / mean of the input */
+	gain = target / (pstat->mean_in > 1.0 ? pstat->mean_in : 1.0);
+	if (gain > AE_GAIN_MAX)
+		gain = AE_GAIN_MAX;
+	pstat->gain += AE_DAMPING * (gain - pstat->gain);
+
+	for (i = 0; i < LUT_TBL_NUM; i++)
+		pcurve[i] = clip_lut_value(i * pstat->gain);
+}
+
+static void make_ae_table(const unsigned char *pcurve, unsigned int *ptbl)
+{
+	int i;
+
+	/* same curve on every channel, keeps the hue */
+	for (i = 0; i < LUT_TBL_NUM; i++) {
+		ptbl[i*2]	= LUT_REG_ADDR + i*4;
+		ptbl[i*2+1]	= pcurve[i] << 16 | pcurve[i] << 8 | pcurve[i];
+	}
+}
+
+static void check_ae_frame(struct ae_stat *pstat, const unsigned char *psrc,
+			   const unsigned char *pdst,
+			   const unsigned char *pcurve,
+			   const unsigned char *pprev)
+{
+	int	now = 0, old = 0;
+	int	pos, ch, i;
+
+	/* argb32 is a:r:g:b in byte order, the lut leaves alpha alone */
+	for (i = 0; i < AE_CHECK_POINTS; i++) {
+		pos = (int)((long long)i * (SRC_WIDTH * SRC_HEIGHT - 1)
+			    / (AE_CHECK_POINTS - 1)) * 4;
+		for (ch = 1; ch < 4; ch++) {
+			if (pdst[pos + ch] == pcurve[psrc[pos + ch]])
+				now++;
+			if (pdst[pos + ch] == pprev[psrc[pos + ch]])
+				old++;
+		}
 	}
-	pdevname = media_entity_get_devname(pentity);
 
-	return open(pdevname, O_RDWR);
+	if (now == AE_CHECK_POINTS * 3)
+		pstat->on_time++;
+	else if (old == AE_CHECK_POINTS * 3)
+		pstat->late++;
+	else
+		pstat->mismatch++;
+}
+
+static int print_ae_stat(struct ae_stat *pstat, enum ae_mode mode,
+			 int frame_num)
+{
+	bool	ok = pstat->dropped == 0 && pstat->late == 0 &&
+		     pstat->mismatch == 0;
+
+	printf("\n----- AUTO EXPOSURE (%s) -----\n",
+		mode == AE_MODE_EQUALIZE ? "equalize" : "exposure");
+	printf("frames        : %d\n", frame_num);
+	printf("dropped frame : %d\n", pstat->dropped);
+	printf("input mean    : %.1f\n", pstat->mean_in);
+	if (mode == AE_MODE_EXPOSURE)
+		printf("gain          : %.3f\n", pstat->gain);
+	printf("curve applied : %d next frame, %d late, %d mismatch\n",
+		pstat->on_time, pstat->late, pstat->mismatch);
+	if (pstat->cpu_us.num) {
+		printf("cpu kernel    : avg %lld us, max %lld us\n",
+			pstat->cpu_us.sum / pstat->cpu_us.num,
+			pstat->cpu_us.max);
+		printf("commit ioctl  : avg %lld us, max %lld us\n",
+			pstat->ioctl_us.sum / pstat->ioctl_us.num,
+			pstat->ioctl_us.max);
+		printf("loop latency  : avg %lld us, max %lld us (1 frame)\n",
+			pstat->loop_us.sum / pstat->loop_us.num,
+			pstat->loop_us.max);
+	}
+	printf("result        : %s\n", ok ? "OK" : "NG");
+	printf("------------------------------------\n");
+	return ok ? 0 : -1;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
 }
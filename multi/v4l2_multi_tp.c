@@ -0,0 +1,1156 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : rpf -> [uds | lut] -> wpf, one pipeline per VSP
+ *  memory type : mmap
+ *
+ *  Every pipeline runs on its own worker thread that owns the device fds,
+ *  the buffers and the tables. With -c a CPU pre-processing worker fills
+ *  the source buffer and a post-processing worker checks the result, so
+ *  a frame goes pre -> vsp -> post. The main thread only routes jobs
+ *  between the workers through spsc rings; nothing on the per-frame path
+ *  takes a lock.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_worker.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#ifndef USE_M3
+/* for h3 */
+#define MEDIA_DEV_NAME		"/dev/media3"		/* fe9a0000.vsp */
+#else
+/* for m3 */
+#define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
+#endif
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* source parameter */
+#define SRC_FILENAME		"1280_720_ARGB32.argb"
+#define SRC_WIDTH		(1280)			/* src: width */
+#define SRC_HEIGHT		(720)			/* src: height */
+#define SRC_SIZE		(SRC_WIDTH*SRC_HEIGHT*4)
+
+/* lut parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+
+/* pipeline parameter */
+#define PIPE_MAX		(4)
+#define PIPE_BUF_MAX		(8)
+#define PIPE_BUF_NUM		(3)		/* jobs in flight per pipeline */
+#define PIPE_FRAME_NUM		(100)
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct multi_module {
+	const char	*pname;
+	const char	*pentity;	/* NULL : rpf.0 -> wpf.0 */
+	const char	*ptag;		/* output file name */
+	unsigned int	dst_width;
+	unsigned int	dst_height;
+};
+
+struct multi_pipe;
+
+struct multi_job {
+	struct multi_pipe	*ppipe;
+	int			slot;		/* src and dst buffer index */
+	int			frame;
+	long long		t_start;
+	unsigned long long	hash;		/* set by post */
+};
+
+struct multi_pipe {
+	int				id;
+	const struct multi_module	*pmod;
+	char				devnode[32];
+	int				buf_num;
+	unsigned int			dst_size;
+	unsigned char			*pimage;	/* input file */
+
+	/* owned by the vsp worker */
+	struct vsp2_media		*pmedia;
+	int				src_fd;
+	int				dst_fd;
+	int				lut_fd;
+	MMNGR_ID			lut_id;
+	unsigned long			lut_virt;
+	unsigned char			*psrc_buf[PIPE_BUF_MAX];
+	unsigned char			*pdst_buf[PIPE_BUF_MAX];
+	struct multi_job		*pqueued[PIPE_BUF_MAX];
+	bool				streaming;
+	int				last_slot;
+
+	/* owned by the main thread */
+	struct vsp2_worker		*pvsp;
+	struct vsp2_worker		*ppre;
+	struct vsp2_worker		*ppost;
+	struct multi_job		job[PIPE_BUF_MAX];
+	int				next_frame;
+	int				done;
+	long long			lat_sum;
+	long long			lat_max;
+	unsigned long long		ref_hash;
+	int				mismatch;
+	long long			t_first;
+	long long			t_last;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct multi_module multi_module[] = {
+	{ "copy",	NULL,		"COPY",	SRC_WIDTH,	SRC_HEIGHT },
+	{ "uds",	"uds.0",	"UDS",	1920,		1080 },
+	{ "lut",	"lut",		"LUT",	SRC_WIDTH,	SRC_HEIGHT },
+};
+
+static struct multi_pipe	multi_pipe[PIPE_MAX];
+static int			multi_pipe_num;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	add_pipe(const char *pspec, int buf_num);
+static int	test_multi(int frame_num, bool cpu_stage);
+static void	start_job(struct multi_pipe *ppipe, struct multi_job *pjob,
+			  bool cpu_stage);
+static void	finish_job(struct multi_pipe *ppipe, struct multi_job *pjob);
+static void	print_pipe_stat(struct multi_pipe *ppipe, bool cpu_stage);
+static int	vsp_start(struct vsp2_worker *pworker, void *pctx);
+static int	vsp_submit(struct vsp2_worker *pworker, void *pctx,
+			   void *pjob);
+static int	vsp_event(struct vsp2_worker *pworker, void *pctx, int fd);
+static void	vsp_stop(struct vsp2_worker *pworker, void *pctx);
+static int	cpu_start(struct vsp2_worker *pworker, void *pctx);
+static int	pre_submit(struct vsp2_worker *pworker, void *pctx,
+			   void *pjob);
+static int	post_submit(struct vsp2_worker *pworker, void *pctx,
+			    void *pjob);
+static int	cpu_event(struct vsp2_worker *pworker, void *pctx, int fd);
+static void	cpu_stop(struct vsp2_worker *pworker, void *pctx);
+static int	read_file(unsigned char*, unsigned int, const char*);
+static int	write_file(unsigned char*, unsigned int, const char*);
+static int	call_media_ctl(struct multi_pipe *ppipe);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity, int flags);
+static int	commit_lut(int lut_fd, void *plut_table);
+static int	queue_stream_buf(struct multi_pipe *ppipe, int slot);
+static unsigned long long	calc_hash(unsigned long long hash,
+					  const void *pdata, size_t len);
+static long long	get_time_us(void);
+
+static const struct vsp2_worker_ops vsp_ops = {
+	.start	= vsp_start,
+	.submit	= vsp_submit,
+	.event	= vsp_event,
+	.stop	= vsp_stop,
+};
+
+static const struct vsp2_worker_ops pre_ops = {
+	.start	= cpu_start,
+	.submit	= pre_submit,
+	.event	= cpu_event,
+	.stop	= cpu_stop,
+};
+
+static const struct vsp2_worker_ops post_ops = {
+	.start	= cpu_start,
+	.submit	= post_submit,
+	.event	= cpu_event,
+	.stop	= cpu_stop,
+};
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -p <module>[@<media>]: add a pipeline, module is\n");
+	printf("             copy, uds or lut [lut@%s]\n", MEDIA_DEV_NAME);
+	printf("             one pipeline per media device, up to %d\n",
+	       PIPE_MAX);
+	printf("        -n <num>: frames per pipeline [%d]\n",
+	       PIPE_FRAME_NUM);
+	printf("        -q <num>: jobs in flight per pipeline [%d]\n",
+	       PIPE_BUF_NUM);
+	printf("        -c: add cpu pre- and post-processing workers\n");
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int	frame_num = PIPE_FRAME_NUM;
+	int	buf_num = PIPE_BUF_NUM;
+	bool	cpu_stage = false;
+	int	opt;
+	int	i;
+
+	vsp2_trace_begin("run");
+
+	/* -q applies to every pipeline, so read it first */
+	while ((opt = getopt(argc, argv, "p:n:q:ch")) != -1) {
+		switch (opt) {
+		case 'p':
+			break;
+		case 'n':
+			frame_num = atoi(optarg);
+			break;
+		case 'q':
+			buf_num = atoi(optarg);
+			break;
+		case 'c':
+			cpu_stage = true;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (frame_num < 1 || buf_num < 1 || buf_num > PIPE_BUF_MAX) {
+		print_usage(argv[0]);
+		exit(0);
+	}
+
+	optind = 1;
+	while ((opt = getopt(argc, argv, "p:n:q:ch")) != -1) {
+		if (opt == 'p' && add_pipe(optarg, buf_num) < 0)
+			exit(1);
+	}
+	if (multi_pipe_num == 0)
+		add_pipe("lut", buf_num);
+
+	printf("exec MULTI %d pipeline(s), %d frames%s\n", multi_pipe_num,
+	       frame_num, cpu_stage ? ", cpu pre / post" : "");
+	for (i = 0; i < multi_pipe_num; i++)
+		printf("  pipe %d : %s on %s\n", i, multi_pipe[i].pmod->pname,
+		       multi_pipe[i].devnode);
+
+	test_multi(frame_num, cpu_stage);
+
+	exit(0);
+}
+
+/******************************************************************************
+ *  pipelines
+ ******************************************************************************/
+static int add_pipe(const char *pspec, int buf_num)
+{
+	struct multi_pipe	*ppipe;
+	const char		*pdev = MEDIA_DEV_NAME;
+	const char		*pat;
+	size_t			len;
+	int			i;
+
+	if (multi_pipe_num >= PIPE_MAX) {
+		printf("Error : too many pipelines (max %d)\n", PIPE_MAX);
+		return -1;
+	}
+
+	pat = strchr(pspec, '@');
+	len = pat ? (size_t)(pat - pspec) : strlen(pspec);
+	if (pat != NULL)
+		pdev = pat + 1;
+
+	ppipe = &multi_pipe[multi_pipe_num];
+	for (i = 0; i < (int)(sizeof(multi_module) / sizeof(multi_module[0]));
+	     i++) {
+		if (strlen(multi_module[i].pname) == len &&
+		    strncmp(multi_module[i].pname, pspec, len) == 0)
+			ppipe->pmod = &multi_module[i];
+	}
+	if (ppipe->pmod == NULL) {
+		printf("Error : unknown module (%s)\n", pspec);
+		return -1;
+	}
+
+	/* the pipeline owns the whole device, wpf.0 included */
+	for (i = 0; i < multi_pipe_num; i++) {
+		if (strcmp(multi_pipe[i].devnode, pdev) == 0) {
+			printf("Error : %s used by two pipelines\n", pdev);
+			return -1;
+		}
+	}
+
+	ppipe->id		= multi_pipe_num;
+	ppipe->buf_num		= buf_num;
+	ppipe->dst_size		= ppipe->pmod->dst_width *
+				  ppipe->pmod->dst_height * 4;
+	ppipe->src_fd		= -1;
+	ppipe->dst_fd		= -1;
+	ppipe->lut_fd		= -1;
+	ppipe->last_slot	= -1;
+	snprintf(ppipe->devnode, sizeof(ppipe->devnode), "%s", pdev);
+	multi_pipe_num++;
+	return 0;
+}
+
+static int test_multi(int frame_num, bool cpu_stage)
+{
+	struct vsp2_worker	*pworker[PIPE_MAX * 3];
+	struct vsp2_worker_stat	stat;
+	struct multi_pipe	*ppipe;
+	struct multi_job	*pjob;
+	int			worker_num = 0;
+	int			out = 0;
+	int			ercd = 0;
+	char			name[16];
+	int			i, j;
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file (shared input, read only after this)                   */
+	/*-------------------------------------------------------------------*/
+	multi_pipe[0].pimage = malloc(SRC_SIZE);
+	if (multi_pipe[0].pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if (read_file(multi_pipe[0].pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Start workers                                                    */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < multi_pipe_num; i++) {
+		ppipe = &multi_pipe[i];
+		ppipe->pimage = multi_pipe[0].pimage;
+
+		snprintf(name, sizeof(name), "vsp%d-%s", i, ppipe->pmod->pname);
+		ppipe->pvsp = vsp2_worker_start(name, &vsp_ops, ppipe,
+						ppipe->buf_num);
+		if (ppipe->pvsp == NULL) {
+			printf("Error : pipe %d start failed.\n", i);
+			ercd = -1;
+			goto stop;
+		}
+		pworker[worker_num++] = ppipe->pvsp;
+
+		if (!cpu_stage)
+			continue;
+
+		snprintf(name, sizeof(name), "pre%d", i);
+		ppipe->ppre = vsp2_worker_start(name, &pre_ops, ppipe,
+						ppipe->buf_num);
+		snprintf(name, sizeof(name), "post%d", i);
+		ppipe->ppost = vsp2_worker_start(name, &post_ops, ppipe,
+						 ppipe->buf_num);
+		if (ppipe->ppre == NULL || ppipe->ppost == NULL) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			ercd = -1;
+			goto stop;
+		}
+		pworker[worker_num++] = ppipe->ppre;
+		pworker[worker_num++] = ppipe->ppost;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Fill every pipeline with jobs                                    */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < multi_pipe_num; i++) {
+		ppipe = &multi_pipe[i];
+		ppipe->t_first = get_time_us();
+		for (j = 0; j < ppipe->buf_num && j < frame_num; j++) {
+			ppipe->job[j].ppipe	= ppipe;
+			ppipe->job[j].slot	= j;
+			start_job(ppipe, &ppipe->job[j], cpu_stage);
+			out++;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Route jobs until every frame is done                             */
+	/*-------------------------------------------------------------------*/
+	while (out > 0) {
+		if (vsp2_worker_wait(pworker, worker_num, -1) < 0) {
+			printf("Error : worker failed.\n");
+			ercd = -1;
+			break;
+		}
+
+		for (i = 0; i < multi_pipe_num; i++) {
+			ppipe = &multi_pipe[i];
+
+			if (ppipe->ppre != NULL) {
+				while ((pjob = vsp2_worker_reap(ppipe->ppre)))
+					vsp2_worker_submit(ppipe->pvsp, pjob);
+			}
+
+			while ((pjob = vsp2_worker_reap(ppipe->pvsp))) {
+				if (ppipe->ppost != NULL) {
+					vsp2_worker_submit(ppipe->ppost, pjob);
+					continue;
+				}
+				finish_job(ppipe, pjob);
+				out--;
+				if (ppipe->next_frame < frame_num) {
+					start_job(ppipe, pjob, cpu_stage);
+					out++;
+				}
+			}
+
+			if (ppipe->ppost == NULL)
+				continue;
+			while ((pjob = vsp2_worker_reap(ppipe->ppost))) {
+				finish_job(ppipe, pjob);
+				out--;
+				if (ppipe->next_frame < frame_num) {
+					start_job(ppipe, pjob, cpu_stage);
+					out++;
+				}
+			}
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Stop workers and print statistics                                */
+	/*-------------------------------------------------------------------*/
+stop:
+	for (i = 0; i < multi_pipe_num; i++) {
+		ppipe = &multi_pipe[i];
+		if (ppipe->pvsp == NULL)
+			continue;
+
+		print_pipe_stat(ppipe, cpu_stage);
+
+		vsp2_worker_stop(ppipe->pvsp, &stat);
+		printf("         vsp  : %llu jobs, %llu sleeps, %llu wakeups "
+		       "in, %llu out\n", stat.jobs, stat.sleeps,
+		       stat.job_signals, stat.done_signals);
+		if (ppipe->ppre != NULL) {
+			vsp2_worker_stop(ppipe->ppre, &stat);
+			printf("         pre  : %llu jobs, %llu sleeps, %llu "
+			       "wakeups in, %llu out\n", stat.jobs,
+			       stat.sleeps, stat.job_signals,
+			       stat.done_signals);
+		}
+		if (ppipe->ppost != NULL) {
+			vsp2_worker_stop(ppipe->ppost, &stat);
+			printf("         post : %llu jobs, %llu sleeps, %llu "
+			       "wakeups in, %llu out\n", stat.jobs,
+			       stat.sleeps, stat.job_signals,
+			       stat.done_signals);
+		}
+	}
+
+	free(multi_pipe[0].pimage);
+	return ercd;
+}
+
+static void start_job(struct multi_pipe *ppipe, struct multi_job *pjob,
+		      bool cpu_stage)
+{
+	pjob->frame	= ppipe->next_frame++;
+	pjob->t_start	= get_time_us();
+
+	/* at most buf_num jobs per pipeline, so the rings never fill */
+	if (cpu_stage)
+		vsp2_worker_submit(ppipe->ppre, pjob);
+	else
+		vsp2_worker_submit(ppipe->pvsp, pjob);
+}
+
+static void finish_job(struct multi_pipe *ppipe, struct multi_job *pjob)
+{
+	long long lat;
+
+	ppipe->t_last	= get_time_us();
+	lat		= ppipe->t_last - pjob->t_start;
+	ppipe->lat_sum	+= lat;
+	if (lat > ppipe->lat_max)
+		ppipe->lat_max = lat;
+
+	/* the same input makes the same output, frame after frame */
+	if (ppipe->ppost != NULL) {
+		if (ppipe->done == 0)
+			ppipe->ref_hash = pjob->hash;
+		else if (pjob->hash != ppipe->ref_hash)
+			ppipe->mismatch++;
+	}
+
+	ppipe->done++;
+}
+
+static void print_pipe_stat(struct multi_pipe *ppipe, bool cpu_stage)
+{
+	long long	elapsed = ppipe->t_last - ppipe->t_first;
+	double		fps = 0.0;
+
+	if (elapsed > 0)
+		fps = (double)ppipe->done * 1000000.0 / elapsed;
+
+	printf("  pipe %d : %s on %s, %d frames, %.1f fps, latency avg "
+	       "%.2f ms max %.2f ms\n", ppipe->id, ppipe->pmod->pname,
+	       ppipe->devnode, ppipe->done, fps,
+	       ppipe->done ? ppipe->lat_sum / 1000.0 / ppipe->done : 0.0,
+	       ppipe->lat_max / 1000.0);
+	if (cpu_stage)
+		printf("         check : %s (%d of %d frames differ)\n",
+		       ppipe->mismatch ? "NG" : "OK", ppipe->mismatch,
+		       ppipe->done);
+}
+
+/******************************************************************************
+ *  vsp worker : owns the device of one pipeline
+ ******************************************************************************/
+static int vsp_start(struct vsp2_worker *pworker, void *pctx)
+{
+	struct multi_pipe		*ppipe = pctx;
+	struct v4l2_format		fmt;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	unsigned int			*ptbl;
+	unsigned long			phys, hard;
+	char				name[32];
+	int				ret;
+	int				i;
+
+	snprintf(name, sizeof(name), "multi %s %d", ppipe->pmod->pname,
+		 ppipe->id);
+	vsp2_mem_pipeline(name);
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(ppipe);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	ppipe->src_fd = open_video_device(ppipe->pmedia, SRC_INPUT_DEV,
+					  O_RDWR);
+	if (ppipe->src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/* dst is polled, done buffers are drained without blocking */
+	ppipe->dst_fd = open_video_device(ppipe->pmedia, DST_OUTPUT_DEV,
+					  O_RDWR | O_NONBLOCK);
+	if (ppipe->dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Lookup table (negative) - VIDIOC_VSP2_LUT_CONFIG                 */
+	/*-------------------------------------------------------------------*/
+	if (strcmp(ppipe->pmod->pname, "lut") == 0) {
+		ppipe->lut_fd = open_video_device(ppipe->pmedia, "lut",
+						  O_RDWR);
+		if (ppipe->lut_fd == -1) {
+			printf("Error open lut device: %s (%d).\n",
+				strerror(errno), errno);
+			return -1;
+		}
+
+		ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &ppipe->lut_id,
+				     LUT_TBL_NUM*8, &phys, &hard,
+				     &ppipe->lut_virt, MMNGR_VA_SUPPORT);
+		if (ret != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			return -1;
+		}
+
+		ptbl = (unsigned int *)ppipe->lut_virt;
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			ptbl[i*2]	= LUT_REG_ADDR + i*4;
+			ptbl[i*2+1]	= (255 - i) << 16
+					| (255 - i) << 8
+					| (255 - i);
+		}
+
+		ret = commit_lut(ppipe->lut_fd, (void *)ppipe->lut_virt);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	ret = ioctl(ppipe->src_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= ppipe->pmod->dst_width;
+	fmt.fmt.pix_mp.height		= ppipe->pmod->dst_height;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.num_planes	= 1;		/* argb32 */
+
+	ret = ioctl(ppipe->dst_fd, VIDIOC_S_FMT, &fmt);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= ppipe->buf_num;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	ret = ioctl(ppipe->src_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != ppipe->buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	req_buf.count	= ppipe->buf_num;
+
+	ret = ioctl(ppipe->dst_fd, VIDIOC_REQBUFS, &req_buf);
+	if (ret < 0 || req_buf.count != ppipe->buf_num) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QUERYBUF / Mmap                                           */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < ppipe->buf_num; i++) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= i;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+
+		ret = ioctl(ppipe->src_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		ppipe->psrc_buf[i] = mmap(0, SRC_SIZE, PROT_READ | PROT_WRITE,
+					  MAP_SHARED, ppipe->src_fd,
+					  planes[0].m.mem_offset);
+		if (ppipe->psrc_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			ppipe->psrc_buf[i] = NULL;
+			return -1;
+		}
+
+		/* without a pre worker the input stays as loaded */
+		memcpy(ppipe->psrc_buf[i], ppipe->pimage, SRC_SIZE);
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		memset(planes, 0, sizeof(planes));
+
+		ret = ioctl(ppipe->dst_fd, VIDIOC_QUERYBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		ppipe->pdst_buf[i] = mmap(0, ppipe->dst_size,
+					  PROT_READ | PROT_WRITE, MAP_SHARED,
+					  ppipe->dst_fd,
+					  planes[0].m.mem_offset);
+		if (ppipe->pdst_buf[i] == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			ppipe->pdst_buf[i] = NULL;
+			return -1;
+		}
+	}
+
+	return vsp2_worker_watch(pworker, ppipe->dst_fd);
+}
+
+static int vsp_submit(struct vsp2_worker *pworker, void *pctx, void *pjob)
+{
+	struct multi_pipe	*ppipe = pctx;
+	struct multi_job	*pj = pjob;
+	unsigned int		type;
+
+	ppipe->pqueued[pj->slot] = pj;
+	if (queue_stream_buf(ppipe, pj->slot) < 0)
+		return -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMON (with the first job)                             */
+	/*-------------------------------------------------------------------*/
+	if (!ppipe->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(ppipe->src_fd, VIDIOC_STREAMON, &type) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(ppipe->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		ppipe->streaming = true;
+	}
+	return 0;
+}
+
+static int vsp_event(struct vsp2_worker *pworker, void *pctx, int fd)
+{
+	struct multi_pipe	*ppipe = pctx;
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	int			dst_idx;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_DQBUF until the done queue is empty                       */
+	/*-------------------------------------------------------------------*/
+	for (;;) {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+
+		if (ioctl(ppipe->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+			if (errno == EAGAIN)
+				return 0;
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		dst_idx = buf.index;
+
+		/* the source of a finished frame is done as well */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= 1;
+
+		if (ioctl(ppipe->src_fd, VIDIOC_DQBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		if (ppipe->pqueued[dst_idx] == NULL) {
+			printf("error line=%d index=%d\n", __LINE__, dst_idx);
+			return -1;
+		}
+		ppipe->last_slot = dst_idx;
+		vsp2_worker_done(pworker, ppipe->pqueued[dst_idx]);
+		ppipe->pqueued[dst_idx] = NULL;
+	}
+}
+
+static void vsp_stop(struct vsp2_worker *pworker, void *pctx)
+{
+	struct multi_pipe		*ppipe = pctx;
+	struct v4l2_requestbuffers	req_buf;
+	unsigned int			type;
+	char				filename[64];
+	int				i;
+
+	/*-------------------------------------------------------------------*/
+	/*  Write file (last frame)                                          */
+	/*-------------------------------------------------------------------*/
+	if (ppipe->last_slot >= 0) {
+		snprintf(filename, sizeof(filename),
+			 "%u_%u_ARGB32_MULTI%d_%s.argb",
+			 ppipe->pmod->dst_width, ppipe->pmod->dst_height,
+			 ppipe->id, ppipe->pmod->ptag);
+		write_file(ppipe->pdst_buf[ppipe->last_slot], ppipe->dst_size,
+			   filename);
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+	if (ppipe->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(ppipe->src_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(ppipe->dst_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		ppipe->streaming = false;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+	for (i = 0; i < ppipe->buf_num; i++) {
+		if (ppipe->psrc_buf[i] != NULL)
+			munmap(ppipe->psrc_buf[i], SRC_SIZE);
+		if (ppipe->pdst_buf[i] != NULL)
+			munmap(ppipe->pdst_buf[i], ppipe->dst_size);
+	}
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+	if (ppipe->src_fd != -1) {
+		req_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(ppipe->src_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		close(ppipe->src_fd);
+	}
+	if (ppipe->dst_fd != -1) {
+		req_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(ppipe->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		close(ppipe->dst_fd);
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for lookup table                                  */
+	/*-------------------------------------------------------------------*/
+	if (ppipe->lut_virt != 0)
+		mmngr_free_in_user(ppipe->lut_id);
+	if (ppipe->lut_fd != -1)
+		close(ppipe->lut_fd);
+
+	if (ppipe->pmedia != NULL)
+		vsp2_media_close(ppipe->pmedia);
+}
+
+/******************************************************************************
+ *  cpu workers : pre fills the source, post checks the result
+ ******************************************************************************/
+static int cpu_start(struct vsp2_worker *pworker, void *pctx)
+{
+	return 0;
+}
+
+static int pre_submit(struct vsp2_worker *pworker, void *pctx, void *pjob)
+{
+	struct multi_pipe	*ppipe = pctx;
+	struct multi_job	*pj = pjob;
+
+	/* the buffer is dequeued, the vsp worker does not touch it */
+	vsp2_trace_begin("pre");
+	memcpy(ppipe->psrc_buf[pj->slot], ppipe->pimage, SRC_SIZE);
+	vsp2_trace_end();
+
+	vsp2_worker_done(pworker, pj);
+	return 0;
+}
+
+static int post_submit(struct vsp2_worker *pworker, void *pctx, void *pjob)
+{
+	struct multi_pipe	*ppipe = pctx;
+	struct multi_job	*pj = pjob;
+
+	vsp2_trace_begin("post");
+	pj->hash = calc_hash(0xcbf29ce484222325ULL,
+			     ppipe->pdst_buf[pj->slot], ppipe->dst_size);
+	vsp2_trace_end();
+
+	vsp2_worker_done(pworker, pj);
+	return 0;
+}
+
+static int cpu_event(struct vsp2_worker *pworker, void *pctx, int fd)
+{
+	return 0;
+}
+
+static void cpu_stop(struct vsp2_worker *pworker, void *pctx)
+{
+}
+
+/******************************************************************************
+ *  internal
+ ******************************************************************************/
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	/* file input */
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int write_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("write file");
+
+	/* file output */
+	fp = fopen(pfilename, "wb");
+	if (!fp) {
+		printf("output file open error..\n");
+		ret = 0;
+	} else {
+		ret = fwrite(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer write error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int call_media_ctl(struct multi_pipe *ppipe)
+{
+	struct vsp2_media		*pmedia;
+	struct v4l2_mbus_framefmt	format;
+	const char			*pentity = ppipe->pmod->pentity;
+
+	/* Initialize v4l2 media controller */
+	pmedia = vsp2_media_open(ppipe->devnode);
+	if (!pmedia) {
+		printf("Error : vsp2_media_open(%s)\n", ppipe->devnode);
+		return -1;
+	}
+
+	ppipe->pmedia = pmedia;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [module] -> wpf.0:0   */
+	/*----------------------------------*/
+	if (pentity == NULL) {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
+			return -1;
+		}
+	} else {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pentity, 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> %s)\n",
+			       pentity);
+			return -1;
+		}
+		if (vsp2_media_setup_link(pmedia, pentity, 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(%s -> wpf)\n",
+			       pentity);
+			return -1;
+		}
+	}
+	/*----------------------*/
+	/* wpf.0:1 -> output    */
+	/*----------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/*----------------------------------------------------- set format */
+	format.width	= SRC_WIDTH;
+	format.height	= SRC_HEIGHT;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 0)\n");
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 1)\n");
+		return -1;
+	}
+	if (pentity != NULL) {
+		if (vsp2_media_set_format(pmedia, pentity, 0, &format) != 0) {
+			printf("Error : vsp2_media_set_format(%s pad 0)\n",
+			       pentity);
+			return -1;
+		}
+		format.width	= ppipe->pmod->dst_width;
+		format.height	= ppipe->pmod->dst_height;
+		if (vsp2_media_set_format(pmedia, pentity, 1, &format) != 0) {
+			printf("Error : vsp2_media_set_format(%s pad 1)\n",
+			       pentity);
+			return -1;
+		}
+	}
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity,
+			     int flags)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, flags);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
+
+static int commit_lut(int lut_fd, void *plut_table)
+{
+	struct vsp2_lut_config	lut_par;
+
+	memset(&lut_par, 0, sizeof(lut_par));
+	lut_par.addr	= plut_table;
+	lut_par.tbl_num	= LUT_TBL_NUM;
+	lut_par.fxa	= 0x80;
+
+	return ioctl(lut_fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+}
+
+static int queue_stream_buf(struct multi_pipe *ppipe, int slot)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= slot;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= ppipe->dst_size;
+
+	if (ioctl(ppipe->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= slot;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= SRC_SIZE;
+	buf.bytesused			= SRC_SIZE;
+
+	if (ioctl(ppipe->src_fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+static unsigned long long calc_hash(unsigned long long hash,
+				    const void *pdata, size_t len)
+{
+	const unsigned char *p = pdata;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
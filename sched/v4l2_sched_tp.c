@@ -0,0 +1,1234 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : rpf -> [uds | lut | clu | bru] -> wpf (hgo), per job
+ *  memory type : mmap
+ *
+ *  Runs a batch of mixed jobs on every VSP found, one thread per device.
+ *  A job is a pipeline spec, an input and an output; it goes only to a
+ *  device that has the units it needs (bru, uds.0, lut, clu, hgo). Jobs
+ *  are placed round robin on the devices able to run them, and an idle
+ *  device steals jobs it can run from the busiest one (common/vsp2_sched).
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_sched.h"
+#include "vsp2_trace.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#define MEDIA_DEV_FORMAT	"/dev/media%d"
+#define MEDIA_DEV_PROBE		(8)		/* /dev/media0 - 7 */
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define OVL_INPUT_DEV		"rpf.1 input"	/* bru overlay */
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* unit capabilities */
+#define CAP_UDS			(1 << 0)
+#define CAP_LUT			(1 << 1)
+#define CAP_CLU			(1 << 2)
+#define CAP_BRU			(1 << 3)
+#define CAP_HGO			(1 << 4)
+
+/* lut / clu / hgo parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+#define CLU_GRID		(17)
+#define CLU_TBL_NUM		(CLU_GRID*CLU_GRID*CLU_GRID)
+#define CLU_REG_DATA		(0x00007404)
+#define HGO_BUFF_SIZE		(1088)
+
+/* batch parameter */
+#define JOB_MAX			(1024)
+#define JOB_GEN_NUM		(48)		/* generated jobs [-g] */
+#define JOB_SIZE_MAX		(4096)		/* width and height */
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+#define VIDIOC_VSP2_CLU_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
+#define VIDIOC_VSP2_HGO_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 3, struct vsp2_hgo_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct vsp2_clu_config {
+	unsigned char	mode;
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned char	fxa;
+	unsigned short	tbl_num;	/* 1 to 9826 */
+};
+
+struct vsp2_hgo_config {
+	void		*addr;	/* Allocate memory size is 1088 bytes. */
+	unsigned short	width;
+	unsigned short	height;
+	unsigned short	x_offset;
+	unsigned short	y_offset;
+	unsigned char	binary_mode;
+	unsigned char	maxrgb_mode;
+	unsigned char	step_mode;
+	unsigned long	sampling;	/* sampling module */
+};
+
+struct sched_kind {
+	const char	*pname;
+	const char	*pentity;	/* NULL : rpf.0 -> wpf.0 */
+	unsigned int	need;		/* CAP_* */
+};
+
+struct sched_job {
+	int				id;
+	const struct sched_kind		*pkind;
+	char				spec[64];	/* as given, for the check */
+	char				input[128];	/* "-" : generated */
+	char				output[128];	/* "-" : checksum only */
+	unsigned int			in_width;
+	unsigned int			in_height;
+	unsigned int			out_width;
+	unsigned int			out_height;
+
+	/* set by the device that ran it */
+	int				dev;
+	bool				done;
+	unsigned long long		hash;
+};
+
+struct vsp_dev {
+	char				devnode[32];
+	struct vsp2_media		*pmedia;
+	unsigned int			caps;
+
+	/* tables, built once per device */
+	MMNGR_ID			lut_id;
+	unsigned long			lut_virt;
+	MMNGR_ID			clu_id;
+	unsigned long			clu_virt;
+	MMNGR_ID			hgo_id;
+	unsigned long			hgo_virt;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct sched_kind sched_kind[] = {
+	{ "copy",	NULL,		0 },
+	{ "uds",	"uds.0",	CAP_UDS },
+	{ "lut",	"lut",		CAP_LUT },
+	{ "clu",	"clu",		CAP_CLU },
+	{ "bru",	"bru",		CAP_BRU },
+	{ "hgo",	NULL,		CAP_HGO },
+};
+
+static const char *cap_name[] = { "uds.0", "lut", "clu", "bru", "hgo" };
+
+static struct sched_job		sched_job[JOB_MAX];
+static int			sched_job_num;
+static struct vsp_dev		vsp_dev[VSP2_SCHED_DEV_MAX];
+static int			vsp_dev_num;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	add_job(const char *ppipe, const char *pinput,
+			const char *poutput);
+static int	load_jobs(const char *pfilename);
+static void	make_jobs(int num);
+static int	add_device(const char *pdevnode, bool quiet);
+static int	test_sched(bool steal);
+static void	print_sched_stat(struct vsp2_sched *psched, bool steal,
+				 int left);
+static int	dev_start(int dev, void *pctx);
+static int	dev_run(int dev, void *pctx, void *pjob);
+static void	dev_stop(int dev, void *pctx);
+static int	run_job(struct vsp_dev *pdev, struct sched_job *pjob);
+static int	config_job(struct vsp_dev *pdev, struct sched_job *pjob);
+static int	read_file(unsigned char*, unsigned int, const char*);
+static int	write_file(unsigned char*, unsigned int, const char*);
+static int	call_media_ctl(struct vsp_dev *pdev, struct sched_job *pjob);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
+static int	set_format(int fd, unsigned int type, unsigned int width,
+			   unsigned int height, unsigned int flags);
+static int	setup_buf(int fd, unsigned int type, unsigned int size,
+			  unsigned char **ppbuf);
+static int	queue_buf(int fd, unsigned int type, unsigned int size);
+static int	dequeue_buf(int fd, unsigned int type);
+static void	release_buf(int fd, unsigned int type, unsigned char *pbuf,
+			    unsigned int size);
+static void	make_pattern(unsigned int *pbuf, unsigned int width,
+			     unsigned int height);
+static void	make_overlay(unsigned int *pbuf, unsigned int width,
+			     unsigned int height);
+static unsigned long long	calc_hash(unsigned long long hash,
+					  const void *pdata, size_t len);
+
+static const struct vsp2_sched_ops dev_ops = {
+	.start	= dev_start,
+	.run	= dev_run,
+	.stop	= dev_stop,
+};
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -f <file>: job list, one job per line :\n");
+	printf("             <pipeline> <input> <output>\n");
+	printf("             pipeline : copy, uds:<w>x<h>, lut, clu, bru,"
+	       " hgo\n");
+	printf("             input    : <file>:<w>x<h> (ARGB32), or -:<w>x<h>"
+	       " for a pattern\n");
+	printf("             output   : <file>, or - to keep a checksum"
+	       " only\n");
+	printf("        -g <num>: generate a mixed list of <num> jobs [%d]\n",
+	       JOB_GEN_NUM);
+	printf("        -d <media>: use this device, repeatable [every VSP"
+	       " found]\n");
+	printf("        -s: static placement only, no stealing\n");
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	char	devnode[32];
+	bool	steal = true;
+	int	job_num = 0;
+	int	opt;
+	int	i;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "f:g:d:sh")) != -1) {
+		switch (opt) {
+		case 'f':
+			if (load_jobs(optarg) < 0)
+				exit(1);
+			break;
+		case 'g':
+			job_num = atoi(optarg);
+			break;
+		case 'd':
+			if (add_device(optarg, false) < 0)
+				exit(1);
+			break;
+		case 's':
+			steal = false;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	if (job_num > 0 || sched_job_num == 0)
+		make_jobs(job_num > 0 ? job_num : JOB_GEN_NUM);
+
+	if (vsp_dev_num == 0) {
+		for (i = 0; i < MEDIA_DEV_PROBE; i++) {
+			snprintf(devnode, sizeof(devnode), MEDIA_DEV_FORMAT, i);
+			add_device(devnode, true);
+		}
+	}
+	if (vsp_dev_num == 0) {
+		printf("Error : no VSP device found.\n");
+		exit(1);
+	}
+
+	printf("exec SCHED %d job(s) on %d device(s)%s\n", sched_job_num,
+	       vsp_dev_num, steal ? ", work stealing" : ", static");
+
+	test_sched(steal);
+
+	exit(0);
+}
+
+/******************************************************************************
+ *  jobs
+ ******************************************************************************/
+static int add_job(const char *ppipe, const char *pinput, const char *poutput)
+{
+	struct sched_job	*pjob;
+	const char		*p;
+	size_t			len;
+	int			i;
+
+	if (sched_job_num >= JOB_MAX) {
+		printf("Error : too many jobs (max %d)\n", JOB_MAX);
+		return -1;
+	}
+	pjob = &sched_job[sched_job_num];
+	memset(pjob, 0, sizeof(*pjob));
+
+	/* pipeline : <kind>[:<w>x<h>] */
+	p = strchr(ppipe, ':');
+	len = p ? (size_t)(p - ppipe) : strlen(ppipe);
+	for (i = 0; i < (int)(sizeof(sched_kind) / sizeof(sched_kind[0]));
+	     i++) {
+		if (strlen(sched_kind[i].pname) == len &&
+		    strncmp(sched_kind[i].pname, ppipe, len) == 0)
+			pjob->pkind = &sched_kind[i];
+	}
+	if (pjob->pkind == NULL) {
+		printf("Error : unknown pipeline (%s)\n", ppipe);
+		return -1;
+	}
+
+	/* input : <file>:<w>x<h> */
+	p = strrchr(pinput, ':');
+	if (p == NULL || sscanf(p + 1, "%ux%u", &pjob->in_width,
+				&pjob->in_height) != 2 ||
+	    pjob->in_width < 16 || pjob->in_width > JOB_SIZE_MAX ||
+	    pjob->in_height < 16 || pjob->in_height > JOB_SIZE_MAX ||
+	    (size_t)(p - pinput) >= sizeof(pjob->input)) {
+		printf("Error : bad input (%s)\n", pinput);
+		return -1;
+	}
+	memcpy(pjob->input, pinput, p - pinput);
+
+	pjob->out_width		= pjob->in_width;
+	pjob->out_height	= pjob->in_height;
+	if (pjob->pkind->need == CAP_UDS) {
+		p = strchr(ppipe, ':');
+		if (p == NULL || sscanf(p + 1, "%ux%u", &pjob->out_width,
+					&pjob->out_height) != 2 ||
+		    pjob->out_width < 16 || pjob->out_width > JOB_SIZE_MAX ||
+		    pjob->out_height < 16 ||
+		    pjob->out_height > JOB_SIZE_MAX) {
+			printf("Error : bad uds size (%s)\n", ppipe);
+			return -1;
+		}
+	}
+
+	snprintf(pjob->output, sizeof(pjob->output), "%s", poutput);
+	snprintf(pjob->spec, sizeof(pjob->spec), "%s %s", ppipe, pinput);
+	pjob->id	= sched_job_num++;
+	pjob->dev	= -1;
+	return 0;
+}
+
+static int load_jobs(const char *pfilename)
+{
+	FILE	*fp;
+	char	line[512];
+	char	pipe[64], input[160], output[160];
+	int	lineno = 0;
+	int	num;
+
+	fp = fopen(pfilename, "r");
+	if (fp == NULL) {
+		printf("Error : job list open error (%s)\n", pfilename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		num = sscanf(line, "%63s %159s %159s", pipe, input, output);
+		if (num <= 0 || pipe[0] == '#')
+			continue;
+		if (num != 3 || add_job(pipe, input, output) < 0) {
+			printf("Error : %s line %d\n", pfilename, lineno);
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+static void make_jobs(int num)
+{
+	static const unsigned int size[][2] = {
+		{ 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 },
+	};
+	unsigned int	seed = 1;
+	unsigned int	w, h;
+	char		pipe[64], input[64];
+	int		kind_num = sizeof(sched_kind) / sizeof(sched_kind[0]);
+	int		i, k, s;
+
+	/* a fixed mix, the same list on every run */
+	for (i = 0; i < num && sched_job_num < JOB_MAX; i++) {
+		seed = seed * 1103515245 + 12345;
+		k = (seed >> 16) % kind_num;
+		seed = seed * 1103515245 + 12345;
+		s = (seed >> 16) % (sizeof(size) / sizeof(size[0]));
+		w = size[s][0];
+		h = size[s][1];
+
+		if (sched_kind[k].need == CAP_UDS)
+			snprintf(pipe, sizeof(pipe), "uds:%ux%u", w / 2, h / 2);
+		else
+			snprintf(pipe, sizeof(pipe), "%s", sched_kind[k].pname);
+		snprintf(input, sizeof(input), "-:%ux%u", w, h);
+		add_job(pipe, input, "-");
+	}
+}
+
+/******************************************************************************
+ *  devices
+ ******************************************************************************/
+static int add_device(const char *pdevnode, bool quiet)
+{
+	struct vsp_dev		*pdev;
+	struct vsp2_media	*pmedia;
+	int			i;
+
+	if (vsp_dev_num >= VSP2_SCHED_DEV_MAX) {
+		printf("Error : too many devices (max %d)\n",
+		       VSP2_SCHED_DEV_MAX);
+		return -1;
+	}
+
+	pmedia = vsp2_media_open(pdevnode);
+	if (pmedia == NULL) {
+		if (!quiet)
+			printf("Error : vsp2_media_open(%s)\n", pdevnode);
+		return -1;
+	}
+
+	/* a VSP has at least the rpf -> wpf path; other media devices
+	 * (vin, fdp, ...) are passed over */
+	if (!vsp2_media_has_entity(pmedia, SRC_INPUT_DEV) ||
+	    !vsp2_media_has_entity(pmedia, DST_OUTPUT_DEV)) {
+		if (!quiet)
+			printf("Error : %s is not a VSP\n", pdevnode);
+		vsp2_media_close(pmedia);
+		return -1;
+	}
+
+	pdev = &vsp_dev[vsp_dev_num++];
+	memset(pdev, 0, sizeof(*pdev));
+	snprintf(pdev->devnode, sizeof(pdev->devnode), "%s", pdevnode);
+	pdev->pmedia = pmedia;
+
+	for (i = 0; i < (int)(sizeof(cap_name) / sizeof(cap_name[0])); i++) {
+		if (vsp2_media_has_entity(pmedia, cap_name[i]))
+			pdev->caps |= 1 << i;
+	}
+	/* the overlay of a blend comes in through rpf.1 */
+	if (!vsp2_media_has_entity(pmedia, OVL_INPUT_DEV))
+		pdev->caps &= ~CAP_BRU;
+	return 0;
+}
+
+static int test_sched(bool steal)
+{
+	struct vsp2_sched	*psched;
+	struct sched_job	*pjob;
+	unsigned long long	cost;
+	char			name[16];
+	int			left;
+	int			i;
+
+	psched = vsp2_sched_new(&dev_ops, steal);
+	if (psched == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	for (i = 0; i < vsp_dev_num; i++) {
+		snprintf(name, sizeof(name), "vsp%d", i);
+		vsp2_sched_add_device(psched, name, vsp_dev[i].caps,
+				      &vsp_dev[i]);
+	}
+
+	/* cost : pixels read and written */
+	for (i = 0; i < sched_job_num; i++) {
+		pjob = &sched_job[i];
+		cost = (unsigned long long)pjob->in_width * pjob->in_height +
+		       (unsigned long long)pjob->out_width * pjob->out_height;
+		if (pjob->pkind->need == CAP_BRU)
+			cost += cost / 8;	/* quarter size overlay */
+		if (vsp2_sched_push(psched, pjob, pjob->pkind->need,
+				    cost) < 0)
+			printf("Error : no device for job %d (%s)\n", pjob->id,
+			       pjob->spec);
+	}
+
+	vsp2_trace_begin("batch");
+	left = vsp2_sched_run(psched);
+	vsp2_trace_end();
+
+	print_sched_stat(psched, steal, left);
+
+	vsp2_sched_free(psched);
+	return left == 0 ? 0 : -1;
+}
+
+static void print_sched_stat(struct vsp2_sched *psched, bool steal, int left)
+{
+	struct vsp2_sched_stat	stat;
+	struct sched_job	*pjob, *pref;
+	long long		makespan = 0;
+	long long		busy_min = -1, busy_max = 0;
+	double			util_sum = 0.0;
+	char			units[32];
+	int			done = 0, mismatch = 0;
+	int			i, j;
+
+	for (i = 0; i < vsp_dev_num; i++) {
+		vsp2_sched_stat(psched, i, &stat);
+		if (stat.wall_us > makespan)
+			makespan = stat.wall_us;
+	}
+
+	/* the same spec gives the same output on any device */
+	for (i = 0; i < sched_job_num; i++) {
+		pjob = &sched_job[i];
+		if (!pjob->done)
+			continue;
+		done++;
+		for (j = 0; j < i; j++) {
+			pref = &sched_job[j];
+			if (pref->done && strcmp(pref->spec, pjob->spec) == 0) {
+				if (pref->hash != pjob->hash)
+					mismatch++;
+				break;
+			}
+		}
+	}
+
+	printf("\n----- BATCH SCHEDULE (%s) -----\n",
+	       steal ? "work stealing" : "static");
+	printf("jobs          : %d, %d done, %d failed or not run\n",
+	       sched_job_num, done, sched_job_num - done);
+	printf("makespan      : %.1f ms, %.1f jobs/s\n", makespan / 1000.0,
+	       makespan ? done * 1000000.0 / makespan : 0.0);
+	printf("device        : units                jobs stolen given"
+	       "   busy ms   util\n");
+	for (i = 0; i < vsp_dev_num; i++) {
+		vsp2_sched_stat(psched, i, &stat);
+
+		units[0] = '\0';
+		for (j = 0; j < (int)(sizeof(cap_name) / sizeof(cap_name[0]));
+		     j++) {
+			if (vsp_dev[i].caps & (1 << j)) {
+				strcat(units, units[0] ? "," : "");
+				strcat(units, j == 0 ? "uds" : cap_name[j]);
+			}
+		}
+
+		printf("  %-12s: %-18s %6u %6u %5u %9.1f %5.1f %%%s\n",
+		       vsp_dev[i].devnode, units[0] ? units : "-", stat.jobs,
+		       stat.stolen, stat.given, stat.busy_us / 1000.0,
+		       makespan ? 100.0 * stat.busy_us / makespan : 0.0,
+		       stat.started ? "" : " (not started)");
+
+		if (!stat.started)
+			continue;
+		util_sum += makespan ? 100.0 * stat.busy_us / makespan : 0.0;
+		if (busy_min < 0 || stat.busy_us < busy_min)
+			busy_min = stat.busy_us;
+		if (stat.busy_us > busy_max)
+			busy_max = stat.busy_us;
+	}
+	printf("balance       : busy %.1f - %.1f ms, mean util %.1f %%\n",
+	       busy_min < 0 ? 0.0 : busy_min / 1000.0, busy_max / 1000.0,
+	       util_sum / vsp_dev_num);
+	/* jobs no device could take never reached the scheduler */
+	left = sched_job_num - done;
+	printf("result        : %s", (left == 0 && mismatch == 0) ?
+	       "OK\n" : "NG");
+	if (left != 0 || mismatch != 0)
+		printf(" (%d left, %d differ between devices)\n", left,
+		       mismatch);
+	printf("--------------------------------------\n");
+}
+
+/******************************************************************************
+ *  device thread
+ ******************************************************************************/
+static int dev_start(int dev, void *pctx)
+{
+	struct vsp_dev	*pdev = pctx;
+	unsigned int	*ptbl;
+	unsigned long	phys, hard;
+	char		name[48];
+	int		r, g, b;
+	int		i;
+
+	snprintf(name, sizeof(name), "sched %s", pdev->devnode);
+	vsp2_mem_pipeline(name);
+
+	/*-------------------------------------------------------------------*/
+	/*  Lookup table (negative)                                          */
+	/*-------------------------------------------------------------------*/
+	if (pdev->caps & CAP_LUT) {
+		if (vsp2_mem_alloc(VSP2_MEM_TABLE, &pdev->lut_id,
+				   LUT_TBL_NUM*8, &phys, &hard,
+				   &pdev->lut_virt, MMNGR_VA_SUPPORT) != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			pdev->lut_virt = 0;
+			return -1;
+		}
+		ptbl = (unsigned int *)pdev->lut_virt;
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			ptbl[i*2]	= LUT_REG_ADDR + i*4;
+			ptbl[i*2+1]	= (255 - i) << 16
+					| (255 - i) << 8
+					| (255 - i);
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Cubic lookup table (r -> g -> b -> r)                            */
+	/*-------------------------------------------------------------------*/
+	if (pdev->caps & CAP_CLU) {
+		if (vsp2_mem_alloc(VSP2_MEM_TABLE, &pdev->clu_id,
+				   CLU_TBL_NUM*8, &phys, &hard,
+				   &pdev->clu_virt, MMNGR_VA_SUPPORT) != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			pdev->clu_virt = 0;
+			return -1;
+		}
+		ptbl = (unsigned int *)pdev->clu_virt;
+		for (b = 0; b < CLU_GRID; b++) {
+			for (g = 0; g < CLU_GRID; g++) {
+				for (r = 0; r < CLU_GRID; r++) {
+					*ptbl++ = CLU_REG_DATA;
+					*ptbl++ = (b * 255 / 16) << 16
+						| (r * 255 / 16) << 8
+						| (g * 255 / 16);
+				}
+			}
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Histogram buffer, kept for the life of the device                */
+	/*-------------------------------------------------------------------*/
+	if (pdev->caps & CAP_HGO) {
+		if (vsp2_mem_alloc(VSP2_MEM_TABLE, &pdev->hgo_id,
+				   HGO_BUFF_SIZE, &phys, &hard,
+				   &pdev->hgo_virt, MMNGR_VA_SUPPORT) != 0) {
+			printf("Error : mmngr_alloc_in_user()\n");
+			pdev->hgo_virt = 0;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int dev_run(int dev, void *pctx, void *pjob)
+{
+	struct vsp_dev		*pdev = pctx;
+	struct sched_job	*pj = pjob;
+	int			ret;
+
+	vsp2_trace_begin(pj->pkind->pname);
+	ret = run_job(pdev, pj);
+	vsp2_trace_end();
+
+	pj->dev = dev;
+	if (ret < 0) {
+		printf("Error : job %d (%s) failed on %s\n", pj->id, pj->spec,
+		       pdev->devnode);
+		return -1;
+	}
+	pj->done = true;
+	return 0;
+}
+
+static void dev_stop(int dev, void *pctx)
+{
+	struct vsp_dev *pdev = pctx;
+
+	/*-------------------------------------------------------------------*/
+	/*  Release memory for tables                                        */
+	/*-------------------------------------------------------------------*/
+	if (pdev->lut_virt != 0)
+		mmngr_free_in_user(pdev->lut_id);
+	if (pdev->clu_virt != 0)
+		mmngr_free_in_user(pdev->clu_id);
+	if (pdev->hgo_virt != 0)
+		mmngr_free_in_user(pdev->hgo_id);
+
+	vsp2_media_close(pdev->pmedia);
+}
+
+static int run_job(struct vsp_dev *pdev, struct sched_job *pjob)
+{
+	const unsigned int out_type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	const unsigned int cap_type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+
+	bool		blend = (pjob->pkind->need == CAP_BRU);
+	unsigned int	src_size = pjob->in_width * pjob->in_height * 4;
+	unsigned int	ovl_size = src_size / 4;
+	unsigned int	dst_size = pjob->out_width * pjob->out_height * 4;
+	unsigned char	*psrc_buf = NULL;
+	unsigned char	*povl_buf = NULL;
+	unsigned char	*pdst_buf = NULL;
+	unsigned int	type;
+
+	int src_fd = -1;	/* src file descriptor */
+	int ovl_fd = -1;	/* overlay file descriptor (bru) */
+	int dst_fd = -1;	/* dst file descriptor */
+	int ret = -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Call media-ctl                                                   */
+	/*-------------------------------------------------------------------*/
+	if (call_media_ctl(pdev, pjob) < 0) {
+		printf("Error : media-ctl call failed.\n");
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device                                                      */
+	/*-------------------------------------------------------------------*/
+	src_fd = open_video_device(pdev->pmedia, SRC_INPUT_DEV);
+	if (blend)
+		ovl_fd = open_video_device(pdev->pmedia, OVL_INPUT_DEV);
+	dst_fd = open_video_device(pdev->pmedia, DST_OUTPUT_DEV);
+	if (src_fd == -1 || dst_fd == -1 || (blend && ovl_fd == -1)) {
+		printf("Error open device: %s (%d).\n", strerror(errno),
+		       errno);
+		goto out;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Tables - VIDIOC_VSP2_*_CONFIG                                    */
+	/*-------------------------------------------------------------------*/
+	if (config_job(pdev, pjob) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT / VIDIOC_REQBUFS / VIDIOC_QUERYBUF / Mmap           */
+	/*-------------------------------------------------------------------*/
+	if (set_format(src_fd, out_type, pjob->in_width, pjob->in_height,
+		       0) < 0 ||
+	    set_format(dst_fd, cap_type, pjob->out_width, pjob->out_height,
+		       0) < 0)
+		goto out;
+	if (blend && set_format(ovl_fd, out_type, pjob->in_width / 2,
+				pjob->in_height / 2,
+				V4L2_PIX_FMT_FLAG_PREMUL_ALPHA) < 0)
+		goto out;
+
+	if (setup_buf(src_fd, out_type, src_size, &psrc_buf) < 0 ||
+	    setup_buf(dst_fd, cap_type, dst_size, &pdst_buf) < 0 ||
+	    (blend && setup_buf(ovl_fd, out_type, ovl_size, &povl_buf) < 0))
+		goto out;
+
+	/*-------------------------------------------------------------------*/
+	/*  Read file / make image                                           */
+	/*-------------------------------------------------------------------*/
+	if (strcmp(pjob->input, "-") == 0) {
+		vsp2_trace_begin("make image");
+		make_pattern((unsigned int *)psrc_buf, pjob->in_width,
+			     pjob->in_height);
+		vsp2_trace_end();
+	} else if (read_file(psrc_buf, src_size, pjob->input) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+	if (blend) {
+		vsp2_trace_begin("make image");
+		make_overlay((unsigned int *)povl_buf, pjob->in_width / 2,
+			     pjob->in_height / 2);
+		vsp2_trace_end();
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_QBUF / VIDIOC_STREAMON                                    */
+	/*-------------------------------------------------------------------*/
+	if (queue_buf(dst_fd, cap_type, dst_size) < 0 ||
+	    queue_buf(src_fd, out_type, src_size) < 0 ||
+	    (blend && queue_buf(ovl_fd, out_type, ovl_size) < 0))
+		goto out;
+
+	type = out_type;
+	if (ioctl(src_fd, VIDIOC_STREAMON, &type) < 0 ||
+	    (blend && ioctl(ovl_fd, VIDIOC_STREAMON, &type) < 0)) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto off;
+	}
+	type = cap_type;
+	if (ioctl(dst_fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto off;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_DQBUF                                                     */
+	/*-------------------------------------------------------------------*/
+	if (dequeue_buf(dst_fd, cap_type) < 0 ||
+	    dequeue_buf(src_fd, out_type) < 0 ||
+	    (blend && dequeue_buf(ovl_fd, out_type) < 0))
+		goto off;
+
+	/*-------------------------------------------------------------------*/
+	/*  Checksum / write file                                            */
+	/*-------------------------------------------------------------------*/
+	pjob->hash = calc_hash(0xcbf29ce484222325ULL, pdst_buf, dst_size);
+	if (pjob->pkind->need == CAP_HGO)
+		pjob->hash = calc_hash(pjob->hash, (void *)pdev->hgo_virt,
+				       HGO_BUFF_SIZE);
+
+	if (strcmp(pjob->output, "-") != 0 &&
+	    write_file(pdst_buf, dst_size, pjob->output) == 0)
+		goto off;
+	ret = 0;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF                                                 */
+	/*-------------------------------------------------------------------*/
+off:
+	type = out_type;
+	ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	if (blend)
+		ioctl(ovl_fd, VIDIOC_STREAMOFF, &type);
+	type = cap_type;
+	ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+
+	/*-------------------------------------------------------------------*/
+	/*  Unmap buffer / VIDIOC_REQBUFS (release)                          */
+	/*-------------------------------------------------------------------*/
+out:
+	if (src_fd != -1) {
+		release_buf(src_fd, out_type, psrc_buf, src_size);
+		close(src_fd);
+	}
+	if (ovl_fd != -1) {
+		release_buf(ovl_fd, out_type, povl_buf, ovl_size);
+		close(ovl_fd);
+	}
+	if (dst_fd != -1) {
+		release_buf(dst_fd, cap_type, pdst_buf, dst_size);
+		close(dst_fd);
+	}
+	return ret;
+}
+
+static int config_job(struct vsp_dev *pdev, struct sched_job *pjob)
+{
+	struct vsp2_lut_config	lut_par;
+	struct vsp2_clu_config	clu_par;
+	struct vsp2_hgo_config	hgo_par;
+	int			fd;
+	int			ret = 0;
+
+	/* one config per job, the tables are already in place */
+	switch (pjob->pkind->need) {
+	case CAP_LUT:
+		fd = open_video_device(pdev->pmedia, "lut");
+		if (fd == -1)
+			return -1;
+		memset(&lut_par, 0, sizeof(lut_par));
+		lut_par.addr	= (void *)pdev->lut_virt;
+		lut_par.tbl_num	= LUT_TBL_NUM;
+		lut_par.fxa	= 0x80;
+		ret = ioctl(fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+		close(fd);
+		break;
+	case CAP_CLU:
+		fd = open_video_device(pdev->pmedia, "clu");
+		if (fd == -1)
+			return -1;
+		memset(&clu_par, 0, sizeof(clu_par));
+		clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
+		clu_par.addr	= (void *)pdev->clu_virt;
+		clu_par.tbl_num	= CLU_TBL_NUM;
+		ret = ioctl(fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par);
+		close(fd);
+		break;
+	case CAP_HGO:
+		fd = open_video_device(pdev->pmedia, "hgo");
+		if (fd == -1)
+			return -1;
+		memset(&hgo_par, 0, sizeof(hgo_par));
+		hgo_par.addr		= (void *)pdev->hgo_virt;
+		hgo_par.width		= pjob->in_width;
+		hgo_par.height		= pjob->in_height;
+		hgo_par.binary_mode	= 0x00;	/* VSP_STRAIGHT_BINARY */
+		hgo_par.maxrgb_mode	= 0x00;	/* VSP_MAXRGB_OFF */
+		hgo_par.step_mode	= 0x00;	/* VSP_STEP_64 */
+		hgo_par.sampling	= 0;	/* VSP_SMPPT_SRC1 */
+		ret = ioctl(fd, VIDIOC_VSP2_HGO_CONFIG, &hgo_par);
+		close(fd);
+		break;
+	default:
+		break;
+	}
+	return ret;
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int read_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("read file");
+
+	/* file input */
+	fp = fopen(pfilename, "rb");
+	if (fp == NULL) {
+		printf("file open error...\n");
+		ret = 0;
+	} else {
+		ret = fread(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer read error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int write_file(
+	unsigned char	*pbuffers,
+	unsigned int	size,
+	const char	*pfilename
+	)
+{
+	FILE	*fp;
+	int	ret;
+
+	vsp2_trace_begin("write file");
+
+	/* file output */
+	fp = fopen(pfilename, "wb");
+	if (!fp) {
+		printf("output file open error..\n");
+		ret = 0;
+	} else {
+		ret = fwrite(pbuffers, size, 1, fp);
+		if (ret == 0)
+			printf("buffer write error...\n");
+		fclose(fp);
+	}
+	vsp2_trace_end();
+	return ret;
+}
+
+static int call_media_ctl(struct vsp_dev *pdev, struct sched_job *pjob)
+{
+	struct vsp2_media		*pmedia = pdev->pmedia;
+	struct v4l2_mbus_framefmt	format;
+	struct v4l2_rect		rect;
+	const char			*pentity = pjob->pkind->pentity;
+	bool				blend = (pjob->pkind->need == CAP_BRU);
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [unit] -> wpf.0:0     */
+	/* rpf.1:1 -> bru:1 (blend)         */
+	/*----------------------------------*/
+	if (pentity == NULL) {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
+			return -1;
+		}
+	} else {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pentity, 0,
+					  true) != 0 ||
+		    (blend && vsp2_media_setup_link(pmedia, "rpf.1", 1,
+						    pentity, 1, true) != 0) ||
+		    vsp2_media_setup_link(pmedia, pentity, blend ? 5 : 1,
+					  "wpf.0", 0, true) != 0) {
+			printf("Error : vsp2_media_setup_link(%s)\n", pentity);
+			return -1;
+		}
+	}
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/*----------------------------------------------------- set format */
+	format.width	= pjob->in_width;
+	format.height	= pjob->in_height;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf.0)\n");
+		return -1;
+	}
+	if (pentity != NULL &&
+	    vsp2_media_set_format(pmedia, pentity, 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(%s pad 0)\n", pentity);
+		return -1;
+	}
+
+	if (blend) {
+		format.width	= pjob->in_width / 2;
+		format.height	= pjob->in_height / 2;
+		if (vsp2_media_set_format(pmedia, "rpf.1", 0, &format) != 0 ||
+		    vsp2_media_set_format(pmedia, "rpf.1", 1, &format) != 0 ||
+		    vsp2_media_set_format(pmedia, "bru", 1, &format) != 0) {
+			printf("Error : vsp2_media_set_format(rpf.1)\n");
+			return -1;
+		}
+
+		rect.left	= 0;
+		rect.top	= 0;
+		rect.width	= pjob->in_width;
+		rect.height	= pjob->in_height;
+		if (vsp2_media_set_selection(pmedia, "rpf.0", 0,
+					     V4L2_SEL_TGT_CROP, &rect) != 0 ||
+		    vsp2_media_set_selection(pmedia, "bru", 0,
+					     V4L2_SEL_TGT_COMPOSE,
+					     &rect) != 0) {
+			printf("Error : vsp2_media_set_selection(bru pad 0)\n");
+			return -1;
+		}
+		rect.width	= pjob->in_width / 2;
+		rect.height	= pjob->in_height / 2;
+		if (vsp2_media_set_selection(pmedia, "rpf.1", 0,
+					     V4L2_SEL_TGT_CROP, &rect) != 0) {
+			printf("Error : vsp2_media_set_selection(rpf.1)\n");
+			return -1;
+		}
+		rect.left	= pjob->in_width / 8;
+		rect.top	= pjob->in_height / 8;
+		if (vsp2_media_set_selection(pmedia, "bru", 1,
+					     V4L2_SEL_TGT_COMPOSE,
+					     &rect) != 0) {
+			printf("Error : vsp2_media_set_selection(bru pad 1)\n");
+			return -1;
+		}
+	}
+
+	format.width	= pjob->out_width;
+	format.height	= pjob->out_height;
+	if (pentity != NULL &&
+	    vsp2_media_set_format(pmedia, pentity, blend ? 5 : 1,
+				  &format) != 0) {
+		printf("Error : vsp2_media_set_format(%s source)\n", pentity);
+		return -1;
+	}
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf)\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
+
+static int set_format(int fd, unsigned int type, unsigned int width,
+		      unsigned int height, unsigned int flags)
+{
+	struct v4l2_format fmt;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= type;
+	fmt.fmt.pix_mp.width		= width;
+	fmt.fmt.pix_mp.height		= height;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+	fmt.fmt.pix_mp.flags		= flags;
+
+	if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int setup_buf(int fd, unsigned int type, unsigned int size,
+		     unsigned char **ppbuf)
+{
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	unsigned char			*pbuf;
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 1;
+	req_buf.type	= type;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+
+	if (ioctl(fd, VIDIOC_REQBUFS, &req_buf) < 0 || req_buf.count != 1) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.index	= 0;
+	buf.type	= type;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+	buf.m.planes	= planes;
+
+	if (ioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	pbuf = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		    planes[0].m.mem_offset);
+	if (pbuf == MAP_FAILED) {
+		printf("Error(%d) : mmap\n", __LINE__);
+		return -1;
+	}
+	*ppbuf = pbuf;
+	return 0;
+}
+
+static int queue_buf(int fd, unsigned int type, unsigned int size)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.index	= 0;
+	buf.type	= type;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= 1;
+	buf.m.planes[0].bytesused	= size;
+	buf.bytesused			= size;
+
+	if (ioctl(fd, VIDIOC_QBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int dequeue_buf(int fd, unsigned int type)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= type;
+	buf.memory	= V4L2_MEMORY_MMAP;
+	buf.length	= VIDEO_MAX_PLANES;
+
+	if (ioctl(fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static void release_buf(int fd, unsigned int type, unsigned char *pbuf,
+			unsigned int size)
+{
+	struct v4l2_requestbuffers req_buf;
+
+	if (pbuf != NULL)
+		munmap(pbuf, size);
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 0;		/* Release buffers */
+	req_buf.type	= type;
+	req_buf.memory	= V4L2_MEMORY_MMAP;
+	ioctl(fd, VIDIOC_REQBUFS, &req_buf);
+}
+
+static void make_pattern(unsigned int *pbuf, unsigned int width,
+			 unsigned int height)
+{
+	unsigned int x, y;
+	unsigned int r, g, b;
+
+	/* a:0xff, r:x ramp, g:y ramp, b:diagonal bands */
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			r = x * 255 / width;
+			g = y * 255 / height;
+			b = (x + y) & 0xff;
+			*pbuf++ = b << 24 | g << 16 | r << 8 | 0xff;
+		}
+	}
+}
+
+static void make_overlay(unsigned int *pbuf, unsigned int width,
+			 unsigned int height)
+{
+	unsigned int	x, y;
+	unsigned int	a, c;
+
+	/* premultiplied green, alpha fades out to the right */
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			a = 255 - x * 255 / width;
+			c = 0xff * a / 255;
+			*pbuf++ = c << 16 | a;
+		}
+	}
+}
+
+static unsigned long long calc_hash(unsigned long long hash,
+				    const void *pdata, size_t len)
+{
+	const unsigned char *p = pdata;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
@@ -0,0 +1,1175 @@
+/*
+ * Copyright (c) 2016-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/******************************************************************************
+ *  link state  : rpf -> [uds | lut | clu] -> wpf
+ *  memory type : mmap, userptr and dmabuf in turn
+ *
+ *  Memory type autotuner. One pipeline and source size is run with every
+ *  memory type at every queue depth up to -q, each for a burst of -t ms
+ *  after a warm-up, with the CPU filling every source and reading every
+ *  output as the tools do: into the mapping for mmap, into mmngr buffers
+ *  for userptr, and the same synced through DMA_BUF_IOCTL_SYNC for dmabuf.
+ *  A burst is timed, not counted, so every candidate gets the same time
+ *  whatever the frame size; a deeper queue has to be clearly faster to
+ *  win, as it costs latency.
+ *
+ *  The winner goes to the profile of the VSP (common/vsp2_profile.c),
+ *  where uds, lut and clu look when no memory type is given.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <mediactl/mediactl.h>
+#include <mediactl/v4l2subdev.h>
+
+#include "mmngr_user_public.h"
+#include "mmngr_buf_user_public.h"
+
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_profile.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+#include "vsp2_userptr.h"
+
+/******************************************************************************
+ *  macros
+ ******************************************************************************/
+/* device name */
+#ifndef USE_M3
+/* for h3 */
+#define MEDIA_DEV_NAME		"/dev/media3"		/* fe9a0000.vsp */
+#else
+/* for m3 */
+#define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
+#endif
+
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
+
+/* source parameter */
+#define SRC_WIDTH		(1280)			/* src: width */
+#define SRC_HEIGHT		(720)			/* src: height */
+#define SIZE_MAX_WH		(8190)			/* width and height */
+
+/* lut / clu parameter */
+#define LUT_TBL_NUM		(256)
+#define LUT_REG_ADDR		(0x00007000)
+#define CLU_GRID		(17)
+#define CLU_TBL_NUM		(CLU_GRID*CLU_GRID*CLU_GRID)
+#define CLU_REG_DATA		(0x00007404)
+
+/* tune parameter */
+#define TUNE_MODULE_NUM		(4)		/* copy, uds, lut, clu */
+#define TUNE_MEMORY_NUM		(3)		/* mmap, userptr, dmabuf */
+#define TUNE_DEPTH_MAX		(8)
+#define TUNE_DEPTH_NUM		(4)		/* deepest queue tried */
+#define TUNE_BURST_MS		(200)		/* timed part of a burst */
+#define TUNE_WARMUP_NUM		(2)		/* untimed frames per buffer */
+#define TUNE_FRAME_MIN		(8)
+#define TUNE_FRAME_MAX		(2000)
+#define TUNE_MARGIN_PCT		(3)		/* a deeper queue must win by */
+#define TUNE_RUN_MAX		(TUNE_MEMORY_NUM * 4)	/* depths 1 2 4 8 */
+
+/* ioctl */
+#define VIDIOC_VSP2_LUT_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct vsp2_lut_config)
+#define VIDIOC_VSP2_CLU_CONFIG \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct vsp2_clu_config)
+
+/******************************************************************************
+ *  structure
+ ******************************************************************************/
+struct vsp2_lut_config {
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned short	tbl_num;	/* 1 to 256 */
+	unsigned char	fxa;
+};
+
+struct vsp2_clu_config {
+	unsigned char	mode;
+	void		*addr;	/* Allocate memory size is tbl_num * 8 bytes. */
+	unsigned char	fxa;
+	unsigned short	tbl_num;	/* 1 to 9826 */
+};
+
+struct tune_module {
+	const char	*pname;
+	const char	*pentity;	/* NULL : rpf.0 -> wpf.0 */
+};
+
+struct tune_buf {
+	unsigned char	*pvirt;		/* NULL : not allocated */
+	MMNGR_ID	id;		/* userptr, dmabuf */
+	int		mbid;		/* dmabuf */
+	int		dmafd;		/* dmabuf, -1 : not exported */
+};
+
+/* one memory type at one depth */
+struct tune_pipe {
+	unsigned int		memory;
+	int			depth;
+	int			src_fd;
+	int			dst_fd;
+	struct vsp2_userptr	*psrc_u;	/* userptr */
+	struct vsp2_userptr	*pdst_u;
+	struct tune_buf		src[TUNE_DEPTH_MAX];
+	struct tune_buf		dst[TUNE_DEPTH_MAX];
+	long long		t_queue[TUNE_DEPTH_MAX];
+	bool			streaming;
+};
+
+struct tune_run {
+	unsigned int		memory;
+	int			depth;
+	bool			ok;
+	int			frames;		/* timed */
+	long long		elapsed;
+	long long		lat_sum;
+	long long		lat_max;
+	unsigned long long	hash;		/* last output */
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static const struct tune_module tune_module[TUNE_MODULE_NUM] = {
+	{ "copy",	NULL },
+	{ "uds",	"uds.0" },
+	{ "lut",	"lut" },
+	{ "clu",	"clu" },
+};
+
+static const unsigned int tune_memory[TUNE_MEMORY_NUM] = {
+	V4L2_MEMORY_MMAP, V4L2_MEMORY_USERPTR, V4L2_MEMORY_DMABUF,
+};
+
+static const struct tune_module	*ptune_mod = &tune_module[2];
+static char			tune_key[VSP2_PROFILE_MODULE_LEN] = "lut";
+static unsigned int		src_width = SRC_WIDTH;
+static unsigned int		src_height = SRC_HEIGHT;
+static unsigned int		dst_width;
+static unsigned int		dst_height;
+static unsigned int		src_size;
+static unsigned int		dst_size;
+
+static struct vsp2_media	*ptune_media;
+static MMNGR_ID			tbl_id;
+static unsigned long		tbl_virt;
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int	set_module(const char *pspec);
+static int	show_profile(const char *pdevnode);
+static int	test_tune(const char *pdevnode, int depth_max, int burst_ms,
+			  bool save);
+static int	run_burst(struct tune_run *prun, const unsigned char *pimage,
+			  long long burst_us);
+static int	open_pipe(struct tune_pipe *pp);
+static void	close_pipe(struct tune_pipe *pp);
+static int	alloc_buf(struct tune_pipe *pp, struct tune_buf *pbuf,
+			  unsigned int type, int index, unsigned int size);
+static void	free_buf(struct tune_pipe *pp, struct tune_buf *pbuf,
+			 unsigned int size);
+static int	fill_src(struct tune_pipe *pp, int b,
+			 const unsigned char *pimage);
+static int	read_dst(struct tune_pipe *pp, int b,
+			 unsigned long long *phash);
+static int	queue_frame(struct tune_pipe *pp, int b);
+static int	dequeue_frame(struct tune_pipe *pp);
+static int	pick_best(const struct tune_run *prun, int run_num);
+static void	print_tune_stat(const struct tune_run *prun, int run_num,
+				int best);
+static int	call_media_ctl(struct vsp2_media *pmedia);
+static int	set_table(struct vsp2_media *pmedia);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity, int flags);
+static void	make_image(unsigned char *pimage);
+static unsigned long long	calc_hash(const void *pdata, size_t len);
+static long long	get_time_us(void);
+
+/******************************************************************************
+ *  main
+ ******************************************************************************/
+void print_usage(const char *pname)
+{
+	printf("----------------------------------\n");
+#ifndef USE_M3
+	printf(" exec for H3 settings\n");
+#else
+	printf(" exec for M3 settings\n");
+#endif
+	printf("----------------------------------\n");
+	printf(" Usage : %s [option]\n", pname);
+	printf("    option\n");
+	printf("        -p <module>: copy, uds:<w>x<h>, lut or clu [lut]\n");
+	printf("        -i <w>x<h>: source size [%dx%d]\n", SRC_WIDTH,
+	       SRC_HEIGHT);
+	printf("        -d <media>: VSP to tune [%s]\n", MEDIA_DEV_NAME);
+	printf("        -t <ms>: timed part of each burst [%d]\n",
+	       TUNE_BURST_MS);
+	printf("        -q <num>: deepest queue tried, 1 - %d [%d]\n",
+	       TUNE_DEPTH_MAX, TUNE_DEPTH_NUM);
+	printf("        -n: measure only, the profile is left as it is\n");
+	printf("        -l: print the profile entry and exit\n");
+	printf("        -h: print usage\n");
+	printf("----------------------------------\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char	*pdevnode = MEDIA_DEV_NAME;
+	int		depth_max = TUNE_DEPTH_NUM;
+	int		burst_ms = TUNE_BURST_MS;
+	bool		save = true;
+	bool		show = false;
+	int		opt;
+	int		ret;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "p:i:d:t:q:nlh")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (set_module(optarg) < 0)
+				exit(1);
+			break;
+		case 'i':
+			if (sscanf(optarg, "%ux%u", &src_width,
+				   &src_height) != 2) {
+				print_usage(argv[0]);
+				exit(1);
+			}
+			break;
+		case 'd':
+			pdevnode = optarg;
+			break;
+		case 't':
+			burst_ms = atoi(optarg);
+			break;
+		case 'q':
+			depth_max = atoi(optarg);
+			break;
+		case 'n':
+			save = false;
+			break;
+		case 'l':
+			show = true;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+	if (src_width < 1 || src_width > SIZE_MAX_WH || src_height < 1 ||
+	    src_height > SIZE_MAX_WH || burst_ms < 1 || depth_max < 1 ||
+	    depth_max > TUNE_DEPTH_MAX) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+
+	/* the output of all but uds is the size of the source */
+	if (strcmp(ptune_mod->pname, "uds") != 0) {
+		dst_width	= src_width;
+		dst_height	= src_height;
+	}
+	src_size = src_width * src_height * 4;
+	dst_size = dst_width * dst_height * 4;
+
+	if (show) {
+		ret = show_profile(pdevnode);
+		exit(ret < 0 ? 1 : 0);
+	}
+
+	printf("exec TUNE %s %ux%u on %s, depth 1 - %d, %d ms bursts\n",
+	       tune_key, src_width, src_height, pdevnode, depth_max,
+	       burst_ms);
+	vsp2_mem_pipeline("tune");
+
+	ret = test_tune(pdevnode, depth_max, burst_ms, save);
+	exit(ret < 0 ? 1 : 0);
+}
+
+static int set_module(const char *pspec)
+{
+	const char	*p;
+	size_t		len;
+	int		i;
+
+	p = strchr(pspec, ':');
+	len = p ? (size_t)(p - pspec) : strlen(pspec);
+
+	ptune_mod = NULL;
+	for (i = 0; i < TUNE_MODULE_NUM; i++) {
+		if (strlen(tune_module[i].pname) == len &&
+		    strncmp(tune_module[i].pname, pspec, len) == 0)
+			ptune_mod = &tune_module[i];
+	}
+	if (ptune_mod == NULL) {
+		printf("Error : unknown module (%s)\n", pspec);
+		return -1;
+	}
+
+	if (strcmp(ptune_mod->pname, "uds") != 0) {
+		snprintf(tune_key, sizeof(tune_key), "%s", ptune_mod->pname);
+		return 0;
+	}
+	if (p == NULL ||
+	    sscanf(p + 1, "%ux%u", &dst_width, &dst_height) != 2 ||
+	    dst_width < 1 || dst_width > SIZE_MAX_WH ||
+	    dst_height < 1 || dst_height > SIZE_MAX_WH) {
+		printf("Error : uds needs an output size (uds:<w>x<h>)\n");
+		return -1;
+	}
+
+	/* the profile key, as the tools ask for it */
+	snprintf(tune_key, sizeof(tune_key), "uds:%ux%u", dst_width,
+		 dst_height);
+	return 0;
+}
+
+static int show_profile(const char *pdevnode)
+{
+	struct vsp2_profile	prof;
+
+	if (vsp2_profile_load(pdevnode, tune_key, src_width, src_height,
+			      &prof) < 0) {
+		if (errno == ENOENT)
+			printf("profile : no entry for %s %ux%u on %s\n",
+			       tune_key, src_width, src_height, pdevnode);
+		return -1;
+	}
+	printf("profile : %s %ux%u on %s : %s, depth %u, %.1f fps"
+	       " (kernel %s)\n", prof.module, prof.width, prof.height,
+	       pdevnode, vsp2_profile_memory_name(prof.memory), prof.depth,
+	       prof.fps, prof.kernel);
+	return 0;
+}
+
+/******************************************************************************
+ *  tune
+ ******************************************************************************/
+static int test_tune(const char *pdevnode, int depth_max, int burst_ms,
+		     bool save)
+{
+	struct tune_run		run[TUNE_RUN_MAX];
+	struct vsp2_profile	prof;
+	unsigned char		*pimage = NULL;
+	int			run_num = 0;
+	int			best;
+	int			ret = -1;
+	int			m, d;
+
+	/*-------------------------------------------------------------------*/
+	/*  Pipeline : links, formats and table once for every burst         */
+	/*-------------------------------------------------------------------*/
+	ptune_media = vsp2_media_open(pdevnode);
+	if (ptune_media == NULL) {
+		printf("Error : vsp2_media_open(%s)\n", pdevnode);
+		return -1;
+	}
+	if (ptune_mod->pentity != NULL &&
+	    !vsp2_media_has_entity(ptune_media, ptune_mod->pentity)) {
+		printf("Error : %s has no %s\n", pdevnode, ptune_mod->pentity);
+		goto out;
+	}
+
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(ptune_media);
+	vsp2_trace_end();
+	if (ret < 0) {
+		printf("Error : media-ctl call failed.\n");
+		goto out;
+	}
+	ret = -1;
+	if (set_table(ptune_media) < 0)
+		goto out;
+
+	pimage = malloc(src_size);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+	make_image(pimage);
+
+	/*-------------------------------------------------------------------*/
+	/*  Bursts : every memory type at depth 1, 2, 4, ... depth_max       */
+	/*-------------------------------------------------------------------*/
+	memset(run, 0, sizeof(run));
+	for (m = 0; m < TUNE_MEMORY_NUM; m++) {
+		for (d = 1; d <= depth_max; d *= 2) {
+			run[run_num].memory	= tune_memory[m];
+			run[run_num].depth	= d;
+			run_burst(&run[run_num], pimage,
+				  (long long)burst_ms * 1000);
+			run_num++;
+		}
+	}
+
+	best = pick_best(run, run_num);
+	print_tune_stat(run, run_num, best);
+	if (best < 0) {
+		printf("Error : no memory type ran\n");
+		goto out;
+	}
+	ret = 0;
+
+	/*-------------------------------------------------------------------*/
+	/*  Profile                                                          */
+	/*-------------------------------------------------------------------*/
+	if (save) {
+		memset(&prof, 0, sizeof(prof));
+		snprintf(prof.module, sizeof(prof.module), "%s", tune_key);
+		prof.width	= src_width;
+		prof.height	= src_height;
+		prof.memory	= run[best].memory;
+		prof.depth	= run[best].depth;
+		prof.fps	= run[best].frames * 1e6 / run[best].elapsed;
+		ret = vsp2_profile_save(pdevnode, &prof);
+		if (ret == 0)
+			printf("profile  : saved for %s\n",
+			       vsp2_media_bus_name(ptune_media));
+	}
+
+out:
+	if (tbl_virt != 0)
+		vsp2_mem_free(tbl_id);
+	tbl_virt = 0;
+	free(pimage);
+	vsp2_media_close(ptune_media);
+	ptune_media = NULL;
+	return ret;
+}
+
+static int run_burst(struct tune_run *prun, const unsigned char *pimage,
+		     long long burst_us)
+{
+	struct tune_pipe	pipe;
+	long long		t_start = 0;
+	long long		t, lat;
+	int			warm;
+	int			done = 0;
+	int			b;
+	int			ret = -1;
+
+	vsp2_trace_begin(vsp2_profile_memory_name(prun->memory));
+	memset(&pipe, 0, sizeof(pipe));
+	pipe.memory	= prun->memory;
+	pipe.depth	= prun->depth;
+
+	if (open_pipe(&pipe) < 0)
+		goto out;
+
+	/*-------------------------------------------------------------------*/
+	/*  Every buffer in flight, then each frame done is filled again     */
+	/*-------------------------------------------------------------------*/
+	for (b = 0; b < pipe.depth; b++) {
+		if (fill_src(&pipe, b, pimage) < 0 || queue_frame(&pipe, b) < 0)
+			goto out;
+	}
+
+	/* timed from the end of the warm-up : queues full, pages pinned */
+	warm = pipe.depth * TUNE_WARMUP_NUM;
+	for (;;) {
+		b = dequeue_frame(&pipe);
+		if (b < 0)
+			goto out;
+		if (read_dst(&pipe, b, &prun->hash) < 0)
+			goto out;
+
+		t = get_time_us();
+		lat = t - pipe.t_queue[b];
+		if (++done == warm) {
+			t_start = t;
+		} else if (done > warm) {
+			prun->frames++;
+			prun->lat_sum += lat;
+			if (lat > prun->lat_max)
+				prun->lat_max = lat;
+			if ((prun->frames >= TUNE_FRAME_MIN &&
+			     t - t_start >= burst_us) ||
+			    prun->frames >= TUNE_FRAME_MAX)
+				break;
+		}
+
+		if (fill_src(&pipe, b, pimage) < 0 || queue_frame(&pipe, b) < 0)
+			goto out;
+	}
+	prun->elapsed	= get_time_us() - t_start;
+	prun->ok	= prun->elapsed > 0;
+	ret = 0;
+
+out:
+	close_pipe(&pipe);
+	vsp2_trace_end();
+	return ret;
+}
+
+static int open_pipe(struct tune_pipe *pp)
+{
+	struct v4l2_format		fmt;
+	struct v4l2_requestbuffers	req_buf;
+	int				b;
+
+	pp->src_fd = -1;
+	pp->dst_fd = -1;
+	for (b = 0; b < TUNE_DEPTH_MAX; b++) {
+		pp->src[b].dmafd = -1;
+		pp->dst[b].dmafd = -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Open device, DQBUF waits for the frame                           */
+	/*-------------------------------------------------------------------*/
+	pp->src_fd = open_video_device(ptune_media, SRC_INPUT_DEV, O_RDWR);
+	if (pp->src_fd == -1) {
+		printf("Error open src device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+	pp->dst_fd = open_video_device(ptune_media, DST_OUTPUT_DEV, O_RDWR);
+	if (pp->dst_fd == -1) {
+		printf("Error open dst device: %s (%d).\n",
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_S_FMT                                                     */
+	/*-------------------------------------------------------------------*/
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= src_width;
+	fmt.fmt.pix_mp.height		= src_height;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+
+	if (ioctl(pp->src_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= dst_width;
+	fmt.fmt.pix_mp.height		= dst_height;
+	memset(fmt.fmt.pix_mp.plane_fmt, 0, sizeof(fmt.fmt.pix_mp.plane_fmt));
+
+	if (ioctl(pp->dst_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (alloc)                                           */
+	/*-------------------------------------------------------------------*/
+	if (pp->memory == V4L2_MEMORY_USERPTR) {
+		/* each buffer keeps its index, pinned once */
+		pp->psrc_u = vsp2_userptr_new(pp->src_fd,
+					      V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+					      pp->depth);
+		pp->pdst_u = vsp2_userptr_new(pp->dst_fd,
+					      V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
+					      pp->depth);
+		if (pp->psrc_u == NULL || pp->pdst_u == NULL) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	} else {
+		memset(&req_buf, 0, sizeof(req_buf));
+		req_buf.count	= pp->depth;
+		req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		req_buf.memory	= pp->memory;
+		if (ioctl(pp->src_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+		    (int)req_buf.count != pp->depth) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		req_buf.count	= pp->depth;
+		req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pp->dst_fd, VIDIOC_REQBUFS, &req_buf) < 0 ||
+		    (int)req_buf.count != pp->depth) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	}
+
+	for (b = 0; b < pp->depth; b++) {
+		if (alloc_buf(pp, &pp->src[b],
+			      V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, b,
+			      src_size) < 0 ||
+		    alloc_buf(pp, &pp->dst[b],
+			      V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, b,
+			      dst_size) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static void close_pipe(struct tune_pipe *pp)
+{
+	struct v4l2_requestbuffers	req_buf;
+	unsigned int			type;
+	int				b;
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMOFF : the frames still in flight come back          */
+	/*-------------------------------------------------------------------*/
+	if (pp->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(pp->src_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pp->dst_fd, VIDIOC_STREAMOFF, &type) < 0)
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		pp->streaming = false;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_REQBUFS (release) before the memory goes                  */
+	/*-------------------------------------------------------------------*/
+	vsp2_userptr_free(pp->psrc_u);
+	vsp2_userptr_free(pp->pdst_u);
+	pp->psrc_u = NULL;
+	pp->pdst_u = NULL;
+
+	if (pp->memory != V4L2_MEMORY_USERPTR) {
+		memset(&req_buf, 0, sizeof(req_buf));
+		req_buf.count	= 0;		/* Release buffers */
+		req_buf.memory	= pp->memory;
+		req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (pp->src_fd != -1)
+			ioctl(pp->src_fd, VIDIOC_REQBUFS, &req_buf);
+		req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (pp->dst_fd != -1)
+			ioctl(pp->dst_fd, VIDIOC_REQBUFS, &req_buf);
+	}
+
+	for (b = 0; b < TUNE_DEPTH_MAX; b++) {
+		free_buf(pp, &pp->src[b], src_size);
+		free_buf(pp, &pp->dst[b], dst_size);
+	}
+
+	if (pp->src_fd != -1)
+		close(pp->src_fd);
+	if (pp->dst_fd != -1)
+		close(pp->dst_fd);
+	pp->src_fd = -1;
+	pp->dst_fd = -1;
+}
+
+static int alloc_buf(struct tune_pipe *pp, struct tune_buf *pbuf,
+		     unsigned int type, int index, unsigned int size)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	unsigned long		phys, hard, virt;
+	int			fd;
+	int			ret;
+
+	/*-------------------------------------------------------------------*/
+	/*  MMAP : VIDIOC_QUERYBUF / Mmap                                    */
+	/*-------------------------------------------------------------------*/
+	if (pp->memory == V4L2_MEMORY_MMAP) {
+		fd = type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE ?
+		     pp->src_fd : pp->dst_fd;
+
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.index	= index;
+		buf.type	= type;
+		buf.memory	= V4L2_MEMORY_MMAP;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.m.planes	= planes;
+		if (ioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pbuf->pvirt = mmap(0, size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, fd, planes[0].m.mem_offset);
+		if (pbuf->pvirt == MAP_FAILED) {
+			printf("Error(%d) : mmap\n", __LINE__);
+			pbuf->pvirt = NULL;
+			return -1;
+		}
+		return 0;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  USERPTR / DMABUF : mmngr, exported for dmabuf                    */
+	/*-------------------------------------------------------------------*/
+	ret = mmngr_alloc_in_user(&pbuf->id, size, &phys, &hard, &virt,
+				  MMNGR_VA_SUPPORT);
+	if (ret != 0) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		return -1;
+	}
+	pbuf->pvirt = (unsigned char *)virt;
+
+	if (pp->memory == V4L2_MEMORY_DMABUF) {
+		ret = mmngr_export_start_in_user(&pbuf->mbid, size, hard,
+						 &pbuf->dmafd);
+		if (ret != 0) {
+			printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+			pbuf->dmafd = -1;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void free_buf(struct tune_pipe *pp, struct tune_buf *pbuf,
+		     unsigned int size)
+{
+	if (pbuf->pvirt == NULL)
+		return;
+
+	if (pp->memory == V4L2_MEMORY_MMAP) {
+		munmap(pbuf->pvirt, size);
+	} else {
+		if (pbuf->dmafd >= 0)
+			mmngr_export_end_in_user(pbuf->mbid);
+		mmngr_free_in_user(pbuf->id);
+	}
+	pbuf->pvirt = NULL;
+	pbuf->dmafd = -1;
+}
+
+static int fill_src(struct tune_pipe *pp, int b, const unsigned char *pimage)
+{
+	int	dmafd = pp->src[b].dmafd;
+
+	if (dmafd >= 0 && vsp2_sync_begin(dmafd, VSP2_SYNC_WRITE) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	memcpy(pp->src[b].pvirt, pimage, src_size);
+	if (dmafd >= 0 && vsp2_sync_end(dmafd, VSP2_SYNC_WRITE) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int read_dst(struct tune_pipe *pp, int b, unsigned long long *phash)
+{
+	int	dmafd = pp->dst[b].dmafd;
+
+	if (dmafd >= 0 && vsp2_sync_begin(dmafd, VSP2_SYNC_READ) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	*phash = calc_hash(pp->dst[b].pvirt, dst_size);
+	if (dmafd >= 0 && vsp2_sync_end(dmafd, VSP2_SYNC_READ) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int queue_frame(struct tune_pipe *pp, int b)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	unsigned int		type;
+
+	pp->t_queue[b] = get_time_us();
+
+	if (pp->memory == V4L2_MEMORY_USERPTR) {
+		if (vsp2_userptr_qbuf(pp->pdst_u, pp->dst[b].pvirt, dst_size,
+				      dst_size) < 0 ||
+		    vsp2_userptr_qbuf(pp->psrc_u, pp->src[b].pvirt, src_size,
+				      src_size) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	} else {
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.index	= b;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.memory	= pp->memory;
+		buf.length	= 1;
+		buf.m.planes[0].bytesused	= dst_size;
+		if (pp->memory == V4L2_MEMORY_DMABUF) {
+			buf.m.planes[0].m.fd	= pp->dst[b].dmafd;
+			buf.m.planes[0].length	= dst_size;
+		}
+		if (ioctl(pp->dst_fd, VIDIOC_QBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.index	= b;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.memory	= pp->memory;
+		buf.length	= 1;
+		buf.bytesused	= src_size;
+		buf.m.planes[0].bytesused	= src_size;
+		if (pp->memory == V4L2_MEMORY_DMABUF) {
+			buf.m.planes[0].m.fd	= pp->src[b].dmafd;
+			buf.m.planes[0].length	= src_size;
+		}
+		if (ioctl(pp->src_fd, VIDIOC_QBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  VIDIOC_STREAMON (with the first frame)                           */
+	/*-------------------------------------------------------------------*/
+	if (!pp->streaming) {
+		type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		if (ioctl(pp->src_fd, VIDIOC_STREAMON, &type) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+
+		type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(pp->dst_fd, VIDIOC_STREAMON, &type) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		pp->streaming = true;
+	}
+	return 0;
+}
+
+/* buffer of the finished frame, or -1 */
+static int dequeue_frame(struct tune_pipe *pp)
+{
+	struct v4l2_buffer	buf;
+	struct v4l2_plane	planes[VIDEO_MAX_PLANES];
+	void			*paddr;
+	int			b;
+
+	if (pp->memory == V4L2_MEMORY_USERPTR) {
+		paddr = vsp2_userptr_dqbuf(pp->pdst_u, NULL);
+		if (paddr == NULL || vsp2_userptr_dqbuf(pp->psrc_u,
+							NULL) == NULL) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			return -1;
+		}
+		for (b = 0; b < pp->depth; b++) {
+			if (pp->dst[b].pvirt == paddr)
+				return b;
+		}
+		printf("error line=%d unknown buffer\n", __LINE__);
+		return -1;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	buf.memory	= pp->memory;
+	buf.length	= VIDEO_MAX_PLANES;
+	if (ioctl(pp->dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	b = buf.index;
+
+	/* the source of a finished frame is done as well */
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.m.planes	= planes;
+	buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	buf.memory	= pp->memory;
+	buf.length	= VIDEO_MAX_PLANES;
+	if (ioctl(pp->src_fd, VIDIOC_DQBUF, &buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if (b < 0 || b >= pp->depth) {
+		printf("error line=%d index=%d\n", __LINE__, b);
+		return -1;
+	}
+	return b;
+}
+
+/* fastest; a deeper queue only when clearly so, a shallower one when
+ * close enough */
+static int pick_best(const struct tune_run *prun, int run_num)
+{
+	double	fps, best_fps = 0;
+	int	best = -1;
+	int	i;
+
+	for (i = 0; i < run_num; i++) {
+		if (!prun[i].ok)
+			continue;
+		fps = prun[i].frames * 1e6 / prun[i].elapsed;
+		if (best < 0 ||
+		    (prun[i].depth > prun[best].depth &&
+		     fps * 100 > best_fps * (100 + TUNE_MARGIN_PCT)) ||
+		    (prun[i].depth == prun[best].depth && fps > best_fps) ||
+		    (prun[i].depth < prun[best].depth &&
+		     fps * (100 + TUNE_MARGIN_PCT) > best_fps * 100)) {
+			best = i;
+			best_fps = fps;
+		}
+	}
+	return best;
+}
+
+static void print_tune_stat(const struct tune_run *prun, int run_num,
+			    int best)
+{
+	const struct tune_run	*pr;
+	bool			same = true;
+	int			first = -1;
+	int			i;
+
+	printf("\n----- TUNE %s %ux%u -> %ux%u on %s -----\n", tune_key,
+	       src_width, src_height, dst_width, dst_height,
+	       vsp2_media_bus_name(ptune_media));
+	printf("%-8s %5s %7s %9s %11s %9s\n", "memory", "depth", "frames",
+	       "fps", "latency ms", "max ms");
+	for (i = 0; i < run_num; i++) {
+		pr = &prun[i];
+		if (!pr->ok) {
+			printf("%-8s %5d %7s\n",
+			       vsp2_profile_memory_name(pr->memory), pr->depth,
+			       "failed");
+			continue;
+		}
+		printf("%-8s %5d %7d %9.1f %11.2f %9.2f%s\n",
+		       vsp2_profile_memory_name(pr->memory), pr->depth,
+		       pr->frames, pr->frames * 1e6 / pr->elapsed,
+		       pr->lat_sum / 1000.0 / pr->frames,
+		       pr->lat_max / 1000.0, i == best ? "  <-" : "");
+		if (first < 0)
+			first = i;
+		else if (pr->hash != prun[first].hash)
+			same = false;
+	}
+	printf("output   : %s\n", same ? "same" : "MISMATCH");
+	if (best >= 0)
+		printf("winner   : %s, depth %d\n",
+		       vsp2_profile_memory_name(prun[best].memory),
+		       prun[best].depth);
+	printf("----------------------\n");
+}
+
+/******************************************************************************
+ *  internal function
+ ******************************************************************************/
+static int call_media_ctl(struct vsp2_media *pmedia)
+{
+	struct v4l2_mbus_framefmt	format;
+	const char			*pentity = ptune_mod->pentity;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
+		return -1;
+	}
+
+	/*----------------------------------*/
+	/* rpf.0:1 -> [module] -> wpf.0:0   */
+	/*----------------------------------*/
+	if (pentity == NULL) {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> wpf)\n");
+			return -1;
+		}
+	} else {
+		if (vsp2_media_setup_link(pmedia, "rpf.0", 1, pentity, 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(rpf -> %s)\n",
+			       pentity);
+			return -1;
+		}
+		if (vsp2_media_setup_link(pmedia, pentity, 1, "wpf.0", 0,
+					  true) != 0) {
+			printf("Error : vsp2_media_setup_link(%s -> wpf)\n",
+			       pentity);
+			return -1;
+		}
+	}
+
+	/*----------------------------------*/
+	/* wpf.0:1 -> wpf.0 output          */
+	/*----------------------------------*/
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
+		return -1;
+	}
+
+	/*----------------------------------------------------- set format */
+	format.width	= src_width;
+	format.height	= src_height;
+	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0 ||
+	    (pentity != NULL &&
+	     vsp2_media_set_format(pmedia, pentity, 0, &format) != 0)) {
+		printf("Error : vsp2_media_set_format(%ux%u)\n", src_width,
+		       src_height);
+		return -1;
+	}
+
+	format.width	= dst_width;
+	format.height	= dst_height;
+	if ((pentity != NULL &&
+	     vsp2_media_set_format(pmedia, pentity, 1, &format) != 0) ||
+	    vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0 ||
+	    vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(%ux%u)\n", dst_width,
+		       dst_height);
+		return -1;
+	}
+	return 0;
+}
+
+/* negative for lut, sepia for clu, nothing for the others */
+static int set_table(struct vsp2_media *pmedia)
+{
+	struct vsp2_lut_config	lut_par;
+	struct vsp2_clu_config	clu_par;
+	unsigned int		*ptbl;
+	unsigned long		phys, hard;
+	bool			lut;
+	int			fd;
+	int			ret;
+	int			r, g, b;
+	int			i;
+
+	lut = (strcmp(ptune_mod->pname, "lut") == 0);
+	if (!lut && strcmp(ptune_mod->pname, "clu") != 0)
+		return 0;
+
+	ret = vsp2_mem_alloc(VSP2_MEM_TABLE, &tbl_id,
+			     (lut ? LUT_TBL_NUM : CLU_TBL_NUM) * 8, &phys,
+			     &hard, &tbl_virt, MMNGR_VA_SUPPORT);
+	if (ret != 0) {
+		printf("Error : mmngr_alloc_in_user()\n");
+		tbl_virt = 0;
+		return -1;
+	}
+
+	ptbl = (unsigned int *)tbl_virt;
+	if (lut) {
+		for (i = 0; i < LUT_TBL_NUM; i++) {
+			ptbl[i*2]	= LUT_REG_ADDR + i*4;
+			ptbl[i*2+1]	= (255 - i) << 16
+					| (255 - i) << 8
+					| (255 - i);
+		}
+	} else {
+		for (b = 0; b < CLU_GRID; b++) {
+			for (g = 0; g < CLU_GRID; g++) {
+				for (r = 0; r < CLU_GRID; r++) {
+					i = (r * 77 + g * 150 + b * 29) *
+					    255 / 16 / 256;
+					*ptbl++ = CLU_REG_DATA;
+					*ptbl++ = (i * 240 / 255 + 15) << 16
+						| (i * 200 / 255 + 10) << 8
+						| (i * 145 / 255);
+				}
+			}
+		}
+	}
+
+	fd = open_video_device(pmedia, ptune_mod->pentity, O_RDWR);
+	if (fd == -1) {
+		printf("Error open %s device: %s (%d).\n",
+		       ptune_mod->pentity, strerror(errno), errno);
+		return -1;
+	}
+
+	if (lut) {
+		memset(&lut_par, 0, sizeof(lut_par));
+		lut_par.addr	= (void *)tbl_virt;
+		lut_par.tbl_num	= LUT_TBL_NUM;
+		lut_par.fxa	= 0x80;
+		ret = ioctl(fd, VIDIOC_VSP2_LUT_CONFIG, &lut_par);
+	} else {
+		memset(&clu_par, 0, sizeof(clu_par));
+		clu_par.mode	= 0x80;		/* VSP_CLU_MODE_3D_AUTO */
+		clu_par.addr	= (void *)tbl_virt;
+		clu_par.tbl_num	= CLU_TBL_NUM;
+		ret = ioctl(fd, VIDIOC_VSP2_CLU_CONFIG, &clu_par);
+	}
+	close(fd);
+
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	return 0;
+}
+
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity,
+			     int flags)
+{
+	int fd;
+
+	fd = vsp2_media_open_node(pmedia, pentity, flags);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
+
+	return fd;
+}
+
+/* gradients, opaque : any size, no input file */
+static void make_image(unsigned char *pimage)
+{
+	unsigned int	x, y;
+	unsigned char	*p = pimage;
+
+	vsp2_trace_begin("make image");
+	for (y = 0; y < src_height; y++) {
+		for (x = 0; x < src_width; x++) {
+			*p++ = 0xff;				/* A */
+			*p++ = x * 255 / src_width;		/* R */
+			*p++ = y * 255 / src_height;		/* G */
+			*p++ = (x + y) & 0xff;			/* B */
+		}
+	}
+	vsp2_trace_end();
+}
+
+static unsigned long long calc_hash(const void *pdata, size_t len)
+{
+	const unsigned long long	*p = pdata;
+	unsigned long long		hash = 0xcbf29ce484222325ULL;
+
+	/* FNV-1a on 64-bit words, a tail under a word is left out */
+	for (len /= sizeof(*p); len > 0; len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -15,6 +15,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
@@ -24,6 +25,13 @@
 #include "mmngr_user_public.h"
 #include "mmngr_buf_user_public.h"
 
+#include "vsp2_media.h"
+#include "vsp2_mem.h"
+#include "vsp2_profile.h"
+#include "vsp2_sync.h"
+#include "vsp2_trace.h"
+#include "vsp2_userptr.h"
+
 /******************************************************************************
  *  macros
  ******************************************************************************/
@@ -36,8 +44,8 @@
 #define MEDIA_DEV_NAME		"/dev/media2"		/* fe9a0000.vsp */
 #endif
 
-#define SRC_INPUT_DEV		"%s rpf.0 input"
-#define DST_OUTPUT_DEV		"%s wpf.0 output"
+#define SRC_INPUT_DEV		"rpf.0 input"
+#define DST_OUTPUT_DEV		"wpf.0 output"
 
 /* source parameter */
 #define SRC_FILENAME		"1280_720_ARGB32.argb"
@@ -53,25 +61,85 @@
 #define DST_HEIGHT		(1080)			/* dst: height */
 #define DST_SIZE		(DST_WIDTH*DST_HEIGHT*4)
 
+/* userptr stream parameter */
+#define STREAM_POOL_NUM		(4)		/* buffers the frames cycle */
+#define STREAM_DEPTH		(2)		/* frames in flight */
+
 /******************************************************************************
  *  structure
  ******************************************************************************/
-struct dev_pads {
-	struct media_pad	*ppad0;
-	struct media_pad	*ppad1;
+struct userptr_stat {
+	bool		huge;
+	long long	alloc_us;
+	long long	pin_src_us;	/* first QBUF of each buffer */
+	long long	pin_dst_us;
+	long long	qbuf_us;	/* later QBUFs, src + dst */
+	long long	fill_first_us;	/* first touch of the source */
+	long long	fill_us;
+	long long	read_us;
+	long		backed_kib;	/* on huge pages, -1 : not known */
+	unsigned long long	hash;
 };
 
+struct sync_stat {
+	bool		cached;
+	long long	fill_us;	/* source written by the CPU */
+	long long	read_us;	/* output read by the CPU */
+	long long	sync_us;	/* begin + end, both buffers */
+	long long	lat_sum;	/* fill start -> output read */
+	long long	lat_max;
+	unsigned long long	hash;
+};
+
+struct stream_stat {
+	int				index_num;
+	long long			total_us;
+	struct vsp2_userptr_stat	src;
+	struct vsp2_userptr_stat	dst;
+	unsigned long long		hash;
+};
+
+/******************************************************************************
+ *  global
+ ******************************************************************************/
+static bool			use_hugepage;
+static enum vsp2_mem_huge_kind	huge_kind;
+
 /******************************************************************************
  *  internal function
  ******************************************************************************/
 static int	test_uds_mmap(void);
 static int	test_uds_userptr(void);
 static int	test_uds_dmabuf(void);
+static int	test_uds_userptr_bench(int frame_num);
+static int	run_userptr_bench(struct userptr_stat *pstat,
+				  const unsigned char *pimage, int frame_num);
+static void	print_userptr_stat(const struct userptr_stat *pstat,
+				   int frame_num);
+static int	test_uds_userptr_stream(int frame_num);
+static int	run_userptr_stream(struct stream_stat *pstat,
+				   const unsigned char *pimage, int frame_num);
+static void	print_stream_stat(const struct stream_stat *pstat,
+				  int frame_num);
+static int	test_uds_dmabuf_bench(int frame_num);
+static int	run_dmabuf_bench(struct sync_stat *pstat,
+				 const unsigned char *pimage, int frame_num);
+static void	print_sync_stat(const struct sync_stat *pstat, int run_num,
+				int frame_num);
+static int	open_pipe(struct vsp2_media **ppmedia, int *psrc_fd,
+			  int *pdst_fd);
+static unsigned char	*alloc_userptr(MMNGR_ID *pid, unsigned long size,
+				       bool huge);
+static int	free_userptr(MMNGR_ID id, unsigned char *pbuf,
+			     unsigned long size, bool huge);
+static unsigned long long	calc_hash(const void *pdata, size_t len);
+static int	profile_mem_type(void);
+static long long	get_time_us(void);
 static int	read_file(unsigned char*, unsigned int, const char*);
 static int	write_file(unsigned char*, unsigned int, const char*);
-static int	call_media_ctl(struct media_device **, const char **);
-static int	open_video_device(struct media_device *pmedia,
-				  char *pentity_base, const char *pmedia_name);
+static int	call_media_ctl(struct vsp2_media **);
+static int	open_video_device(struct vsp2_media *pmedia,
+				  const char *pentity);
 
 /******************************************************************************
  *  main
@@ -87,9 +155,18 @@ void print_usage(const char *pname)
 	printf("----------------------------------\n");
 	printf(" Usage : %s [option]\n", pname);
 	printf("    option\n");
-	printf("        -m: use MMAP [default]\n");
+	printf("        -m: use MMAP [default, unless tuned]\n");
 	printf("        -u: use USERPTR\n");
 	printf("        -d: use DMABUF\n");
+	printf("        -H: USERPTR buffers on 2 MiB hugepages (with -u)\n");
+	printf("        -b <n>: USERPTR pin, fill and read cost over <n> frames,\n");
+	printf("                mmngr against hugepage buffers\n");
+	printf("        -r <n>: USERPTR stream of <n> frames over %d buffers,\n",
+	       STREAM_POOL_NUM);
+	printf("                %d indexes against one per buffer\n",
+	       STREAM_DEPTH);
+	printf("        -s <n>: DMABUF fill, read and latency over <n> frames,\n");
+	printf("                uncached against cached, CPU access synced\n");
 	printf("        -h: print usage\n");
 	printf("----------------------------------\n");
 }
@@ -97,28 +174,81 @@ void print_usage(const char *pname)
 int main(int argc, char *argv[])
 {
 	int opt;
-
-	opt = getopt(argc, argv, "mudh");
-
-	switch (opt) {
+	int mem_type = 0;
+	int bench_num = 0;
+	int stream_num = 0;
+	int sync_num = 0;
+
+	vsp2_trace_begin("run");
+
+	while ((opt = getopt(argc, argv, "mudHb:r:s:h")) != -1) {
+		switch (opt) {
+		case 'm':
+		case 'u':
+		case 'd':
+			mem_type = opt;
+			break;
+		case 'H':
+			use_hugepage = true;
+			break;
+		case 'b':
+			bench_num = atoi(optarg);
+			break;
+		case 'r':
+			stream_num = atoi(optarg);
+			break;
+		case 's':
+			sync_num = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	if (bench_num > 0) {
+		printf("exec USERPTR BENCH (%d frames)\n", bench_num);
+		test_uds_userptr_bench(bench_num);
+		exit(0);
+	}
+
+	if (stream_num > 0) {
+		printf("exec USERPTR STREAM (%d frames)\n", stream_num);
+		test_uds_userptr_stream(stream_num);
+		exit(0);
+	}
+
+	if (sync_num > 0) {
+		printf("exec DMABUF SYNC BENCH (%d frames)\n", sync_num);
+		test_uds_dmabuf_bench(sync_num);
+		exit(0);
+	}
+
+	/* none given : the one tune found fastest on this VSP, if any */
+	if (mem_type == 0)
+		mem_type = profile_mem_type();
+
+	switch (mem_type) {
 	case 'm':
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("uds mmap");
 		test_uds_mmap();
 		break;
 	case 'u':
-		printf("exec USERPTR\n");
+		printf("exec USERPTR%s\n", use_hugepage ? " (hugepage)" : "");
+		vsp2_mem_pipeline("uds userptr");
 		test_uds_userptr();
 		break;
 	case 'd':
 		printf("exec DMABUF\n");
+		vsp2_mem_pipeline("uds dmabuf");
 		test_uds_dmabuf();
 		break;
-	case 'h':
-		print_usage(argv[0]);
-		break;
 	default:
 		print_usage(argv[0]);
 		printf("exec MMAP\n");
+		vsp2_mem_pipeline("uds mmap");
 		test_uds_mmap();
 		break;
 	}
@@ -131,7 +261,7 @@ int main(int argc, char *argv[])
  ******************************************************************************/
 static int test_uds_mmap(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -151,12 +281,12 @@ static int test_uds_mmap(void)
 	unsigned int        caps;
 	struct v4l2_format  gfmt;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -166,7 +296,7 @@ static int test_uds_mmap(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -174,7 +304,7 @@ static int test_uds_mmap(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -562,7 +692,7 @@ static int test_uds_mmap(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -572,7 +702,7 @@ static int test_uds_mmap(void)
  ******************************************************************************/
 static int test_uds_userptr(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -593,21 +723,14 @@ static int test_uds_userptr(void)
 	struct v4l2_format  gfmt;
 
 	MMNGR_ID	srcfd;
-	unsigned long	src_phys;
-	unsigned long	src_hard;
-	unsigned long	src_virt;
-
 	MMNGR_ID	dstfd;
-	unsigned long	dst_phys;
-	unsigned long	dst_hard;
-	unsigned long	dst_virt;
-
-	const char *pmedia_name;
 
 	/*-------------------------------------------------------------------*/
 	/*  Call media-ctl                                                   */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -617,7 +740,7 @@ static int test_uds_userptr(void)
 	/*  Open device                                                      */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -625,7 +748,7 @@ static int test_uds_userptr(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -724,16 +847,13 @@ static int test_uds_userptr(void)
 	}
 
 	/*-------------------------------------------------------------------*/
-	/*  Allocate memory by mmngr                                         */
+	/*  Allocate memory by mmngr, or on hugepages                        */
 	/*-------------------------------------------------------------------*/
-	ret = mmngr_alloc_in_user(
-		&srcfd, SRC_SIZE,
-		&src_phys, &src_hard, &src_virt, MMNGR_VA_SUPPORT);
-	if (ret) {
-		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+	psrc_buf = alloc_userptr(&srcfd, SRC_SIZE, use_hugepage);
+	if (psrc_buf == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	psrc_buf = (void *)src_virt;
 
 	/*-------------------------------------------------------------------*/
 	/*  Read file                                                        */
@@ -836,16 +956,13 @@ static int test_uds_userptr(void)
 	}
 
 	/*-------------------------------------------------------------------*/
-	/*  Allocate memory by mmngr                                         */
+	/*  Allocate memory by mmngr, or on hugepages                        */
 	/*-------------------------------------------------------------------*/
-	ret = mmngr_alloc_in_user(
-		&dstfd, DST_SIZE,
-		&dst_phys, &dst_hard, &dst_virt, MMNGR_VA_SUPPORT);
-	if (ret) {
-		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+	pdst_buf = alloc_userptr(&dstfd, DST_SIZE, use_hugepage);
+	if (pdst_buf == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
-	pdst_buf = (void *)dst_virt;
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -949,7 +1066,7 @@ static int test_uds_userptr(void)
 	/*-------------------------------------------------------------------*/
 	/*  Free buffer                                                      */
 	/*-------------------------------------------------------------------*/
-	ret = mmngr_free_in_user(srcfd);
+	ret = free_userptr(srcfd, psrc_buf, SRC_SIZE, use_hugepage);
 	if (ret < 0) {
 		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
 		return -1;
@@ -984,7 +1101,7 @@ static int test_uds_userptr(void)
 	/*-------------------------------------------------------------------*/
 	/*  Free buffer                                                      */
 	/*-------------------------------------------------------------------*/
-	ret = mmngr_free_in_user(dstfd);
+	ret = free_userptr(dstfd, pdst_buf, DST_SIZE, use_hugepage);
 	if (ret < 0) {
 		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
 		return -1;
@@ -993,17 +1110,715 @@ static int test_uds_userptr(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
 
+/******************************************************************************
+ *  userptr benchmark : mmngr against hugepage buffers
+ ******************************************************************************/
+static int test_uds_userptr_bench(int frame_num)
+{
+	struct userptr_stat	stat[2];
+	unsigned char		*pimage;
+	int			i, ret = 0;
+
+	pimage = malloc(SRC_SIZE);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if (read_file(pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		free(pimage);
+		return -1;
+	}
+
+	memset(stat, 0, sizeof(stat));
+	for (i = 0; i < 2 && ret == 0; i++) {
+		stat[i].huge = (i == 1);
+		ret = run_userptr_bench(&stat[i], pimage, frame_num);
+	}
+	if (ret == 0)
+		print_userptr_stat(stat, frame_num);
+
+	free(pimage);
+	return ret;
+}
+
+static int run_userptr_bench(struct userptr_stat *pstat,
+			     const unsigned char *pimage, int frame_num)
+{
+	struct vsp2_media		*pmedia = NULL;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	unsigned char			*psrc_buf = NULL;
+	unsigned char			*pdst_buf = NULL;
+	MMNGR_ID			srcfd = 0, dstfd = 0;
+	unsigned int			type;
+	long long			t, t_src, t_dst;
+	int				src_fd = -1;
+	int				dst_fd = -1;
+	int				ret = -1;
+	int				f;
+
+	vsp2_mem_pipeline(pstat->huge ? "uds userptr huge" :
+					"uds userptr mmngr");
+
+	/*-------------------------------------------------------------------*/
+	/*  Pipeline, one USERPTR buffer per queue                           */
+	/*-------------------------------------------------------------------*/
+	if (open_pipe(&pmedia, &src_fd, &dst_fd) < 0)
+		goto out;
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 1;
+	req_buf.memory	= V4L2_MEMORY_USERPTR;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (ioctl(src_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+	req_buf.count	= 1;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	t = get_time_us();
+	psrc_buf = alloc_userptr(&srcfd, SRC_SIZE, pstat->huge);
+	pdst_buf = alloc_userptr(&dstfd, DST_SIZE, pstat->huge);
+	pstat->alloc_us = get_time_us() - t;
+	if (psrc_buf == NULL || pdst_buf == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Frames : fill, QBUF, wait, read                                  */
+	/*-------------------------------------------------------------------*/
+	for (f = 0; f < frame_num; f++) {
+		/* the first fill faults the pages in */
+		t = get_time_us();
+		memcpy(psrc_buf, pimage, SRC_SIZE);
+		t = get_time_us() - t;
+		if (f == 0)
+			pstat->fill_first_us = t;
+		else
+			pstat->fill_us += t;
+
+		/* the first QBUF of an address pins its pages */
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.index	= 0;
+		buf.memory	= V4L2_MEMORY_USERPTR;
+		buf.length	= 1;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.m.planes[0].bytesused	= SRC_SIZE;
+		buf.m.planes[0].length		= SRC_SIZE;
+		buf.m.planes[0].m.userptr	= (unsigned long)psrc_buf;
+		buf.bytesused			= SRC_SIZE;
+		t = get_time_us();
+		ret = ioctl(src_fd, VIDIOC_QBUF, &buf);
+		t_src = get_time_us() - t;
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.bytesused	= 0;
+		buf.m.planes[0].bytesused	= DST_SIZE;
+		buf.m.planes[0].length		= DST_SIZE;
+		buf.m.planes[0].m.userptr	= (unsigned long)pdst_buf;
+		t = get_time_us();
+		ret = ioctl(dst_fd, VIDIOC_QBUF, &buf);
+		t_dst = get_time_us() - t;
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		if (f == 0) {
+			pstat->pin_src_us = t_src;
+			pstat->pin_dst_us = t_dst;
+
+			type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+			ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+			type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+			if (ret == 0)
+				ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n",
+				       __LINE__, errno);
+				goto out;
+			}
+		} else {
+			pstat->qbuf_us += t_src + t_dst;
+		}
+
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.memory	= V4L2_MEMORY_USERPTR;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		ret = ioctl(dst_fd, VIDIOC_DQBUF, &buf);
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		if (ret == 0)
+			ret = ioctl(src_fd, VIDIOC_DQBUF, &buf);
+		if (ret < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+
+		t = get_time_us();
+		pstat->hash = calc_hash(pdst_buf, DST_SIZE);
+		pstat->read_us += get_time_us() - t;
+	}
+
+	if (pstat->huge) {
+		pstat->backed_kib = vsp2_mem_huge_backed(psrc_buf, SRC_SIZE);
+		if (pstat->backed_kib >= 0)
+			pstat->backed_kib += vsp2_mem_huge_backed(pdst_buf,
+								  DST_SIZE);
+	}
+	ret = 0;
+
+out:
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (src_fd >= 0)
+		ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (dst_fd >= 0)
+		ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+
+	/* the driver lets go of the pages before they are freed */
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.memory	= V4L2_MEMORY_USERPTR;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (src_fd >= 0)
+		ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (dst_fd >= 0)
+		ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+
+	if (psrc_buf != NULL)
+		free_userptr(srcfd, psrc_buf, SRC_SIZE, pstat->huge);
+	if (pdst_buf != NULL)
+		free_userptr(dstfd, pdst_buf, DST_SIZE, pstat->huge);
+	if (src_fd >= 0)
+		close(src_fd);
+	if (dst_fd >= 0)
+		close(dst_fd);
+	vsp2_media_close(pmedia);
+	return ret;
+}
+
+static void print_userptr_stat(const struct userptr_stat *pstat,
+			       int frame_num)
+{
+	const char	*pname[2] = { "mmngr", "hugepage" };
+	double		n = frame_num > 1 ? frame_num - 1 : 1;
+	int		i;
+
+	printf("\n----- USERPTR %d frames -----\n", frame_num);
+	printf("%-9s %8s %10s %10s %10s %10s %10s %9s\n", "buffers",
+	       "alloc ms", "pin src us", "pin dst us", "qbuf us",
+	       "1st MB/s", "fill MB/s", "read MB/s");
+	for (i = 0; i < 2; i++) {
+		printf("%-9s %8.2f %10lld %10lld %10.1f %10.0f %10.0f %9.0f\n",
+		       pname[i], pstat[i].alloc_us / 1000.0,
+		       pstat[i].pin_src_us, pstat[i].pin_dst_us,
+		       pstat[i].qbuf_us / n,
+		       pstat[i].fill_first_us ?
+				SRC_SIZE / (double)pstat[i].fill_first_us : 0,
+		       pstat[i].fill_us ?
+				SRC_SIZE * n / pstat[i].fill_us : 0,
+		       pstat[i].read_us ?
+				DST_SIZE * (double)frame_num /
+				pstat[i].read_us : 0);
+	}
+	if (pstat[1].backed_kib >= 0)
+		printf("hugepage  : %ld of %lu KiB on huge pages (%s)\n",
+		       pstat[1].backed_kib,
+		       (unsigned long)(SRC_SIZE + DST_SIZE) / 1024,
+		       huge_kind == VSP2_MEM_HUGE_TLB ? "hugetlbfs" : "THP");
+	printf("output    : %s\n", pstat[0].hash == pstat[1].hash ?
+	       "same" : "MISMATCH");
+	printf("----------------------\n");
+}
+
+/******************************************************************************
+ *  userptr stream : a pool of buffers through few or stable indexes
+ ******************************************************************************/
+static int test_uds_userptr_stream(int frame_num)
+{
+	struct stream_stat	stat[2];
+	unsigned char		*pimage;
+	int			i, ret = 0;
+
+	pimage = malloc(SRC_SIZE);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if (read_file(pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		free(pimage);
+		return -1;
+	}
+
+	/* one index per frame in flight, then one per buffer of the pool */
+	memset(stat, 0, sizeof(stat));
+	stat[0].index_num = STREAM_DEPTH;
+	stat[1].index_num = STREAM_POOL_NUM;
+	for (i = 0; i < 2 && ret == 0; i++)
+		ret = run_userptr_stream(&stat[i], pimage, frame_num);
+	if (ret == 0)
+		print_stream_stat(stat, frame_num);
+
+	free(pimage);
+	return ret;
+}
+
+static int run_userptr_stream(struct stream_stat *pstat,
+			      const unsigned char *pimage, int frame_num)
+{
+	struct vsp2_media	*pmedia = NULL;
+	struct vsp2_userptr	*psrc_u = NULL;
+	struct vsp2_userptr	*pdst_u = NULL;
+	struct vsp2_userptr_stat ustat;
+	unsigned char		*psrc_buf[STREAM_POOL_NUM];
+	unsigned char		*pdst_buf[STREAM_POOL_NUM];
+	unsigned char		*pdone = NULL;
+	MMNGR_ID		srcfd[STREAM_POOL_NUM];
+	MMNGR_ID		dstfd[STREAM_POOL_NUM];
+	unsigned int		type;
+	long long		t_start;
+	bool			streaming = false;
+	int			src_fd = -1;
+	int			dst_fd = -1;
+	int			next = 0;
+	int			done = 0;
+	int			queued = 0;
+	int			ret = -1;
+	int			b;
+
+	vsp2_mem_pipeline("uds userptr stream");
+	memset(psrc_buf, 0, sizeof(psrc_buf));
+	memset(pdst_buf, 0, sizeof(pdst_buf));
+
+	if (open_pipe(&pmedia, &src_fd, &dst_fd) < 0)
+		goto out;
+
+	psrc_u = vsp2_userptr_new(src_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+				  pstat->index_num);
+	pdst_u = vsp2_userptr_new(dst_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
+				  pstat->index_num);
+	if (psrc_u == NULL || pdst_u == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	for (b = 0; b < STREAM_POOL_NUM; b++) {
+		psrc_buf[b] = alloc_userptr(&srcfd[b], SRC_SIZE, use_hugepage);
+		pdst_buf[b] = alloc_userptr(&dstfd[b], DST_SIZE, use_hugepage);
+		if (psrc_buf[b] == NULL || pdst_buf[b] == NULL) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		memcpy(psrc_buf[b], pimage, SRC_SIZE);
+	}
+
+	/*-------------------------------------------------------------------*/
+	/*  Frames : the pool in turn, STREAM_DEPTH in flight                */
+	/*-------------------------------------------------------------------*/
+	t_start = get_time_us();
+	while (done < frame_num) {
+		while (queued < STREAM_DEPTH && next < frame_num) {
+			b = next % STREAM_POOL_NUM;
+			if (vsp2_userptr_qbuf(psrc_u, psrc_buf[b], SRC_SIZE,
+					      SRC_SIZE) < 0 ||
+			    vsp2_userptr_qbuf(pdst_u, pdst_buf[b], DST_SIZE,
+					      DST_SIZE) < 0) {
+				printf("error line=%d errno=(%d)\n", __LINE__,
+				       errno);
+				goto out;
+			}
+			next++;
+			queued++;
+		}
+
+		if (!streaming) {
+			type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+			ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+			type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+			if (ret == 0)
+				ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n", __LINE__,
+				       errno);
+				ret = -1;
+				goto out;
+			}
+			ret = -1;
+			streaming = true;
+		}
+
+		pdone = vsp2_userptr_dqbuf(pdst_u, NULL);
+		if (pdone == NULL || vsp2_userptr_dqbuf(psrc_u, NULL) == NULL) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		queued--;
+		done++;
+	}
+	pstat->total_us	= get_time_us() - t_start;
+	pstat->hash	= calc_hash(pdone, DST_SIZE);
+
+	vsp2_userptr_stat(psrc_u, &pstat->src);
+	vsp2_userptr_stat(pdst_u, &ustat);
+	pstat->dst = ustat;
+	ret = 0;
+
+out:
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (streaming)
+		ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (streaming)
+		ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+
+	/* unpinned before the pages go */
+	vsp2_userptr_free(psrc_u);
+	vsp2_userptr_free(pdst_u);
+	for (b = 0; b < STREAM_POOL_NUM; b++) {
+		if (psrc_buf[b] != NULL)
+			free_userptr(srcfd[b], psrc_buf[b], SRC_SIZE,
+				     use_hugepage);
+		if (pdst_buf[b] != NULL)
+			free_userptr(dstfd[b], pdst_buf[b], DST_SIZE,
+				     use_hugepage);
+	}
+	if (src_fd >= 0)
+		close(src_fd);
+	if (dst_fd >= 0)
+		close(dst_fd);
+	vsp2_media_close(pmedia);
+	return ret;
+}
+
+static void print_stream_stat(const struct stream_stat *pstat,
+			      int frame_num)
+{
+	const struct vsp2_userptr_stat	*ps;
+	int				i, q;
+
+	printf("\n----- USERPTR STREAM %d frames, %d buffers, %d in flight -----\n",
+	       frame_num, STREAM_POOL_NUM, STREAM_DEPTH);
+	printf("%-8s %-5s %7s %7s %7s %7s %9s %9s\n", "indexes", "queue",
+	       "fps", "qbufs", "hits", "misses", "hit us", "miss us");
+	for (i = 0; i < 2; i++) {
+		for (q = 0; q < 2; q++) {
+			ps = q == 0 ? &pstat[i].src : &pstat[i].dst;
+			printf("%-8d %-5s %7.1f %7llu %7llu %7llu %9.1f %9.1f\n",
+			       pstat[i].index_num, q == 0 ? "src" : "dst",
+			       pstat[i].total_us ? frame_num * 1e6 /
+						   pstat[i].total_us : 0,
+			       ps->qbufs, ps->hits, ps->misses,
+			       ps->hits ? ps->hit_us / (double)ps->hits : 0,
+			       ps->misses ? ps->miss_us /
+					    (double)ps->misses : 0);
+		}
+	}
+	printf("output   : %s\n", pstat[0].hash == pstat[1].hash ?
+	       "same" : "MISMATCH");
+	printf("----------------------\n");
+}
+
+/******************************************************************************
+ *  dmabuf sync benchmark : uncached against cached mmngr buffers
+ ******************************************************************************/
+static int test_uds_dmabuf_bench(int frame_num)
+{
+	struct sync_stat	stat[2];
+	unsigned char		*pimage;
+	int			run_num;
+	int			i, ret = 0;
+
+	pimage = malloc(SRC_SIZE);
+	if (pimage == NULL) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	if (read_file(pimage, SRC_SIZE, SRC_FILENAME) == 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		free(pimage);
+		return -1;
+	}
+
+	/* cached buffers only where the exporter's sync writes them back */
+	run_num = vsp2_mem_cached_ok() ? 2 : 1;
+
+	memset(stat, 0, sizeof(stat));
+	for (i = 0; i < run_num && ret == 0; i++) {
+		stat[i].cached = (i == 1);
+		ret = run_dmabuf_bench(&stat[i], pimage, frame_num);
+	}
+	if (ret == 0)
+		print_sync_stat(stat, run_num, frame_num);
+
+	free(pimage);
+	return ret;
+}
+
+static int run_dmabuf_bench(struct sync_stat *pstat,
+			    const unsigned char *pimage, int frame_num)
+{
+	struct vsp2_media		*pmedia = NULL;
+	struct v4l2_requestbuffers	req_buf;
+	struct v4l2_buffer		buf;
+	struct v4l2_plane		planes[VIDEO_MAX_PLANES];
+	unsigned long			phys, hard;
+	unsigned long			src_virt = 0, dst_virt = 0;
+	unsigned long			flag;
+	MMNGR_ID			srcfd, dstfd;
+	unsigned int			type;
+	long long			t, t_frame;
+	int				src_mbid, dst_mbid;
+	int				src_dmafd = -1;
+	int				dst_dmafd = -1;
+	int				src_fd = -1;
+	int				dst_fd = -1;
+	int				ret = -1;
+	int				f;
+
+	vsp2_mem_pipeline(pstat->cached ? "uds dmabuf cached" :
+					  "uds dmabuf uncached");
+	flag = pstat->cached ? MMNGR_VA_SUPPORT_CACHED : MMNGR_VA_SUPPORT;
+
+	/*-------------------------------------------------------------------*/
+	/*  Pipeline, one DMABUF buffer per queue                            */
+	/*-------------------------------------------------------------------*/
+	if (open_pipe(&pmedia, &src_fd, &dst_fd) < 0)
+		goto out;
+
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.count	= 1;
+	req_buf.memory	= V4L2_MEMORY_DMABUF;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (ioctl(src_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+	req_buf.count	= 1;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		goto out;
+	}
+
+	ret = mmngr_alloc_in_user(&srcfd, SRC_SIZE, &phys, &hard, &src_virt,
+				  flag);
+	if (ret == 0)
+		ret = mmngr_export_start_in_user(&src_mbid, SRC_SIZE, hard,
+						 &src_dmafd);
+	if (ret != 0) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		ret = -1;
+		goto out;
+	}
+	ret = mmngr_alloc_in_user(&dstfd, DST_SIZE, &phys, &hard, &dst_virt,
+				  flag);
+	if (ret == 0)
+		ret = mmngr_export_start_in_user(&dst_mbid, DST_SIZE, hard,
+						 &dst_dmafd);
+	if (ret != 0) {
+		printf("error line=%d errcode=(%d)\n", __LINE__, ret);
+		ret = -1;
+		goto out;
+	}
+	ret = -1;
+
+	/*-------------------------------------------------------------------*/
+	/*  Frames : fill, QBUF, wait, read; the CPU access is synced        */
+	/*-------------------------------------------------------------------*/
+	for (f = 0; f < frame_num; f++) {
+		t_frame = get_time_us();
+
+		t = get_time_us();
+		if (vsp2_sync_begin(src_dmafd, VSP2_SYNC_WRITE) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		pstat->sync_us += get_time_us() - t;
+
+		t = get_time_us();
+		memcpy((void *)src_virt, pimage, SRC_SIZE);
+		pstat->fill_us += get_time_us() - t;
+
+		t = get_time_us();
+		if (vsp2_sync_end(src_dmafd, VSP2_SYNC_WRITE) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		pstat->sync_us += get_time_us() - t;
+
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.index	= 0;
+		buf.memory	= V4L2_MEMORY_DMABUF;
+		buf.length	= 1;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.m.planes[0].m.fd		= src_dmafd;
+		buf.m.planes[0].bytesused	= SRC_SIZE;
+		buf.m.planes[0].length		= SRC_SIZE;
+		buf.bytesused			= SRC_SIZE;
+		if (ioctl(src_fd, VIDIOC_QBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		buf.bytesused	= 0;
+		buf.m.planes[0].m.fd		= dst_dmafd;
+		buf.m.planes[0].bytesused	= DST_SIZE;
+		buf.m.planes[0].length		= DST_SIZE;
+		if (ioctl(dst_fd, VIDIOC_QBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+
+		if (f == 0) {
+			type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+			ret = ioctl(src_fd, VIDIOC_STREAMON, &type);
+			type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+			if (ret == 0)
+				ret = ioctl(dst_fd, VIDIOC_STREAMON, &type);
+			if (ret < 0) {
+				printf("error line=%d errno=(%d)\n",
+				       __LINE__, errno);
+				goto out;
+			}
+			ret = -1;
+		}
+
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.m.planes	= planes;
+		buf.memory	= V4L2_MEMORY_DMABUF;
+		buf.length	= VIDEO_MAX_PLANES;
+		buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		if (ioctl(dst_fd, VIDIOC_DQBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		buf.length	= VIDEO_MAX_PLANES;
+		if (ioctl(src_fd, VIDIOC_DQBUF, &buf) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+
+		t = get_time_us();
+		if (vsp2_sync_begin(dst_dmafd, VSP2_SYNC_READ) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		pstat->sync_us += get_time_us() - t;
+
+		t = get_time_us();
+		pstat->hash = calc_hash((void *)dst_virt, DST_SIZE);
+		pstat->read_us += get_time_us() - t;
+
+		t = get_time_us();
+		if (vsp2_sync_end(dst_dmafd, VSP2_SYNC_READ) < 0) {
+			printf("error line=%d errno=(%d)\n", __LINE__, errno);
+			goto out;
+		}
+		pstat->sync_us += get_time_us() - t;
+
+		t = get_time_us() - t_frame;
+		pstat->lat_sum += t;
+		if (t > pstat->lat_max)
+			pstat->lat_max = t;
+	}
+	ret = 0;
+
+out:
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (src_fd >= 0)
+		ioctl(src_fd, VIDIOC_STREAMOFF, &type);
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (dst_fd >= 0)
+		ioctl(dst_fd, VIDIOC_STREAMOFF, &type);
+
+	/* the driver lets go of the attachments before the export ends */
+	memset(&req_buf, 0, sizeof(req_buf));
+	req_buf.memory	= V4L2_MEMORY_DMABUF;
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	if (src_fd >= 0)
+		ioctl(src_fd, VIDIOC_REQBUFS, &req_buf);
+	req_buf.type	= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	if (dst_fd >= 0)
+		ioctl(dst_fd, VIDIOC_REQBUFS, &req_buf);
+
+	if (src_dmafd >= 0)
+		mmngr_export_end_in_user(src_mbid);
+	if (dst_dmafd >= 0)
+		mmngr_export_end_in_user(dst_mbid);
+	if (src_virt != 0)
+		mmngr_free_in_user(srcfd);
+	if (dst_virt != 0)
+		mmngr_free_in_user(dstfd);
+	if (src_fd >= 0)
+		close(src_fd);
+	if (dst_fd >= 0)
+		close(dst_fd);
+	vsp2_media_close(pmedia);
+	return ret;
+}
+
+static void print_sync_stat(const struct sync_stat *pstat, int run_num,
+			    int frame_num)
+{
+	const char	*pname[2] = { "uncached", "cached" };
+	int		i;
+
+	printf("\n----- DMABUF SYNC %d frames -----\n", frame_num);
+	printf("%-9s %10s %10s %9s %11s %9s\n", "buffers", "fill MB/s",
+	       "read MB/s", "sync us", "latency ms", "max ms");
+	for (i = 0; i < run_num; i++) {
+		printf("%-9s %10.0f %10.0f %9.1f %11.2f %9.2f\n", pname[i],
+		       pstat[i].fill_us ? SRC_SIZE * (double)frame_num /
+					  pstat[i].fill_us : 0,
+		       pstat[i].read_us ? DST_SIZE * (double)frame_num /
+					  pstat[i].read_us : 0,
+		       pstat[i].sync_us / (double)frame_num,
+		       pstat[i].lat_sum / 1000.0 / frame_num,
+		       pstat[i].lat_max / 1000.0);
+	}
+	if (run_num < 2)
+		printf("cached    : refused, the dmabuf sync is not seen to "
+		       "write the cache back\n");
+	else
+		printf("output    : %s\n", pstat[0].hash == pstat[1].hash ?
+		       "same" : "MISMATCH");
+	printf("----------------------\n");
+}
+
 /******************************************************************************
  *  dmabuf
  ******************************************************************************/
 static int test_uds_dmabuf(void)
 {
-	struct media_device  *pmedia;
+	struct vsp2_media  *pmedia;
 
 	unsigned char  *psrc_buf;
 	unsigned char  *pdst_buf;
@@ -1037,12 +1852,12 @@ static int test_uds_dmabuf(void)
 	int		dst_mbid;
 	int		dst_dmafd;
 
-	const char *pmedia_name;
-
 	/*-------------------------------------------------------------------*/
 	/* Call media-ctl                                                    */
 	/*-------------------------------------------------------------------*/
-	ret = call_media_ctl(&pmedia, &pmedia_name);
+	vsp2_trace_begin("media-ctl");
+	ret = call_media_ctl(&pmedia);
+	vsp2_trace_end();
 	if (ret < 0) {
 		printf("Error : media-ctl call failed.\n");
 		return -1;
@@ -1052,7 +1867,7 @@ static int test_uds_dmabuf(void)
 	/* Open device                                                       */
 	/*-------------------------------------------------------------------*/
 	/* src device(rpf.0) */
-	src_fd = open_video_device(pmedia, SRC_INPUT_DEV, pmedia_name);
+	src_fd = open_video_device(pmedia, SRC_INPUT_DEV);
 	if (src_fd == -1) {
 		printf("Error open src device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1060,7 +1875,7 @@ static int test_uds_dmabuf(void)
 	}
 
 	/* dst device(wpf.0) */
-	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV, pmedia_name);
+	dst_fd = open_video_device(pmedia, DST_OUTPUT_DEV);
 	if (dst_fd == -1) {
 		printf("Error open dst device: %s (%d).\n",
 			strerror(errno), errno);
@@ -1183,11 +1998,21 @@ static int test_uds_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Read file                                                        */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = read_file(psrc_buf, SRC_SIZE, SRC_FILENAME);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(src_dmafd, VSP2_SYNC_WRITE);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*-------------------------------------------------------------------*/
 	/*  VIDIOC_QBUF                                                      */
@@ -1353,11 +2178,21 @@ static int test_uds_dmabuf(void)
 	/*-------------------------------------------------------------------*/
 	/*  Write file                                                       */
 	/*-------------------------------------------------------------------*/
+	ret = vsp2_sync_begin(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 	ret = write_file(pdst_buf, DST_SIZE, DST_FILENAME_DMABUF);
 	if (ret == 0) {
 		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
+	ret = vsp2_sync_end(dst_dmafd, VSP2_SYNC_READ);
+	if (ret < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
 
 	/*********************************************************************
 	 *  src
@@ -1467,7 +2302,7 @@ static int test_uds_dmabuf(void)
 	close(src_fd);
 	close(dst_fd);
 
-	media_device_unref(pmedia);
+	vsp2_media_close(pmedia);
 
 	return 0;
 }
@@ -1484,6 +2319,8 @@ static int read_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("read file");
+
 	fp = fopen(pfilename, "rb");
 	if (fp == NULL) {
 		printf("file open error...\n");
@@ -1494,6 +2331,7 @@ static int read_file(
 			printf("buffer read error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
@@ -1506,6 +2344,8 @@ static int write_file(
 	FILE	*fp;
 	int	ret;
 
+	vsp2_trace_begin("write file");
+
 	/* file output */
 	fp = fopen(pfilename, "wb");
 	if (!fp) {
@@ -1517,144 +2357,164 @@ static int write_file(
 			printf("buffer write error...\n");
 		fclose(fp);
 	}
+	vsp2_trace_end();
 	return ret;
 }
 
-static int call_media_ctl(struct media_device **ppmedia,
-			  const char **ppmedia_name)
+static int open_pipe(struct vsp2_media **ppmedia, int *psrc_fd,
+		     int *pdst_fd)
 {
-	struct media_device		*pmedia;
-	struct media_link		*plink;
-	char				*endp;
-	struct dev_pads			rpfpad;
-	struct dev_pads			udspad;
-	struct dev_pads			wpfpad;
-	struct v4l2_mbus_framefmt	format;
-
-	const struct media_device_info	*pinfo;
-	char		*p;
-	const char	*pname;
-	char		buf[128];
+	struct v4l2_format	fmt;
+	int			src_fd, dst_fd;
 
-	/* Initialize v4l2 media controller */
-	pmedia = media_device_new(MEDIA_DEV_NAME);
-	if (!pmedia) {
-		printf("Error : media_device_new()\n");
+	/* the caller closes what was opened, also on an error */
+	if (call_media_ctl(ppmedia) < 0) {
+		printf("Error : media-ctl call failed.\n");
 		return -1;
 	}
-
-	*ppmedia = pmedia;
-
-	if (media_device_enumerate(pmedia) != 0) {
-		printf("Error : media_device_enumerate()\n");
+	src_fd = *psrc_fd = open_video_device(*ppmedia, SRC_INPUT_DEV);
+	dst_fd = *pdst_fd = open_video_device(*ppmedia, DST_OUTPUT_DEV);
+	if (src_fd < 0 || dst_fd < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
 
-	if (media_reset_links(pmedia) != 0) {
-		printf("Error : media_reset_links()\n");
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.width		= SRC_WIDTH;
+	fmt.fmt.pix_mp.height		= SRC_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+	if (ioctl(src_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
+		return -1;
+	}
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type			= V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	fmt.fmt.pix_mp.width		= DST_WIDTH;
+	fmt.fmt.pix_mp.height		= DST_HEIGHT;
+	fmt.fmt.pix_mp.field		= V4L2_FIELD_ANY;
+	fmt.fmt.pix_mp.pixelformat	= V4L2_PIX_FMT_ARGB32;
+	fmt.fmt.pix_mp.num_planes	= 1;
+	if (ioctl(dst_fd, VIDIOC_S_FMT, &fmt) < 0) {
+		printf("error line=%d errno=(%d)\n", __LINE__, errno);
 		return -1;
 	}
 
-	/* get media device name */
-	pinfo = media_get_info(pmedia);
-	p = strchr(pinfo->bus_info, ':');
-	if (p)
-		pname = p + 1;
-	else
-		pname = pinfo->bus_info;
+	return 0;
+}
 
-	*ppmedia_name = pname;
+static unsigned char *alloc_userptr(MMNGR_ID *pid, unsigned long size,
+				    bool huge)
+{
+	unsigned long	phys, hard, virt;
+	unsigned char	*p;
 
-	/*----------------------*/
-	/* rpf.0:1 -> uds.0:0   */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1 -> '%s uds.0':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(rpf -> uds)\n");
-		return -1;
+	if (huge) {
+		p = vsp2_mem_huge_alloc(size, &huge_kind);
+		if (p == NULL)
+			printf("Error : no hugepage memory (%lu bytes)\n", size);
+		return p;
 	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(rpf -> uds)\n");
-		return -1;
-	}
-	/*----------------------*/
-	/* uds.0:1 -> wpf.0:0   */
-	/*----------------------*/
-	sprintf(buf, "'%s uds.0':1 -> '%s wpf.0':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(uds -> wpf)\n");
-		return -1;
+
+	if (mmngr_alloc_in_user(pid, size, &phys, &hard, &virt,
+				MMNGR_VA_SUPPORT) != 0)
+		return NULL;
+	return (unsigned char *)virt;
+}
+
+static int free_userptr(MMNGR_ID id, unsigned char *pbuf,
+			unsigned long size, bool huge)
+{
+	if (huge)
+		return vsp2_mem_huge_free(pbuf, size);
+	return mmngr_free_in_user(id);
+}
+
+static unsigned long long calc_hash(const void *pdata, size_t len)
+{
+	const unsigned long long	*p = pdata;
+	unsigned long long		hash = 0xcbf29ce484222325ULL;
+
+	/* FNV-1a over 64 bit words : bound by the reads, not the bytes */
+	for (len /= sizeof(*p); len > 0; len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
 	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(uds -> wpf)\n");
-		return -1;
+	return hash;
+}
+
+static int profile_mem_type(void)
+{
+	struct vsp2_profile	prof;
+	char			key[VSP2_PROFILE_MODULE_LEN];
+
+	/* the key tune writes for this scale : uds:<dst w>x<dst h> */
+	snprintf(key, sizeof(key), "uds:%dx%d", DST_WIDTH, DST_HEIGHT);
+	if (vsp2_profile_load(MEDIA_DEV_NAME, key, SRC_WIDTH, SRC_HEIGHT,
+			      &prof) < 0)
+		return 0;
+
+	printf("profile : %s, %.1f fps when tuned\n",
+	       vsp2_profile_memory_name(prof.memory), prof.fps);
+	switch (prof.memory) {
+	case V4L2_MEMORY_USERPTR:
+		return 'u';
+	case V4L2_MEMORY_DMABUF:
+		return 'd';
+	default:
+		return 'm';
 	}
-	/*----------------------*/
-	/* wpf.0:1 -> output    */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1 -> '%s wpf.0 output':0", pname, pname);
-	plink = media_parse_link(pmedia, buf, &endp);
-	if (plink == NULL) {
-		printf("Error : media_parse_link(wpf -> output)\n");
+}
+
+static long long get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int call_media_ctl(struct vsp2_media **ppmedia)
+{
+	struct vsp2_media		*pmedia;
+	struct v4l2_mbus_framefmt	format;
+
+	/* Initialize v4l2 media controller */
+	pmedia = vsp2_media_open(MEDIA_DEV_NAME);
+	if (!pmedia) {
+		printf("Error : vsp2_media_open()\n");
 		return -1;
 	}
-	/*----------------------*/
-	if (media_setup_link(pmedia, plink->source, plink->sink, 1) != 0) {
-		printf("Error : media_setup_link(wpf -> output)\n");
+
+	*ppmedia = pmedia;
+
+	if (vsp2_media_reset_links(pmedia) != 0) {
+		printf("Error : vsp2_media_reset_links()\n");
 		return -1;
 	}
 
-	/*-------------------------------------------------- get pads */
 	/*----------------------*/
-	/* rpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':0", pname);
-	rpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 0)\n");
-		return -1;
-	}
+	/* rpf.0:1 -> uds.0:0   */
 	/*----------------------*/
-	sprintf(buf, "'%s rpf.0':1", pname);
-	rpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (rpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(rpf pad 1)\n");
+	if (vsp2_media_setup_link(pmedia, "rpf.0", 1, "uds.0", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(rpf -> uds)\n");
 		return -1;
 	}
 	/*----------------------*/
-	/* uds pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s uds.0':0", pname);
-	udspad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (udspad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(uds pad 0)\n");
-		return -1;
-	}
+	/* uds.0:1 -> wpf.0:0   */
 	/*----------------------*/
-	sprintf(buf, "'%s uds.0':1", pname);
-	udspad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (udspad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(uds pad 1)\n");
+	if (vsp2_media_setup_link(pmedia, "uds.0", 1, "wpf.0", 0, true) != 0) {
+		printf("Error : vsp2_media_setup_link(uds -> wpf)\n");
 		return -1;
 	}
 	/*----------------------*/
-	/* wpf pad              */
-	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':0", pname);
-	wpfpad.ppad0 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad0 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 0)\n");
-		return -1;
-	}
+	/* wpf.0:1 -> output    */
 	/*----------------------*/
-	sprintf(buf, "'%s wpf.0':1", pname);
-	wpfpad.ppad1 = media_parse_pad(pmedia, buf, NULL);
-	if (wpfpad.ppad1 == NULL) {
-		printf("Error : media_parse_pad(wpf pad 1)\n");
+	if (vsp2_media_setup_link(pmedia, "wpf.0", 1, "wpf.0 output", 0,
+				  true) != 0) {
+		printf("Error : vsp2_media_setup_link(wpf -> output)\n");
 		return -1;
 	}
 
@@ -1665,26 +2525,23 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= SRC_WIDTH;
 	format.height	= SRC_HEIGHT;
 	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(rpfpad.ppad0->entity, &format,
-		rpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* rpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(rpfpad.ppad1->entity, &format,
-		rpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(rpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "rpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(rpf pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* uds.0:0              */
 	/*----------------------*/
 	format.code = V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(udspad.ppad0->entity, &format,
-		udspad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(uds pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "uds.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(uds pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
@@ -1693,45 +2550,34 @@ static int call_media_ctl(struct media_device **ppmedia,
 	format.width	= DST_WIDTH;
 	format.height	= DST_HEIGHT;
 	format.code	= V4L2_MBUS_FMT_ARGB8888_1X32;
-	if (v4l2_subdev_set_format(udspad.ppad1->entity, &format,
-		udspad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(uds pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "uds.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(uds pad 1)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:0              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad0->entity, &format,
-		wpfpad.ppad0->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 0)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 0, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 0)\n");
 		return -1;
 	}
 	/*----------------------*/
 	/* wpf.0:1              */
 	/*----------------------*/
-	if (v4l2_subdev_set_format(wpfpad.ppad1->entity, &format,
-		wpfpad.ppad1->index, V4L2_SUBDEV_FORMAT_ACTIVE) != 0) {
-		printf("Error : v4l2_subdev_set_format(wpf pad 1)\n");
+	if (vsp2_media_set_format(pmedia, "wpf.0", 1, &format) != 0) {
+		printf("Error : vsp2_media_set_format(wpf pad 1)\n");
 		return -1;
 	}
 	return 0;
 }
 
-static int open_video_device(struct media_device *pmedia, char *pentity_base,
-			     const char *pmedia_name)
+static int open_video_device(struct vsp2_media *pmedia, const char *pentity)
 {
-	char entity_name[32];
-	const char *pdevname;
-	struct media_entity *pentity;
+	int fd;
 
-	snprintf(entity_name, sizeof(entity_name), pentity_base, pmedia_name);
-	pentity = media_get_entity_by_name(pmedia, entity_name,
-					   strlen(entity_name));
-	if (!pentity) {
-		printf("Error media_get_entity(%s)\n", entity_name);
-		return -1;
-	}
-	pdevname = media_entity_get_devname(pentity);
+	fd = vsp2_media_open_node(pmedia, pentity, O_RDWR);
+	if (fd < 0 && errno == ENOENT)
+		printf("Error vsp2_media_open_node(%s)\n", pentity);
 
-	return open(pdevname, O_RDWR);
+	return fd;
 }